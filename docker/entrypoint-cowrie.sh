@@ -2,12 +2,16 @@
 # Cowrie entrypoint - copies dynamic commands before starting
 
 # Copy dynamic commands into container filesystem
-if [ -d "/data/cowrie-dynamic" ]; then
+# (current -> gen-NNNNNN is swapped by the morph engine once a generation is complete)
+DYNAMIC=/data/cowrie-dynamic.d/current
+if [ -d "$DYNAMIC" ]; then
     echo "[*] Installing dynamic commands..."
-    cp -f /data/cowrie-dynamic/bin/* /cowrie/cowrie-git/share/cowrie/honeyfs/usr/bin/ 2>/dev/null || true
-    cp -f /data/cowrie-dynamic/bin/* /cowrie/cowrie-git/share/cowrie/honeyfs/bin/ 2>/dev/null || true
-    cp -f /data/cowrie-dynamic/sbin/* /cowrie/cowrie-git/share/cowrie/honeyfs/sbin/ 2>/dev/null || true
-    cp -f /data/cowrie-dynamic/usr/bin/* /cowrie/cowrie-git/share/cowrie/honeyfs/usr/bin/ 2>/dev/null || true
+    cp -f $DYNAMIC/bin/* /cowrie/cowrie-git/share/cowrie/honeyfs/usr/bin/ 2>/dev/null || true
+    cp -f $DYNAMIC/bin/* /cowrie/cowrie-git/share/cowrie/honeyfs/bin/ 2>/dev/null || true
+    cp -f $DYNAMIC/sbin/* /cowrie/cowrie-git/share/cowrie/honeyfs/sbin/ 2>/dev/null || true
+    cp -f $DYNAMIC/usr/bin/* /cowrie/cowrie-git/share/cowrie/honeyfs/usr/bin/ 2>/dev/null || true
+    # /proc comes from the same device state as ps and top
+    cp -rf $DYNAMIC/proc/. /cowrie/cowrie-git/share/cowrie/honeyfs/proc/ 2>/dev/null || true
 fi
 
 # Ensure proper Cowrie config
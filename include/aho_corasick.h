@@ -0,0 +1,33 @@
+#ifndef AHO_CORASICK_H
+#define AHO_CORASICK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define AC_MAX_GROUPS 64  // Match results are a bitmask of groups
+
+// Case-insensitive multi-pattern matcher. Each pattern belongs to a group
+// (e.g. one attack pattern with many signatures); a match reports which
+// groups occur anywhere in the text. Read-only once compiled, so one
+// automaton can be shared by any number of threads.
+typedef struct {
+    char** patterns;          // Added patterns, owned
+    uint8_t* pattern_groups;
+    int pattern_count;
+    int pattern_capacity;
+    uint8_t byte_class[256];  // Byte -> column; bytes in no pattern share column 0
+    int class_count;
+    int32_t* delta;           // Full transition table, state_count x class_count
+    uint64_t* output;         // Groups matched on reaching each state
+    int state_count;
+    bool compiled;
+} ac_automaton_t;
+
+int ac_init(ac_automaton_t* ac);
+void ac_free(ac_automaton_t* ac);
+int ac_add(ac_automaton_t* ac, const char* pattern, int group);
+int ac_compile(ac_automaton_t* ac);
+uint64_t ac_match(const ac_automaton_t* ac, const char* text, size_t len);
+
+#endif // AHO_CORASICK_H
@@ -0,0 +1,52 @@
+#ifndef COWRIE_JSON_H
+#define COWRIE_JSON_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+#include "quorum.h"
+
+#define COWRIE_MAX_EVENTID 48
+#define COWRIE_MAX_SESSION 32
+#define COWRIE_MAX_CREDENTIAL 64
+#define COWRIE_MAX_INPUT 256
+
+// Cowrie eventids quorum cares about
+typedef enum {
+    COWRIE_EVENT_OTHER = 0,
+    COWRIE_EVENT_CONNECT,        // cowrie.session.connect
+    COWRIE_EVENT_LOGIN_FAILED,   // cowrie.login.failed
+    COWRIE_EVENT_LOGIN_SUCCESS,  // cowrie.login.success
+    COWRIE_EVENT_COMMAND,        // cowrie.command.input / cowrie.command.failed
+    COWRIE_EVENT_FILE_DOWNLOAD,  // cowrie.session.file_download
+    COWRIE_EVENT_CLOSED          // cowrie.session.closed
+} cowrie_event_type_t;
+
+// One line of cowrie.json, reduced to the fields quorum uses.
+// String fields are truncated to their buffers and always NUL-terminated.
+typedef struct {
+    cowrie_event_type_t type;
+    char eventid[COWRIE_MAX_EVENTID];
+    char src_ip[MAX_IP_STRING];  // Canonical form when has_addr is set
+    ip_addr_t addr;
+    bool has_addr;
+    char session[COWRIE_MAX_SESSION];
+    char username[COWRIE_MAX_CREDENTIAL];
+    char password[COWRIE_MAX_CREDENTIAL];
+    char input[COWRIE_MAX_INPUT];  // Command line for command events (stored copy, truncated)
+    const char* input_json;        // The whole "input" value in the line, quotes included;
+    size_t input_json_len;         // NULL if absent. Valid only while the line is.
+    time_t timestamp;              // 0 if missing or unparseable
+} cowrie_event_t;
+
+// Parse one JSON line. Returns 0 on success, -1 if it is not a cowrie event.
+int cowrie_json_parse_line(const char* line, size_t len, cowrie_event_t* event);
+cowrie_event_type_t cowrie_event_type(const char* eventid);
+
+// The whole command line of an event whose input did not fit event->input,
+// decoded into a malloc()ed string. NULL if event->input already holds all
+// of it (or memory runs out) - use event->input then.
+char* cowrie_event_full_input(const cowrie_event_t* event);
+time_t cowrie_parse_timestamp(const char* timestamp);
+
+#endif // COWRIE_JSON_H
@@ -0,0 +1,31 @@
+#ifndef HONEYFS_H
+#define HONEYFS_H
+
+// Native honeyfs builder.
+//
+// Each profile under HONEYFS_PROFILES_DIR has a manifest listing the
+// directories, files and symlinks of its fake filesystem. honeyfs_build()
+// makes the honeyfs tree match it, touching only what changed.
+
+#define HONEYFS_DIR "services/cowrie/honeyfs"
+#define HONEYFS_PROFILES_DIR "services/cowrie/honeyfs-profiles"
+#define HONEYFS_MANIFEST "manifest"
+#define HONEYFS_RECORD ".cerberus-honeyfs"   // Paths the last build created, in dest
+#define HONEYFS_MAX_ENTRIES 256
+#define HONEYFS_PATH 256
+
+typedef struct {
+    int created;        // Paths that did not exist
+    int updated;        // Replaced because their content changed
+    int unchanged;      // Content hash matched, left alone
+    int linked;         // Of created + updated: reflinked, not copied
+    int removed;        // Left over from the previous manifest
+} honeyfs_stats_t;
+
+// Build dest_dir from profiles_root/profile/manifest. File sources are
+// relative to profiles_root. stats may be NULL. Returns 0 on success, -1 if
+// the manifest is missing or malformed or any entry could not be placed.
+int honeyfs_build(const char* profiles_root, const char* profile, const char* dest_dir,
+                  honeyfs_stats_t* stats);
+
+#endif // HONEYFS_H
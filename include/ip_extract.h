@@ -0,0 +1,34 @@
+#ifndef IP_EXTRACT_H
+#define IP_EXTRACT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "quorum.h"
+
+// Most addresses reported from a single log line
+#define IP_EXTRACT_MAX 8
+
+// One address found in a line
+typedef struct {
+    ip_addr_t addr;
+    uint32_t offset;  // Start of the address text within the line
+    uint32_t length;  // Length of the address text
+} ip_match_t;
+
+// Anchor scanners. IP_SCAN_AUTO picks the widest one the CPU supports.
+typedef enum {
+    IP_SCAN_AUTO = 0,
+    IP_SCAN_SCALAR,
+    IP_SCAN_SSE2,
+    IP_SCAN_AVX2
+} ip_scan_impl_t;
+
+// Extraction. line does not need to be NUL-terminated.
+int ip_extract_all(const char* line, size_t len, ip_match_t* out, int max_out);
+int ip_extract_first(const char* line, size_t len, ip_addr_t* out);
+
+// Scanner selection (benchmarks and tests). Returns -1 if the CPU lacks it.
+int ip_extract_set_impl(ip_scan_impl_t impl);
+const char* ip_extract_impl_name(void);
+
+#endif // IP_EXTRACT_H
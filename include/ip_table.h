@@ -0,0 +1,45 @@
+#ifndef IP_TABLE_H
+#define IP_TABLE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include "quorum.h"
+
+// Open-addressing hash table of tracked IPs, keyed on the binary address.
+// Entries live in a dense pool (so they can be walked by index); the hash
+// slots only hold pool indices. When the table is full the least recently
+// seen IP is evicted.
+typedef struct {
+    ip_tracking_t* entries;  // Dense pool, entries[0..count) are live
+    int32_t* slots;          // Linear-probing index into entries, -1 = empty
+    uint32_t slot_mask;      // Slot count - 1 (power of two)
+    int count;
+    int allocated;           // Pool entries currently allocated
+    int capacity;            // Maximum live entries
+    int32_t lru_head;        // Most recently seen
+    int32_t lru_tail;        // Next to be evicted
+    uint64_t seed;           // Per-table hash seed
+    uint64_t evictions;      // Entries dropped to make room for new ones
+} ip_table_t;
+
+// Table lifecycle
+int ip_table_init(ip_table_t* table, int capacity);
+void ip_table_free(ip_table_t* table);
+void ip_table_clear(ip_table_t* table);
+
+// Lookup and update. Pointers stay valid until the next insert or removal.
+ip_tracking_t* ip_table_find(ip_table_t* table, const ip_addr_t* addr);
+ip_tracking_t* ip_table_touch(ip_table_t* table, const ip_addr_t* addr, time_t when,
+                              bool* created);
+int ip_table_expire(ip_table_t* table, time_t older_than);
+ip_tracking_t* ip_table_get(ip_table_t* table, int index);
+
+// Address helpers
+bool ip_addr_parse(const char* str, ip_addr_t* addr);
+void ip_addr_format(const ip_addr_t* addr, char* out, size_t out_size);
+void ip_addr_from_ipv4(uint32_t host_order, ip_addr_t* addr);
+bool ip_addr_is_ipv4(const ip_addr_t* addr);
+
+#endif // IP_TABLE_H
@@ -0,0 +1,40 @@
+#ifndef LOG_CURSOR_H
+#define LOG_CURSOR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+// Number of leading bytes hashed to recognise a file that was replaced in place
+#define LOG_CURSOR_FINGERPRINT_BYTES 256
+
+// Persistent read position inside one log file.
+// The cursor only ever advances past complete lines: an unterminated tail is
+// carried over to the next read by leaving the offset at the start of it.
+typedef struct {
+    ino_t inode;               // Inode of the file the offset refers to (0 = never read)
+    off_t offset;              // First byte not yet parsed
+    uint32_t fingerprint;      // FNV-1a of the first fingerprint_len bytes
+    uint32_t fingerprint_len;  // How many bytes the fingerprint covers
+} log_cursor_t;
+
+// Called once per log line. The line is not NUL-terminated and excludes '\n'.
+typedef void (*log_line_handler_t)(const char* line, size_t len, void* ctx);
+
+// Cursor functions
+void log_cursor_reset(log_cursor_t* cursor);
+int log_cursor_read(log_cursor_t* cursor, const char* filepath,
+                    log_line_handler_t handler, void* ctx);
+uint32_t log_cursor_hash(const char* data, size_t len, uint32_t seed);
+
+// Split reading, for parsing one log in several line-aligned ranges at once:
+// begin() on one thread, read_range() per range, commit() the total consumed
+int log_cursor_begin(log_cursor_t* cursor, const char* filepath,
+                     log_line_handler_t handler, void* ctx, off_t* end);
+off_t log_cursor_read_range(const char* filepath, off_t start, off_t end,
+                            log_line_handler_t handler, void* ctx);
+off_t log_cursor_align(const char* filepath, off_t pos, off_t end);
+void log_cursor_commit(log_cursor_t* cursor, const char* filepath, off_t consumed);
+
+#endif // LOG_CURSOR_H
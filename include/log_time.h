@@ -0,0 +1,14 @@
+#ifndef LOG_TIME_H
+#define LOG_TIME_H
+
+#include <stddef.h>
+#include <time.h>
+
+// Event time of a log line, from the first timestamp near its start.
+// Understands ISO 8601 ("2024-03-12T08:15:02.123Z", "2024-03-12 08:15:02"),
+// common log format ("[12/Mar/2024:08:15:02 +0000]") and syslog
+// ("Mar 12 08:15:02"). Timestamps without a zone are local time.
+// Returns 0 if the line has no recognisable timestamp.
+time_t log_time_parse(const char* line, size_t len);
+
+#endif // LOG_TIME_H
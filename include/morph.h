@@ -1,6 +1,8 @@
 #ifndef MORPH_H
 #define MORPH_H
 
+#include "template.h"
+
 #define MAX_PROFILES 10
 #define MAX_PROFILE_NAME 64
 #define MAX_BANNER_SIZE 512
@@ -27,14 +29,43 @@ int get_profile_count(void);
 device_profile_t* get_profile(int index);
 int get_current_profile_index(void);
 int set_current_profile(int index);
+const char* get_profile_type(const char* device_name);   // "camera" or "router"
 
 // Morphing functions
 int morph_device(void);
-int morph_cowrie_banners(const device_profile_t* profile);
-int morph_router_html(const device_profile_t* profile);
-int morph_camera_html(const device_profile_t* profile);
+// Stage the Cowrie config, /etc/issue and web pages under out_dir,
+// mirroring their live paths; morph_device() installs them once the
+// generation is published. The hostname and kernel come from out_dir's
+// boot_info.conf, so phase 1 must have run there first. buffer is the
+// morph's render buffer, shared so it is only allocated while it grows.
+int morph_cowrie_banners(const device_profile_t* profile, const char* out_dir, template_buffer_t* buffer);
+int morph_router_html(const device_profile_t* profile, const char* out_dir, template_buffer_t* buffer);
+int morph_camera_html(const device_profile_t* profile, const char* out_dir, template_buffer_t* buffer);
 int save_current_profile(const char* state_file);
 
+// Phase scheduling
+#define MORPH_PHASE_COUNT 3
+
+typedef enum {
+    MORPH_PHASE_PENDING,
+    MORPH_PHASE_OK,
+    MORPH_PHASE_FAILED,
+    MORPH_PHASE_SKIPPED     // A phase it depends on failed
+} morph_phase_status_t;
+
+typedef struct {
+    const char* name;
+    morph_phase_status_t status;
+    int result;             // What the phase returned
+    long elapsed_ms;
+} morph_phase_report_t;
+
+// Runs phases 1-3, independent ones at the same time, writing their outputs
+// under out_dir. Fills one report per phase; returns 0 if every phase
+// succeeded, -1 otherwise.
+int morph_run_phases(const device_profile_t* profile, const char* out_dir,
+                     morph_phase_report_t reports[MORPH_PHASE_COUNT]);
+
 // Session variation functions
 void generate_random_mac(char* mac_out, size_t size, const char* vendor_prefix);
 int generate_session_variations(const device_profile_t* profile);
@@ -0,0 +1,42 @@
+#ifndef MORPH_STAGE_H
+#define MORPH_STAGE_H
+
+// Staged publishing of morph outputs.
+//
+// A morph builds a complete generation in its own directory under
+// MORPH_STAGE_ROOT, syncs it to disk, then swaps the "current" symlink in
+// one rename(). Readers go through MORPH_DYNAMIC_DIR (a symlink to
+// MORPH_STAGE_ROOT/current) and see the old device or the new one, never
+// a mix of the two.
+
+#define MORPH_DYNAMIC_DIR "build/cowrie-dynamic"
+#define MORPH_STAGE_ROOT "build/cowrie-dynamic.d"
+#define MORPH_STAGE_KEEP 2          // Generations kept: current + previous
+#define MORPH_STAGE_PATH 512
+
+typedef struct {
+    char root[MORPH_STAGE_PATH];
+    char dir[MORPH_STAGE_PATH];     // Generation being built
+    unsigned long generation;
+    int lock_fd;                    // flock() on dir until publish or abort
+} morph_stage_t;
+
+// Create the next generation directory under root, seeded with a copy of
+// seed_dir (the live outputs) if it exists. Returns 0 on success.
+int morph_stage_begin(morph_stage_t* stage, const char* root, const char* seed_dir);
+
+// fsync the generation, make it current, and point link_path at
+// root/current. Returns 0 on success; on failure nothing readers see changes.
+int morph_stage_publish(morph_stage_t* stage, const char* link_path);
+
+// Throw away a generation that will not be published
+void morph_stage_abort(morph_stage_t* stage);
+
+// Remove generations older than the newest `keep` (counting current) and
+// anything left over from failed runs: every other generation that is
+// neither current nor `building` (the one in progress, may be NULL).
+// Generations another morph still holds locked are left alone.
+// Returns the number removed.
+int morph_stage_cleanup(const char* root, int keep, const morph_stage_t* building);
+
+#endif // MORPH_STAGE_H
@@ -0,0 +1,35 @@
+#ifndef MORPH_STATE_H
+#define MORPH_STATE_H
+
+// Renders a morph's device artifacts from one state engine state.
+//
+// Kept out of morph.c on purpose: state_engine.h and morph.h each define
+// their own device_profile_t, so only this file includes the state engine.
+
+#include "template.h"
+
+typedef struct {
+    const char* name;               // Matched against the state engine's builtin profiles
+    const char* kernel_version;     // Overrides below: NULL or 0 keeps the builtin value
+    const char* ssh_banner;
+    const char* telnet_banner;
+    const char* arch;               // uname -m name, e.g. "mips" or "armv7l"
+    const char* mac_prefix;         // Vendor octets, e.g. "14:cc:20"
+    int memory_mb;
+    int cpu_mhz;
+    int is_camera;                  // Device type when an unknown name falls back to Generic_IoT
+    const char* type;               // "router" or "camera", for template lookup
+    template_cache_t* templates;    // boot_info.conf and etc/network/interfaces
+} morph_identity_t;
+
+// Compile the templates morph_state_render() uses for a profile, so the
+// first morph does not pay for parsing. Returns -1 if any is missing or
+// does not compile.
+int morph_state_load_templates(template_cache_t* templates, const char* profile, const char* type);
+
+// Build one state for identity and write every artifact (ps, top, uptime,
+// dmesg, ifconfig, df, passwd, /proc/...) under out_dir.
+// Returns 0 on success, -1 if the state or any artifact could not be made.
+int morph_state_render(const morph_identity_t* identity, const char* out_dir);
+
+#endif // MORPH_STATE_H
@@ -2,27 +2,43 @@
 #define QUORUM_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <time.h>
+#include "log_cursor.h"
+#include "time_window.h"
 
-#define MAX_IPS 1000
+#define DEFAULT_IP_CAPACITY 65536  // Distinct IPs tracked before the oldest is evicted
 #define MAX_IP_STRING 46  // IPv6 max length
-#define MAX_SERVICES 10
+#define MAX_SERVICES 10   // Must fit in ip_tracking_t.service_mask
 #define MAX_SERVICE_NAME 64
 #define MAX_LOG_LINE 2048
 
+// Binary IP address; IPv4 is stored IPv4-mapped (::ffff:a.b.c.d)
 typedef struct {
+    uint8_t bytes[16];
+} ip_addr_t;
+
+typedef struct {
+    ip_addr_t addr;
     char ip[MAX_IP_STRING];
+    uint32_t service_mask;  // Bit i set = seen in service_configs[i]
     int service_count;
-    char services[MAX_SERVICES][MAX_SERVICE_NAME];
     time_t first_seen;
     time_t last_seen;
     int hit_count;
+    bool alerted;  // Already reported, don't alert again on later passes
+    time_t service_seen[MAX_SERVICES];  // Latest event time per service
+    hit_ring_t windows[MAX_WINDOWS];    // Hits per configured sliding window
+    uint8_t window_alerted;  // Bit w set = reported for window w until it lapses
+    int32_t lru_prev;  // Recency list links, maintained by ip_table.c
+    int32_t lru_next;
 } ip_tracking_t;
 
 typedef struct {
     char name[MAX_SERVICE_NAME];
     char log_path[MAX_LOG_LINE];
     bool enabled;
+    log_cursor_t cursor;  // Where the previous pass stopped reading
 } service_config_t;
 
 // Quorum detection functions
@@ -34,11 +50,17 @@ int extract_ip_from_line(const char* line, char* ip_out);
 bool is_ip_in_tracking(const char* ip);
 int add_ip_to_tracking(const char* ip, const char* service);
 int generate_alert(const ip_tracking_t* ip_track);
+const char* get_service_name(int index);
 
 // Configuration
 int load_service_configs(const char* config_file);
 int add_service_config(const char* name, const char* log_path);
 
+// Incremental scanning. Cursors resume from the --state snapshot; the
+// cursor file is a text export of them for other tools.
+int save_service_cursors(const char* cursor_file);
+int run_follow_mode(void);
+
 // Statistics
 int get_tracked_ip_count(void);
 ip_tracking_t* get_tracked_ip(int index);
@@ -1,12 +1,18 @@
 #ifndef QUORUM_ADAPT_H
 #define QUORUM_ADAPT_H
 
+#include <stddef.h>
 #include <time.h>
 #include <stdint.h>
 #include <stdbool.h>
 
-#define MAX_ATTACK_PATTERNS 50
-#define MAX_ATTACKERS 100
+#define MAX_ATTACK_PATTERNS 50     // Must fit in attacker_profile_t.pattern_mask
+#define MAX_ATTACKERS 65536        // Profiles kept before new sources are ignored
+#define MAX_PROFILE_CREDENTIALS 16 // Distinct credentials that make up a fingerprint
+#define MAX_PROFILE_COMMANDS 32    // Leading commands that make up a fingerprint
+#define COORDINATION_WINDOW 300    // Seconds between look-alike sources
+#define MAX_SIGNATURE_NAME 64
+#define DEFAULT_SIGNATURE_FILE "signatures.conf"
 
 // Attack pattern signature
 typedef struct {
@@ -17,11 +23,12 @@ typedef struct {
     uint32_t occurrence_count;
     time_t first_seen;
     time_t last_seen;
+    uint32_t id;  // 1-based registry slot, 0 if not registered
 } attack_pattern_t;
 
 // Attacker profile
 typedef struct {
-    char ip_address[32];
+    char ip_address[46];
     uint32_t total_attempts;
     uint32_t failed_attempts;
     uint32_t successful_exploits;
@@ -30,6 +37,12 @@ typedef struct {
     bool is_coordinated;  // Part of coordinated attack?
     attack_pattern_t* patterns[10];
     int pattern_count;
+    uint64_t pattern_mask;       // Bit (id - 1) per registered pattern seen
+    uint64_t credentials[MAX_PROFILE_CREDENTIALS];  // Distinct user/password hashes
+    int credential_count;
+    uint64_t credential_hash;    // Order-independent hash of credentials[], 0 if none
+    uint64_t command_hash;       // Rolling hash of the first commands, 0 if none
+    int command_count;
 } attacker_profile_t;
 
 // Global threat assessment
@@ -68,4 +81,26 @@ float calculate_threat_score(attacker_profile_t* attacker);
 void free_attack_pattern(attack_pattern_t* pattern);
 void free_attacker_profile(attacker_profile_t* profile);
 
+// Attacker registry - one profile per source IP, fed by structured events
+attacker_profile_t* get_attacker_profile(const char* ip);
+attacker_profile_t* find_attacker_profile(const char* ip);
+int get_attacker_profiles(attacker_profile_t*** profiles);
+attack_pattern_t* get_attack_pattern(const char* name);
+int get_attack_patterns(attack_pattern_t*** patterns);
+void add_pattern_to_attacker(attacker_profile_t* attacker, attack_pattern_t* pattern);
+uint64_t hash_credential(const char* username, const char* password);
+uint64_t hash_credential_set(const uint64_t* credentials, int count);
+uint64_t hash_command(const char* command);
+void add_credential_to_attacker(attacker_profile_t* attacker, uint64_t credential);
+void add_command_to_attacker(attacker_profile_t* attacker, uint64_t command);
+const char* classify_command(const char* command);
+
+// Signature matching - one pass over a line finds every signature group in it
+int load_attack_signatures(const char* path);
+uint64_t match_attack_signatures(const char* text, size_t len);
+const char* get_signature_name(int group);
+attack_pattern_t* get_signature_pattern(int group);
+void free_attack_signatures(void);
+void reset_attacker_registry(void);
+
 #endif // QUORUM_ADAPT_H
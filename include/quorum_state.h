@@ -0,0 +1,26 @@
+#ifndef QUORUM_STATE_H
+#define QUORUM_STATE_H
+
+#include "ip_table.h"
+#include "quorum.h"
+
+#define QUORUM_STATE_VERSION 1
+
+// The quorum engine's live state, as handed to the snapshot writer/reader.
+// Attacker profiles and patterns come from the quorum_adapt registry.
+typedef struct {
+    ip_table_t* ips;
+    service_config_t* services;
+    int service_count;
+    const int* window_seconds;  // Ring contents are only kept if these match
+    int window_count;
+} quorum_state_t;
+
+// Write a snapshot atomically (temp file + rename). Returns 0 on success.
+int quorum_state_save(const char* path, const quorum_state_t* state);
+
+// Restore a snapshot into empty tables. Returns the number of IPs restored,
+// or -1 if the file is missing, from another version, or damaged.
+int quorum_state_load(const char* path, quorum_state_t* state);
+
+#endif // QUORUM_STATE_H
@@ -0,0 +1,193 @@
+/**
+ * state_compact.h - Compact, string-interned form of a system state
+ * ============================================================================
+ *
+ * WHY A SECOND LAYOUT:
+ * system_state_t sizes its records for the worst case: 256-byte paths and
+ * link targets, 256 log lines of 512 bytes, fixed process and user tables,
+ * and so on. A real fake device fills a few percent of that, yet each
+ * state costs hundreds of KB and every init/morph walks all of it.
+ *
+ * state_compact_t keeps the same facts in what they actually need:
+ * - Strings live once in a pool and are referenced by 32-bit handles.
+ *   Identical strings ("root", "?", "/bin/false") are stored once, and a
+ *   file's name is a handle into the middle of its path.
+ * - Tables are sized to their contents.
+ * - Fields the generators scan on every call (pid, ppid, uid, state,
+ *   memory) are separate arrays, so `ps` walks a few dense cache lines
+ *   instead of striding over 400-byte records.
+ *
+ * The full struct stays the working form for morphing and mutation; a
+ * compact state is built from one and can be expanded back. Long-lived
+ * devices can be parked compactly and served straight from this form.
+ *
+ * ============================================================================
+ */
+
+#ifndef STATE_COMPACT_H
+#define STATE_COMPACT_H
+
+#include <stddef.h>
+#include "state_engine.h"
+
+/* Handle into a string pool. 0 is always the empty string. */
+typedef uint32_t str_handle_t;
+
+typedef struct {
+    char* data;                 /* NUL-terminated strings back to back */
+    uint32_t size;
+    uint32_t capacity;
+    uint32_t* slots;            /* Open-addressed intern table: handle + 1, 0 = empty */
+    uint32_t slot_mask;
+    uint32_t count;             /* Distinct strings */
+} string_pool_t;
+
+/* Process flags */
+#define COMPACT_PROC_KERNEL     0x01
+#define COMPACT_PROC_SERVICE    0x02
+#define COMPACT_PROC_VISIBLE    0x04
+
+/* File flags */
+#define COMPACT_FILE_DYNAMIC    0x01
+#define COMPACT_FILE_ATTACKER   0x02
+#define COMPACT_FILE_DELETED    0x04
+
+typedef struct {
+    /* Identity and derived values */
+    device_profile_t profile;
+    str_handle_t hostname;
+    uint32_t state_seed;
+    state_rng_t rng;
+    time_t boot_time;
+    uint32_t uptime_seconds;
+    pid_t next_pid;
+    uint32_t total_memory_kb;
+    uint32_t used_memory_kb;
+    uint32_t cached_memory_kb;
+    uint32_t buffer_memory_kb;
+    uint16_t cpu_usage_percent;
+    uint16_t load_avg_1;
+    uint16_t load_avg_5;
+    uint16_t load_avg_15;
+
+    string_pool_t strings;
+
+    /* Processes - hot columns */
+    int process_count;
+    pid_t* pid;
+    pid_t* ppid;
+    uid_t* proc_uid;
+    uint8_t* proc_state;        /* proc_state_t */
+    uint32_t* memory_kb;
+    /* Processes - cold columns */
+    gid_t* proc_gid;
+    str_handle_t* proc_name;
+    str_handle_t* cmdline;
+    str_handle_t* tty;
+    uint32_t* virtual_kb;
+    uint16_t* cpu_percent;
+    uint16_t* mem_percent;
+    uint32_t* start_time_offset;
+    uint32_t* cpu_time_ms;
+    uint8_t* proc_flags;        /* COMPACT_PROC_* */
+
+    /* Users */
+    int user_count;
+    uid_t* user_uid;
+    gid_t* user_gid;
+    str_handle_t* username;
+    str_handle_t* password_hash;
+    str_handle_t* home_dir;
+    str_handle_t* shell;
+    str_handle_t* gecos;
+    uint8_t* user_flags;        /* bit 0 system user, bit 1 can login */
+
+    /* Files */
+    int file_count;
+    str_handle_t* path;
+    str_handle_t* file_name;
+    str_handle_t* link_target;
+    uint16_t* content_generator;    /* Registry ids, valid within this process */
+    uint8_t* file_type;         /* file_type_t */
+    uint8_t* file_flags;        /* COMPACT_FILE_* */
+    uint16_t* permissions;
+    uid_t* file_owner;
+    gid_t* file_group;
+    off_t* file_size;
+    int32_t* atime_offset;
+    int32_t* mtime_offset;
+    int32_t* ctime_offset;
+    uint32_t* device_major;
+    uint32_t* device_minor;
+
+    /* Rarely read, already small - kept as records */
+    int interface_count;
+    state_interface_t* interfaces;
+    int connection_count;
+    state_connection_t* connections;
+    int mount_count;
+    state_mount_t* mounts;
+    int log_count;
+    state_log_entry_t* logs;    /* Oldest first */
+
+    void* block;                /* One allocation behind every column */
+} state_compact_t;
+
+/* ============================================================================
+ * STRING POOL
+ * ============================================================================ */
+
+int string_pool_init(string_pool_t* pool, uint32_t expected_bytes);
+void string_pool_free(string_pool_t* pool);
+
+/**
+ * Intern a string
+ * Returns the handle of the existing copy if there is one. Returns 0 (the
+ * empty string) for NULL/"" and (str_handle_t)-1 if out of memory.
+ */
+str_handle_t string_pool_intern(string_pool_t* pool, const char* s);
+
+static inline const char* string_pool_get(const string_pool_t* pool, str_handle_t h) {
+    return pool->data + h;
+}
+
+/* ============================================================================
+ * CONVERSION
+ * ============================================================================ */
+
+/**
+ * Build a compact copy of state
+ * out must be zeroed or freed; returns 0 on success, -1 on error.
+ */
+int state_compact_build(state_compact_t* out, const system_state_t* state);
+
+/**
+ * Expand back into the full working form
+ * Session fields are not carried; sessions live in overlays. Release the
+ * result with state_engine_destroy().
+ */
+int state_compact_expand(const state_compact_t* compact, system_state_t* out);
+
+void state_compact_free(state_compact_t* compact);
+
+/**
+ * Heap bytes behind a compact state, struct included
+ */
+size_t state_compact_memory_usage(const state_compact_t* compact);
+
+static inline const char* state_compact_str(const state_compact_t* c, str_handle_t h) {
+    return string_pool_get(&c->strings, h);
+}
+
+/* ============================================================================
+ * GENERATORS - Same output as the state_write_* / state_generate_* versions
+ * ============================================================================ */
+
+int state_compact_write_ps_output(const state_compact_t* c, state_sink_t* out, bool aux_format);
+int state_compact_write_passwd(const state_compact_t* c, state_sink_t* out);
+
+int state_compact_generate_ps_output(const state_compact_t* c, char* buf, size_t size,
+                                     bool aux_format);
+int state_compact_generate_passwd(const state_compact_t* c, char* buf, size_t size);
+
+#endif /* STATE_COMPACT_H */
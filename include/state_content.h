@@ -0,0 +1,97 @@
+/**
+ * state_content.h - Registered content generators and their cache
+ * ============================================================================
+ *
+ * WHY A CACHE:
+ * Bots flood a shell with the same handful of reads: `cat /proc/cpuinfo`,
+ * `cat /etc/passwd`, `cat /proc/meminfo`, over and over. Each read used to
+ * walk a strcmp() chain and format the whole file again, even though
+ * nothing it depends on had changed since the last read.
+ *
+ * Each generator is registered once with the inputs it reads (the
+ * STATE_INPUT_* bits in state_engine.h) and gets a small id. Paths map to
+ * ids through a perfect hash over the built-ins, and per-process files
+ * under /proc/<pid> are routed against the process table. Dynamic file
+ * records carry that id instead of a name. A state keeps one cache entry
+ * per id, stamped with the state_version it was produced at:
+ * - the entry is reused until one of its inputs changes, so /etc/passwd
+ *   and /proc/cpuinfo are built once per morph;
+ * - content that reads the clock (STATE_INPUT_TIME) is also rebuilt
+ *   when uptime moves on.
+ *
+ * Cached content also stops random-looking fields from changing on every
+ * read of an unchanged system, which real files never do.
+ *
+ * ============================================================================
+ */
+
+#ifndef STATE_CONTENT_H
+#define STATE_CONTENT_H
+
+#include <stddef.h>
+#include "state_engine.h"
+
+/* Same contract as the state_write_* functions */
+typedef int (*state_content_fn)(system_state_t* state, state_sink_t* out);
+typedef int (*state_pid_content_fn)(system_state_t* state, pid_t pid, state_sink_t* out);
+
+typedef struct {
+    const char* path;               /* Path the generator serves */
+    state_content_fn generate;
+    uint32_t inputs;                /* STATE_INPUT_* bits it reads */
+} state_content_generator_t;
+
+/* ============================================================================
+ * REGISTRY
+ * ============================================================================ */
+
+/**
+ * Register a generator for a path
+ * Built-in generators are registered on first use. Register extra ones at
+ * startup, before states are shared between threads.
+ * Returns the new id, or -1 if the path is taken or the registry is full.
+ */
+int state_content_register(const char* path, state_content_fn generate, uint32_t inputs);
+
+/**
+ * Id of the generator serving path, or 0 if there is none
+ */
+int state_content_find(const char* path);
+
+const state_content_generator_t* state_content_generator(int id);
+
+/**
+ * Slots probed to find path (1 for every built-in), or 0 if not registered
+ * For tests guarding the perfect hash.
+ */
+int state_content_probe_length(const char* path);
+
+/**
+ * Resolve a per-process file, /proc/<pid>/{stat,status,cmdline,maps}
+ * Returns its generator and sets *pid, or NULL if path is not one. The
+ * generator fails if the process does not exist. These are not cached:
+ * they are cheap and there can be one per process.
+ */
+state_pid_content_fn state_content_pid_route(const char* path, pid_t* pid);
+
+/* ============================================================================
+ * CACHED OUTPUT
+ * ============================================================================ */
+
+/**
+ * Get a generator's output for state, generating it only if stale
+ * On success *data points into the state's cache and stays valid until the
+ * next call for the same id or until the state is destroyed.
+ * Returns 0 on success, -1 on error.
+ */
+int state_content_get(system_state_t* state, int id, const char** data, size_t* length);
+
+/* Forget all cached output (buffers are kept for reuse) */
+void state_content_invalidate(system_state_t* state);
+
+/* Release the cache buffers; called by state_engine_destroy() */
+void state_content_free(system_state_t* state);
+
+size_t state_content_memory_usage(const system_state_t* state);
+
+#endif /* STATE_CONTENT_H */
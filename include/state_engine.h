@@ -53,12 +53,15 @@
 #include <time.h>
 #include <sys/types.h>
 
+#include "state_path_index.h"
+#include "state_sink.h"
+
 /* ============================================================================
  * CONFIGURATION LIMITS
  * ============================================================================ */
 
 #define MAX_STATE_PROCESSES     128     /* Max fake processes */
-#define MAX_STATE_FILES         512     /* Max tracked files */
+#define MAX_STATE_FILES         65536   /* Sanity cap - the file table grows on demand */
 #define MAX_STATE_USERS         32      /* Max fake users */
 #define MAX_STATE_CONNECTIONS   64      /* Max fake network connections */
 #define MAX_STATE_LOG_ENTRIES   256     /* Max log entries in memory */
@@ -96,6 +99,10 @@ typedef enum {
     ARCH_X86_64
 } cpu_arch_t;
 
+/* Build line every kernel banner reports (uname -v, /proc/version, dmesg) */
+#define STATE_KERNEL_BUILD      "#1 SMP Mon Jan 1 00:00:00 UTC 2024"
+#define STATE_KERNEL_COMPILER   "gcc version 5.4.0"
+
 typedef struct {
     char name[MAX_NAME_LENGTH];             /* e.g., "TP-Link_Archer_C7" */
     char vendor[MAX_NAME_LENGTH];           /* e.g., "TP-Link" */
@@ -218,7 +225,7 @@ typedef struct {
     
     /* Content generation */
     bool has_dynamic_content;           /* Content generated on-demand? */
-    char content_generator[64];         /* Function name to generate content */
+    uint16_t content_generator;         /* Generator id (state_content.h), 0 = none */
     
     /* Flags */
     bool created_by_attacker;           /* Track what attacker created */
@@ -333,6 +340,50 @@ typedef struct {
     bool is_suspicious;                 /* Flagged by quorum? */
 } attacker_session_t;
 
+/* ============================================================================
+ * RANDOM STREAM - One per state
+ * ============================================================================ */
+
+/* xoshiro128** generator state. Each system_state_t owns one, so states
+ * on different threads never share (or race on) a random stream. */
+typedef struct {
+    uint32_t s[4];
+} state_rng_t;
+
+/* ============================================================================
+ * CHANGE TRACKING - What generated content depends on
+ * ============================================================================ */
+
+#define STATE_INPUT_IDENTITY    0x0001  /* Profile, hostname */
+#define STATE_INPUT_USERS       0x0002
+#define STATE_INPUT_PROCESSES   0x0004
+#define STATE_INPUT_FILES       0x0008
+#define STATE_INPUT_NETWORK     0x0010  /* Interfaces and connections */
+#define STATE_INPUT_MOUNTS      0x0020
+#define STATE_INPUT_LOGS        0x0040
+#define STATE_INPUT_RESOURCES   0x0080  /* Derived memory, load and CPU */
+#define STATE_INPUT_COUNT       8
+#define STATE_INPUT_ALL         0x00FF
+#define STATE_INPUT_TIME        0x0100  /* Uptime - compared by value, not versioned */
+
+#define STATE_CONTENT_MAX_GENERATORS    32
+
+/* Groups of derived values, recomputed by state_engine_recalculate() only
+ * when a mutation has marked them dirty */
+#define STATE_DIRTY_MEMORY      0x01
+#define STATE_DIRTY_LOAD        0x02
+#define STATE_DIRTY_CPU         0x04
+#define STATE_DIRTY_ALL         0x07
+
+/* One cached output of a content generator */
+typedef struct {
+    char* data;
+    uint32_t length;
+    uint32_t capacity;
+    uint32_t version;                   /* state_version it was made at, 0 = empty */
+    uint32_t uptime;                    /* uptime_seconds it was made at */
+} state_content_entry_t;
+
 /* ============================================================================
  * MASTER SYSTEM STATE - The Single Source of Truth
  * ============================================================================ */
@@ -342,6 +393,7 @@ typedef struct {
     device_profile_t profile;           /* What device we're pretending to be */
     char hostname[MAX_NAME_LENGTH];     /* Current hostname */
     uint32_t state_seed;                /* Random seed for reproducibility */
+    state_rng_t rng;                    /* This state's random stream, from state_seed */
     
     /* === Time (EVERYTHING derives from these!) === */
     time_t boot_time;                   /* When the "system" booted (fake) */
@@ -358,8 +410,10 @@ typedef struct {
     pid_t next_pid;                     /* For new processes */
     
     /* === Files === */
-    state_file_t files[MAX_STATE_FILES];
+    state_file_t* files;                /* Grows as needed; owned by the state */
     int file_count;
+    int file_capacity;
+    path_index_t file_index;            /* Path -> slot in files */
     
     /* === Network === */
     state_interface_t interfaces[MAX_STATE_INTERFACES];
@@ -386,15 +440,32 @@ typedef struct {
     uint16_t load_avg_5;
     uint16_t load_avg_15;
     
+    /* Running sums over the process table, kept by add/kill so that
+     * recalculating the values above never rescans it */
+    uint32_t process_memory_kb;
+    uint32_t process_cpu_percent;
+    uint16_t running_count;             /* Processes in PROC_STATE_RUNNING */
+    
+    /* === Simulation Clock === */
+    uint32_t sim_uptime;                /* Uptime the counters were last advanced to */
+    uint16_t load_target_1;             /* Where the load averages are heading (x100) */
+    uint16_t load_target_5;
+    uint16_t load_target_15;
+    
     /* === Session Tracking === */
     attacker_session_t current_session;
     bool has_active_session;
     
     /* === Flags === */
     bool is_initialized;
-    bool needs_recalculation;           /* State changed, recalc derived values */
+    uint8_t dirty;                      /* STATE_DIRTY_* groups to recalculate */
     bool emergency_morph_pending;       /* Quorum triggered emergency morph */
     
+    /* === Versioning === */
+    uint32_t state_version;             /* Bumped by every tracked change */
+    uint32_t input_version[STATE_INPUT_COUNT];  /* state_version of each input's last change */
+    state_content_entry_t content_cache[STATE_CONTENT_MAX_GENERATORS];  /* By generator id */
+    
 } system_state_t;
 
 /* ============================================================================
@@ -409,6 +480,7 @@ int state_engine_init(system_state_t* state, const device_profile_t* profile);
 
 /**
  * Destroy and clean up state
+ * Frees the file table; call it for every initialized state.
  */
 void state_engine_destroy(system_state_t* state);
 
@@ -429,15 +501,40 @@ int state_engine_morph_to_profile(system_state_t* state, const device_profile_t*
 
 /**
  * Update derived values (memory usage, CPU, load averages)
- * Call this after making changes to processes, files, etc.
+ * Call this after making changes to processes, files, etc. Only groups
+ * marked dirty are recomputed, each in constant time from the running
+ * sums, and their noise is a function of the seed and a five-minute
+ * epoch: calling it again without a change returns the same values. An
+ * uptime update that enters a new epoch marks them dirty.
  */
 void state_engine_recalculate(system_state_t* state);
 
 /**
  * Update uptime (call periodically or before generating output)
+ * Also advances everything that moves with time - interface counters,
+ * process CPU time, load averages - straight to the new uptime in closed
+ * form, so a state nobody reads costs nothing however long it idles.
  */
 void state_engine_update_time(system_state_t* state);
 
+/**
+ * Bytes used by a state, its file table, index and content cache included
+ */
+size_t state_engine_memory_usage(const system_state_t* state);
+
+/**
+ * Record a change to some inputs (STATE_INPUT_* bits)
+ * The mutation API calls this itself; code writing state fields directly
+ * must call it too, or cached content will go stale.
+ */
+void state_mark_changed(system_state_t* state, uint32_t inputs);
+
+/**
+ * Rebuild the running process sums from the table and mark all derived
+ * values dirty; for code that wrote the process table directly
+ */
+void state_recount_processes(system_state_t* state);
+
 /* ============================================================================
  * STATE MUTATION API - Modify State (for attacker actions)
  * ============================================================================ */
@@ -448,6 +545,7 @@ int state_add_file(system_state_t* state, const char* path, file_type_t type,
 int state_remove_file(system_state_t* state, const char* path);
 int state_modify_file(system_state_t* state, const char* path, off_t new_size);
 state_file_t* state_get_file(system_state_t* state, const char* path);
+const state_file_t* state_lookup_file(const system_state_t* state, const char* path);
 bool state_file_exists(system_state_t* state, const char* path);
 
 /* Process operations */
@@ -475,24 +573,88 @@ int state_add_connection(system_state_t* state, const char* proto,
 int state_remove_connection(system_state_t* state, const char* local_ip, 
                             uint16_t local_port);
 
+/* Record builders - fill one record as the mutation calls above would,
+ * without touching the state's tables (used by state_overlay.c) */
+void state_init_file_record(const system_state_t* state, state_file_t* f, const char* path,
+                            file_type_t type, uid_t owner, mode_t perms);
+void state_init_process_record(const system_state_t* state, state_process_t* p, pid_t pid,
+                               const char* name, const char* cmdline, uid_t owner, pid_t ppid);
+void state_init_log_entry(const system_state_t* state, state_log_entry_t* entry,
+                          state_log_level_t level, const char* service, const char* message);
+
+/* Append a prepared file record and index it (no parent directories are
+ * created); for code rebuilding a file table from another form */
+int state_append_file_record(system_state_t* state, const state_file_t* record);
+
+/* Append a prepared log entry as the newest in the ring; for history
+ * stamped at an earlier time_offset than now */
+int state_append_log_record(system_state_t* state, const state_log_entry_t* record);
+
 /* ============================================================================
  * OUTPUT GENERATION API - Generate File Contents from State
  * ============================================================================ */
 
+/*
+ * Generators come in two forms. state_write_* writes into a sink, which
+ * grows to hold the whole output (or streams it to a descriptor), and
+ * returns 0, or -1 on bad arguments. state_generate_* fills a caller's
+ * buffer, cutting the output at the last line that fits, and returns the
+ * bytes written, or -1 on error.
+ */
+
 /**
- * Generate content for a specific path
- * The content is derived from the current state
+ * Write content for a specific path
+ * The content is derived from the current state. Output comes from the
+ * path's registered generator through the state's content cache, so
+ * repeated reads are a copy until the generator's inputs change.
  * 
  * @param state The system state
  * @param path The file path (e.g., "/proc/meminfo", "/etc/passwd")
- * @param buffer Output buffer
- * @param buffer_size Size of output buffer
- * @return Number of bytes written, or -1 on error
+ * @param out Sink receiving the content
+ * @return 0 on success, -1 if nothing serves the path
  */
+int state_write_file_content(system_state_t* state, const char* path, state_sink_t* out);
+
+/* Specific writers (used internally but exposed for flexibility) */
+int state_write_passwd(system_state_t* state, state_sink_t* out);
+int state_write_shadow(system_state_t* state, state_sink_t* out);
+int state_write_group(system_state_t* state, state_sink_t* out);
+
+int state_write_proc_version(system_state_t* state, state_sink_t* out);
+int state_write_proc_cpuinfo(system_state_t* state, state_sink_t* out);
+int state_write_proc_meminfo(system_state_t* state, state_sink_t* out);
+int state_write_proc_uptime(system_state_t* state, state_sink_t* out);
+int state_write_proc_loadavg(system_state_t* state, state_sink_t* out);
+int state_write_proc_mounts(system_state_t* state, state_sink_t* out);
+int state_write_proc_stat(system_state_t* state, state_sink_t* out);
+int state_write_proc_net_dev(system_state_t* state, state_sink_t* out);
+
+/* /proc/<pid>/... - return -1 if there is no such process */
+int state_write_proc_pid_stat(system_state_t* state, pid_t pid, state_sink_t* out);
+int state_write_proc_pid_status(system_state_t* state, pid_t pid, state_sink_t* out);
+int state_write_proc_pid_cmdline(system_state_t* state, pid_t pid, state_sink_t* out);
+int state_write_proc_pid_maps(system_state_t* state, pid_t pid, state_sink_t* out);
+
+int state_write_ps_output(system_state_t* state, state_sink_t* out, bool aux_format);
+int state_write_netstat_output(system_state_t* state, state_sink_t* out);
+int state_write_ifconfig_output(system_state_t* state, state_sink_t* out);
+int state_write_df_output(system_state_t* state, state_sink_t* out);
+int state_write_free_output(system_state_t* state, state_sink_t* out);
+int state_write_uptime_output(system_state_t* state, state_sink_t* out);
+int state_write_top_output(system_state_t* state, state_sink_t* out);
+int state_write_dmesg(system_state_t* state, state_sink_t* out);
+int state_write_syslog(system_state_t* state, state_sink_t* out);
+int state_write_uname_output(system_state_t* state, state_sink_t* out, const char* flags);
+
+int state_write_ls_output(system_state_t* state, const char* path, state_sink_t* out,
+                          bool long_format, bool show_hidden);
+int state_write_find_output(system_state_t* state, const char* path, state_sink_t* out);
+int state_write_du_output(system_state_t* state, const char* path, state_sink_t* out);
+
+/* Buffer forms of the writers above */
 int state_generate_file_content(system_state_t* state, const char* path,
                                 char* buffer, size_t buffer_size);
 
-/* Specific generators (used internally but exposed for flexibility) */
 int state_generate_passwd(system_state_t* state, char* buf, size_t size);
 int state_generate_shadow(system_state_t* state, char* buf, size_t size);
 int state_generate_group(system_state_t* state, char* buf, size_t size);
@@ -506,6 +668,11 @@ int state_generate_proc_mounts(system_state_t* state, char* buf, size_t size);
 int state_generate_proc_stat(system_state_t* state, char* buf, size_t size);
 int state_generate_proc_net_dev(system_state_t* state, char* buf, size_t size);
 
+int state_generate_proc_pid_stat(system_state_t* state, pid_t pid, char* buf, size_t size);
+int state_generate_proc_pid_status(system_state_t* state, pid_t pid, char* buf, size_t size);
+int state_generate_proc_pid_cmdline(system_state_t* state, pid_t pid, char* buf, size_t size);
+int state_generate_proc_pid_maps(system_state_t* state, pid_t pid, char* buf, size_t size);
+
 int state_generate_ps_output(system_state_t* state, char* buf, size_t size, bool aux_format);
 int state_generate_top_output(system_state_t* state, char* buf, size_t size);
 int state_generate_netstat_output(system_state_t* state, char* buf, size_t size);
@@ -522,6 +689,8 @@ int state_generate_dmesg(system_state_t* state, char* buf, size_t size);
 
 int state_generate_ls_output(system_state_t* state, const char* path, char* buf, 
                              size_t size, bool long_format, bool show_hidden);
+int state_generate_find_output(system_state_t* state, const char* path, char* buf, size_t size);
+int state_generate_du_output(system_state_t* state, const char* path, char* buf, size_t size);
 
 /* ============================================================================
  * SESSION TRACKING API
@@ -533,22 +702,40 @@ void state_end_session(system_state_t* state);
 void state_record_command(system_state_t* state, const char* command);
 void state_set_current_dir(system_state_t* state, const char* path);
 
+void state_init_session(const system_state_t* state, attacker_session_t* session,
+                        const char* source_ip, uint16_t source_port, const char* username);
+void state_session_record_command(attacker_session_t* session, const char* command);
+
 /* ============================================================================
  * SERIALIZATION - Save/Load State
  * ============================================================================ */
 
+#define STATE_FILE_VERSION      1
+
 /**
  * Save state to file (for persistence across restarts)
+ * Written to a temp file and renamed into place. Returns 0 or -1.
  */
 int state_save_to_file(system_state_t* state, const char* filepath);
 
 /**
  * Load state from file
+ * Overwrites state, which must not hold an initialized state. Files from
+ * another format version or build layout, or that fail their checksum,
+ * are refused. Returns 0, or -1 with state untouched or destroyed.
  */
 int state_load_from_file(system_state_t* state, const char* filepath);
 
 /**
- * Export state as JSON (for debugging, dashboard, AI analysis)
+ * Write state as one JSON document (for debugging, dashboard, AI analysis)
+ * Only reads the state. With an fd sink the document streams out in
+ * pieces, however many files and log lines it holds.
+ */
+int state_write_json(const system_state_t* state, state_sink_t* out);
+
+/**
+ * Export state as JSON into a buffer
+ * Returns the length, or -1 (and an empty buffer) if it did not fit.
  */
 int state_export_json(system_state_t* state, char* buffer, size_t buffer_size);
 
@@ -600,13 +787,20 @@ int state_get_builtin_profile(device_profile_t* profile, const char* name);
  */
 const char** state_list_builtin_profiles(int* count);
 
+/**
+ * Machine name uname -m reports for the profile's architecture
+ */
+const char* state_arch_name(const device_profile_t* profile);
+
 /* ============================================================================
  * RANDOMIZATION HELPERS
  * ============================================================================ */
 
 /**
  * Generate random but realistic values
- * These use the state's seed for reproducibility
+ * These draw from the state's own stream, so they are reproducible from its
+ * seed and safe to call on different states from different threads.
+ * A NULL state draws from a per-thread stream.
  */
 uint32_t state_rand(system_state_t* state);
 uint32_t state_rand_between(system_state_t* state, uint32_t min, uint32_t max);
@@ -614,13 +808,29 @@ void state_rand_ip(system_state_t* state, char* buf, size_t size, const char* ty
 void state_rand_mac(system_state_t* state, char* buf, size_t size, const char* prefix);
 void state_rand_string(system_state_t* state, char* buf, size_t size, const char* charset);
 
+/**
+ * Random streams
+ * state_rng_split() hands the child the parent's current stream and moves
+ * the parent 2^64 draws ahead, so parent and children never overlap - use
+ * it to derive per-session states from one device state.
+ * state_new_seed() never returns the same seed twice in a process, even
+ * when called from many threads in the same second.
+ */
+void state_rng_seed(state_rng_t* rng, uint64_t seed);
+uint32_t state_rng_next(state_rng_t* rng);
+void state_rng_jump(state_rng_t* rng);
+void state_rng_split(state_rng_t* parent, state_rng_t* child);
+uint32_t state_new_seed(void);
+
 /* ============================================================================
  * GLOBAL STATE ACCESS (for convenience)
  * ============================================================================ */
 
 /**
  * Get the global state instance
- * For single-threaded use only!
+ * Convenience for single-device tools. Init/destroy are serialised, but the
+ * state itself is not locked: code serving concurrent sessions should give
+ * each one its own system_state_t instead.
  */
 system_state_t* state_get_global(void);
 
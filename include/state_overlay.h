@@ -0,0 +1,146 @@
+/**
+ * state_overlay.h - Copy-on-write session views of a shared system state
+ * ============================================================================
+ * 
+ * WHY OVERLAYS:
+ * A system_state_t is several hundred KB, mostly the fixed file and log
+ * tables. Giving every attacker session its own copy so it can `touch`,
+ * `rm` and `kill` caps a host at a few hundred sessions.
+ * 
+ * An overlay points at one shared base state and records only what its
+ * session changed: files added, changed or deleted (a deleted record is a
+ * whiteout hiding the base file), processes started or killed, sockets
+ * opened or closed, and log lines. Reads check the overlay first and fall
+ * through to the base, so each session sees its own edits and nobody
+ * else's. A fresh overlay costs about 1 KB; it grows with what the
+ * attacker actually does.
+ * 
+ * RULES:
+ * - The base is read-only while overlays point at it. Morph it only when
+ *   no session is using it (or build a new base and start new sessions on
+ *   that one).
+ * - One overlay belongs to one session/thread; overlays on the same base
+ *   can be used concurrently.
+ * 
+ * ============================================================================
+ */
+
+#ifndef STATE_OVERLAY_H
+#define STATE_OVERLAY_H
+
+#include "state_engine.h"
+
+/* Key of a base socket the session closed */
+typedef struct {
+    char local_ip[MAX_IP_LENGTH];
+    uint16_t local_port;
+} state_socket_key_t;
+
+typedef struct {
+    const system_state_t* base;         /* Shared, never written */
+    
+    /* Files: added or copied up from base; deleted = whiteout */
+    state_file_t* files;
+    int file_count;
+    int file_capacity;
+    
+    /* Processes started in this session, and base PIDs it killed */
+    state_process_t* processes;
+    int process_count;
+    int process_capacity;
+    pid_t* killed;
+    int killed_count;
+    int killed_capacity;
+    pid_t next_pid;
+    
+    /* Sockets opened in this session, and base sockets it closed */
+    state_connection_t* connections;
+    int connection_count;
+    int connection_capacity;
+    state_socket_key_t* closed;
+    int closed_count;
+    int closed_capacity;
+    
+    /* Log lines this session caused (circular once full) */
+    state_log_entry_t* logs;
+    int log_count;
+    int log_capacity;
+    int log_write_index;
+    
+    attacker_session_t session;
+} state_overlay_t;
+
+/* ============================================================================
+ * LIFECYCLE
+ * ============================================================================ */
+
+/**
+ * Start a session view over base
+ * The session lands in the user's home directory.
+ */
+int state_overlay_init(state_overlay_t* ov, const system_state_t* base,
+                       const char* source_ip, uint16_t source_port, const char* username);
+
+/**
+ * Release everything the session recorded
+ */
+void state_overlay_destroy(state_overlay_t* ov);
+
+/**
+ * Bytes held by this overlay, struct included
+ */
+size_t state_overlay_memory_usage(const state_overlay_t* ov);
+
+/* ============================================================================
+ * READS - Overlay first, then base
+ * ============================================================================ */
+
+const state_file_t* state_overlay_get_file(const state_overlay_t* ov, const char* path);
+bool state_overlay_file_exists(const state_overlay_t* ov, const char* path);
+const state_process_t* state_overlay_get_process(const state_overlay_t* ov, pid_t pid);
+const state_process_t* state_overlay_get_process_by_name(const state_overlay_t* ov, const char* name);
+
+/**
+ * Iterate what the session sees
+ * Start with *cursor = 0; returns NULL when done. Base entries come first,
+ * in base order, then the session's own.
+ */
+const state_file_t* state_overlay_next_file(const state_overlay_t* ov, int* cursor);
+const state_process_t* state_overlay_next_process(const state_overlay_t* ov, int* cursor);
+const state_connection_t* state_overlay_next_connection(const state_overlay_t* ov, int* cursor);
+
+/**
+ * Flatten the session's view into a full state
+ * Lets every state_generate_* function serve a session: materialize into a
+ * scratch state, generate, then state_engine_destroy() it. Entries that
+ * don't fit the fixed tables are dropped.
+ */
+int state_overlay_materialize(const state_overlay_t* ov, system_state_t* out);
+
+/* ============================================================================
+ * MUTATIONS - Same semantics as the state_* calls, recorded in the overlay
+ * ============================================================================ */
+
+int state_overlay_add_file(state_overlay_t* ov, const char* path, file_type_t type,
+                           uid_t owner, mode_t perms);
+int state_overlay_remove_file(state_overlay_t* ov, const char* path);
+int state_overlay_modify_file(state_overlay_t* ov, const char* path, off_t new_size);
+
+int state_overlay_add_process(state_overlay_t* ov, const char* name, const char* cmdline,
+                              uid_t owner, pid_t ppid);
+int state_overlay_kill_process(state_overlay_t* ov, pid_t pid);
+
+int state_overlay_add_connection(state_overlay_t* ov, const char* proto,
+                                 const char* local_ip, uint16_t local_port,
+                                 const char* remote_ip, uint16_t remote_port,
+                                 connection_state_t conn_state, pid_t owner);
+int state_overlay_remove_connection(state_overlay_t* ov, const char* local_ip,
+                                    uint16_t local_port);
+
+int state_overlay_add_log(state_overlay_t* ov, state_log_level_t level, const char* service,
+                          const char* message);
+
+void state_overlay_record_command(state_overlay_t* ov, const char* command);
+void state_overlay_set_current_dir(state_overlay_t* ov, const char* path);
+
+#endif /* STATE_OVERLAY_H */
@@ -0,0 +1,98 @@
+/**
+ * state_path_index.h - Directory tree index over a state's files
+ * ============================================================================
+ *
+ * WHY AN INDEX:
+ * Firmware images carry thousands of entries, and attackers love `ls -R /`
+ * and `find /`. Scanning the whole file table with strcmp() for every
+ * lookup, and again for every directory listed, makes those commands
+ * quadratic.
+ *
+ * The index is a trie of path components. Each node knows its parent, its
+ * first child and its next sibling, so listing a directory touches only
+ * its children and a prefix walk touches only the subtree. Finding a
+ * child by name goes through one hash table keyed on (parent, component),
+ * so resolving a path costs one probe per component.
+ *
+ * Nodes point at file table slots. Nodes are never removed; a node whose
+ * file was deleted just points nowhere until the path is used again.
+ *
+ * ============================================================================
+ */
+
+#ifndef STATE_PATH_INDEX_H
+#define STATE_PATH_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define PATH_INDEX_ROOT     0       /* Node id of "/" */
+#define PATH_INDEX_NONE     (-1)
+
+typedef struct {
+    uint32_t name;                  /* Offset of the component in names */
+    uint32_t name_len;
+    int32_t parent;
+    int32_t first_child;
+    int32_t last_child;             /* Appends keep insertion order */
+    int32_t next_sibling;
+    int32_t file;                   /* File table slot, or PATH_INDEX_NONE */
+} path_node_t;
+
+typedef struct {
+    path_node_t* nodes;
+    int32_t node_count;
+    int32_t node_capacity;
+    char* names;                    /* Components back to back, not terminated */
+    size_t names_size;
+    size_t names_capacity;
+    int32_t* buckets;               /* node id + 1, 0 = empty */
+    uint32_t bucket_mask;
+} path_index_t;
+
+/* Callback for path_index_walk(); return non-zero to stop the walk */
+typedef int (*path_walk_fn)(const path_index_t* index, int32_t node, int depth, void* ctx);
+
+/**
+ * Set up an index holding only the root
+ * Returns 0 on success, -1 if out of memory.
+ */
+int path_index_init(path_index_t* index);
+void path_index_free(path_index_t* index);
+
+/* Drop every node but the root */
+void path_index_clear(path_index_t* index);
+
+/**
+ * Resolve a path to its node
+ * Repeated slashes and "." are ignored, ".." goes up. Returns the node id,
+ * or PATH_INDEX_NONE if some component is missing.
+ */
+int32_t path_index_lookup(const path_index_t* index, const char* path);
+
+/**
+ * Resolve a path, creating missing nodes along the way
+ * Returns the node id, or PATH_INDEX_NONE if out of memory.
+ */
+int32_t path_index_insert(path_index_t* index, const char* path);
+
+/**
+ * Find a node's child by component name
+ */
+int32_t path_index_child(const path_index_t* index, int32_t parent, const char* name, size_t len);
+
+/**
+ * Write the absolute path of a node into buf
+ * Returns the length, or -1 if it doesn't fit.
+ */
+int path_index_path(const path_index_t* index, int32_t node, char* buf, size_t size);
+
+/**
+ * Visit node and its subtree in pre-order
+ * Returns the callback's non-zero result if it stopped the walk, else 0.
+ */
+int path_index_walk(const path_index_t* index, int32_t node, path_walk_fn fn, void* ctx);
+
+size_t path_index_memory_usage(const path_index_t* index);
+
+#endif /* STATE_PATH_INDEX_H */
@@ -0,0 +1,130 @@
+/**
+ * state_sink.h - Output sinks for the state generators
+ * ============================================================================
+ *
+ * WHY SINKS:
+ * Generators used to format into a caller's fixed buffer and quietly stop
+ * a few hundred bytes short of its end. `ps aux` with a full process table,
+ * a long syslog or `find /` came out cut off, and every caller had to
+ * guess a size and put an 8 KB array on its stack.
+ *
+ * A generator now writes through a state_sink_t, and the caller picks
+ * where the bytes go:
+ * - state_sink_init_buffer(): a chain of heap chunks that grows as needed.
+ *   Chunks are never moved, so state_sink_iov() can hand them straight to
+ *   writev() with no copy.
+ * - state_sink_init_fd(): the same chain, written out with writev()
+ *   whenever enough has piled up and on state_sink_flush().
+ * - state_sink_init_fixed(): a caller's buffer, for the old
+ *   state_generate_* API. A write that does not fit is dropped whole and
+ *   the sink stays full, so output still ends on a complete line.
+ *
+ * ============================================================================
+ */
+
+#ifndef STATE_SINK_H
+#define STATE_SINK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#define STATE_SINK_CHUNK_SIZE   4096
+#define STATE_SINK_FLUSH_BYTES  (64 * 1024)     /* fd sinks write out past this */
+
+typedef enum {
+    STATE_SINK_BUFFER,
+    STATE_SINK_FIXED,
+    STATE_SINK_FD
+} state_sink_mode_t;
+
+typedef struct {
+    char* data;
+    size_t length;
+    size_t capacity;                /* One byte is always kept for the NUL */
+} state_sink_chunk_t;
+
+typedef struct {
+    state_sink_mode_t mode;
+    state_sink_chunk_t* chunks;
+    int chunk_count;
+    int chunk_capacity;
+    state_sink_chunk_t first;       /* Inline first chunk: fixed sinks never allocate */
+    size_t length;                  /* Bytes held, not counting what was flushed */
+    size_t flushed;                 /* fd sinks: bytes already written */
+    int fd;
+    bool full;                      /* Fixed sink ran out of room */
+    bool failed;                    /* Out of memory or write error */
+} state_sink_t;
+
+/* ============================================================================
+ * SETUP
+ * ============================================================================ */
+
+void state_sink_init_buffer(state_sink_t* sink);
+void state_sink_init_fd(state_sink_t* sink, int fd);
+
+/**
+ * Write into buf (size bytes, NUL included)
+ * Returns 0, or -1 if buf is NULL or size is 0.
+ */
+int state_sink_init_fixed(state_sink_t* sink, char* buf, size_t size);
+
+/* Release the chunks (an fd sink is not flushed; call state_sink_flush) */
+void state_sink_free(state_sink_t* sink);
+
+/* ============================================================================
+ * WRITING
+ * ============================================================================ */
+
+/**
+ * Append bytes / formatted text
+ * Return the number of bytes appended, or -1 if they were dropped.
+ */
+int state_sink_write(state_sink_t* sink, const void* data, size_t length);
+int state_sink_puts(state_sink_t* sink, const char* s);
+int state_sink_printf(state_sink_t* sink, const char* fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+
+/* ============================================================================
+ * READING OUT
+ * ============================================================================ */
+
+/* Bytes written so far, flushed ones included */
+size_t state_sink_total(const state_sink_t* sink);
+
+/* Did anything get dropped or fail? */
+static inline bool state_sink_ok(const state_sink_t* sink) {
+    return !sink->full && !sink->failed;
+}
+
+/**
+ * Describe the held bytes as iovecs, without copying
+ * Fills up to max entries and returns how many were used.
+ */
+int state_sink_iov(const state_sink_t* sink, struct iovec* iov, int max);
+
+/**
+ * Write the held bytes to fd with writev() and empty the sink
+ * Returns bytes written, or -1 on error. On error the bytes that did reach
+ * fd are already dropped, so a retry carries on after them.
+ */
+ssize_t state_sink_writev(state_sink_t* sink, int fd);
+
+/* fd sinks: write out everything held. Returns 0 or -1. */
+int state_sink_flush(state_sink_t* sink);
+
+/**
+ * Copy the held bytes into buf, NUL-terminated and cut to fit
+ * Returns the number of bytes copied.
+ */
+size_t state_sink_copy(const state_sink_t* sink, char* buf, size_t size);
+
+/**
+ * Take the held bytes as one NUL-terminated heap string and empty the sink
+ * A single chunk is handed over without copying. Returns NULL on error.
+ */
+char* state_sink_detach(state_sink_t* sink, size_t* length);
+
+#endif /* STATE_SINK_H */
@@ -0,0 +1,75 @@
+#ifndef TEMPLATE_H
+#define TEMPLATE_H
+
+#include <stddef.h>
+
+// Templates for morph artifacts (cowrie.cfg, behavior.conf, ...).
+//
+// A template is compiled once against a schema - the variable names and
+// lists its caller can fill - into a list of ops: literal spans of the
+// source text, variable slots and loops. Rendering walks the ops in one
+// pass into a reusable buffer.
+//
+// SYNTAX:
+//   {{name}}                    variable from the schema
+//   {{#each list}} ... {{/each}} repeat once per item; {{field}} inside
+//                               names a field of the item (or a variable)
+//   {{! comment }}              dropped
+//
+// Templates are looked up per device profile: TEMPLATE_DIR/<profile name>/,
+// then TEMPLATE_DIR/<device type>/, then TEMPLATE_DIR/common/.
+
+#define TEMPLATE_DIR "templates"
+#define TEMPLATE_COMMON "common"
+#define TEMPLATE_PATH 512
+
+typedef struct {
+    const char* name;                   // {{#each name}}
+    const char* const* fields;          // NULL-terminated item field names
+    int (*count)(const void* data);
+    // Point out[i] at the text of field i of item index; numbers can be
+    // formatted into scratch
+    void (*item)(const void* data, int index, const char** out, char* scratch, size_t size);
+} template_list_t;
+
+typedef struct {
+    const char* const* vars;            // NULL-terminated variable names
+    const template_list_t* lists;       // NULL, or ended by an entry with a NULL name
+} template_schema_t;
+
+typedef struct template template_t;
+typedef struct template_cache template_cache_t;
+
+// Growable output; reuse one across renders and it stops allocating
+typedef struct {
+    char* data;                         // NUL-terminated after a render
+    size_t length;
+    size_t capacity;
+} template_buffer_t;
+
+void template_buffer_init(template_buffer_t* buffer);
+void template_buffer_free(template_buffer_t* buffer);
+
+// Compile source (copied) against schema; name is used in error messages.
+// Returns NULL and logs the line of the first error.
+template_t* template_compile(const char* name, const char* source, const template_schema_t* schema);
+void template_free(template_t* tmpl);
+
+// values[i] is the text of schema->vars[i] (NULL renders as empty);
+// list_data is handed to the schema's list callbacks.
+// Returns the rendered length, or -1 if the buffer could not grow.
+long template_render(const template_t* tmpl, const char* const* values, const void* list_data,
+                     template_buffer_t* out);
+
+// Compiled templates keyed by (profile, type, name); safe to share between threads
+template_cache_t* template_cache_create(const char* root);
+void template_cache_free(template_cache_t* cache);
+
+// Find name for a profile (see lookup order above), compiling it on first
+// use. Returns NULL if no directory has it or it does not compile. Both
+// answers are remembered: later calls for the same key do not touch the
+// disk, so a template added or fixed later needs a new cache.
+const template_t* template_cache_get(template_cache_t* cache, const char* profile, const char* type,
+                                     const char* name, const template_schema_t* schema);
+
+#endif // TEMPLATE_H
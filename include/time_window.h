@@ -0,0 +1,30 @@
+#ifndef TIME_WINDOW_H
+#define TIME_WINDOW_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MAX_WINDOWS 4       // Sliding windows evaluated per IP
+#define WINDOW_BUCKETS 12   // Resolution of each window's hit counter
+
+// Hit counter over one sliding window, as a ring of time buckets.
+// Buckets are addressed by absolute slot (event time / bucket width), so
+// hits can be added in any order and two rings can be merged.
+typedef struct {
+    int64_t head_slot;                 // Newest slot the ring covers
+    uint16_t counts[WINDOW_BUCKETS];   // Saturating per-bucket hit counts
+} hit_ring_t;
+
+// Ring operations
+void hit_ring_add(hit_ring_t* ring, int64_t slot, uint32_t count);
+void hit_ring_merge(hit_ring_t* dst, const hit_ring_t* src);
+uint32_t hit_ring_sum(const hit_ring_t* ring, int64_t now_slot);
+
+// Window specifications ("300", "5m", "1h", "1d"; lists are comma separated).
+// parse_window_list() fills seconds (sorted, at most MAX_WINDOWS) and
+// returns the count, or returns -1 and leaves seconds untouched.
+int parse_duration(const char* text);
+int parse_window_list(const char* spec, int* seconds, int max_windows);
+void format_duration(int seconds, char* out, size_t out_size);
+
+#endif // TIME_WINDOW_H
@@ -23,6 +23,7 @@ void log_event_file(log_level_t level, const char* filepath, const char* msg);
 bool file_exists(const char* filepath);
 bool dir_exists(const char* dirpath);
 int read_file(const char* filepath, char* buffer, size_t buffer_size);
+// write_file and copy_file replace dst atomically (temp file + rename)
 int write_file(const char* filepath, const char* content);
 int append_file(const char* filepath, const char* content);
 int copy_file(const char* src, const char* dst);
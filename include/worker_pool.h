@@ -0,0 +1,11 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+// Runs job(arg, i) for every i in [0, job_count) on up to `threads` threads.
+// The calling thread works too; the call returns when every job is done.
+// Jobs are handed out in index order but may finish in any order.
+typedef void (*worker_job_fn)(void* arg, int index);
+
+int worker_pool_run(int threads, int job_count, worker_job_fn job, void* arg);
+
+#endif // WORKER_POOL_H
@@ -8,8 +8,10 @@ import os
 import json
 from typing import Optional
 
-# Path to Cerberus dynamic outputs (inside Cowrie container)
-CERBERUS_DYNAMIC = "/data/cowrie-dynamic"
+# Path to Cerberus dynamic outputs (inside Cowrie container). "current" is a
+# symlink the morph engine swaps in one step, so it always names a complete
+# generation.
+CERBERUS_DYNAMIC = "/data/cowrie-dynamic.d/current"
 
 def load_cerberus_output(command_name: str, args: list = None) -> Optional[str]:
     """
@@ -0,0 +1,524 @@
+/**
+ * honeyfs.c - Build the honeyfs tree from a per-profile manifest
+ *
+ * Every morph used to run scripts/setup_honeyfs.sh through system(): a
+ * shell, a few hundred forked mkdir/cat/echo/date processes, and an
+ * `rm -rf` of the whole tree first - hundreds of milliseconds, and Cowrie
+ * could read the tree while it was empty. Then setup_device_filesystem()
+ * copied the profile's /etc files over it one by one, whether they had
+ * changed or not.
+ *
+ * Now each profile declares its tree in honeyfs-profiles/<profile>/manifest
+ * and this file makes the honeyfs match it, in-process:
+ *
+ *   - Every path is resolved with the *at() calls against one directory fd
+ *     for the profiles and one for the honeyfs. Manifest paths are checked
+ *     to be relative with no "..", so nothing outside the two roots can be
+ *     named.
+ *   - A file whose content hash matches what is already there is left
+ *     alone. Switching back and forth between two routers rewrites nothing.
+ *   - A new or changed file is reflinked to its source where the filesystem
+ *     can, else copied - never hard linked, since a write through the
+ *     honeyfs would then change the profile source. Either way it lands
+ *     under a temporary name and is renamed into place, so a reader sees
+ *     the old file or the new one.
+ *   - Paths the previous manifest created and this one does not list are
+ *     removed; files nobody declared are never touched.
+ *
+ * MANIFEST FORMAT (one entry per line, '#' starts a comment line):
+ *   dir     <path> [mode]
+ *   file    <path> [mode] [source]
+ *   symlink <path> <target>
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#endif
+#include "honeyfs.h"
+#include "utils.h"
+
+#define MANIFEST_MAX_SIZE (256 * 1024)
+#define DEFAULT_DIR_MODE 0755
+
+typedef enum {
+    ENTRY_DIR,
+    ENTRY_FILE,
+    ENTRY_SYMLINK
+} entry_type_t;
+
+typedef struct {
+    entry_type_t type;
+    char path[HONEYFS_PATH];
+    char source[HONEYFS_PATH];      // file: source under the profiles root; symlink: target
+    int mode;                       // -1: directories 0755, files keep the source's mode
+} honeyfs_entry_t;
+
+typedef struct {
+    honeyfs_entry_t entries[HONEYFS_MAX_ENTRIES];
+    int count;
+} manifest_t;
+
+/* ---------------------------------------------------------------------------
+ * Paths
+ * --------------------------------------------------------------------------- */
+
+// Relative, no empty, "." or ".." components - it cannot leave its root
+static int valid_rel_path(const char* path) {
+    if (!path || !path[0] || path[0] == '/' || strlen(path) >= HONEYFS_PATH) return 0;
+
+    const char* p = path;
+    while (*p) {
+        const char* end = strchr(p, '/');
+        size_t len = end ? (size_t)(end - p) : strlen(p);
+        if (len == 0) return 0;
+        if ((len == 1 && p[0] == '.') || (len == 2 && p[0] == '.' && p[1] == '.')) return 0;
+        if (!end) break;
+        p = end + 1;
+    }
+    return path[strlen(path) - 1] != '/';
+}
+
+// A symlink at path pointing to target must resolve inside the tree
+static int link_stays_inside(const char* path, const char* target) {
+    if (!target[0] || target[0] == '/') return 0;
+
+    int depth = 0;
+    for (const char* p = path; *p; p++) {
+        if (*p == '/') depth++;        // Directories the link sits in
+    }
+    const char* p = target;
+    while (*p) {
+        const char* end = strchr(p, '/');
+        size_t len = end ? (size_t)(end - p) : strlen(p);
+        if (len == 2 && p[0] == '.' && p[1] == '.') {
+            if (--depth < 0) return 0;
+        } else if (len > 0 && !(len == 1 && p[0] == '.')) {
+            depth++;
+        }
+        if (!end) break;
+        p = end + 1;
+    }
+    return 1;
+}
+
+// mkdir every directory above path; existing ones are fine
+static int ensure_parents(int dirfd, const char* path) {
+    char partial[HONEYFS_PATH];
+    snprintf(partial, sizeof(partial), "%s", path);
+
+    for (char* slash = strchr(partial, '/'); slash; slash = strchr(slash + 1, '/')) {
+        *slash = '\0';
+        int made = mkdirat(dirfd, partial, DEFAULT_DIR_MODE);
+        *slash = '/';
+        if (made != 0 && errno != EEXIST) return -1;
+    }
+    return 0;
+}
+
+/* ---------------------------------------------------------------------------
+ * Manifest
+ * --------------------------------------------------------------------------- */
+
+static int parse_mode(const char* token) {
+    size_t len = strlen(token);
+    if (len == 0 || len > 4 || strspn(token, "01234567") != len) return -1;
+    return (int)strtol(token, NULL, 8);
+}
+
+static int manifest_error(const char* profile, int line, const char* reason) {
+    char msg[256];
+    snprintf(msg, sizeof(msg), "Honeyfs manifest %s line %d: %s", profile, line, reason);
+    log_event_level(LOG_ERROR, msg);
+    return -1;
+}
+
+static int parse_manifest(char* text, const char* profile, manifest_t* manifest) {
+    manifest->count = 0;
+
+    int line_no = 0;
+    for (char* line = text; line; ) {
+        char* newline = strchr(line, '\n');
+        if (newline) *newline = '\0';
+        char* rest = newline ? newline + 1 : NULL;
+        line_no++;
+        char* tokens[5];
+        int count = 0;
+        char* token_save = NULL;
+        for (char* t = strtok_r(line, " \t\r", &token_save); t && count < 5;
+             t = strtok_r(NULL, " \t\r", &token_save)) {
+            tokens[count++] = t;
+        }
+        if (count == 0 || tokens[0][0] == '#') {
+            line = rest;
+            continue;
+        }
+
+        if (manifest->count >= HONEYFS_MAX_ENTRIES) {
+            return manifest_error(profile, line_no, "too many entries");
+        }
+        honeyfs_entry_t* e = &manifest->entries[manifest->count];
+        memset(e, 0, sizeof(*e));
+        e->mode = -1;
+        if (count < 2 || !valid_rel_path(tokens[1])) {
+            return manifest_error(profile, line_no, "missing or unsafe path");
+        }
+        snprintf(e->path, sizeof(e->path), "%s", tokens[1]);
+
+        int next = 2;
+        if (strcmp(tokens[0], "dir") == 0 || strcmp(tokens[0], "file") == 0) {
+            e->type = tokens[0][0] == 'd' ? ENTRY_DIR : ENTRY_FILE;
+            if (next < count && parse_mode(tokens[next]) >= 0) e->mode = parse_mode(tokens[next++]);
+            if (e->type == ENTRY_FILE) {
+                if (next < count) {
+                    if (!valid_rel_path(tokens[next])) {
+                        return manifest_error(profile, line_no, "unsafe source path");
+                    }
+                    snprintf(e->source, sizeof(e->source), "%s", tokens[next++]);
+                } else if ((size_t)snprintf(e->source, sizeof(e->source), "%s/%s",
+                                            profile, tokens[1]) >= sizeof(e->source)) {
+                    return manifest_error(profile, line_no, "path too long");
+                }
+            }
+        } else if (strcmp(tokens[0], "symlink") == 0) {
+            e->type = ENTRY_SYMLINK;
+            if (next >= count || strlen(tokens[next]) >= sizeof(e->source) ||
+                !link_stays_inside(e->path, tokens[next])) {
+                return manifest_error(profile, line_no, "symlink target missing or outside the tree");
+            }
+            snprintf(e->source, sizeof(e->source), "%s", tokens[next++]);
+        } else {
+            return manifest_error(profile, line_no, "unknown entry type");
+        }
+        if (next != count) return manifest_error(profile, line_no, "unexpected extra fields");
+        manifest->count++;
+        line = rest;
+    }
+    return 0;
+}
+
+// Whole small file at dirfd/path as a NUL-terminated heap string
+static char* read_small_file(int dirfd, const char* path, size_t max) {
+    int fd = openat(dirfd, path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return NULL;
+
+    struct stat st;
+    char* text = NULL;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && (size_t)st.st_size <= max) {
+        text = malloc((size_t)st.st_size + 1);
+    }
+    size_t length = 0;
+    while (text && length < (size_t)st.st_size) {
+        ssize_t n = read(fd, text + length, (size_t)st.st_size - length);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        length += (size_t)n;
+    }
+    close(fd);
+    if (text) text[length] = '\0';
+    return text;
+}
+
+/* ---------------------------------------------------------------------------
+ * Content
+ * --------------------------------------------------------------------------- */
+
+// FNV-1a over the whole file
+static int hash_fd(int fd, uint64_t* hash) {
+    if (lseek(fd, 0, SEEK_SET) < 0) return -1;
+
+    uint64_t h = 14695981039346656037ull;
+    unsigned char buf[16384];
+    for (;;) {
+        ssize_t n = read(fd, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return -1;
+        if (n == 0) break;
+        for (ssize_t i = 0; i < n; i++) {
+            h ^= buf[i];
+            h *= 1099511628211ull;
+        }
+    }
+    *hash = h;
+    return 0;
+}
+
+static int same_content(int src, const struct stat* src_st, int destfd, const char* path,
+                        const struct stat* dst_st) {
+    if (!S_ISREG(dst_st->st_mode) || dst_st->st_size != src_st->st_size) return 0;
+    if (dst_st->st_dev == src_st->st_dev && dst_st->st_ino == src_st->st_ino) return 1;
+
+    int dst = openat(destfd, path, O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+    if (dst < 0) return 0;
+    uint64_t a, b;
+    int same = hash_fd(src, &a) == 0 && hash_fd(dst, &b) == 0 && a == b;
+    close(dst);
+    return same;
+}
+
+static int clone_fd(int src, int out) {
+#ifdef FICLONE
+    return ioctl(out, FICLONE, src);
+#else
+    (void)src;
+    (void)out;
+    return -1;
+#endif
+}
+
+static int copy_fd(int src, int out) {
+    if (lseek(src, 0, SEEK_SET) < 0) return -1;
+
+    char buf[16384];
+    for (;;) {
+        ssize_t n = read(src, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return -1;
+        if (n == 0) return 0;
+        for (ssize_t done = 0; done < n;) {
+            ssize_t w = write(out, buf + done, (size_t)(n - done));
+            if (w < 0 && errno == EINTR) continue;
+            if (w <= 0) return -1;
+            done += w;
+        }
+    }
+}
+
+/* ---------------------------------------------------------------------------
+ * Entries
+ * --------------------------------------------------------------------------- */
+
+static int place_dir(int destfd, const honeyfs_entry_t* e, honeyfs_stats_t* stats) {
+    mode_t mode = e->mode >= 0 ? (mode_t)e->mode : DEFAULT_DIR_MODE;
+    if (ensure_parents(destfd, e->path) != 0) return -1;
+
+    if (mkdirat(destfd, e->path, mode) == 0) {
+        if (fchmodat(destfd, e->path, mode, 0) != 0) return -1;    // mkdir applies the umask
+        stats->created++;
+        return 0;
+    }
+    struct stat st;
+    if (errno != EEXIST || fstatat(destfd, e->path, &st, AT_SYMLINK_NOFOLLOW) != 0 ||
+        !S_ISDIR(st.st_mode)) {
+        return -1;
+    }
+    if (e->mode >= 0 && (st.st_mode & 07777) != mode && fchmodat(destfd, e->path, mode, 0) != 0) {
+        return -1;
+    }
+    stats->unchanged++;
+    return 0;
+}
+
+static int place_file(int rootfd, int destfd, const honeyfs_entry_t* e, honeyfs_stats_t* stats) {
+    int src = openat(rootfd, e->source, O_RDONLY | O_CLOEXEC);
+    if (src < 0) return -1;
+    struct stat src_st;
+    if (fstat(src, &src_st) != 0 || !S_ISREG(src_st.st_mode) || ensure_parents(destfd, e->path) != 0) {
+        close(src);
+        return -1;
+    }
+    mode_t mode = e->mode >= 0 ? (mode_t)e->mode : (src_st.st_mode & 07777);
+
+    struct stat dst_st;
+    int exists = fstatat(destfd, e->path, &dst_st, AT_SYMLINK_NOFOLLOW) == 0;
+    // A hard link left by an older build is replaced: a write through the
+    // honeyfs must never reach the profile source
+    int shared = exists && dst_st.st_ino == src_st.st_ino && dst_st.st_dev == src_st.st_dev;
+    if (exists && !shared && same_content(src, &src_st, destfd, e->path, &dst_st)) {
+        close(src);
+        if ((dst_st.st_mode & 07777) != mode && fchmodat(destfd, e->path, mode, 0) != 0) return -1;
+        stats->unchanged++;
+        return 0;
+    }
+
+    char tmp[HONEYFS_PATH + 8];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", e->path);
+    unlinkat(destfd, tmp, 0);
+
+    int linked = 0;
+    int result = 0;
+    int out = openat(destfd, tmp, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, mode);
+    if (out < 0) {
+        result = -1;
+    } else {
+        if (clone_fd(src, out) == 0) {
+            linked = 1;
+        } else if (copy_fd(src, out) != 0) {
+            result = -1;
+        }
+        if (fchmod(out, mode) != 0 || close(out) != 0) result = -1;
+    }
+    close(src);
+
+    if (result == 0 && renameat(destfd, tmp, destfd, e->path) != 0) result = -1;
+    if (result != 0) {
+        unlinkat(destfd, tmp, 0);
+        return -1;
+    }
+    if (exists) {
+        stats->updated++;
+    } else {
+        stats->created++;
+    }
+    if (linked) stats->linked++;
+    return 0;
+}
+
+static int place_symlink(int destfd, const honeyfs_entry_t* e, honeyfs_stats_t* stats) {
+    char current[HONEYFS_PATH];
+    ssize_t len = readlinkat(destfd, e->path, current, sizeof(current) - 1);
+    if (len >= 0) {
+        current[len] = '\0';
+        if (strcmp(current, e->source) == 0) {
+            stats->unchanged++;
+            return 0;
+        }
+    }
+    struct stat st;
+    int exists = fstatat(destfd, e->path, &st, AT_SYMLINK_NOFOLLOW) == 0;
+    if (ensure_parents(destfd, e->path) != 0) return -1;
+
+    char tmp[HONEYFS_PATH + 8];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", e->path);
+    unlinkat(destfd, tmp, 0);
+    if (symlinkat(e->source, destfd, tmp) != 0) return -1;
+    if (renameat(destfd, tmp, destfd, e->path) != 0) {
+        unlinkat(destfd, tmp, 0);
+        return -1;
+    }
+    if (exists) {
+        stats->updated++;
+    } else {
+        stats->created++;
+    }
+    return 0;
+}
+
+/* ---------------------------------------------------------------------------
+ * Record of what the last build created
+ * --------------------------------------------------------------------------- */
+
+static int listed(const manifest_t* manifest, const char* path) {
+    for (int i = 0; i < manifest->count; i++) {
+        if (strcmp(manifest->entries[i].path, path) == 0) return 1;
+    }
+    return 0;
+}
+
+static int compare_longest_first(const void* a, const void* b) {
+    size_t la = strlen(*(char* const*)a);
+    size_t lb = strlen(*(char* const*)b);
+    return (la < lb) - (la > lb);
+}
+
+// Remove what the last build created that this manifest no longer lists.
+// Children sort before their parents, so emptied directories go too;
+// a directory someone else put files in stays.
+static void prune_stale(int destfd, const manifest_t* manifest, honeyfs_stats_t* stats) {
+    char* record = read_small_file(destfd, HONEYFS_RECORD, MANIFEST_MAX_SIZE);
+    if (!record) return;
+
+    char* stale[HONEYFS_MAX_ENTRIES];
+    int count = 0;
+    char* save = NULL;
+    for (char* line = strtok_r(record, "\n", &save); line && count < HONEYFS_MAX_ENTRIES;
+         line = strtok_r(NULL, "\n", &save)) {
+        if (line[0] != '#' && valid_rel_path(line) && !listed(manifest, line)) stale[count++] = line;
+    }
+    if (count > 1) qsort(stale, (size_t)count, sizeof(stale[0]), compare_longest_first);
+
+    for (int i = 0; i < count; i++) {
+        struct stat st;
+        if (fstatat(destfd, stale[i], &st, AT_SYMLINK_NOFOLLOW) != 0) continue;
+        if (unlinkat(destfd, stale[i], S_ISDIR(st.st_mode) ? AT_REMOVEDIR : 0) == 0) stats->removed++;
+    }
+    free(record);
+}
+
+static int write_record(int destfd, const manifest_t* manifest, const char* profile) {
+    char tmp[] = HONEYFS_RECORD ".tmp";
+    int fd = openat(destfd, tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return -1;
+
+    FILE* f = fdopen(fd, "w");
+    if (!f) {
+        close(fd);
+        return -1;
+    }
+    fprintf(f, "# Paths created by the honeyfs builder for profile %s\n", profile);
+    for (int i = 0; i < manifest->count; i++) fprintf(f, "%s\n", manifest->entries[i].path);
+    if (fclose(f) != 0) return -1;
+    return renameat(destfd, tmp, destfd, HONEYFS_RECORD);
+}
+
+/* ---------------------------------------------------------------------------
+ * Build
+ * --------------------------------------------------------------------------- */
+
+int honeyfs_build(const char* profiles_root, const char* profile, const char* dest_dir,
+                  honeyfs_stats_t* stats) {
+    honeyfs_stats_t local;
+    if (!stats) stats = &local;
+    memset(stats, 0, sizeof(*stats));
+    if (!profiles_root || !profile || !dest_dir || !valid_rel_path(profile) || strchr(profile, '/')) {
+        return -1;
+    }
+
+    int rootfd = open(profiles_root, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (rootfd < 0) return -1;
+
+    char manifest_path[HONEYFS_PATH + 16];
+    snprintf(manifest_path, sizeof(manifest_path), "%s/%s", profile, HONEYFS_MANIFEST);
+    char* text = read_small_file(rootfd, manifest_path, MANIFEST_MAX_SIZE);
+    manifest_t* manifest = calloc(1, sizeof(manifest_t));
+    if (!text || !manifest || parse_manifest(text, profile, manifest) != 0) {
+        if (!text) log_event_level(LOG_ERROR, "Honeyfs manifest not found for profile");
+        free(text);
+        free(manifest);
+        close(rootfd);
+        return -1;
+    }
+    free(text);
+
+    int destfd = -1;
+    if (create_dir(dest_dir) == 0) destfd = open(dest_dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (destfd < 0) {
+        free(manifest);
+        close(rootfd);
+        return -1;
+    }
+
+    prune_stale(destfd, manifest, stats);
+
+    int result = 0;
+    for (int i = 0; i < manifest->count; i++) {
+        const honeyfs_entry_t* e = &manifest->entries[i];
+        int placed = -1;
+        switch (e->type) {
+            case ENTRY_DIR:     placed = place_dir(destfd, e, stats); break;
+            case ENTRY_FILE:    placed = place_file(rootfd, destfd, e, stats); break;
+            case ENTRY_SYMLINK: placed = place_symlink(destfd, e, stats); break;
+        }
+        if (placed != 0) {
+            char msg[HONEYFS_PATH + 64];
+            snprintf(msg, sizeof(msg), "Honeyfs: could not place %s", e->path);
+            log_event_level(LOG_WARN, msg);
+            result = -1;
+        }
+    }
+
+    if (write_record(destfd, manifest, profile) != 0) result = -1;
+
+    free(manifest);
+    close(destfd);
+    close(rootfd);
+    return result;
+}
@@ -1,29 +1,29 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <time.h>
 #include <unistd.h>
 #include "morph.h"
 #include "utils.h"
-#include "network.h"
-#include "filesystem.h"
-#include "processes.h"
 #include "behavior.h"
-#include "temporal.h"
 #include "quorum_adapt.h"
+#include "worker_pool.h"
+#include "morph_stage.h"
+#include "morph_state.h"
+#include "honeyfs.h"
+#include "template.h"
 
 // Global state
 static device_profile_t profiles[MAX_PROFILES];
 static int profile_count = 0;
 static int current_profile_index = -1;
 static char state_file_path[MAX_PATH_SIZE] = "build/morph-state.txt";
+static template_cache_t* templates = NULL;
 
 // Forward declaration
 static int create_default_profiles(void);
 
-// External function declaration for Phase 1 (Network)
-extern int morph_network_config(const char* base_ip);
-
 // Profile management
 int load_profiles(const char* config_file) {
     if (!file_exists(config_file)) {
@@ -235,320 +235,340 @@ int set_current_profile(int index) {
     return 0;
 }
 
-// Morphing functions
-int morph_cowrie_banners(const device_profile_t* profile) {
-    if (!profile) return -1;
-    
-    char cowrie_cfg_path[] = "services/cowrie/etc/cowrie.cfg";
-    char cowrie_cfg_local[] = "services/cowrie/etc/cowrie.cfg.local";
-    
-    // Create cowrie config directory if it doesn't exist
-    create_dir("services/cowrie/etc");
-    
-    // Cowrie reads configuration from cowrie.cfg (main file)
-    // The [shell] section controls uname output - this is what affects command responses
-    // Environment variables take precedence, but we also write the config file
-    char config_content[4096];
-    snprintf(config_content, sizeof(config_content),
-        "# Cowrie configuration - Auto-generated by CERBERUS morph engine\n"
-        "# Profile: %s\n"
-        "# This file is read by Cowrie at startup for uname/hostname commands\n\n"
-        "[output_jsonlog]\n"
-        "enabled = true\n"
-        "logfile = log/cowrie.json\n\n"
-        "[output_textlog]\n"
-        "enabled = true\n"
-        "logfile = log/cowrie.log\n\n"
-        "[ssh]\n"
-        "# SSH settings\n"
-        "listen_endpoints = tcp:2222:interface=0.0.0.0\n"
-        "version = %s\n"
-        "banner = %s\n\n"
-        "[telnet]\n"
-        "# Telnet settings\n"
-        "listen_endpoints = tcp:2323:interface=0.0.0.0\n"
-        "banner = %s\n\n"
-        "[honeypot]\n"
-        "# Honeypot hostname (appears in logs and prompt)\n"
-        "hostname = %s\n"
-        "# Session timeout in seconds (600 = 10 minutes)\n"
-        "timeout = 600\n"
-        "# Realistic login attempt limits\n"
-        "login_attempt_limit = 10\n\n"
-        "[shell]\n"
-        "# Shell configuration - controls uname and hostname command outputs\n"
-        "# These values are what Cowrie returns for uname -a, uname -r, hostname, etc.\n"
-        "kernel_name = Linux\n"
-        "kernel_version = %s\n"
-        "kernel_build_string = #1 SMP PREEMPT %s\n"
-        "hardware_platform = %s\n"
-        "operating_system = GNU/Linux\n"
-        "hostname = %s\n",
-        profile->name,
-        profile->ssh_banner,
-        profile->ssh_banner,
-        profile->telnet_banner,
-        profile->name,
-        profile->kernel_version,
-        profile->arch,
-        profile->arch,
-        profile->name);
-    
-    // Write to MAIN config file (cowrie.cfg) - this is what Cowrie reads!
-    if (write_file(cowrie_cfg_path, config_content) != 0) {
-        log_event_level(LOG_ERROR, "Failed to write Cowrie config");
+/**
+ * Templates filled from a device_profile_t
+ * 
+ * WHY TEMPLATES: cowrie.cfg, cowrie.env and the default web pages were
+ * single snprintf() calls into fixed buffers. Adding a line meant editing C,
+ * and anything that outgrew the buffer was silently cut off. The text now
+ * lives in templates/ (per profile, per device type, or common), is compiled
+ * once at startup, and renders into a buffer that grows as needed.
+ * 
+ * The hostname and kernel fields come from the device state (through the
+ * generation's boot_info.conf), not the profile, so Cowrie's prompt and
+ * uname agree with /etc/hostname, /proc/version and dmesg.
+ */
+enum {
+    PVAR_PROFILE, PVAR_HOSTNAME, PVAR_SSH_BANNER, PVAR_TELNET_BANNER, PVAR_KERNEL, PVAR_KERNEL_BUILD,
+    PVAR_ARCH, PVAR_MAC, PVAR_MEMORY_MB, PVAR_CPU_MHZ, PVAR_DEVICE_TYPE, PVAR_COUNT
+};
+
+static const char* const profile_vars[PVAR_COUNT + 1] = {
+    "profile", "hostname", "ssh_banner", "telnet_banner", "kernel_version", "kernel_build",
+    "arch", "mac_address", "memory_mb", "cpu_mhz", "device_type", NULL
+};
+
+static const template_schema_t profile_schema = { profile_vars, NULL };
+
+// behavior.conf is filled from a session_behavior_t instead (phase 3)
+enum {
+    BVAR_PROFILE, BVAR_MIN_DELAY, BVAR_MAX_DELAY, BVAR_VARIANCE, BVAR_TIMEOUT, BVAR_FAILED_AUTH,
+    BVAR_JITTER, BVAR_PERMISSION, BVAR_NOT_FOUND, BVAR_TIMEOUT_ERROR, BVAR_COUNT
+};
+
+static const char* const behavior_vars[BVAR_COUNT + 1] = {
+    "profile", "min_delay_ms", "max_delay_ms", "response_variance", "timeout_seconds",
+    "max_failed_auth", "has_jitter", "permission_denied", "command_not_found", "timeout_error", NULL
+};
+
+static const template_schema_t behavior_schema = { behavior_vars, NULL };
+
+#define ROUTER_HTML_DIR "services/fake-router-web/html"
+#define CAMERA_HTML_DIR "services/fake-camera-web/html"
+
+// Everything morph_cowrie_banners() and the HTML defaults render, and where
+static const struct {
+    const char* name;
+    const char* path;
+    int required;           // Fail the morph (vs. warn) if this one cannot be written
+} profile_templates[] = {
+    { "cowrie.cfg",         "services/cowrie/etc/cowrie.cfg",           1 },
+    { "cowrie.cfg",         "services/cowrie/etc/cowrie.cfg.local",     0 },
+    { "cowrie.env",         "services/cowrie/etc/cowrie.env",           0 },
+    { "etc/issue",          "services/cowrie/honeyfs/etc/issue",        0 },
+    { "router-index.html",  NULL,                                       0 },
+    { "camera-index.html",  NULL,                                       0 },
+};
+
+#define PROFILE_TEMPLATE_COUNT ((int)(sizeof(profile_templates) / sizeof(profile_templates[0])))
+
+// Holds the strings values[] points into
+typedef struct {
+    const char* values[PVAR_COUNT];
+    char memory_mb[16];
+    char cpu_mhz[16];
+    char hostname[64];
+    char kernel_version[64];
+    char kernel_build[128];
+    char arch[32];
+} profile_values_t;
+
+/**
+ * Values for profile, with the identity the device state in out_dir settled on
+ * Returns -1 if out_dir has no boot_info.conf (phase 1 did not run or failed).
+ */
+static int fill_profile_values(const device_profile_t* profile, const char* out_dir, profile_values_t* v) {
+    char boot_info[MAX_PATH_SIZE];
+    snprintf(boot_info, sizeof(boot_info), "%s/boot_info.conf", out_dir);
+    if (read_config_value(boot_info, "hostname", v->hostname, sizeof(v->hostname)) != 0 ||
+        read_config_value(boot_info, "kernel_version", v->kernel_version, sizeof(v->kernel_version)) != 0 ||
+        read_config_value(boot_info, "kernel_build", v->kernel_build, sizeof(v->kernel_build)) != 0 ||
+        read_config_value(boot_info, "arch", v->arch, sizeof(v->arch)) != 0) {
+        log_event_level(LOG_ERROR, "No device state to take the hostname and kernel from");
         return -1;
     }
     
-    // Also write to local config for backwards compatibility
-    if (write_file(cowrie_cfg_local, config_content) != 0) {
-        log_event_level(LOG_WARN, "Failed to write Cowrie local config");
-    }
-    
-    // Generate environment file for Docker - Cowrie checks env vars FIRST
-    // This is the most reliable way to set uname values
-    char env_file_path[] = "services/cowrie/etc/cowrie.env";
-    char env_content[1024];
-    snprintf(env_content, sizeof(env_content),
-        "# Cowrie environment variables - Auto-generated by CERBERUS morph engine\n"
-        "# Profile: %s\n"
-        "# These override ALL config file values for uname/hostname commands\n"
-        "COWRIE_SHELL_KERNEL_NAME=Linux\n"
-        "COWRIE_SHELL_KERNEL_VERSION=%s\n"
-        "COWRIE_SHELL_KERNEL_BUILD_STRING=#1 SMP PREEMPT %s\n"
-        "COWRIE_SHELL_HARDWARE_PLATFORM=%s\n"
-        "COWRIE_SHELL_OPERATING_SYSTEM=GNU/Linux\n"
-        "COWRIE_HONEYPOT_HOSTNAME=%s\n",
-        profile->name,
-        profile->kernel_version,
-        profile->arch,
-        profile->arch,
-        profile->name);
-    
-    if (write_file(env_file_path, env_content) != 0) {
-        log_event_level(LOG_WARN, "Failed to write Cowrie env file");
+    snprintf(v->memory_mb, sizeof(v->memory_mb), "%d", profile->memory_mb);
+    snprintf(v->cpu_mhz, sizeof(v->cpu_mhz), "%d", profile->cpu_mhz);
+    v->values[PVAR_PROFILE] = profile->name;
+    v->values[PVAR_HOSTNAME] = v->hostname;
+    v->values[PVAR_SSH_BANNER] = profile->ssh_banner;
+    v->values[PVAR_TELNET_BANNER] = profile->telnet_banner;
+    v->values[PVAR_KERNEL] = v->kernel_version;
+    v->values[PVAR_KERNEL_BUILD] = v->kernel_build;
+    v->values[PVAR_ARCH] = v->arch;
+    v->values[PVAR_MAC] = profile->mac_address;
+    v->values[PVAR_MEMORY_MB] = v->memory_mb;
+    v->values[PVAR_CPU_MHZ] = v->cpu_mhz;
+    v->values[PVAR_DEVICE_TYPE] = get_profile_type(profile->name);
+    return 0;
+}
+
+/**
+ * Where the service file live_path is staged in out_dir; creates its directory
+ */
+static int staged_path(const char* out_dir, const char* live_path, char* path, size_t size) {
+    if ((size_t)snprintf(path, size, "%s/%s", out_dir, live_path) >= size) return -1;
+    char* slash = strrchr(path, '/');
+    *slash = '\0';
+    int result = create_dir(path);
+    *slash = '/';
+    return result;
+}
+
+/**
+ * Render template name for profile and stage it for live_path under out_dir
+ * buffer is reused between calls so a morph only allocates while it grows.
+ * On failure the staged copy is removed, so the previous profile's file
+ * (carried into the generation) is not installed in its place.
+ */
+static int render_profile_template(const device_profile_t* profile, const profile_values_t* v, const char* name,
+                                   const char* out_dir, const char* live_path, template_buffer_t* buffer) {
+    char path[MAX_PATH_SIZE];
+    if (staged_path(out_dir, live_path, path, sizeof(path)) != 0) return -1;
+    
+    const template_t* tmpl = template_cache_get(templates, profile->name, get_profile_type(profile->name),
+                                                name, &profile_schema);
+    if (!tmpl || template_render(tmpl, v->values, NULL, buffer) < 0 || write_file(path, buffer->data) != 0) {
+        remove(path);
+        return -1;
     }
-    
-    // Update honeyfs (fake filesystem) files for shell responses
-    // Create honeyfs directory structure if it doesn't exist
-    create_dir("services/cowrie/honeyfs/etc");
-    create_dir("services/cowrie/honeyfs/proc");
-    
-    // Update /etc/hostname (what 'hostname' command reads)
-    char hostname_path[] = "services/cowrie/honeyfs/etc/hostname";
-    if (write_file(hostname_path, profile->name) != 0) {
-        log_event_level(LOG_WARN, "Failed to write honeyfs hostname");
+    return 0;
+}
+
+/**
+ * Compile every template a profile can use, so morphs never parse
+ * Missing or broken templates are reported here, at startup.
+ */
+static int load_profile_templates(const device_profile_t* profile) {
+    const char* type = get_profile_type(profile->name);
+    int result = 0;
+    for (int i = 0; i < PROFILE_TEMPLATE_COUNT; i++) {
+        if (!template_cache_get(templates, profile->name, type, profile_templates[i].name, &profile_schema)) {
+            result = -1;
+        }
     }
+    if (!template_cache_get(templates, profile->name, type, "behavior.conf", &behavior_schema)) result = -1;
+    if (morph_state_load_templates(templates, profile->name, type) != 0) result = -1;
+    return result;
+}
+
+// Morphing functions
+int morph_cowrie_banners(const device_profile_t* profile, const char* out_dir, template_buffer_t* buffer) {
+    if (!profile || !out_dir || !buffer) return -1;
     
-    // Update /proc/version (what 'uname -a' reads)
-    char proc_version_path[] = "services/cowrie/honeyfs/proc/version";
-    char proc_version[512];
-    snprintf(proc_version, sizeof(proc_version),
-        "Linux version %s (root@localhost) (gcc version 4.6.3) #1 SMP PREEMPT %s",
-        profile->kernel_version, profile->arch);
-    if (write_file(proc_version_path, proc_version) != 0) {
-        log_event_level(LOG_WARN, "Failed to write honeyfs proc/version");
-    }
+    // Cowrie reads cowrie.cfg at startup; its [shell] section controls uname
+    // output. cowrie.env overrides it for Docker. The honeyfs /etc/hostname
+    // and /proc/version are written by phase 1 with the rest of the state.
+    profile_values_t v;
+    if (fill_profile_values(profile, out_dir, &v) != 0) return -1;
     
-    // Update /etc/issue (login banner)
-    char issue_path[] = "services/cowrie/honeyfs/etc/issue";
-    char issue_content[256];
-    snprintf(issue_content, sizeof(issue_content),
-        "%s Router\nKernel \\r on an \\m (\\l)\n\n",
-        profile->name);
-    if (write_file(issue_path, issue_content) != 0) {
-        log_event_level(LOG_WARN, "Failed to write honeyfs issue");
+    int result = 0;
+    for (int i = 0; i < PROFILE_TEMPLATE_COUNT; i++) {
+        if (!profile_templates[i].path) continue;
+        if (render_profile_template(profile, &v, profile_templates[i].name, out_dir,
+                                    profile_templates[i].path, buffer) != 0) {
+            char msg[256];
+            snprintf(msg, sizeof(msg), "Failed to write %s", profile_templates[i].path);
+            log_event_level(profile_templates[i].required ? LOG_ERROR : LOG_WARN, msg);
+            if (profile_templates[i].required) result = -1;
+        }
     }
+    if (result != 0) return -1;
     
     char msg[256];
-    snprintf(msg, sizeof(msg), "Cowrie banners and honeyfs updated for profile: %s", profile->name);
+    snprintf(msg, sizeof(msg), "Cowrie banners and honeyfs files staged for profile: %s", profile->name);
     log_event_level(LOG_INFO, msg);
     return 0;
 }
 
-int morph_router_html(const device_profile_t* profile) {
-    if (!profile) return -1;
+/**
+ * Stage the profile's web theme, or the default page if it has none
+ */
+static int morph_web_html(const device_profile_t* profile, const char* theme_path, const char* kind,
+                          const char* default_template, const char* html_dir, const char* out_dir,
+                          template_buffer_t* buffer) {
+    char live_path[MAX_PATH_SIZE];
+    snprintf(live_path, sizeof(live_path), "%s/index.html", html_dir);
+    char msg[256];
     
     // Check if theme file exists
-    if (!file_exists(profile->router_html_path)) {
-        log_event_level(LOG_WARN, "Router HTML theme not found, using default");
-        // Create default HTML
-        create_dir("services/fake-router-web/html");
-        char default_html[2048];
-        snprintf(default_html, sizeof(default_html),
-            "<!DOCTYPE html>\n"
-            "<html><head><title>Router Admin - %s</title></head>\n"
-            "<body><h1>Router Administration</h1><p>Device: %s</p></body></html>\n",
-            profile->name, profile->name);
-        write_file("services/fake-router-web/html/index.html", default_html);
-        return 0;
+    if (!file_exists(theme_path)) {
+        snprintf(msg, sizeof(msg), "%s HTML theme not found, using default", kind);
+        log_event_level(LOG_WARN, msg);
+        
+        profile_values_t v;
+        if (fill_profile_values(profile, out_dir, &v) != 0) return -1;
+        
+        int result = render_profile_template(profile, &v, default_template, out_dir, live_path, buffer);
+        if (result != 0) {
+            snprintf(msg, sizeof(msg), "Failed to write default %s HTML", kind);
+            log_event_level(LOG_ERROR, msg);
+        }
+        return result;
     }
     
-    // Copy theme to active location
-    if (copy_file(profile->router_html_path, "services/fake-router-web/html/index.html") != 0) {
-        log_event_level(LOG_ERROR, "Failed to copy router HTML");
+    // Stage the theme for the active location
+    char index_path[MAX_PATH_SIZE];
+    if (staged_path(out_dir, live_path, index_path, sizeof(index_path)) != 0 ||
+        copy_file(theme_path, index_path) != 0) {
+        snprintf(msg, sizeof(msg), "Failed to copy %s HTML", kind);
+        log_event_level(LOG_ERROR, msg);
         return -1;
     }
     
-    log_event_level(LOG_INFO, "Router HTML theme updated");
+    snprintf(msg, sizeof(msg), "%s HTML theme staged", kind);
+    log_event_level(LOG_INFO, msg);
     return 0;
 }
 
-int morph_camera_html(const device_profile_t* profile) {
-    if (!profile) return -1;
-    
-    // Check if theme file exists
-    if (!file_exists(profile->camera_html_path)) {
-        log_event_level(LOG_WARN, "Camera HTML theme not found, using default");
-        // Create default HTML
-        create_dir("services/fake-camera-web/html");
-        char default_html[2048];
-        snprintf(default_html, sizeof(default_html),
-            "<!DOCTYPE html>\n"
-            "<html><head><title>Camera View - %s</title></head>\n"
-            "<body><h1>CCTV Camera Feed</h1><p>Device: %s</p></body></html>\n",
-            profile->name, profile->name);
-        write_file("services/fake-camera-web/html/index.html", default_html);
-        return 0;
-    }
-    
-    // Copy theme to active location
-    if (copy_file(profile->camera_html_path, "services/fake-camera-web/html/index.html") != 0) {
-        log_event_level(LOG_ERROR, "Failed to copy camera HTML");
-        return -1;
-    }
-    
-    log_event_level(LOG_INFO, "Camera HTML theme updated");
-    return 0;
+int morph_router_html(const device_profile_t* profile, const char* out_dir, template_buffer_t* buffer) {
+    if (!profile || !out_dir || !buffer) return -1;
+    return morph_web_html(profile, profile->router_html_path, "Router", "router-index.html",
+                          ROUTER_HTML_DIR, out_dir, buffer);
 }
 
-/**
- * Phase 1: Network Layer Variation
- * Generates randomized network interfaces, routing tables, ARP cache entries
- */
-int morph_phase1_network(const char* base_ip) {
-    log_event_level(LOG_INFO, "Phase 1: Network Layer Variation");
-    return morph_network_config(base_ip ? base_ip : "192.168.1.1");
+int morph_camera_html(const device_profile_t* profile, const char* out_dir, template_buffer_t* buffer) {
+    if (!profile || !out_dir || !buffer) return -1;
+    return morph_web_html(profile, profile->camera_html_path, "Camera", "camera-index.html",
+                          CAMERA_HTML_DIR, out_dir, buffer);
 }
 
 /**
- * Phase 2: Filesystem Dynamics
- * Creates varying filesystem structures with randomized timestamps
+ * Copy the service files staged in a published generation to where the
+ * services read them
  * 
- * WHY THIS FIX: Before, we generated beautiful fake filesystem data... then threw it away!
- * Like cooking a meal and dumping it in the trash. Now we actually SAVE the outputs
- * so Cowrie can serve them to attackers.
+ * WHY: Cowrie's config, the honeyfs and the web roots are mounted on their
+ * own, outside build/cowrie-dynamic, so the "current" swap cannot cover
+ * them. They are rendered into the generation with everything else - a
+ * missing template fails the morph before anything live changes - and only
+ * copied out once the generation is current. Each copy is a rename, so a
+ * reader sees the old file or the new one.
  */
-int morph_phase2_filesystem(const char* device_type) {
-    log_event_level(LOG_INFO, "Phase 2: Filesystem Dynamics");
+static int install_profile_outputs(const char* stage_dir) {
+    static const char* const other_outputs[] = {
+        ROUTER_HTML_DIR "/index.html",
+        CAMERA_HTML_DIR "/index.html",
+        HONEYFS_DIR "/etc/hostname",        // Written by phase 1 from the device state
+        HONEYFS_DIR "/etc/passwd",
+        HONEYFS_DIR "/etc/shadow",          // Re-moded 0600 below, as a real device keeps it
+        HONEYFS_DIR "/etc/group",
+        HONEYFS_DIR "/proc/version",
+    };
+    int count = PROFILE_TEMPLATE_COUNT + (int)(sizeof(other_outputs) / sizeof(other_outputs[0]));
+    int result = 0;
     
-    filesystem_snapshot_t* fs = create_filesystem_snapshot("/");
-    if (!fs) {
-        log_event_level(LOG_WARN, "Failed to create filesystem snapshot");
-        return -1;
+    for (int i = 0; i < count; i++) {
+        const char* live_path = (i < PROFILE_TEMPLATE_COUNT) ? profile_templates[i].path
+                                                             : other_outputs[i - PROFILE_TEMPLATE_COUNT];
+        if (!live_path) continue;
+        
+        char path[MORPH_STAGE_PATH + MAX_PATH_SIZE];
+        snprintf(path, sizeof(path), "%s/%s", stage_dir, live_path);
+        if (!file_exists(path)) continue;   // Optional output that did not render
+        
+        char dir[MAX_PATH_SIZE];
+        snprintf(dir, sizeof(dir), "%s", live_path);
+        *strrchr(dir, '/') = '\0';
+        if (create_dir(dir) != 0 || copy_file(path, live_path) != 0 ||
+            (strcmp(live_path, HONEYFS_DIR "/etc/shadow") == 0 && chmod(live_path, 0600) != 0)) {
+            char msg[MAX_PATH_SIZE + 32];
+            snprintf(msg, sizeof(msg), "Failed to install %s", live_path);
+            log_event_level(LOG_ERROR, msg);
+            result = -1;
+        }
     }
-    
-    // Generate variations based on device type
-    // Think of this like rearranging furniture - same room, different layout each time
-    generate_directory_variations(fs);
-    generate_file_size_variations(fs);
-    vary_permissions(fs);
-    
-    // Generate a realistic boot time for consistent timestamps
-    time_t boot_time = time(NULL) - get_realistic_uptime_seconds();
-    generate_random_timestamps(fs, boot_time);
-    
-    // Create output directory
-    create_dir("build/cowrie-dynamic/bin");
-    
-    // Generate and SAVE ls output (this is what attackers see when they type "ls")
-    char ls_output[4096];
-    generate_ls_output(fs, "/", ls_output, sizeof(ls_output));
-    write_file("build/cowrie-dynamic/bin/ls", ls_output);
-    
-    // Generate and SAVE find output
-    char find_output[4096];
-    generate_find_output(fs, NULL, find_output, sizeof(find_output));
-    write_file("build/cowrie-dynamic/bin/find", find_output);
-    
-    // Generate and SAVE du (disk usage) output
-    char du_output[4096];
-    generate_du_output(fs, du_output, sizeof(du_output));
-    write_file("build/cowrie-dynamic/bin/du", du_output);
-    
-    // Log what device type we're emulating
-    char msg[256];
-    snprintf(msg, sizeof(msg), "Filesystem morphing complete for: %s", 
-             device_type ? device_type : "Generic");
-    log_event_level(LOG_INFO, msg);
-    
-    // Clean up
-    free_filesystem_snapshot(fs);
-    
-    return 0;
+    return result;
 }
 
 /**
- * Phase 3: Process Simulation
- * Generates realistic process lists with varying PIDs
- * 
- * WHY THIS FIX: We were calling generate_core_processes() and generate_service_processes()
- * TWICE - once inside create_process_list() and once here. That's like washing dishes
- * that are already clean. Now we only randomize (which IS needed after creation).
+ * Write one phase output file under out_dir (the generation being staged)
+ * rel_dir may be NULL for files at the top of the generation.
  */
-int morph_phase3_processes(const char* device_profile) {
-    log_event_level(LOG_INFO, "Phase 3: Process Simulation");
-    
-    const char* profile = device_profile ? device_profile : "Generic_Router";
-    
-    // create_process_list() already calls generate_core_processes() and 
-    // generate_service_processes() internally - don't call them again!
-    process_list_t* procs = create_process_list(profile);
-    if (!procs) {
-        log_event_level(LOG_WARN, "Failed to create process list");
-        return -1;
+static int write_phase_output(const char* out_dir, const char* rel_dir, const char* name, const char* content) {
+    char path[MAX_PATH_SIZE];
+    if (rel_dir) {
+        snprintf(path, sizeof(path), "%s/%s", out_dir, rel_dir);
+        create_dir(path);
+        snprintf(path, sizeof(path), "%s/%s/%s", out_dir, rel_dir, name);
+    } else {
+        snprintf(path, sizeof(path), "%s/%s", out_dir, name);
     }
-    
-    // Only randomize - the processes are already generated inside create_process_list()
-    // Think of it like: the list is made, now we're just shuffling the cards
-    randomize_pids(procs);
-    randomize_memory_usage(procs, 128 * 1024);  // 128 MB in KB (was wrong unit!)
-    
-    // Generate outputs and write to Cowrie's dynamic directory
-    char ps_output[4096];
-    generate_ps_output(procs, ps_output, sizeof(ps_output));
-    
-    // Actually save the output so Cowrie can use it!
-    create_dir("build/cowrie-dynamic/bin");
-    write_file("build/cowrie-dynamic/bin/ps", ps_output);
-    
-    // Also generate ps aux output
-    char ps_aux_output[8192];
-    generate_ps_aux_output(procs, ps_aux_output, sizeof(ps_aux_output));
-    write_file("build/cowrie-dynamic/bin/ps_aux", ps_aux_output);
-    
-    // Generate top output
-    char top_output[8192];
-    generate_top_output(procs, top_output, sizeof(top_output));
-    write_file("build/cowrie-dynamic/bin/top", top_output);
-    
-    // Clean up
-    free_process_list(procs);
-    
-    log_event_level(LOG_INFO, "Process morphing complete - outputs written to cowrie-dynamic");
-    return 0;
+    return write_file(path, content);
 }
 
 /**
- * Phase 4: Behavioral Adaptation
+ * Phase 1: Device State
+ * Renders ps, top, uptime, dmesg, ifconfig, route, arp, df, /proc and /etc
+ * from one state engine state
+ * 
+ * WHY THIS EXISTS: Filesystem, processes and temporal were three phases
+ * that each made up their own numbers. An attacker could read 20 days in
+ * `uptime` and a boot 200 days ago in `dmesg`, or add up the RSS column of
+ * `ps aux` and get more than `free` said was used. One state behind every
+ * artifact means every command tells the same story. The network phase
+ * went the same way: its route and arp tables came from network.c's own
+ * interfaces, not the ones ifconfig showed.
+ */
+int morph_phase1_device_state(const device_profile_t* profile, const char* out_dir) {
+    log_event_level(LOG_INFO, "Phase 1: Device State");
+    
+    morph_identity_t identity = {
+        .name = profile->name,
+        .kernel_version = profile->kernel_version,
+        .ssh_banner = profile->ssh_banner,
+        .telnet_banner = profile->telnet_banner,
+        .arch = profile->arch,
+        .mac_prefix = profile->mac_address,
+        .memory_mb = profile->memory_mb,
+        .cpu_mhz = profile->cpu_mhz,
+        .is_camera = strcmp(get_profile_type(profile->name), "camera") == 0,
+        .type = get_profile_type(profile->name),
+        .templates = templates,
+    };
+    return morph_state_render(&identity, out_dir);
+}
+
+/**
+ * Phase 2: Behavioral Adaptation
  * Adds realistic command execution delays and error messages
  * 
  * WHY THIS FIX: Before, we calculated behavior settings but didn't save them anywhere!
  * Now we write a config file that tells Cowrie how to behave (delays, errors, etc.)
  * Think of it like writing stage directions for an actor.
  */
-int morph_phase4_behavior(const char* device_profile) {
-    log_event_level(LOG_INFO, "Phase 4: Behavioral Adaptation");
+int morph_phase2_behavior(const char* device_profile, const char* out_dir) {
+    log_event_level(LOG_INFO, "Phase 2: Behavioral Adaptation");
     
     const char* profile = device_profile ? device_profile : "Generic_Router";
     
@@ -556,109 +576,46 @@ int morph_phase4_behavior(const char* device_profile) {
     session_behavior_t session = generate_session_behavior(profile);
     
     // Create a behavior config file that other parts of the system can read
-    create_dir("build/cowrie-dynamic");
-    
-    char behavior_config[2048];
-    snprintf(behavior_config, sizeof(behavior_config),
-        "# Behavioral configuration - Auto-generated by CERBERUS\n"
-        "# Profile: %s\n"
-        "# These settings make the honeypot feel like a real slow IoT device\n\n"
-        "[delays]\n"
-        "min_delay_ms=%u\n"
-        "max_delay_ms=%u\n"
-        "response_variance=%.2f\n\n"
-        "[session]\n"
-        "timeout_seconds=%u\n"
-        "max_failed_auth=%u\n"
-        "has_jitter=%s\n\n"
-        "[errors]\n"
-        "# Common error responses for this device type\n"
-        "permission_denied=%s\n"
-        "command_not_found=%s\n"
-        "timeout_error=%s\n",
-        profile,
-        session.min_delay_ms,
-        session.max_delay_ms,
-        session.response_variance,
-        session.timeout_seconds,
-        session.failed_auth_attempts,
-        session.has_jitter ? "true" : "false",
-        get_permission_error("generic", "/etc/shadow"),
-        get_realistic_error("unknown_cmd"),
-        get_timeout_error("network")
-    );
-    
-    write_file("build/cowrie-dynamic/behavior.conf", behavior_config);
-    
-    // Log behavior characteristics
-    char msg[256];
-    snprintf(msg, sizeof(msg), "Session behavior configured: %u-%u ms delays, %us timeout", 
-             session.min_delay_ms, session.max_delay_ms, session.timeout_seconds);
-    log_event_level(LOG_INFO, msg);
-    
-    return 0;
-}
-
-/**
- * Phase 5: Temporal Evolution
- * Simulates system uptime that grows realistically and accumulates logs
- * 
- * WHY THIS FIX: We generated fake uptime, kernel messages, and logs... then forgot to save them!
- * Now we write these to files so when an attacker types "uptime" or "dmesg", they see
- * a consistent, realistic system that appears to have been running for days/months.
- */
-int morph_phase5_temporal(void) {
-    log_event_level(LOG_INFO, "Phase 5: Temporal Evolution");
-    
-    // Get a realistic boot time (system appears to have been running 1-365 days)
-    time_t boot_time = get_realistic_boot_time();
+    char min_delay[16], max_delay[16], variance[16], timeout[16], failed_auth[16];
+    snprintf(min_delay, sizeof(min_delay), "%u", session.min_delay_ms);
+    snprintf(max_delay, sizeof(max_delay), "%u", session.max_delay_ms);
+    snprintf(variance, sizeof(variance), "%.2f", session.response_variance);
+    snprintf(timeout, sizeof(timeout), "%u", session.timeout_seconds);
+    snprintf(failed_auth, sizeof(failed_auth), "%u", session.failed_auth_attempts);
+    const char* values[BVAR_COUNT] = {
+        [BVAR_PROFILE] = profile,
+        [BVAR_MIN_DELAY] = min_delay,
+        [BVAR_MAX_DELAY] = max_delay,
+        [BVAR_VARIANCE] = variance,
+        [BVAR_TIMEOUT] = timeout,
+        [BVAR_FAILED_AUTH] = failed_auth,
+        [BVAR_JITTER] = session.has_jitter ? "true" : "false",
+        [BVAR_PERMISSION] = get_permission_error("generic", "/etc/shadow"),
+        [BVAR_NOT_FOUND] = get_realistic_error("unknown_cmd"),
+        [BVAR_TIMEOUT_ERROR] = get_timeout_error("network"),
+    };
     
-    system_state_t* state = create_initial_system_state(boot_time);
-    if (!state) {
-        log_event_level(LOG_WARN, "Failed to create system state");
+    // Runs on a worker thread; the cache is shared but its lookups are locked
+    const template_t* tmpl = template_cache_get(templates, profile, get_profile_type(profile),
+                                                "behavior.conf", &behavior_schema);
+    template_buffer_t buffer;
+    template_buffer_init(&buffer);
+    int result = -1;
+    if (tmpl && template_render(tmpl, values, NULL, &buffer) >= 0) {
+        result = write_phase_output(out_dir, NULL, "behavior.conf", buffer.data);
+    }
+    template_buffer_free(&buffer);
+    if (result != 0) {
+        log_event_level(LOG_ERROR, "Failed to write behavior.conf");
         return -1;
     }
     
-    // Simulate the system aging - adds fake log entries, service restarts, etc.
-    simulate_system_aging(state);
-    accumulate_log_files(state);
-    
-    // Create output directories
-    create_dir("build/cowrie-dynamic/bin");
-    create_dir("build/cowrie-dynamic/var/log");
-    
-    // Generate and SAVE uptime output
-    // This is what attackers see when they type "uptime"
-    char uptime_output[512];
-    generate_system_uptime(state, uptime_output, sizeof(uptime_output));
-    write_file("build/cowrie-dynamic/bin/uptime", uptime_output);
-    
-    // Generate and SAVE kernel messages (dmesg output)
-    char dmesg_output[4096];
-    generate_kernel_messages(state, dmesg_output, sizeof(dmesg_output));
-    write_file("build/cowrie-dynamic/bin/dmesg", dmesg_output);
-    
-    // Generate and SAVE syslog
-    char syslog_output[8192];
-    generate_syslog(state, syslog_output, sizeof(syslog_output));
-    write_file("build/cowrie-dynamic/var/log/syslog", syslog_output);
-    
-    // Save the boot time so other phases can use it for consistent timestamps
-    char boot_info[256];
-    snprintf(boot_info, sizeof(boot_info), 
-             "boot_time=%ld\nuptime_seconds=%u\nkernel_version=%s\n",
-             boot_time, state->uptime_seconds, state->kernel_version);
-    write_file("build/cowrie-dynamic/boot_info.conf", boot_info);
-    
-    // Log what we did
+    // Log behavior characteristics
     char msg[256];
-    snprintf(msg, sizeof(msg), "Temporal morphing complete - system appears %u days old", 
-             state->uptime_seconds / 86400);
+    snprintf(msg, sizeof(msg), "Session behavior configured: %u-%u ms delays, %us timeout", 
+             session.min_delay_ms, session.max_delay_ms, session.timeout_seconds);
     log_event_level(LOG_INFO, msg);
     
-    // Clean up
-    free_system_state(state);
-    
     return 0;
 }
 
@@ -667,36 +624,32 @@ int morph_phase5_temporal(void) {
  * 
  * WHY THIS EXISTS: Every time we morph to a new device, we need to update
  * the fake filesystem to match. A router should have router files, a camera
- * should have camera files. This calls our setup script to rebuild honeyfs.
+ * should have camera files.
+ * 
+ * This used to run scripts/setup_honeyfs.sh through system() - a shell and
+ * hundreds of forked commands per morph. Now the profile's manifest
+ * (honeyfs-profiles/<type>/manifest) is applied in-process by honeyfs.c,
+ * which only rewrites files whose content changed.
  * 
  * Think of it like changing the set decorations when a play moves to a new scene.
  */
 int setup_honeyfs_for_profile(const char* device_name, const char* profile_type) {
-    log_event_level(LOG_INFO, "Setting up honeyfs for device profile...");
-    
-    // Build the command to run our setup script
-    // The script creates a realistic fake filesystem based on device type
-    char cmd[512];
-    snprintf(cmd, sizeof(cmd), 
-             "./scripts/setup_honeyfs.sh services/cowrie/honeyfs %s \"%s\" >/dev/null 2>&1",
-             profile_type, device_name);
-    
-    // Check if script exists before trying to run it
-    if (file_exists("scripts/setup_honeyfs.sh")) {
-        int result = system(cmd);
-        if (result == 0) {
-            char msg[256];
-            snprintf(msg, sizeof(msg), "Honeyfs configured for %s (%s)", device_name, profile_type);
-            log_event_level(LOG_INFO, msg);
-            return 0;
-        } else {
-            log_event_level(LOG_WARN, "Honeyfs setup script returned non-zero");
-        }
-    } else {
-        log_event_level(LOG_WARN, "Honeyfs setup script not found - using existing filesystem");
-    }
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
     
-    return -1;
+    honeyfs_stats_t stats;
+    int result = honeyfs_build(HONEYFS_PROFILES_DIR, profile_type, HONEYFS_DIR, &stats);
+    
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    long elapsed_us = (end.tv_sec - start.tv_sec) * 1000000L + (end.tv_nsec - start.tv_nsec) / 1000;
+    
+    char msg[256];
+    snprintf(msg, sizeof(msg),
+             "Honeyfs for %s (%s): %d created, %d updated (%d reflinked), %d unchanged, %d removed in %ld us",
+             device_name, profile_type, stats.created, stats.updated, stats.linked,
+             stats.unchanged, stats.removed, elapsed_us);
+    log_event_level(result == 0 ? LOG_INFO : LOG_WARN, msg);
+    return result;
 }
 
 /**
@@ -720,8 +673,32 @@ const char* get_profile_type(const char* device_name) {
     return "router";
 }
 
+#define EMERGENCY_SIGNAL "build/signals/emergency_morph.signal"
+
+// The emergency signal phase 3 saw in this morph, if any
+static struct stat emergency_seen;
+static int emergency_pending = 0;
+
+/**
+ * Clear the emergency signal this morph answered
+ * A signal quorum rewrote while we were morphing is a new request, so it
+ * is left for the next morph.
+ */
+static void clear_emergency_signal(void) {
+    if (!emergency_pending) return;
+    emergency_pending = 0;
+    
+    struct stat now;
+    if (stat(EMERGENCY_SIGNAL, &now) != 0 || now.st_ino != emergency_seen.st_ino ||
+        now.st_mtime != emergency_seen.st_mtime || now.st_size != emergency_seen.st_size) {
+        return;
+    }
+    remove(EMERGENCY_SIGNAL);
+    log_event_level(LOG_INFO, "Emergency signal processed and cleared");
+}
+
 /**
- * Phase 6: Quorum-Based Adaptation
+ * Phase 3: Quorum-Based Adaptation
  * Detects coordinated attacks and triggers adaptive responses
  * 
  * WHY THIS FIX: Before, this phase just logged "monitoring enabled" and did NOTHING!
@@ -731,30 +708,30 @@ const char* get_profile_type(const char* device_name) {
  * Think of it like checking your voicemail - the quorum engine leaves messages
  * (signal files), and this phase reads them and takes action.
  */
-int morph_phase6_quorum(void) {
-    log_event_level(LOG_INFO, "Phase 6: Quorum-Based Adaptation");
+int morph_phase3_quorum(void) {
+    log_event_level(LOG_INFO, "Phase 3: Quorum-Based Adaptation");
     
     // Check if there's an emergency morph signal from the quorum engine
     // The quorum engine writes this file when it detects coordinated attacks
-    const char* emergency_signal = "build/signals/emergency_morph.signal";
+    struct stat signal_stat;
+    emergency_pending = 0;
     
-    if (file_exists(emergency_signal)) {
+    if (stat(EMERGENCY_SIGNAL, &signal_stat) == 0) {
         log_event_level(LOG_WARN, "ALERT: Emergency morph signal detected!");
         
         // Read the signal to see why we're being asked to morph
         char signal_content[512];
-        if (read_file(emergency_signal, signal_content, sizeof(signal_content)) > 0) {
+        if (read_file(EMERGENCY_SIGNAL, signal_content, sizeof(signal_content)) > 0) {
             // Log what triggered the emergency
             if (strstr(signal_content, "coordinated_attack")) {
                 log_event_level(LOG_WARN, "Reason: Coordinated attack detected by quorum engine");
             }
         }
         
-        // Delete the signal file so we don't process it again
-        // It's like throwing away a "call me back" note after you've called
-        remove(emergency_signal);
-        
-        log_event_level(LOG_INFO, "Emergency signal processed and cleared");
+        // Only answered once the new device is live; morph_device() clears
+        // it then, and an aborted morph leaves it for the next attempt
+        emergency_seen = signal_stat;
+        emergency_pending = 1;
     } else {
         log_event_level(LOG_INFO, "No emergency signals - normal operation");
     }
@@ -808,64 +785,137 @@ int morph_phase6_quorum(void) {
 }
 
 /**
- * Setup device-specific filesystem based on profile type
+ * Phase scheduler
+ * 
+ * WHY THIS EXISTS: The morph phases used to run one after another, and their
+ * return codes were added up into a single number. Each phase builds its own
+ * data and writes its own files into the staged generation, so waiting for
+ * the device state phase before starting the next one bought nothing -
+ * and an emergency morph requested by quorum took as long as all the phases
+ * put together.
  * 
- * WHY THIS FIX: The old code had a buffer overflow risk - we were trying to 
- * stuff too many characters into a 512-byte buffer. Also, system() is a 
- * security risk (attackers could inject commands). Now we use safe C functions.
+ * Now every phase declares which phases must finish before it starts. Phases
+ * whose dependencies are done run together on the worker pool, wave after
+ * wave, and each one gets its own report (status, return code, time taken).
+ * Today none of the phases reads another's output, so they all go in the
+ * first wave and a morph takes as long as the slowest phase.
  */
-int setup_device_filesystem(const char* device_name) {
-    if (!device_name) {
-        return -1;
-    }
-    
-    // Determine if it's a router or camera based on profile name
-    // Think of this like sorting mail - router stuff goes to router box, camera to camera box
-    int is_router = 1;  // Default to router
-    if (strstr(device_name, "Camera") || strstr(device_name, "DS-2CD") || 
-        strstr(device_name, "Hikvision") || strstr(device_name, "Dahua") ||
-        strstr(device_name, "IPC")) {
-        is_router = 0;
+typedef int (*morph_phase_fn)(const device_profile_t* profile, const char* out_dir);
+
+typedef struct {
+    const char* name;
+    morph_phase_fn run;
+    unsigned int after;     // Bit i set: phase i+1 must succeed first
+} morph_phase_t;
+
+#define PHASE_BIT(index) (1u << (index))
+
+static int run_state_phase(const device_profile_t* profile, const char* out_dir) {
+    return morph_phase1_device_state(profile, out_dir);
+}
+
+static int run_behavior_phase(const device_profile_t* profile, const char* out_dir) {
+    return morph_phase2_behavior(profile->name, out_dir);
+}
+
+static int run_quorum_phase(const device_profile_t* profile, const char* out_dir) {
+    (void)profile;
+    (void)out_dir;
+    return morph_phase3_quorum();
+}
+
+static const morph_phase_t morph_phases[MORPH_PHASE_COUNT] = {
+    { "device state", run_state_phase,    0 },
+    { "behavior",     run_behavior_phase, 0 },
+    { "quorum",       run_quorum_phase,   0 },
+};
+
+typedef struct {
+    const device_profile_t* profile;
+    const char* out_dir;
+    morph_phase_report_t* reports;
+    int wave[MORPH_PHASE_COUNT];    // Phase indexes running in this wave
+} phase_wave_t;
+
+static void run_phase_job(void* arg, int index) {
+    phase_wave_t* wave = (phase_wave_t*)arg;
+    int phase = wave->wave[index];
+    morph_phase_report_t* report = &wave->reports[phase];
+    
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    report->result = morph_phases[phase].run(wave->profile, wave->out_dir);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    
+    report->elapsed_ms = (end.tv_sec - start.tv_sec) * 1000 + (end.tv_nsec - start.tv_nsec) / 1000000;
+    report->status = (report->result == 0) ? MORPH_PHASE_OK : MORPH_PHASE_FAILED;
+}
+
+int morph_run_phases(const device_profile_t* profile, const char* out_dir,
+                     morph_phase_report_t reports[MORPH_PHASE_COUNT]) {
+    if (!profile || !out_dir || !reports) return -1;
+    
+    for (int i = 0; i < MORPH_PHASE_COUNT; i++) {
+        reports[i].name = morph_phases[i].name;
+        reports[i].status = MORPH_PHASE_PENDING;
+        reports[i].result = 0;
+        reports[i].elapsed_ms = 0;
     }
     
-    const char* profile_type = is_router ? "router" : "camera";
-    
-    // Create the destination directory if it doesn't exist
-    create_dir("services/cowrie/honeyfs/etc");
-    
-    // Copy key files individually instead of using dangerous system() call
-    // This is like moving items one by one instead of dumping the whole drawer
-    char src_file[512];
-    char dst_file[512];
-    
-    // List of files to copy from profile to honeyfs
-    const char* profile_files[] = {
-        "passwd", "shadow", "group", "hostname", "hosts", 
-        "resolv.conf", "issue", "motd", NULL
-    };
-    
-    for (int i = 0; profile_files[i] != NULL; i++) {
-        snprintf(src_file, sizeof(src_file), 
-                 "services/cowrie/honeyfs-profiles/%s/etc/%s", 
-                 profile_type, profile_files[i]);
-        snprintf(dst_file, sizeof(dst_file), 
-                 "services/cowrie/honeyfs/etc/%s", 
-                 profile_files[i]);
+    unsigned int done = 0;
+    unsigned int failed = 0;     // Failed or skipped
+    for (;;) {
+        phase_wave_t wave = { .profile = profile, .out_dir = out_dir, .reports = reports };
+        int ready = 0;
+        bool skipped = false;
+        
+        for (int i = 0; i < MORPH_PHASE_COUNT; i++) {
+            if (reports[i].status != MORPH_PHASE_PENDING) continue;
+            
+            unsigned int after = morph_phases[i].after;
+            if (after & failed) {
+                // No point running on top of a phase that did not finish
+                reports[i].status = MORPH_PHASE_SKIPPED;
+                reports[i].result = -1;
+                failed |= PHASE_BIT(i);
+                skipped = true;
+            } else if ((after & done) == after) {
+                wave.wave[ready++] = i;
+            }
+        }
+        
+        if (ready == 0) {
+            if (skipped) continue;  // Skips may have unblocked more skips
+            break;                  // Finished (or the table has a cycle)
+        }
         
-        // Only copy if source exists (no error if it doesn't)
-        if (file_exists(src_file)) {
-            copy_file(src_file, dst_file);
+        worker_pool_run(ready, ready, run_phase_job, &wave);
+        
+        for (int w = 0; w < ready; w++) {
+            int i = wave.wave[w];
+            if (reports[i].status == MORPH_PHASE_OK) {
+                done |= PHASE_BIT(i);
+            } else {
+                failed |= PHASE_BIT(i);
+            }
         }
     }
     
-    char msg[256];
-    snprintf(msg, sizeof(msg), "Device filesystem configured for: %s (%s)", 
-             device_name, profile_type);
-    log_event_level(LOG_INFO, msg);
-    
+    for (int i = 0; i < MORPH_PHASE_COUNT; i++) {
+        if (reports[i].status != MORPH_PHASE_OK) return -1;
+    }
     return 0;
 }
 
+static const char* phase_status_name(morph_phase_status_t status) {
+    switch (status) {
+        case MORPH_PHASE_OK:      return "ok";
+        case MORPH_PHASE_FAILED:  return "failed";
+        case MORPH_PHASE_SKIPPED: return "skipped";
+        default:                  return "not run";
+    }
+}
+
 int morph_device(void) {
     if (profile_count == 0) {
         log_event_level(LOG_ERROR, "No profiles loaded");
@@ -888,54 +938,77 @@ int morph_device(void) {
     snprintf(msg, sizeof(msg), "Morphing to profile: %s", new_profile->name);
     log_event_level(LOG_INFO, msg);
     
-    // Apply morphing - Core functions
-    int result = 0;
-    result += morph_cowrie_banners(new_profile);
-    result += morph_router_html(new_profile);
-    result += morph_camera_html(new_profile);
+    log_event_level(LOG_INFO, "=== Starting Morphing Cycle ===");
+    
+    // Everything is written into a fresh generation; Cowrie keeps serving
+    // the current one until the whole new device is on disk
+    morph_stage_t stage;
+    if (morph_stage_begin(&stage, MORPH_STAGE_ROOT, MORPH_DYNAMIC_DIR) != 0) {
+        log_event_level(LOG_ERROR, "Morphing failed");
+        return -1;
+    }
     
-    // Setup device-specific filesystem using our honeyfs script
-    // This creates a realistic fake filesystem that matches the device type
-    const char* profile_type = get_profile_type(new_profile->name);
-    setup_honeyfs_for_profile(new_profile->name, profile_type);
+    // Generations left over from earlier morphs are removed here, well
+    // after the swap that retired them, rather than on the way to publishing
+    morph_stage_cleanup(MORPH_STAGE_ROOT, MORPH_STAGE_KEEP, &stage);
     
-    // Also run the old setup for backwards compatibility
-    setup_device_filesystem(new_profile->name);
+    morph_phase_report_t reports[MORPH_PHASE_COUNT];
+    int result = morph_run_phases(new_profile, stage.dir, reports);
     
-    // Apply all 6 phases of morphing
+    for (int i = 0; i < MORPH_PHASE_COUNT; i++) {
+        snprintf(msg, sizeof(msg), "Phase %d (%s): %s in %ld ms", i + 1, reports[i].name,
+                 phase_status_name(reports[i].status), reports[i].elapsed_ms);
+        log_event_level(reports[i].status == MORPH_PHASE_OK ? LOG_INFO : LOG_ERROR, msg);
+    }
+    
+    // Banners and web pages are staged with the phase outputs, after them:
+    // they take the hostname and kernel from the state phase 1 built.
+    // The phases ran on worker threads with their own buffers; these share one.
     if (result == 0) {
-        log_event_level(LOG_INFO, "=== Starting 6-Phase Morphing Cycle ===");
-        
-        // Phase 1: Network Layer Variation
-        result += morph_phase1_network("192.168.1.1");
-        
-        // Phase 2: Filesystem Dynamics
-        result += morph_phase2_filesystem(new_profile->name);
-        
-        // Phase 3: Process Simulation
-        result += morph_phase3_processes(new_profile->name);
-        
-        // Phase 4: Behavioral Adaptation
-        result += morph_phase4_behavior(new_profile->name);
-        
-        // Phase 5: Temporal Evolution
-        result += morph_phase5_temporal();
-        
-        // Phase 6: Quorum-Based Adaptation
-        result += morph_phase6_quorum();
-        
-        log_event_level(LOG_INFO, "=== 6-Phase Morphing Cycle Complete ===");
+        template_buffer_t buffer;
+        template_buffer_init(&buffer);
+        if (morph_cowrie_banners(new_profile, stage.dir, &buffer) != 0) result = -1;
+        if (morph_router_html(new_profile, stage.dir, &buffer) != 0) result = -1;
+        if (morph_camera_html(new_profile, stage.dir, &buffer) != 0) result = -1;
+        template_buffer_free(&buffer);
     }
     
+    char stage_dir[MORPH_STAGE_PATH];
+    snprintf(stage_dir, sizeof(stage_dir), "%s", stage.dir);
+    if (result == 0) {
+        result = morph_stage_publish(&stage, MORPH_DYNAMIC_DIR);
+    }
+    if (result != 0) {
+        log_event_level(LOG_WARN, "Discarding staged generation - previous device stays live");
+        morph_stage_abort(&stage);
+        log_event_level(LOG_ERROR, "Morphing failed");
+        return -1;
+    }
+    
+    // The new device is live: its profile is current from here on, even if
+    // a service file below cannot be brought in line with it
+    current_profile_index = next_index;
+    save_current_profile(state_file_path);
+    clear_emergency_signal();
+    
+    // Rebuild the fake filesystem from the device type's manifest, then
+    // copy the staged files over it and into the other services
+    if (setup_honeyfs_for_profile(new_profile->name, get_profile_type(new_profile->name)) != 0) {
+        result = -1;
+    }
+    if (install_profile_outputs(stage_dir) != 0) result = -1;
+    
+    log_event_level(LOG_INFO, "=== Morphing Cycle Complete ===");
+    
     if (result == 0) {
-        current_profile_index = next_index;
-        save_current_profile(state_file_path);
-        
         snprintf(msg, sizeof(msg), "Successfully morphed to profile: %s", new_profile->name);
         log_event_level(LOG_INFO, msg);
         log_to_file("build/morph-events.log", msg);
     } else {
-        log_event_level(LOG_ERROR, "Morphing failed");
+        snprintf(msg, sizeof(msg), "Morphed to profile %s, but its service files are incomplete",
+                 new_profile->name);
+        log_event_level(LOG_ERROR, msg);
+        log_to_file("build/morph-events.log", msg);
     }
     
     return result;
@@ -981,13 +1054,10 @@ int init_morph_engine(const char* config_file, const char* state_file) {
     // Now we create ALL required directories at startup, so nothing fails later.
     log_event_level(LOG_INFO, "Initializing directory structure...");
     
-    // Build output directories
+    // Build output directories (build/cowrie-dynamic itself is published by
+    // morph_device as a symlink to the current generation)
     create_dir("build");
-    create_dir("build/cowrie-dynamic");
-    create_dir("build/cowrie-dynamic/bin");
-    create_dir("build/cowrie-dynamic/sbin");
-    create_dir("build/cowrie-dynamic/usr/bin");
-    create_dir("build/cowrie-dynamic/var/log");
+    create_dir(MORPH_STAGE_ROOT);
     
     // Service directories for Cowrie
     create_dir("services/cowrie/etc");
@@ -1023,6 +1093,22 @@ int init_morph_engine(const char* config_file, const char* state_file) {
     // Load current profile state
     load_current_profile(state_file_path);
     
+    // Compile every profile's templates now rather than on its first morph
+    if (!templates) templates = template_cache_create(TEMPLATE_DIR);
+    if (!templates) {
+        log_event_level(LOG_ERROR, "Failed to create template cache");
+        return -1;
+    }
+    int broken = 0;
+    for (int i = 0; i < profile_count; i++) {
+        if (load_profile_templates(&profiles[i]) != 0) broken++;
+    }
+    if (broken) {
+        char msg[128];
+        snprintf(msg, sizeof(msg), "Templates missing or invalid for %d of %d profiles", broken, profile_count);
+        log_event_level(LOG_WARN, msg);
+    }
+    
     return 0;
 }
 
@@ -0,0 +1,420 @@
+/**
+ * morph_stage.c - Build each morph generation aside, then swap it in
+ *
+ * The phases used to overwrite build/cowrie-dynamic in place. While a morph
+ * was running, Cowrie could serve a new `ps` next to an old `uptime`, or a
+ * file caught halfway through being written.
+ *
+ * LAYOUT:
+ *   build/cowrie-dynamic.d/gen-000041/    previous generation
+ *   build/cowrie-dynamic.d/gen-000042/    current generation
+ *   build/cowrie-dynamic.d/current     -> gen-000042
+ *   build/cowrie-dynamic               -> cowrie-dynamic.d/current
+ *
+ * A new generation starts as a copy of the current one (so files other
+ * tools dropped in, like scripts/add_dynamic_commands.sh, carry over) and
+ * the phases overwrite their own outputs in it. Publishing fsyncs the tree
+ * and renames a fresh "current" symlink over the old one - the only step
+ * readers can see. Old generations are removed at the start of the next
+ * morph instead of right after the swap, so a reader still walking the
+ * previous tree is not pulled out from under. Generations that were never
+ * published (a crashed or aborted morph) go at the same time.
+ *
+ * CONCURRENT MORPHS: a morph holds flock() on its generation directory
+ * from mkdir() until it publishes or aborts, and takes it while holding
+ * flock() on the root, which cleanup also holds while it scans. So cleanup
+ * never sees another morph's generation unlocked, and a generation it can
+ * lock has been abandoned - the kernel drops the lock when its owner dies.
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "morph_stage.h"
+#include "utils.h"
+
+#define GENERATION_PREFIX "gen-"
+#define LEGACY_PREFIX "legacy-"
+#define CURRENT_LINK "current"
+
+// Returns the generation number in a "gen-NNNNNN" name, or 0
+static unsigned long parse_generation(const char* name) {
+    if (strncmp(name, GENERATION_PREFIX, strlen(GENERATION_PREFIX)) != 0) return 0;
+    const char* digits = name + strlen(GENERATION_PREFIX);
+    if (*digits < '0' || *digits > '9') return 0;
+    char* end;
+    unsigned long generation = strtoul(digits, &end, 10);
+    return (*end == '\0') ? generation : 0;
+}
+
+// Generation root/current points at, or 0 if there is none yet
+static unsigned long current_generation(const char* root) {
+    char link_path[MORPH_STAGE_PATH];
+    char target[MORPH_STAGE_PATH];
+    snprintf(link_path, sizeof(link_path), "%s/%s", root, CURRENT_LINK);
+    ssize_t len = readlink(link_path, target, sizeof(target) - 1);
+    if (len <= 0) return 0;
+    target[len] = '\0';
+    return parse_generation(target);
+}
+
+// Open path (a directory) and flock() it; returns the fd holding the lock, or -1
+static int lock_dir(const char* path, int operation) {
+    int fd = open(path, O_RDONLY | O_DIRECTORY);
+    if (fd < 0) return -1;
+    if (flock(fd, operation) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void unlock_dir(int fd) {
+    if (fd >= 0) close(fd);     // Closing the last fd releases the flock
+}
+
+// A generation some live morph is still building (or publishing)
+static int in_flight(const char* path) {
+    int fd = lock_dir(path, LOCK_EX | LOCK_NB);
+    if (fd >= 0) {
+        unlock_dir(fd);
+        return 0;
+    }
+    return errno == EWOULDBLOCK;
+}
+
+static int fsync_path(const char* path, int flags) {
+    int fd = open(path, flags);
+    if (fd < 0) return -1;
+    int result = fsync(fd);
+    close(fd);
+    return result;
+}
+
+/* ---------------------------------------------------------------------------
+ * Tree walks (outputs are a few dozen small files; plain recursion is fine)
+ * --------------------------------------------------------------------------- */
+
+static int copy_tree(const char* src, const char* dst) {
+    DIR* dir = opendir(src);
+    if (!dir) return -1;
+
+    int result = 0;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+
+        char from[MORPH_STAGE_PATH];
+        char to[MORPH_STAGE_PATH];
+        if ((size_t)snprintf(from, sizeof(from), "%s/%s", src, entry->d_name) >= sizeof(from) ||
+            (size_t)snprintf(to, sizeof(to), "%s/%s", dst, entry->d_name) >= sizeof(to)) {
+            result = -1;
+            continue;
+        }
+
+        struct stat st;
+        if (lstat(from, &st) != 0) continue;   // Gone since readdir
+        if (S_ISDIR(st.st_mode)) {
+            if (mkdir(to, 0755) != 0 && errno != EEXIST) {
+                result = -1;
+            } else if (copy_tree(from, to) != 0) {
+                result = -1;
+            }
+        } else if (S_ISREG(st.st_mode)) {
+            if (copy_file(from, to) != 0) {
+                result = -1;
+            } else {
+                chmod(to, st.st_mode & 07777);
+            }
+        }
+    }
+    closedir(dir);
+    return result;
+}
+
+static int sync_tree(const char* path) {
+    DIR* dir = opendir(path);
+    if (!dir) return -1;
+
+    int result = 0;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+
+        char child[MORPH_STAGE_PATH];
+        if ((size_t)snprintf(child, sizeof(child), "%s/%s", path, entry->d_name) >= sizeof(child)) {
+            result = -1;
+            continue;
+        }
+
+        struct stat st;
+        if (lstat(child, &st) != 0) {
+            result = -1;
+        } else if (S_ISDIR(st.st_mode)) {
+            if (sync_tree(child) != 0) result = -1;
+        } else if (S_ISREG(st.st_mode)) {
+            if (fsync_path(child, O_RDONLY) != 0) result = -1;
+        }
+    }
+    closedir(dir);
+
+    // The directory itself, so the new names are on disk too
+    if (fsync_path(path, O_RDONLY | O_DIRECTORY) != 0) result = -1;
+    return result;
+}
+
+static int remove_tree(const char* path) {
+    struct stat st;
+    if (lstat(path, &st) != 0) return (errno == ENOENT) ? 0 : -1;
+    if (!S_ISDIR(st.st_mode)) return unlink(path);
+
+    DIR* dir = opendir(path);
+    if (!dir) return -1;
+
+    int result = 0;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+
+        char child[MORPH_STAGE_PATH];
+        if ((size_t)snprintf(child, sizeof(child), "%s/%s", path, entry->d_name) >= sizeof(child) ||
+            remove_tree(child) != 0) {
+            result = -1;
+        }
+    }
+    closedir(dir);
+
+    if (rmdir(path) != 0) result = -1;
+    return result;
+}
+
+/* ---------------------------------------------------------------------------
+ * Staging
+ * --------------------------------------------------------------------------- */
+
+int morph_stage_begin(morph_stage_t* stage, const char* root, const char* seed_dir) {
+    if (!stage || !root) return -1;
+    memset(stage, 0, sizeof(morph_stage_t));
+    stage->lock_fd = -1;
+    snprintf(stage->root, sizeof(stage->root), "%s", root);
+
+    int root_fd = (create_dir(root) == 0) ? lock_dir(root, LOCK_EX) : -1;
+    if (root_fd < 0) {
+        log_event_level(LOG_ERROR, "Failed to create morph staging root");
+        return -1;
+    }
+
+    // Next number after anything on disk, finished or not
+    unsigned long highest = current_generation(root);
+    DIR* dir = opendir(root);
+    if (dir) {
+        struct dirent* entry;
+        while ((entry = readdir(dir)) != NULL) {
+            unsigned long generation = parse_generation(entry->d_name);
+            if (generation > highest) highest = generation;
+        }
+        closedir(dir);
+    }
+
+    // mkdir() claims the number; a morph racing us (or one that does not
+    // lock the root) takes the next one. The generation is locked before
+    // the root is released, so cleanup can tell it is in flight.
+    bool created = false;
+    for (int attempt = 0; attempt < 100 && !created; attempt++) {
+        stage->generation = highest + 1 + (unsigned long)attempt;
+        snprintf(stage->dir, sizeof(stage->dir), "%s/" GENERATION_PREFIX "%06lu",
+                 root, stage->generation);
+        if (mkdir(stage->dir, 0755) == 0) {
+            created = true;
+        } else if (errno != EEXIST) {
+            break;
+        }
+    }
+    if (created) stage->lock_fd = lock_dir(stage->dir, LOCK_EX);
+    unlock_dir(root_fd);
+    if (!created || stage->lock_fd < 0) {
+        log_event_level(LOG_ERROR, "Failed to create morph staging directory");
+        if (created) rmdir(stage->dir);
+        stage->dir[0] = '\0';
+        return -1;
+    }
+
+    if (seed_dir && dir_exists(seed_dir) && copy_tree(seed_dir, stage->dir) != 0) {
+        log_event_level(LOG_WARN, "Some live outputs could not be copied into the new generation");
+    }
+
+    char msg[MORPH_STAGE_PATH + 64];
+    snprintf(msg, sizeof(msg), "Staging morph generation in %s", stage->dir);
+    log_event_level(LOG_INFO, msg);
+    return 0;
+}
+
+// Make link_path a symlink to root/current, moving an old real directory aside
+static int point_link(const char* link_path, const char* root, unsigned long generation) {
+    // Relative target when both live in the same directory, so the pair
+    // still works after build/ is bind-mounted or moved
+    char target[MORPH_STAGE_PATH + 32];
+    const char* link_slash = strrchr(link_path, '/');
+    const char* root_slash = strrchr(root, '/');
+    size_t link_parent = link_slash ? (size_t)(link_slash - link_path) : 0;
+    size_t root_parent = root_slash ? (size_t)(root_slash - root) : 0;
+    if (link_parent == root_parent && strncmp(link_path, root, link_parent) == 0) {
+        snprintf(target, sizeof(target), "%s/%s", root_slash ? root_slash + 1 : root, CURRENT_LINK);
+    } else {
+        char resolved[MORPH_STAGE_PATH];
+        if (!realpath(root, resolved)) return -1;
+        snprintf(target, sizeof(target), "%s/%s", resolved, CURRENT_LINK);
+    }
+
+    struct stat st;
+    if (lstat(link_path, &st) == 0) {
+        if (S_ISLNK(st.st_mode)) {
+            char existing[MORPH_STAGE_PATH];
+            ssize_t len = readlink(link_path, existing, sizeof(existing) - 1);
+            if (len > 0) {
+                existing[len] = '\0';
+                if (strcmp(existing, target) == 0) return 0;
+            }
+        } else if (S_ISDIR(st.st_mode)) {
+            // First publish over the old in-place directory. rename() cannot
+            // swap a directory for a symlink, so this one time the path is
+            // briefly missing. The old tree is cleaned up with the rest.
+            char legacy[MORPH_STAGE_PATH + 32];
+            snprintf(legacy, sizeof(legacy), "%s/" LEGACY_PREFIX "%06lu", root, generation);
+            if (rename(link_path, legacy) != 0) return -1;
+        } else {
+            return -1;
+        }
+    }
+
+    char tmp_link[MORPH_STAGE_PATH + 8];
+    snprintf(tmp_link, sizeof(tmp_link), "%s.tmp", link_path);
+    unlink(tmp_link);
+    if (symlink(target, tmp_link) != 0) return -1;
+    if (rename(tmp_link, link_path) != 0) {
+        unlink(tmp_link);
+        return -1;
+    }
+    return 0;
+}
+
+int morph_stage_publish(morph_stage_t* stage, const char* link_path) {
+    if (!stage || stage->dir[0] == '\0') return -1;
+
+    if (sync_tree(stage->dir) != 0) {
+        log_event_level(LOG_ERROR, "Failed to sync morph generation, not publishing it");
+        return -1;
+    }
+
+    // The swap: a new "current" symlink renamed over the old one
+    char name[64];
+    char tmp_link[MORPH_STAGE_PATH + 32];
+    char current_link[MORPH_STAGE_PATH + 32];
+    snprintf(name, sizeof(name), GENERATION_PREFIX "%06lu", stage->generation);
+    snprintf(tmp_link, sizeof(tmp_link), "%s/%s.tmp", stage->root, CURRENT_LINK);
+    snprintf(current_link, sizeof(current_link), "%s/%s", stage->root, CURRENT_LINK);
+
+    unlink(tmp_link);
+    if (symlink(name, tmp_link) != 0 || rename(tmp_link, current_link) != 0) {
+        unlink(tmp_link);
+        log_event_level(LOG_ERROR, "Failed to swap in morph generation");
+        return -1;
+    }
+    fsync_path(stage->root, O_RDONLY | O_DIRECTORY);
+
+    if (link_path && point_link(link_path, stage->root, stage->generation) != 0) {
+        log_event_level(LOG_WARN, "Failed to point dynamic output path at current generation");
+    }
+
+    char msg[128];
+    snprintf(msg, sizeof(msg), "Published morph generation %lu", stage->generation);
+    log_event_level(LOG_INFO, msg);
+    stage->dir[0] = '\0';
+    unlock_dir(stage->lock_fd);
+    stage->lock_fd = -1;
+    return 0;
+}
+
+void morph_stage_abort(morph_stage_t* stage) {
+    if (!stage || stage->dir[0] == '\0') return;
+    remove_tree(stage->dir);
+    stage->dir[0] = '\0';
+    unlock_dir(stage->lock_fd);
+    stage->lock_fd = -1;
+}
+
+static int compare_generations_desc(const void* a, const void* b) {
+    unsigned long x = *(const unsigned long*)a;
+    unsigned long y = *(const unsigned long*)b;
+    return (x < y) - (x > y);
+}
+
+int morph_stage_cleanup(const char* root, int keep, const morph_stage_t* building) {
+    if (!root) return 0;
+    unsigned long current = current_generation(root);
+    unsigned long ours = (building && building->dir[0] != '\0') ? building->generation : 0;
+    if (keep < 1) keep = 1;
+
+    // Held for the scan, so a morph cannot be between mkdir() and locking
+    // its generation while we look
+    int root_fd = lock_dir(root, LOCK_EX);
+    if (root_fd < 0) return 0;
+    DIR* dir = opendir(root);
+    if (!dir) {
+        unlock_dir(root_fd);
+        return 0;
+    }
+
+    // Older generations, newest first; leftovers go straight away
+    unsigned long* older = NULL;
+    int older_count = 0;
+    int older_capacity = 0;
+    int removed = 0;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        char path[MORPH_STAGE_PATH];
+        snprintf(path, sizeof(path), "%s/%s", root, entry->d_name);
+
+        unsigned long generation = parse_generation(entry->d_name);
+        if (generation != 0 && generation != current && generation != ours && in_flight(path)) {
+            continue;   // Another morph's, still being built
+        }
+        if (generation == 0 || generation == current || generation == ours) {
+            if (strncmp(entry->d_name, LEGACY_PREFIX, strlen(LEGACY_PREFIX)) == 0 &&
+                remove_tree(path) == 0) {
+                removed++;
+            }
+        } else if (generation < current) {
+            if (older_count == older_capacity) {
+                int capacity = older_capacity ? older_capacity * 2 : 16;
+                unsigned long* grown = realloc(older, (size_t)capacity * sizeof(unsigned long));
+                if (!grown) break;
+                older = grown;
+                older_capacity = capacity;
+            }
+            older[older_count++] = generation;
+        } else if (remove_tree(path) == 0) {
+            // Never published, and nobody holds it: a morph that crashed
+            removed++;
+        }
+    }
+    closedir(dir);
+
+    if (older_count > 1) {
+        qsort(older, (size_t)older_count, sizeof(unsigned long), compare_generations_desc);
+    }
+    for (int i = keep - 1; i < older_count; i++) {
+        char path[MORPH_STAGE_PATH];
+        snprintf(path, sizeof(path), "%s/" GENERATION_PREFIX "%06lu", root, older[i]);
+        if (remove_tree(path) == 0) removed++;
+    }
+    free(older);
+    unlock_dir(root_fd);
+    return removed;
+}
@@ -0,0 +1,529 @@
+/**
+ * morph_state.c - Render every device artifact from one state
+ *
+ * The filesystem, process and temporal phases used to invent their own
+ * data: a filesystem_snapshot_t, a process_list_t and temporal's private
+ * system_state_t, each from its own rand() calls. `ps` could show a
+ * process using more memory than `free` said was in use, and `uptime`
+ * disagreed with the boot messages in `dmesg`.
+ *
+ * Now one morph builds one state with state_engine_init() and writes all
+ * of these artifacts from it in a single pass, so every file agrees with
+ * the others. Config-style files that are mostly fixed text come from
+ * templates/ instead, filled from the same state.
+ */
+
+#include <arpa/inet.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include "honeyfs.h"
+#include "morph_state.h"
+#include "state_engine.h"
+#include "utils.h"
+
+#define MORPH_STATE_PATH 512
+
+typedef int (*artifact_fn)(system_state_t* state, state_sink_t* out);
+
+static int write_ps(system_state_t* state, state_sink_t* out) {
+    return state_write_ps_output(state, out, false);
+}
+
+static int write_ps_aux(system_state_t* state, state_sink_t* out) {
+    return state_write_ps_output(state, out, true);
+}
+
+static int write_ls_root(system_state_t* state, state_sink_t* out) {
+    return state_write_ls_output(state, "/", out, false, false);
+}
+
+static int write_find_root(system_state_t* state, state_sink_t* out) {
+    return state_write_find_output(state, "/", out);
+}
+
+static int write_du_root(system_state_t* state, state_sink_t* out) {
+    return state_write_du_output(state, "/", out);
+}
+
+static int write_hostname(system_state_t* state, state_sink_t* out) {
+    return state_sink_printf(out, "%s\n", state->hostname) < 0 ? -1 : 0;
+}
+
+/* ---------------------------------------------------------------------------
+ * Routes and neighbours, from the interfaces ifconfig shows
+ * --------------------------------------------------------------------------- */
+
+static int routed(const state_interface_t* iface) {
+    return iface->is_up && !iface->is_loopback;
+}
+
+static in_addr_t ipv4(const char* text) {
+    struct in_addr addr;
+    return inet_pton(AF_INET, text, &addr) == 1 ? addr.s_addr : 0;
+}
+
+static const char* ipv4_text(in_addr_t addr, char* buf, size_t size) {
+    struct in_addr in = { .s_addr = addr };
+    return inet_ntop(AF_INET, &in, buf, (socklen_t)size) ? buf : "0.0.0.0";
+}
+
+static int write_route(system_state_t* state, state_sink_t* out) {
+    int failed = state_sink_printf(out, "Kernel IP routing table\n"
+                                   "Destination     Gateway         Genmask         Flags Metric Ref    Use Iface\n") < 0;
+    for (int pass = 0; pass < 2; pass++) {     // Default routes first, like the kernel's table
+        for (int i = 0; i < state->interface_count; i++) {
+            const state_interface_t* iface = &state->interfaces[i];
+            if (!routed(iface)) continue;
+            if (pass == 0) {
+                if (!iface->gateway[0]) continue;
+                failed |= state_sink_printf(out, "%-15s %-15s %-15s %-5s %-6d %-3d %6d %s\n", "0.0.0.0",
+                                            iface->gateway, "0.0.0.0", "UG", 0, 0, 0, iface->name) < 0;
+            } else {
+                char network[INET_ADDRSTRLEN];
+                ipv4_text(ipv4(iface->ip_address) & ipv4(iface->netmask), network, sizeof(network));
+                failed |= state_sink_printf(out, "%-15s %-15s %-15s %-5s %-6d %-3d %6d %s\n", network,
+                                            "0.0.0.0", iface->netmask, "U", 0, 0, 0, iface->name) < 0;
+            }
+        }
+    }
+    return failed ? -1 : 0;
+}
+
+// /proc/net/route prints addresses as the in-memory word, in hex
+static int write_proc_net_route(system_state_t* state, state_sink_t* out) {
+    char line[160];
+    snprintf(line, sizeof(line), "Iface\tDestination\tGateway \tFlags\tRefCnt\tUse\tMetric\tMask\t\tMTU\tWindow\tIRTT");
+    int failed = state_sink_printf(out, "%-127s\n", line) < 0;
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; i < state->interface_count; i++) {
+            const state_interface_t* iface = &state->interfaces[i];
+            if (!routed(iface) || (pass == 0 && !iface->gateway[0])) continue;
+            in_addr_t mask = pass ? ipv4(iface->netmask) : 0;
+            in_addr_t destination = pass ? ipv4(iface->ip_address) & mask : 0;
+            in_addr_t gateway = pass ? 0 : ipv4(iface->gateway);
+            snprintf(line, sizeof(line), "%s\t%08X\t%08X\t%04X\t0\t0\t0\t%08X\t0\t0\t0", iface->name,
+                     (unsigned)destination, (unsigned)gateway, pass ? 0x0001u : 0x0003u, (unsigned)mask);
+            failed |= state_sink_printf(out, "%-127s\n", line) < 0;
+        }
+    }
+    return failed ? -1 : 0;
+}
+
+// A neighbour's MAC: fixed for this state and address, not drawn from its stream
+static void neighbour_mac(const system_state_t* state, const char* ip, char* mac, size_t size) {
+    uint32_t h = 2166136261u ^ state->state_seed;
+    for (const char* p = ip; *p; p++) h = (h ^ (uint8_t)*p) * 16777619u;
+    uint32_t l = h * 2654435761u;
+    snprintf(mac, size, "%02x:%02x:%02x:%02x:%02x:%02x", (h >> 24) & 0xfc, (h >> 16) & 0xff,
+             (h >> 8) & 0xff, (l >> 16) & 0xff, (l >> 8) & 0xff, l & 0xff);
+}
+
+// Gateways, plus the peers of established connections on a local subnet
+static int write_arp(system_state_t* state, state_sink_t* out) {
+    int failed = state_sink_printf(out, "Address                  HWtype  HWaddress           "
+                                   "Flags Mask            Iface\n") < 0;
+    char mac[MAX_MAC_LENGTH];
+    for (int i = 0; i < state->interface_count; i++) {
+        const state_interface_t* iface = &state->interfaces[i];
+        if (!routed(iface)) continue;
+        in_addr_t mask = ipv4(iface->netmask);
+        in_addr_t network = ipv4(iface->ip_address) & mask;
+
+        if (iface->gateway[0]) {
+            neighbour_mac(state, iface->gateway, mac, sizeof(mac));
+            failed |= state_sink_printf(out, "%-24s %-7s %-19s %-5s %-15s %s\n",
+                                        iface->gateway, "ether", mac, "C", "", iface->name) < 0;
+        }
+        for (int c = 0; c < state->connection_count; c++) {
+            const state_connection_t* conn = &state->connections[c];
+            in_addr_t peer = ipv4(conn->remote_ip);
+            if (conn->state != CONN_STATE_ESTABLISHED || peer == 0 || (peer & mask) != network ||
+                strcmp(conn->remote_ip, iface->gateway) == 0) {
+                continue;
+            }
+            int seen = 0;
+            for (int k = 0; k < c && !seen; k++) {
+                seen = state->connections[k].state == CONN_STATE_ESTABLISHED &&
+                       strcmp(state->connections[k].remote_ip, conn->remote_ip) == 0;
+            }
+            if (seen) continue;
+            neighbour_mac(state, conn->remote_ip, mac, sizeof(mac));
+            failed |= state_sink_printf(out, "%-24s %-7s %-19s %-5s %-15s %s\n",
+                                        conn->remote_ip, "ether", mac, "C", "", iface->name) < 0;
+        }
+    }
+    return failed ? -1 : 0;
+}
+
+// What cerberus_loader.load_network_config() reads
+static int write_network_json(system_state_t* state, state_sink_t* out) {
+    int failed = state_sink_printf(out, "{\n  \"interfaces\": [\n") < 0;
+    int first = 1;
+    for (int i = 0; i < state->interface_count; i++) {
+        const state_interface_t* iface = &state->interfaces[i];
+        if (iface->is_loopback) continue;
+        failed |= state_sink_printf(out, "%s    {\n"
+                                    "      \"name\": \"%s\",\n"
+                                    "      \"ip\": \"%s\",\n"
+                                    "      \"netmask\": \"%s\",\n"
+                                    "      \"gateway\": \"%s\",\n"
+                                    "      \"mtu\": %u,\n"
+                                    "      \"primary\": %s\n"
+                                    "    }", first ? "" : ",\n", iface->name, iface->ip_address,
+                                    iface->netmask, iface->gateway, iface->mtu, first ? "true" : "false") < 0;
+        first = 0;
+    }
+    failed |= state_sink_printf(out, "%s  ]\n}\n", first ? "" : "\n") < 0;
+    return failed ? -1 : 0;
+}
+
+// Paths are relative to the generation directory. The honeyfs copies are
+// what Cowrie's cat reads; morph.c installs them after the publish.
+static const struct {
+    const char* path;
+    artifact_fn write;
+} artifacts[] = {
+    { "bin/ps",         write_ps },
+    { "bin/ps_aux",     write_ps_aux },
+    { "bin/top",        state_write_top_output },
+    { "bin/uptime",     state_write_uptime_output },
+    { "bin/dmesg",      state_write_dmesg },
+    { "bin/free",       state_write_free_output },
+    { "bin/df",         state_write_df_output },
+    { "bin/netstat",    state_write_netstat_output },
+    { "bin/route",      write_route },
+    { "bin/ls",         write_ls_root },
+    { "bin/find",       write_find_root },
+    { "bin/du",         write_du_root },
+    { "sbin/ifconfig",  state_write_ifconfig_output },
+    { "sbin/arp",       write_arp },
+    { "proc/cpuinfo",   state_write_proc_cpuinfo },
+    { "proc/meminfo",   state_write_proc_meminfo },
+    { "proc/uptime",    state_write_proc_uptime },
+    { "proc/loadavg",   state_write_proc_loadavg },
+    { "proc/version",   state_write_proc_version },
+    { "proc/mounts",    state_write_proc_mounts },
+    { "proc/stat",      state_write_proc_stat },
+    { "proc/net/dev",   state_write_proc_net_dev },
+    { "proc/net/route", write_proc_net_route },
+    { "proc_net_route", write_proc_net_route },    // Path the network phase used to write
+    { "var/log/syslog", state_write_syslog },
+    { "etc/passwd",     state_write_passwd },
+    { "etc/group",      state_write_group },
+    { "etc/hostname",   write_hostname },
+    { "network-config.json", write_network_json },
+    { HONEYFS_DIR "/etc/hostname", write_hostname },
+    { HONEYFS_DIR "/etc/passwd", state_write_passwd },
+    { HONEYFS_DIR "/etc/shadow", state_write_shadow },
+    { HONEYFS_DIR "/etc/group", state_write_group },
+    { HONEYFS_DIR "/proc/version", state_write_proc_version },
+};
+
+#define ARTIFACT_COUNT ((int)(sizeof(artifacts) / sizeof(artifacts[0])))
+
+/* ---------------------------------------------------------------------------
+ * Templated artifacts
+ * --------------------------------------------------------------------------- */
+
+// What the template lists walk: the state plus its services in start order
+typedef struct {
+    const system_state_t* state;
+    const state_process_t* services[MAX_STATE_PROCESSES];
+    int service_count;
+} render_data_t;
+
+static int count_services(const void* data) {
+    return ((const render_data_t*)data)->service_count;
+}
+
+static void service_item(const void* data, int index, const char** out, char* scratch, size_t size) {
+    const state_process_t* p = ((const render_data_t*)data)->services[index];
+    int used = snprintf(scratch, size, "%d", (int)p->pid) + 1;
+    snprintf(scratch + used, size - (size_t)used, "%u", p->start_time_offset);
+    out[0] = p->name;
+    out[1] = scratch;
+    out[2] = scratch + used;
+}
+
+// Loopback is written by the template itself
+static int count_interfaces(const void* data) {
+    const system_state_t* state = ((const render_data_t*)data)->state;
+    int count = 0;
+    for (int i = 0; i < state->interface_count; i++) {
+        if (!state->interfaces[i].is_loopback) count++;
+    }
+    return count;
+}
+
+static void interface_item(const void* data, int index, const char** out, char* scratch, size_t size) {
+    (void)scratch;
+    (void)size;
+    const system_state_t* state = ((const render_data_t*)data)->state;
+    for (int i = 0; i < state->interface_count; i++) {
+        const state_interface_t* iface = &state->interfaces[i];
+        if (iface->is_loopback || index-- > 0) continue;
+        out[0] = iface->name;
+        out[1] = iface->ip_address;
+        out[2] = iface->netmask;
+        out[3] = iface->mac_address;
+        return;
+    }
+}
+
+static const char* const service_fields[] = { "name", "pid", "start", NULL };
+static const char* const interface_fields[] = { "name", "address", "netmask", "mac", NULL };
+
+static const template_list_t state_lists[] = {
+    { "services",   service_fields,   count_services,   service_item },
+    { "interfaces", interface_fields, count_interfaces, interface_item },
+    { NULL, NULL, NULL, NULL },
+};
+
+enum {
+    VAR_HOSTNAME, VAR_PROFILE, VAR_KERNEL, VAR_KERNEL_BUILD, VAR_ARCH, VAR_BOOT_TIME, VAR_UPTIME, VAR_COUNT
+};
+
+static const char* const state_vars[VAR_COUNT + 1] = {
+    "hostname", "profile", "kernel_version", "kernel_build", "arch", "boot_time", "uptime_seconds", NULL
+};
+
+static const template_schema_t state_schema = { state_vars, state_lists };
+
+// Paths are relative to the generation directory and to the template root
+static const char* const templated[] = {
+    "boot_info.conf",           // The numbers other tools key their timestamps to, and the
+                                // identity morph_cowrie_banners() gives Cowrie
+    "etc/network/interfaces",
+};
+
+#define TEMPLATED_COUNT ((int)(sizeof(templated) / sizeof(templated[0])))
+
+int morph_state_load_templates(template_cache_t* templates, const char* profile, const char* type) {
+    int result = 0;
+    for (int i = 0; i < TEMPLATED_COUNT; i++) {
+        if (!template_cache_get(templates, profile, type, templated[i], &state_schema)) result = -1;
+    }
+    return result;
+}
+
+// Start from the builtin profile of the same name. An unknown name gets
+// Generic_IoT, which claims no vendor, typed to match the web UI and
+// honeyfs the morph installs for it - never another vendor's profile.
+static void resolve_profile(const morph_identity_t* identity, device_profile_t* profile) {
+    const char* name = identity->name ? identity->name : "";
+    if (state_get_builtin_profile(profile, name) == 0) return;
+
+    state_get_builtin_profile(profile, "Generic_IoT");
+    profile->type = identity->is_camera ? DEVICE_TYPE_CAMERA : DEVICE_TYPE_ROUTER;
+    snprintf(profile->name, sizeof(profile->name), "%s", name);
+
+    char msg[sizeof(profile->name) + 96];
+    snprintf(msg, sizeof(msg), "No builtin device profile named %s, using Generic_IoT as a %s",
+             name, identity->is_camera ? "camera" : "router");
+    log_event_level(LOG_WARN, msg);
+}
+
+// The architecture whose uname -m name is arch, so profiles.conf says
+// "mips" or "armv7l" exactly as the device would print it
+static int parse_arch(const char* arch, cpu_arch_t* out) {
+    for (int a = ARCH_MIPS; a <= ARCH_X86_64; a++) {
+        device_profile_t probe = { .architecture = (cpu_arch_t)a };
+        if (strcasecmp(arch, state_arch_name(&probe)) == 0) {
+            *out = (cpu_arch_t)a;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// Copy a "14:cc:20" vendor prefix in the upper case ifconfig prints the
+// rest of the address in. Returns -1 unless it is three hex octets.
+static int parse_mac_prefix(const char* prefix, char* out, size_t size) {
+    if (strlen(prefix) != 8 || size < 9) return -1;
+    for (int i = 0; i < 8; i++) {
+        int want_colon = (i % 3) == 2;
+        if (want_colon ? prefix[i] != ':' : !isxdigit((unsigned char)prefix[i])) return -1;
+        out[i] = (char)toupper((unsigned char)prefix[i]);
+    }
+    out[8] = '\0';
+    return 0;
+}
+
+static void warn_override(const char* key, const char* value) {
+    char msg[160];
+    snprintf(msg, sizeof(msg), "Ignoring %s=%s from the profile, keeping the builtin value", key, value);
+    log_event_level(LOG_WARN, msg);
+}
+
+static void apply_overrides(const morph_identity_t* identity, device_profile_t* profile) {
+    if (identity->kernel_version && identity->kernel_version[0]) {
+        snprintf(profile->kernel_version, sizeof(profile->kernel_version), "%s", identity->kernel_version);
+    }
+    if (identity->ssh_banner && identity->ssh_banner[0]) {
+        snprintf(profile->ssh_banner, sizeof(profile->ssh_banner), "%s", identity->ssh_banner);
+    }
+    if (identity->telnet_banner && identity->telnet_banner[0]) {
+        snprintf(profile->telnet_banner, sizeof(profile->telnet_banner), "%s", identity->telnet_banner);
+    }
+    if (identity->arch && identity->arch[0] && parse_arch(identity->arch, &profile->architecture) != 0) {
+        warn_override("arch", identity->arch);
+    }
+    if (identity->mac_prefix && identity->mac_prefix[0] &&
+        parse_mac_prefix(identity->mac_prefix, profile->mac_prefix, sizeof(profile->mac_prefix)) != 0) {
+        warn_override("mac_prefix", identity->mac_prefix);
+    }
+    if (identity->memory_mb > 0) profile->total_ram_kb = (uint32_t)identity->memory_mb * 1024;
+    if (identity->cpu_mhz > 0) profile->cpu_mhz = (uint32_t)identity->cpu_mhz;
+}
+
+static int compare_start(const void* a, const void* b) {
+    const state_process_t* pa = *(const state_process_t* const*)a;
+    const state_process_t* pb = *(const state_process_t* const*)b;
+    if (pa->start_time_offset != pb->start_time_offset) {
+        return pa->start_time_offset < pb->start_time_offset ? -1 : 1;
+    }
+    return pa->pid - pb->pid;
+}
+
+// A fresh state has an empty log. Give it the entries a boot leaves
+// behind - each service starting at its own start time - so syslog
+// agrees with the process table.
+// The services are left in data for the templates.
+static void seed_boot_history(system_state_t* state, render_data_t* data) {
+    const state_process_t** services = data->services;
+    int count = 0;
+    for (int i = 0; i < state->process_count; i++) {
+        const state_process_t* p = &state->processes[i];
+        if (p->is_service && !p->is_kernel_thread) services[count++] = p;
+    }
+    qsort(services, (size_t)count, sizeof(services[0]), compare_start);
+    data->state = state;
+    data->service_count = count;
+
+    for (int i = 0; i < count; i++) {
+        state_log_entry_t entry;
+        char message[MAX_LOG_MESSAGE];
+        snprintf(message, sizeof(message), "started: %.200s", services[i]->cmdline);
+        state_init_log_entry(state, &entry, STATE_LOG_INFO, services[i]->name, message);
+        entry.time_offset = (int32_t)services[i]->start_time_offset;
+        entry.pid = services[i]->pid;
+        state_append_log_record(state, &entry);
+    }
+}
+
+// out_dir/rel, with its parent directory created
+static int artifact_path(const char* out_dir, const char* rel, char* path, size_t size) {
+    if ((size_t)snprintf(path, size, "%s/%s", out_dir, rel) >= size) return -1;
+
+    char* slash = strrchr(path, '/');
+    *slash = '\0';
+    int made = create_dir(path);
+    *slash = '/';
+    return made;
+}
+
+// Stream one artifact straight to its file through an fd sink
+static int write_artifact(system_state_t* state, const char* out_dir, int index) {
+    char path[MORPH_STATE_PATH];
+    if (artifact_path(out_dir, artifacts[index].path, path, sizeof(path)) != 0) return -1;
+
+    // The generation is private until published, so no temp file is needed
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return -1;
+
+    state_sink_t out;
+    state_sink_init_fd(&out, fd);
+    int result = artifacts[index].write(state, &out);
+    if (state_sink_flush(&out) != 0 || !state_sink_ok(&out)) result = -1;
+    state_sink_free(&out);
+    if (close(fd) != 0) result = -1;
+    return result;
+}
+
+static int write_templated(const morph_identity_t* identity, const render_data_t* data,
+                           const char* const* values, template_buffer_t* buffer,
+                           const char* out_dir, int index) {
+    const template_t* tmpl = template_cache_get(identity->templates, identity->name, identity->type,
+                                                templated[index], &state_schema);
+    char path[MORPH_STATE_PATH];
+    if (!tmpl || template_render(tmpl, values, data, buffer) < 0) return -1;
+    if (artifact_path(out_dir, templated[index], path, sizeof(path)) != 0) return -1;
+    return write_file(path, buffer->data);
+}
+
+int morph_state_render(const morph_identity_t* identity, const char* out_dir) {
+    if (!identity || !out_dir) return -1;
+
+    device_profile_t profile;
+    resolve_profile(identity, &profile);
+    apply_overrides(identity, &profile);
+
+    // system_state_t carries its process and log tables inline - keep it off the stack
+    system_state_t* state = calloc(1, sizeof(system_state_t));
+    if (!state) return -1;
+    if (state_engine_init(state, &profile) != 0) {
+        free(state);
+        log_event_level(LOG_ERROR, "Failed to build device state");
+        return -1;
+    }
+
+    // Large: one pointer per possible process
+    render_data_t* data = calloc(1, sizeof(render_data_t));
+    if (!data) {
+        state_engine_destroy(state);
+        free(state);
+        return -1;
+    }
+    seed_boot_history(state, data);
+
+    int failed = 0;
+    for (int i = 0; i < ARTIFACT_COUNT; i++) {
+        if (write_artifact(state, out_dir, i) != 0) {
+            char msg[256];
+            snprintf(msg, sizeof(msg), "Failed to write %s from device state", artifacts[i].path);
+            log_event_level(LOG_WARN, msg);
+            failed++;
+        }
+    }
+
+    char boot_time[24];
+    char uptime[16];
+    snprintf(boot_time, sizeof(boot_time), "%ld", (long)state->boot_time);
+    snprintf(uptime, sizeof(uptime), "%u", state->uptime_seconds);
+    const char* values[VAR_COUNT] = {
+        [VAR_HOSTNAME] = state->hostname,
+        [VAR_PROFILE] = state->profile.name,
+        [VAR_KERNEL] = state->profile.kernel_version,
+        [VAR_KERNEL_BUILD] = STATE_KERNEL_BUILD,
+        [VAR_ARCH] = state_arch_name(&state->profile),
+        [VAR_BOOT_TIME] = boot_time,
+        [VAR_UPTIME] = uptime,
+    };
+    template_buffer_t buffer;
+    template_buffer_init(&buffer);
+    for (int i = 0; i < TEMPLATED_COUNT; i++) {
+        if (write_templated(identity, data, values, &buffer, out_dir, i) != 0) {
+            char msg[256];
+            snprintf(msg, sizeof(msg), "Failed to render %s from device state", templated[i]);
+            log_event_level(LOG_WARN, msg);
+            failed++;
+        }
+    }
+    template_buffer_free(&buffer);
+    free(data);
+
+    char msg[256];
+    snprintf(msg, sizeof(msg), "Device state %s (%s): %d processes, %u days up, %d artifacts written",
+             state->hostname, state->profile.name, state->process_count,
+             state->uptime_seconds / 86400, ARTIFACT_COUNT + TEMPLATED_COUNT - failed);
+    log_event_level(LOG_INFO, msg);
+
+    state_engine_destroy(state);
+    free(state);
+    return failed ? -1 : 0;
+}
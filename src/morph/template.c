@@ -0,0 +1,460 @@
+/**
+ * template.c - Compile-once templates for morph artifacts
+ *
+ * cowrie.cfg, cowrie.env, behavior.conf and the default web pages were
+ * each one big snprintf() into a fixed 1-4 KB buffer. Adding a line meant
+ * editing C and counting format arguments, and output that outgrew its
+ * buffer was cut off without a word.
+ *
+ * Now the text lives in templates/ and is compiled once into ops that
+ * point into the source: literal spans, variable slots and loops over the
+ * caller's lists. Rendering is a single walk that appends into a buffer
+ * the caller keeps between renders, so nothing is parsed or allocated per
+ * artifact once the buffer has grown to size.
+ */
+
+#include <ctype.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "template.h"
+#include "utils.h"
+
+#define TEMPLATE_MAX_SIZE (256 * 1024)
+#define TEMPLATE_MAX_FIELDS 16
+#define TEMPLATE_SCRATCH 512
+
+typedef enum {
+    OP_LITERAL,     // text[offset, offset + length)
+    OP_VAR,         // values[index]
+    OP_FIELD,       // field index of the current item
+    OP_EACH,        // loop over lists[index]; jump = matching OP_END
+    OP_END          // jump = matching OP_EACH
+} op_kind_t;
+
+typedef struct {
+    op_kind_t kind;
+    int index;
+    int jump;
+    size_t offset;
+    size_t length;
+} template_op_t;
+
+struct template {
+    char name[TEMPLATE_PATH];
+    char* text;
+    template_op_t* ops;
+    int op_count;
+    const template_schema_t* schema;
+};
+
+/* ---------------------------------------------------------------------------
+ * Compiling
+ * --------------------------------------------------------------------------- */
+
+typedef struct {
+    template_t* tmpl;
+    int capacity;
+    int open_each;      // Op index of the unclosed {{#each}}, or -1
+} compiler_t;
+
+static int compile_error(const template_t* tmpl, size_t at, const char* reason) {
+    int line = 1;
+    for (size_t i = 0; i < at; i++) {
+        if (tmpl->text[i] == '\n') line++;
+    }
+    char msg[TEMPLATE_PATH + 128];
+    snprintf(msg, sizeof(msg), "Template %s line %d: %s", tmpl->name, line, reason);
+    log_event_level(LOG_ERROR, msg);
+    return -1;
+}
+
+static int emit(compiler_t* c, op_kind_t kind, int index, size_t offset, size_t length) {
+    template_t* t = c->tmpl;
+    if (t->op_count == c->capacity) {
+        int capacity = c->capacity ? c->capacity * 2 : 32;
+        template_op_t* ops = realloc(t->ops, (size_t)capacity * sizeof(template_op_t));
+        if (!ops) return -1;
+        t->ops = ops;
+        c->capacity = capacity;
+    }
+    t->ops[t->op_count++] = (template_op_t){ kind, index, -1, offset, length };
+    return 0;
+}
+
+static int find_name(const char* const* names, const char* name, size_t length) {
+    for (int i = 0; names && names[i]; i++) {
+        if (strlen(names[i]) == length && strncmp(names[i], name, length) == 0) return i;
+    }
+    return -1;
+}
+
+static int find_list(const template_schema_t* schema, const char* name, size_t length) {
+    for (int i = 0; schema->lists && schema->lists[i].name; i++) {
+        const char* list = schema->lists[i].name;
+        if (strlen(list) == length && strncmp(list, name, length) == 0) return i;
+    }
+    return -1;
+}
+
+// A block tag alone on its line takes the line with it, so loops do not
+// leave blank lines behind. Returns how much of the literal before the tag
+// to keep; *skip_newline says whether to drop the newline after it.
+static size_t standalone_trim(const char* text, size_t literal_start, size_t open, size_t close,
+                              int* skip_newline) {
+    size_t line_start = open;
+    while (line_start > literal_start && (text[line_start - 1] == ' ' || text[line_start - 1] == '\t')) {
+        line_start--;
+    }
+    int at_line_start = line_start == 0 || text[line_start - 1] == '\n';
+    int at_line_end = text[close] == '\n' || text[close] == '\0';
+    if (at_line_start && line_start >= literal_start && at_line_end) {
+        *skip_newline = text[close] == '\n';
+        return line_start - literal_start;
+    }
+    *skip_newline = 0;
+    return open - literal_start;
+}
+
+static int compile_tag(compiler_t* c, size_t open, const char* tag, size_t length) {
+    template_t* t = c->tmpl;
+    const template_schema_t* schema = t->schema;
+
+    if (length > 6 && strncmp(tag, "#each", 5) == 0 && isspace((unsigned char)tag[5])) {
+        const char* name = tag + 6;
+        size_t name_length = length - 6;
+        while (name_length && isspace((unsigned char)*name)) {
+            name++;
+            name_length--;
+        }
+        int list = find_list(schema, name, name_length);
+        if (list < 0) {
+            char reason[96];
+            snprintf(reason, sizeof(reason), "unknown list '%.*s'", (int)(name_length < 64 ? name_length : 64), name);
+            return compile_error(t, open, reason);
+        }
+        if (c->open_each >= 0) return compile_error(t, open, "#each cannot be nested");
+        c->open_each = t->op_count;
+        return emit(c, OP_EACH, list, 0, 0);
+    }
+    if (length == 5 && strncmp(tag, "/each", 5) == 0) {
+        if (c->open_each < 0) return compile_error(t, open, "/each without #each");
+        if (emit(c, OP_END, 0, 0, 0) != 0) return -1;
+        t->ops[t->op_count - 1].jump = c->open_each;
+        t->ops[c->open_each].jump = t->op_count - 1;
+        c->open_each = -1;
+        return 0;
+    }
+
+    // Inside a loop the item's fields come first, then the variables
+    if (c->open_each >= 0) {
+        const template_list_t* list = &schema->lists[t->ops[c->open_each].index];
+        int field = find_name(list->fields, tag, length);
+        if (field >= 0) return emit(c, OP_FIELD, field, 0, 0);
+    }
+    int var = find_name(schema->vars, tag, length);
+    if (var < 0) {
+        char reason[96];
+        snprintf(reason, sizeof(reason), "unknown variable '%.*s'", (int)(length < 64 ? length : 64), tag);
+        return compile_error(t, open, reason);
+    }
+    return emit(c, OP_VAR, var, 0, 0);
+}
+
+template_t* template_compile(const char* name, const char* source, const template_schema_t* schema) {
+    if (!name || !source || !schema) return NULL;
+    // load_item() hands every list TEMPLATE_MAX_FIELDS slots
+    for (int i = 0; schema->lists && schema->lists[i].name; i++) {
+        int fields = 0;
+        while (schema->lists[i].fields[fields]) fields++;
+        if (fields > TEMPLATE_MAX_FIELDS) return NULL;
+    }
+
+    template_t* t = calloc(1, sizeof(template_t));
+    if (!t) return NULL;
+    snprintf(t->name, sizeof(t->name), "%s", name);
+    t->schema = schema;
+    t->text = str_dup(source);
+    compiler_t c = { t, 0, -1 };
+    if (!t->text) goto fail;
+
+    const char* text = t->text;
+    size_t pos = 0;
+    for (;;) {
+        const char* open_at = strstr(text + pos, "{{");
+        size_t open = open_at ? (size_t)(open_at - text) : strlen(text);
+        if (!open_at) {
+            if (open > pos && emit(&c, OP_LITERAL, 0, pos, open - pos) != 0) goto fail;
+            break;
+        }
+        const char* close_at = strstr(open_at + 2, "}}");
+        if (!close_at) {
+            compile_error(t, open, "unclosed {{");
+            goto fail;
+        }
+        size_t close = (size_t)(close_at - text) + 2;
+
+        // Tag text without the braces and surrounding spaces
+        const char* tag = open_at + 2;
+        size_t length = (size_t)(close_at - tag);
+        while (length && isspace((unsigned char)*tag)) {
+            tag++;
+            length--;
+        }
+        while (length && isspace((unsigned char)tag[length - 1])) length--;
+
+        int block = length && (tag[0] == '#' || tag[0] == '/' || tag[0] == '!');
+        int skip_newline = 0;
+        size_t keep = block ? standalone_trim(text, pos, open, close, &skip_newline) : open - pos;
+        if (keep && emit(&c, OP_LITERAL, 0, pos, keep) != 0) goto fail;
+
+        if (length == 0) {
+            compile_error(t, open, "empty tag");
+            goto fail;
+        }
+        if (tag[0] != '!' && compile_tag(&c, open, tag, length) != 0) goto fail;
+        pos = close + (skip_newline ? 1 : 0);
+    }
+    if (c.open_each >= 0) {
+        compile_error(t, strlen(text), "#each without /each");
+        goto fail;
+    }
+    return t;
+
+fail:
+    template_free(t);
+    return NULL;
+}
+
+void template_free(template_t* tmpl) {
+    if (!tmpl) return;
+    free(tmpl->text);
+    free(tmpl->ops);
+    free(tmpl);
+}
+
+/* ---------------------------------------------------------------------------
+ * Rendering
+ * --------------------------------------------------------------------------- */
+
+void template_buffer_init(template_buffer_t* buffer) {
+    buffer->data = NULL;
+    buffer->length = 0;
+    buffer->capacity = 0;
+}
+
+void template_buffer_free(template_buffer_t* buffer) {
+    free(buffer->data);
+    template_buffer_init(buffer);
+}
+
+static int append(template_buffer_t* out, const char* data, size_t length) {
+    if (out->length + length + 1 > out->capacity) {
+        size_t capacity = out->capacity ? out->capacity : 1024;
+        while (out->length + length + 1 > capacity) capacity *= 2;
+        char* grown = realloc(out->data, capacity);
+        if (!grown) return -1;
+        out->data = grown;
+        out->capacity = capacity;
+    }
+    memcpy(out->data + out->length, data, length);
+    out->length += length;
+    out->data[out->length] = '\0';
+    return 0;
+}
+
+static int append_str(template_buffer_t* out, const char* s) {
+    return s ? append(out, s, strlen(s)) : 0;
+}
+
+static void load_item(const template_list_t* list, const void* data, int index,
+                      const char** fields, char* scratch) {
+    for (int f = 0; f < TEMPLATE_MAX_FIELDS; f++) fields[f] = NULL;
+    list->item(data, index, fields, scratch, TEMPLATE_SCRATCH);
+}
+
+long template_render(const template_t* tmpl, const char* const* values, const void* list_data,
+                     template_buffer_t* out) {
+    if (!tmpl || !out) return -1;
+    out->length = 0;
+    if (append(out, "", 0) != 0) return -1;
+
+    const char* fields[TEMPLATE_MAX_FIELDS];
+    char scratch[TEMPLATE_SCRATCH];
+    const template_list_t* list = NULL;
+    int item = 0;
+    int count = 0;
+
+    int result = 0;
+    for (int i = 0; i < tmpl->op_count && result == 0; i++) {
+        const template_op_t* op = &tmpl->ops[i];
+        switch (op->kind) {
+            case OP_LITERAL:
+                result = append(out, tmpl->text + op->offset, op->length);
+                break;
+            case OP_VAR:
+                result = append_str(out, values ? values[op->index] : NULL);
+                break;
+            case OP_FIELD:
+                result = append_str(out, fields[op->index]);
+                break;
+            case OP_EACH:
+                list = &tmpl->schema->lists[op->index];
+                count = list->count(list_data);
+                item = 0;
+                if (count <= 0) {
+                    i = op->jump;       // Straight past the matching /each
+                } else {
+                    load_item(list, list_data, item, fields, scratch);
+                }
+                break;
+            case OP_END:
+                if (++item < count) {
+                    load_item(list, list_data, item, fields, scratch);
+                    i = op->jump;       // Back to the op after #each
+                }
+                break;
+        }
+    }
+    return result == 0 ? (long)out->length : -1;
+}
+
+/* ---------------------------------------------------------------------------
+ * Cache
+ * --------------------------------------------------------------------------- */
+
+// One lookup, hit or miss. A profile that falls back to common/ gets its
+// own entry pointing at the common template, so a hit never touches the
+// disk, and a miss is only reported once.
+typedef struct {
+    char key[TEMPLATE_PATH];            // <profile>/<type>/<name>, with unusable dirs left empty
+    const template_schema_t* schema;
+    char path[TEMPLATE_PATH];           // File the key resolved to, "" if none
+    template_t* tmpl;                   // NULL: missing or did not compile - not retried
+    int owner;                          // Frees tmpl; other keys for the same file share it
+} cache_entry_t;
+
+struct template_cache {
+    char root[TEMPLATE_PATH];
+    pthread_mutex_t lock;
+    cache_entry_t* entries;
+    int count;
+    int capacity;
+};
+
+template_cache_t* template_cache_create(const char* root) {
+    template_cache_t* cache = calloc(1, sizeof(template_cache_t));
+    if (!cache) return NULL;
+    snprintf(cache->root, sizeof(cache->root), "%s", root ? root : TEMPLATE_DIR);
+    pthread_mutex_init(&cache->lock, NULL);
+    return cache;
+}
+
+void template_cache_free(template_cache_t* cache) {
+    if (!cache) return;
+    for (int i = 0; i < cache->count; i++) {
+        if (cache->entries[i].owner) template_free(cache->entries[i].tmpl);
+    }
+    free(cache->entries);
+    pthread_mutex_destroy(&cache->lock);
+    free(cache);
+}
+
+// A profile or type directory name that cannot leave the root, else ""
+static const char* lookup_dir(const char* dir) {
+    return (!dir || dir[0] == '.' || strchr(dir, '/')) ? "" : dir;
+}
+
+// First of root/<profile>/name, root/<type>/name, root/common/name that exists
+static int resolve(const template_cache_t* cache, const char* profile, const char* type,
+                   const char* name, char* path, size_t size) {
+    const char* dirs[] = { profile, type, TEMPLATE_COMMON };
+    for (size_t i = 0; i < sizeof(dirs) / sizeof(dirs[0]); i++) {
+        const char* dir = dirs[i];
+        if (!dir[0]) continue;
+        if ((size_t)snprintf(path, size, "%s/%s/%s", cache->root, dir, name) >= size) continue;
+        if (file_exists(path)) return 0;
+    }
+    return -1;
+}
+
+static char* read_template_file(const char* path) {
+    FILE* f = fopen(path, "r");
+    if (!f) return NULL;
+    char* text = malloc(TEMPLATE_MAX_SIZE + 1);
+    size_t length = text ? fread(text, 1, TEMPLATE_MAX_SIZE, f) : 0;
+    int complete = text && !ferror(f) && feof(f);
+    if (text && !complete && fgetc(f) == EOF && !ferror(f)) complete = 1;   // Exactly full
+    fclose(f);
+    if (!complete) {
+        free(text);
+        return NULL;
+    }
+    text[length] = '\0';
+    return text;
+}
+
+// Resolve and compile the template for key, reusing one another key already compiled
+static void load_entry(template_cache_t* cache, cache_entry_t* e, const char* profile, const char* type,
+                       const char* name) {
+    if (resolve(cache, profile, type, name, e->path, sizeof(e->path)) != 0) {
+        e->path[0] = '\0';
+        char msg[TEMPLATE_PATH + 64];
+        snprintf(msg, sizeof(msg), "Template not found: %s", name);
+        log_event_level(LOG_WARN, msg);
+        return;
+    }
+
+    for (int i = 0; i < cache->count; i++) {
+        const cache_entry_t* other = &cache->entries[i];
+        if (other->owner && other->schema == e->schema && strcmp(other->path, e->path) == 0) {
+            e->tmpl = other->tmpl;
+            return;
+        }
+    }
+
+    char* source = read_template_file(e->path);
+    e->tmpl = source ? template_compile(e->path, source, e->schema) : NULL;
+    e->owner = e->tmpl != NULL;
+    free(source);
+}
+
+const template_t* template_cache_get(template_cache_t* cache, const char* profile, const char* type,
+                                     const char* name, const template_schema_t* schema) {
+    if (!cache || !name || !schema || strstr(name, "..") || name[0] == '/') return NULL;
+
+    profile = lookup_dir(profile);
+    type = lookup_dir(type);
+    char key[TEMPLATE_PATH];
+    if ((size_t)snprintf(key, sizeof(key), "%s/%s/%s", profile, type, name) >= sizeof(key)) return NULL;
+
+    pthread_mutex_lock(&cache->lock);
+    for (int i = 0; i < cache->count; i++) {
+        if (cache->entries[i].schema == schema && strcmp(cache->entries[i].key, key) == 0) {
+            const template_t* found = cache->entries[i].tmpl;
+            pthread_mutex_unlock(&cache->lock);
+            return found;
+        }
+    }
+
+    if (cache->count == cache->capacity) {
+        int capacity = cache->capacity ? cache->capacity * 2 : 16;
+        cache_entry_t* entries = realloc(cache->entries, (size_t)capacity * sizeof(cache_entry_t));
+        if (!entries) {
+            pthread_mutex_unlock(&cache->lock);
+            return NULL;
+        }
+        cache->entries = entries;
+        cache->capacity = capacity;
+    }
+    cache_entry_t* e = &cache->entries[cache->count];
+    memset(e, 0, sizeof(*e));
+    snprintf(e->key, sizeof(e->key), "%s", key);
+    e->schema = schema;
+    load_entry(cache, e, profile, type, name);
+    cache->count++;
+    const template_t* found = e->tmpl;
+    pthread_mutex_unlock(&cache->lock);
+    return found;
+}
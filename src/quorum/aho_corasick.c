@@ -0,0 +1,186 @@
+/**
+ * aho_corasick.c - Multi-pattern signature matcher
+ *
+ * Checking each log line against every signature with strcasestr() costs
+ * one pass over the line per signature. An Aho-Corasick automaton finds
+ * all of them in one pass: the signatures are merged into a trie, failure
+ * links say where to continue after a mismatch, and compiling those links
+ * into a full transition table leaves exactly one table lookup per input
+ * byte, whatever the number of signatures.
+ *
+ * The table is kept small by mapping bytes to columns first: only bytes
+ * that occur in some signature get their own column (upper and lower case
+ * share one, which also makes matching case-insensitive), and every other
+ * byte goes to column 0. A few hundred signatures compile to a table that
+ * fits in cache.
+ */
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include "aho_corasick.h"
+
+int ac_init(ac_automaton_t* ac) {
+    if (!ac) return -1;
+    memset(ac, 0, sizeof(ac_automaton_t));
+    return 0;
+}
+
+void ac_free(ac_automaton_t* ac) {
+    if (!ac) return;
+    for (int i = 0; i < ac->pattern_count; i++) {
+        free(ac->patterns[i]);
+    }
+    free(ac->patterns);
+    free(ac->pattern_groups);
+    free(ac->delta);
+    free(ac->output);
+    memset(ac, 0, sizeof(ac_automaton_t));
+}
+
+/**
+ * Add a pattern before compiling
+ * Returns 0 on success, -1 for an empty pattern, bad group or no memory.
+ */
+int ac_add(ac_automaton_t* ac, const char* pattern, int group) {
+    if (!ac || ac->compiled || !pattern || !*pattern) return -1;
+    if (group < 0 || group >= AC_MAX_GROUPS) return -1;
+
+    if (ac->pattern_count == ac->pattern_capacity) {
+        int capacity = ac->pattern_capacity ? ac->pattern_capacity * 2 : 32;
+        char** patterns = realloc(ac->patterns, (size_t)capacity * sizeof(char*));
+        if (!patterns) return -1;
+        ac->patterns = patterns;
+        uint8_t* groups = realloc(ac->pattern_groups, (size_t)capacity);
+        if (!groups) return -1;
+        ac->pattern_groups = groups;
+        ac->pattern_capacity = capacity;
+    }
+
+    char* copy = strdup(pattern);
+    if (!copy) return -1;
+    ac->patterns[ac->pattern_count] = copy;
+    ac->pattern_groups[ac->pattern_count] = (uint8_t)group;
+    ac->pattern_count++;
+    return 0;
+}
+
+// Column assignment: one per distinct (case-folded) signature byte
+static void build_byte_classes(ac_automaton_t* ac) {
+    memset(ac->byte_class, 0, sizeof(ac->byte_class));
+    ac->class_count = 1;
+
+    for (int i = 0; i < ac->pattern_count; i++) {
+        for (const unsigned char* p = (const unsigned char*)ac->patterns[i]; *p; p++) {
+            int lower = tolower(*p);
+            if (ac->byte_class[lower]) continue;
+            ac->byte_class[lower] = (uint8_t)ac->class_count;
+            ac->byte_class[toupper(lower)] = (uint8_t)ac->class_count;
+            ac->class_count++;
+        }
+    }
+}
+
+/**
+ * Build the trie, then turn failure links into a complete transition table
+ *
+ * States are numbered in insertion order and processed breadth-first, so a
+ * state's failure target is always finished before the state itself.
+ */
+int ac_compile(ac_automaton_t* ac) {
+    if (!ac || ac->compiled) return -1;
+
+    build_byte_classes(ac);
+
+    size_t max_states = 1;
+    for (int i = 0; i < ac->pattern_count; i++) {
+        max_states += strlen(ac->patterns[i]);
+    }
+    size_t columns = (size_t)ac->class_count;
+
+    int32_t* delta = malloc(max_states * columns * sizeof(int32_t));
+    uint64_t* output = calloc(max_states, sizeof(uint64_t));
+    int32_t* fail = calloc(max_states, sizeof(int32_t));
+    int32_t* queue = malloc(max_states * sizeof(int32_t));
+    if (!delta || !output || !fail || !queue) {
+        free(delta);
+        free(output);
+        free(fail);
+        free(queue);
+        return -1;
+    }
+    memset(delta, 0xff, max_states * columns * sizeof(int32_t));  // -1 = no edge yet
+
+    // Trie
+    int32_t state_count = 1;
+    for (int i = 0; i < ac->pattern_count; i++) {
+        int32_t state = 0;
+        for (const unsigned char* p = (const unsigned char*)ac->patterns[i]; *p; p++) {
+            int32_t* edge = &delta[(size_t)state * columns + ac->byte_class[*p]];
+            if (*edge < 0) {
+                *edge = state_count++;
+            }
+            state = *edge;
+        }
+        output[state] |= 1ull << ac->pattern_groups[i];
+    }
+
+    // Failure links, breadth first
+    int head = 0, tail = 0;
+    for (size_t c = 0; c < columns; c++) {
+        int32_t* edge = &delta[c];
+        if (*edge < 0) {
+            *edge = 0;
+        } else {
+            fail[*edge] = 0;
+            queue[tail++] = *edge;
+        }
+    }
+    while (head < tail) {
+        int32_t state = queue[head++];
+        output[state] |= output[fail[state]];
+
+        for (size_t c = 0; c < columns; c++) {
+            int32_t* edge = &delta[(size_t)state * columns + c];
+            int32_t via_fail = delta[(size_t)fail[state] * columns + c];
+            if (*edge < 0) {
+                *edge = via_fail;
+            } else {
+                fail[*edge] = via_fail;
+                queue[tail++] = *edge;
+            }
+        }
+    }
+
+    free(fail);
+    free(queue);
+
+    // Trim to the states actually used
+    int32_t* trimmed = realloc(delta, (size_t)state_count * columns * sizeof(int32_t));
+    ac->delta = trimmed ? trimmed : delta;
+    uint64_t* trimmed_output = realloc(output, (size_t)state_count * sizeof(uint64_t));
+    ac->output = trimmed_output ? trimmed_output : output;
+    ac->state_count = state_count;
+    ac->compiled = true;
+    return 0;
+}
+
+/**
+ * Groups whose patterns occur in text
+ * Returns 0 if nothing matched or the automaton isn't compiled.
+ */
+uint64_t ac_match(const ac_automaton_t* ac, const char* text, size_t len) {
+    if (!ac || !ac->compiled || !text) return 0;
+
+    const int32_t* delta = ac->delta;
+    const uint8_t* byte_class = ac->byte_class;
+    size_t columns = (size_t)ac->class_count;
+    uint64_t hits = 0;
+    int32_t state = 0;
+
+    for (size_t i = 0; i < len; i++) {
+        state = delta[(size_t)state * columns + byte_class[(unsigned char)text[i]]];
+        hits |= ac->output[state];
+    }
+    return hits;
+}
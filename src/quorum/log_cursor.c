@@ -0,0 +1,382 @@
+/**
+ * log_cursor.c - Incremental log reading for the quorum engine
+ *
+ * Remembers where we stopped in each log (inode + byte offset) so every
+ * quorum pass only parses bytes appended since the previous one.
+ *
+ * WHY THIS MODULE EXISTS:
+ * cowrie.log only ever grows. Rereading it from byte 0 on every timer run
+ * means each pass gets slower the longer the honeypot has been up, even when
+ * nobody is attacking. With a cursor, the cost of a pass depends on the new
+ * traffic only.
+ *
+ * Rotation and truncation are detected three ways:
+ * - the inode changed (logrotate moved the file and created a new one)
+ * - the file is now shorter than our offset (truncated with "> file")
+ * - the first bytes no longer hash to the stored fingerprint (rewritten in place)
+ * In all cases we start again from the beginning of the new file.
+ *
+ * Live logs are read with pread() into a buffer that grows to fit the
+ * longest line, and lines are found with memchr(). They are never mapped:
+ * logrotate's copytruncate can shrink a live log at any moment, and
+ * touching a mapped page past the new end raises SIGBUS - possibly inside
+ * a line handler, where there is no safe way to recover. A rotated file
+ * (<log>.1) is no longer written or truncated, so it is mapped and handlers
+ * get pointers straight into the page cache.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "log_cursor.h"
+#include "quorum.h"
+#include "utils.h"
+
+#define FNV_OFFSET_BASIS 2166136261u
+#define FNV_PRIME 16777619u
+
+// Map at most this much of a log at a time (grown if one line is longer)
+#define MAP_WINDOW_BYTES ((off_t)64 << 20)
+// Starting buffer for pread() reads (grown if one line is longer)
+#define READ_BUFFER_BYTES (256 * 1024)
+
+/**
+ * FNV-1a hash, chainable through the seed
+ */
+uint32_t log_cursor_hash(const char* data, size_t len, uint32_t seed) {
+    uint32_t hash = seed ? seed : FNV_OFFSET_BASIS;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)data[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+void log_cursor_reset(log_cursor_t* cursor) {
+    if (!cursor) return;
+    memset(cursor, 0, sizeof(log_cursor_t));
+}
+
+static int open_log(const char* filepath) {
+    int fd;
+    do {
+        fd = open(filepath, O_RDONLY | O_CLOEXEC);
+    } while (fd < 0 && errno == EINTR);
+    return fd;
+}
+
+static ssize_t read_full(int fd, char* buf, size_t len, off_t offset) {
+    size_t done = 0;
+    while (done < len) {
+        ssize_t n = pread(fd, buf + done, len - done, offset + (off_t)done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        done += (size_t)n;
+    }
+    return (ssize_t)done;
+}
+
+/**
+ * Hash the first len bytes of an open file. Returns false if the file is shorter.
+ */
+static bool hash_file_prefix(int fd, uint32_t len, uint32_t* hash_out) {
+    char prefix[LOG_CURSOR_FINGERPRINT_BYTES];
+    if (len > sizeof(prefix)) len = sizeof(prefix);
+
+    if (read_full(fd, prefix, len, 0) != (ssize_t)len) return false;
+
+    *hash_out = log_cursor_hash(prefix, len, 0);
+    return true;
+}
+
+/**
+ * Hand every complete line in data[0..len) to the handler
+ * Returns the bytes consumed; an unterminated tail is left for the caller.
+ */
+static size_t scan_lines(const char* data, size_t len, log_line_handler_t handler, void* ctx) {
+    const char* p = data;
+    const char* stop = data + len;
+
+    while (p < stop) {
+        const char* nl = memchr(p, '\n', (size_t)(stop - p));
+        if (!nl) break;
+        handler(p, (size_t)(nl - p), ctx);
+        p = nl + 1;
+    }
+    return (size_t)(p - data);
+}
+
+/**
+ * pread() reader for live logs, and for files that cannot be mapped
+ * A file truncated underneath us just reads short; the next
+ * log_cursor_begin() sees the shrink and starts over.
+ */
+static off_t read_lines_buffered(int fd, off_t start, off_t end,
+                                 log_line_handler_t handler, void* ctx) {
+    size_t capacity = READ_BUFFER_BYTES;
+    char* buf = malloc(capacity);
+    if (!buf) return 0;
+
+    off_t consumed = 0;
+    size_t filled = 0;  // Unconsumed bytes at the front of buf
+
+    while (start + consumed + (off_t)filled < end) {
+        if (filled == capacity) {
+            // One line fills the whole buffer - make room for the rest of it
+            char* grown = realloc(buf, capacity * 2);
+            if (!grown) break;
+            buf = grown;
+            capacity *= 2;
+        }
+
+        size_t want = capacity - filled;
+        off_t remaining = end - (start + consumed + (off_t)filled);
+        if ((off_t)want > remaining) want = (size_t)remaining;
+
+        ssize_t n = read_full(fd, buf + filled, want, start + consumed + (off_t)filled);
+        if (n <= 0) break;
+        filled += (size_t)n;
+
+        size_t used = scan_lines(buf, filled, handler, ctx);
+        consumed += (off_t)used;
+        filled -= used;
+        memmove(buf, buf + used, filled);
+    }
+
+    free(buf);
+    return consumed;
+}
+
+/**
+ * Parse complete lines in [start, end) of an open file
+ * A line that runs past end (or is unterminated at EOF) is left unread.
+ * Only pass stable = true for files nobody writes or truncates any more;
+ * anything else is read with pread() (see the top of this file).
+ * Returns the number of bytes consumed.
+ */
+static off_t read_lines(int fd, off_t start, off_t end, bool stable,
+                        log_line_handler_t handler, void* ctx) {
+    // Never map past the real end of file: touching those pages raises SIGBUS
+    struct stat st;
+    if (fstat(fd, &st) != 0) return 0;
+    if (end > st.st_size) end = st.st_size;
+    if (end <= start) return 0;
+
+    posix_fadvise(fd, start, end - start, POSIX_FADV_SEQUENTIAL);
+    if (!stable) {
+        return read_lines_buffered(fd, start, end, handler, ctx);
+    }
+
+    long page_size = sysconf(_SC_PAGESIZE);
+    if (page_size <= 0) page_size = 4096;
+
+    off_t pos = start;
+    off_t window = MAP_WINDOW_BYTES;
+    while (pos < end) {
+        off_t map_start = pos & ~((off_t)page_size - 1);
+        off_t map_end = (end - pos > window) ? pos + window : end;
+        size_t map_len = (size_t)(map_end - map_start);
+
+        void* map = mmap(NULL, map_len, PROT_READ, MAP_PRIVATE, fd, map_start);
+        if (map == MAP_FAILED) {
+            return (pos - start) + read_lines_buffered(fd, pos, end, handler, ctx);
+        }
+        madvise(map, map_len, MADV_SEQUENTIAL);
+
+        size_t skip = (size_t)(pos - map_start);
+        size_t used = scan_lines((const char*)map + skip, map_len - skip, handler, ctx);
+        munmap(map, map_len);
+
+        pos += (off_t)used;
+        if (used == 0) {
+            if (map_end == end) break;  // Unterminated last line - wait for the rest
+            window *= 2;                // A single line longer than the window
+        }
+    }
+
+    return pos - start;
+}
+
+/**
+ * Refresh the fingerprint while the file is still shorter than the window
+ */
+static void update_fingerprint(int fd, log_cursor_t* cursor) {
+    if (cursor->fingerprint_len >= LOG_CURSOR_FINGERPRINT_BYTES ||
+        cursor->offset <= (off_t)cursor->fingerprint_len) {
+        return;
+    }
+
+    uint32_t len = cursor->offset < LOG_CURSOR_FINGERPRINT_BYTES
+                       ? (uint32_t)cursor->offset
+                       : LOG_CURSOR_FINGERPRINT_BYTES;
+    uint32_t hash;
+    if (hash_file_prefix(fd, len, &hash)) {
+        cursor->fingerprint = hash;
+        cursor->fingerprint_len = len;
+    }
+}
+
+/**
+ * Finish the old file after logrotate renamed it to <path>.1
+ */
+static void drain_rotated_file(log_cursor_t* cursor, const char* filepath,
+                               log_line_handler_t handler, void* ctx) {
+    char rotated_path[MAX_LOG_LINE + 8];
+    snprintf(rotated_path, sizeof(rotated_path), "%s.1", filepath);
+
+    struct stat st;
+    if (stat(rotated_path, &st) != 0 || st.st_ino != cursor->inode) {
+        return;
+    }
+
+    int fd = open_log(rotated_path);
+    if (fd < 0) return;
+
+    if (st.st_size >= cursor->offset) {
+        cursor->offset += read_lines(fd, cursor->offset, st.st_size, true, handler, ctx);
+    }
+    close(fd);
+}
+
+/**
+ * Validate the cursor against the file on disk before reading
+ *
+ * Handles rotation (finishing the old file through handler), truncation and
+ * in-place replacement, then reports where the readable data ends.
+ *
+ * @return 0 with *end set (0 if the file is missing), -1 on error
+ */
+int log_cursor_begin(log_cursor_t* cursor, const char* filepath,
+                     log_line_handler_t handler, void* ctx, off_t* end) {
+    if (!cursor || !filepath || !handler || !end) return -1;
+    *end = 0;
+
+    struct stat st;
+    if (stat(filepath, &st) != 0 || !S_ISREG(st.st_mode)) {
+        return 0; // Missing log is not an error (service may not have started yet)
+    }
+
+    if (cursor->inode != 0 && cursor->inode != st.st_ino) {
+        drain_rotated_file(cursor, filepath, handler, ctx);
+        log_event_level(LOG_DEBUG, "Log file rotated, reading new file from the start");
+        log_cursor_reset(cursor);
+    }
+    cursor->inode = st.st_ino;
+
+    int fd = open_log(filepath);
+    if (fd < 0) {
+        log_event_level(LOG_WARN, "Failed to open log file");
+        return -1;
+    }
+
+    if (st.st_size < cursor->offset) {
+        log_event_level(LOG_DEBUG, "Log file truncated, reading from the start");
+        cursor->offset = 0;
+        cursor->fingerprint_len = 0;
+    } else if (cursor->fingerprint_len > 0) {
+        uint32_t hash;
+        if (!hash_file_prefix(fd, cursor->fingerprint_len, &hash) ||
+            hash != cursor->fingerprint) {
+            log_event_level(LOG_DEBUG, "Log file replaced, reading from the start");
+            cursor->offset = 0;
+            cursor->fingerprint_len = 0;
+        }
+    }
+
+    close(fd);
+    *end = st.st_size;
+    return 0;
+}
+
+/**
+ * Parse the complete lines in [start, end) of a log
+ * Safe to call from several threads on disjoint, line-aligned ranges.
+ *
+ * @return bytes consumed, -1 if the file cannot be opened
+ */
+off_t log_cursor_read_range(const char* filepath, off_t start, off_t end,
+                            log_line_handler_t handler, void* ctx) {
+    if (!filepath || !handler || end <= start) return 0;
+
+    int fd = open_log(filepath);
+    if (fd < 0) return -1;
+
+    off_t consumed = read_lines(fd, start, end, false, handler, ctx);
+    close(fd);
+    return consumed;
+}
+
+/**
+ * First line start at or after pos (end if there is none before end)
+ */
+off_t log_cursor_align(const char* filepath, off_t pos, off_t end) {
+    if (pos <= 0) return 0;
+
+    int fd = open_log(filepath);
+    if (fd < 0) return end;
+
+    // The byte before pos tells us whether pos already starts a line
+    off_t aligned = end;
+    off_t at = pos - 1;
+    char buf[4096];
+    while (at < end) {
+        size_t want = sizeof(buf);
+        if ((off_t)want > end - at) want = (size_t)(end - at);
+        ssize_t n = read_full(fd, buf, want, at);
+        if (n <= 0) break;
+
+        const char* nl = memchr(buf, '\n', (size_t)n);
+        if (nl) {
+            aligned = at + (nl - buf) + 1;
+            break;
+        }
+        at += n;
+    }
+
+    close(fd);
+    return aligned;
+}
+
+/**
+ * Advance the cursor past bytes consumed since log_cursor_begin()
+ */
+void log_cursor_commit(log_cursor_t* cursor, const char* filepath, off_t consumed) {
+    if (!cursor || !filepath) return;
+    cursor->offset += consumed;
+
+    if (cursor->fingerprint_len >= LOG_CURSOR_FINGERPRINT_BYTES) return;
+
+    int fd = open_log(filepath);
+    if (fd < 0) return;
+    update_fingerprint(fd, cursor);
+    close(fd);
+}
+
+/**
+ * Read everything appended to filepath since the cursor was last advanced
+ *
+ * @return bytes consumed (0 if nothing new or file missing), -1 on error
+ */
+int log_cursor_read(log_cursor_t* cursor, const char* filepath,
+                    log_line_handler_t handler, void* ctx) {
+    off_t end;
+    if (log_cursor_begin(cursor, filepath, handler, ctx, &end) != 0) {
+        return -1;
+    }
+    if (end <= cursor->offset) {
+        return 0;
+    }
+
+    off_t consumed = log_cursor_read_range(filepath, cursor->offset, end, handler, ctx);
+    if (consumed < 0) {
+        return -1;
+    }
+    log_cursor_commit(cursor, filepath, consumed);
+
+    return (int)(consumed > 0x7fffffff ? 0x7fffffff : consumed);
+}
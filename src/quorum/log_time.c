@@ -0,0 +1,227 @@
+/**
+ * log_time.c - Event timestamps from log lines
+ *
+ * Quorum used to stamp every hit with the time of the scan. That is fine
+ * for "has this IP touched two services ever", but sliding-window detection
+ * needs to know when the attacker actually did something: a backlog read
+ * at startup, or a log that was rotated in an hour late, would otherwise
+ * look like one burst.
+ *
+ * Only the first timestamp near the start of the line is considered (the
+ * prefix services write), so a date inside an attacker's command does not
+ * move the event.
+ *
+ * Local-time conversion goes through mktime(), which takes the tz lock and
+ * is slow; its result is cached per hour, per thread, so a log full of
+ * lines from the same hour costs one call.
+ */
+
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include "log_time.h"
+
+#define SCAN_PREFIX 96  // How far into the line to look for a timestamp
+
+static const char* const month_names[12] = {
+    "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+    "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"
+};
+
+typedef struct {
+    int year, month, day;   // month 1-12
+    int hour, minute, second;
+    bool has_offset;
+    long offset;            // Seconds east of UTC when has_offset is set
+} stamp_t;
+
+/* ============================================================================
+ * Calendar conversion
+ * ============================================================================ */
+
+// Days since 1970-01-01 for a proleptic Gregorian date
+static long days_from_civil(int y, int m, int d) {
+    y -= m <= 2;
+    long era = (y >= 0 ? y : y - 399) / 400;
+    long yoe = y - era * 400;
+    long doy = (153L * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+static time_t stamp_to_time(const stamp_t* s) {
+    if (s->has_offset) {
+        long days = days_from_civil(s->year, s->month, s->day);
+        return (time_t)(days * 86400L + s->hour * 3600L + s->minute * 60L + s->second) - s->offset;
+    }
+
+    // Local time: one mktime() per distinct hour
+    static __thread int cached_key = -1;
+    static __thread time_t cached_hour;
+    int key = ((s->year * 12 + s->month) * 31 + s->day) * 24 + s->hour;
+    if (key != cached_key) {
+        struct tm tm;
+        memset(&tm, 0, sizeof(tm));
+        tm.tm_year = s->year - 1900;
+        tm.tm_mon = s->month - 1;
+        tm.tm_mday = s->day;
+        tm.tm_hour = s->hour;
+        tm.tm_isdst = -1;
+        time_t hour = mktime(&tm);
+        if (hour == (time_t)-1) return 0;
+        cached_key = key;
+        cached_hour = hour;
+    }
+    return cached_hour + s->minute * 60 + s->second;
+}
+
+/* ============================================================================
+ * Field scanning
+ * ============================================================================ */
+
+// Read exactly n digits
+static bool digits(const char** p, const char* end, int n, int* out) {
+    if (end - *p < n) return false;
+    int v = 0;
+    for (int i = 0; i < n; i++) {
+        char c = (*p)[i];
+        if (c < '0' || c > '9') return false;
+        v = v * 10 + (c - '0');
+    }
+    *p += n;
+    *out = v;
+    return true;
+}
+
+static bool expect(const char** p, const char* end, char c) {
+    if (*p >= end || **p != c) return false;
+    (*p)++;
+    return true;
+}
+
+static bool valid_stamp(const stamp_t* s) {
+    return s->month >= 1 && s->month <= 12 && s->day >= 1 && s->day <= 31 &&
+           s->hour <= 23 && s->minute <= 59 && s->second <= 60;
+}
+
+// "Z", "+HH:MM", "+HHMM" or nothing (local time)
+static void parse_offset(const char* p, const char* end, stamp_t* s) {
+    if (p < end && *p == ' ') p++;
+    if (p < end && *p == 'Z') {
+        s->has_offset = true;
+        s->offset = 0;
+        return;
+    }
+    if (p >= end || (*p != '+' && *p != '-')) return;
+
+    int sign = (*p == '-') ? -1 : 1;
+    p++;
+    int hours, minutes;
+    if (!digits(&p, end, 2, &hours)) return;
+    if (p < end && *p == ':') p++;
+    if (!digits(&p, end, 2, &minutes)) return;
+    s->has_offset = true;
+    s->offset = sign * (hours * 3600L + minutes * 60L);
+}
+
+// "2024-03-12T08:15:02[.frac][zone]" or "2024-03-12 08:15:02"
+static bool parse_iso(const char* p, const char* end, stamp_t* s) {
+    if (!digits(&p, end, 4, &s->year) || !expect(&p, end, '-') ||
+        !digits(&p, end, 2, &s->month) || !expect(&p, end, '-') ||
+        !digits(&p, end, 2, &s->day)) {
+        return false;
+    }
+    if (p >= end || (*p != 'T' && *p != ' ')) return false;
+    p++;
+    if (!digits(&p, end, 2, &s->hour) || !expect(&p, end, ':') ||
+        !digits(&p, end, 2, &s->minute) || !expect(&p, end, ':') ||
+        !digits(&p, end, 2, &s->second)) {
+        return false;
+    }
+    if (p < end && (*p == '.' || *p == ',')) {
+        p++;
+        while (p < end && *p >= '0' && *p <= '9') p++;
+    }
+    parse_offset(p, end, s);
+    return valid_stamp(s);
+}
+
+static int month_from_name(const char* p, const char* end) {
+    if (end - p < 3) return 0;
+    for (int i = 0; i < 12; i++) {
+        if (memcmp(p, month_names[i], 3) == 0) return i + 1;
+    }
+    return 0;
+}
+
+// "12/Mar/2024:08:15:02 +0000" (after the opening bracket)
+static bool parse_clf(const char* p, const char* end, stamp_t* s) {
+    if (!digits(&p, end, 2, &s->day) || !expect(&p, end, '/')) return false;
+    s->month = month_from_name(p, end);
+    if (!s->month) return false;
+    p += 3;
+    if (!expect(&p, end, '/') || !digits(&p, end, 4, &s->year) || !expect(&p, end, ':') ||
+        !digits(&p, end, 2, &s->hour) || !expect(&p, end, ':') ||
+        !digits(&p, end, 2, &s->minute) || !expect(&p, end, ':') ||
+        !digits(&p, end, 2, &s->second)) {
+        return false;
+    }
+    parse_offset(p, end, s);
+    return valid_stamp(s);
+}
+
+// "Mar 12 08:15:02" - syslog has no year, assume the current one
+static bool parse_syslog(const char* p, const char* end, stamp_t* s) {
+    s->month = month_from_name(p, end);
+    if (!s->month) return false;
+    p += 3;
+    if (!expect(&p, end, ' ')) return false;
+    if (p < end && *p == ' ') p++;  // Single-digit days are space padded
+
+    int day = 0;
+    if (!digits(&p, end, 2, &day) && !digits(&p, end, 1, &day)) return false;
+    s->day = day;
+    if (!expect(&p, end, ' ') ||
+        !digits(&p, end, 2, &s->hour) || !expect(&p, end, ':') ||
+        !digits(&p, end, 2, &s->minute) || !expect(&p, end, ':') ||
+        !digits(&p, end, 2, &s->second)) {
+        return false;
+    }
+
+    static __thread time_t year_checked;
+    static __thread int current_year;
+    time_t now = time(NULL);
+    if (now - year_checked >= 3600) {
+        struct tm local;
+        localtime_r(&now, &local);
+        current_year = local.tm_year + 1900;
+        year_checked = now;
+    }
+    s->year = current_year;
+    return valid_stamp(s);
+}
+
+/* ============================================================================
+ * Public API
+ * ============================================================================ */
+
+time_t log_time_parse(const char* line, size_t len) {
+    if (!line || len == 0) return 0;
+    const char* end = line + (len < SCAN_PREFIX ? len : SCAN_PREFIX);
+
+    stamp_t s;
+    memset(&s, 0, sizeof(s));
+    if (parse_syslog(line, end, &s)) return stamp_to_time(&s);
+
+    for (const char* p = line; p < end; p++) {
+        memset(&s, 0, sizeof(s));
+        if (*p >= '0' && *p <= '9') {
+            if (parse_iso(p, end, &s)) return stamp_to_time(&s);
+            // Not a date; skip the rest of this number
+            while (p + 1 < end && p[1] >= '0' && p[1] <= '9') p++;
+        } else if (*p == '[' && parse_clf(p + 1, end, &s)) {
+            return stamp_to_time(&s);
+        }
+    }
+    return 0;
+}
@@ -1,18 +1,61 @@
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
-#include <ctype.h>
+#include <errno.h>
+#include <libgen.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/inotify.h>
 #include <sys/stat.h>
 #include "quorum.h"
+#include "cowrie_json.h"
+#include "ip_extract.h"
+#include "ip_table.h"
+#include "log_time.h"
+#include "quorum_adapt.h"
+#include "quorum_state.h"
 #include "utils.h"
+#include "worker_pool.h"
 
 // Global state
-static ip_tracking_t ip_tracking[MAX_IPS];
-static int ip_count = 0;
+static ip_table_t ip_table;
+static int max_tracked_ips = DEFAULT_IP_CAPACITY;
+static int ip_ttl_seconds = 0;  // 0 = keep IPs until evicted for space
+static int scan_threads = 1;
+static bool attackers_changed = false;  // New cowrie events since the last assessment
+static int window_seconds[MAX_WINDOWS];  // Sliding windows, shortest first
+static int window_count = 0;             // 0 = cumulative detection (one-shot default)
 static service_config_t service_configs[MAX_SERVICES];
 static int service_count = 0;
 static char alert_log_path[512] = "build/quorum-alerts.log";
+static char cursor_file_path[512] = "build/quorum-cursors.state";
+static char state_file_path[512] = "build/quorum-state.bin";
+static char signature_file_path[512] = DEFAULT_SIGNATURE_FILE;
+static bool state_dirty = false;     // Tracking changed since the last snapshot
+static time_t last_snapshot = 0;
+static bool follow_mode = false;
+static volatile sig_atomic_t keep_following = 1;
+
+#define COWRIE_JSON_LOG "services/cowrie/logs/cowrie.json"
+#define COWRIE_TEXT_LOG "services/cowrie/logs/cowrie.log"
+
+// Below this many new bytes per pass, threads cost more than they save
+#define SCAN_PARALLEL_MIN_BYTES (1 << 20)
+// Smallest piece a single log is split into
+#define SCAN_CHUNK_MIN_BYTES (256 << 10)
+
+// Follow mode rescans at least this often even without inotify events,
+// so a missed event (or an unwatchable directory) only delays detection
+#define FOLLOW_POLL_INTERVAL_MS 5000
+
+// Follow mode writes the state snapshot at most this often (and on exit)
+#define SNAPSHOT_INTERVAL_SECONDS 60
+
+// Windows evaluated in follow mode unless --window says otherwise
+#define DEFAULT_WINDOWS "5m,1h,24h"
 
 // IP address validation (simple IPv4 check)
 bool is_valid_ip(const char* ip) {
@@ -30,162 +73,627 @@ bool is_valid_ip(const char* ip) {
     return true;
 }
 
-// Extract IP from log line (simple regex-free approach)
+// Extract the first IP from a NUL-terminated log line, as a string
 int extract_ip_from_line(const char* line, char* ip_out) {
     if (!line || !ip_out) return -1;
     
-    // Look for IP pattern: digits.digits.digits.digits
-    const char* start = line;
-    while (*start) {
-        if (isdigit(*start)) {
-            char ip_candidate[46] = {0};
-            int i = 0;
-            const char* p = start;
-            
-            // Try to extract IP-like pattern
-            while (i < 45 && *p && (isdigit(*p) || *p == '.')) {
-                ip_candidate[i++] = *p++;
-            }
-            ip_candidate[i] = '\0';
-            
-            if (is_valid_ip(ip_candidate)) {
-                strncpy(ip_out, ip_candidate, MAX_IP_STRING - 1);
-                ip_out[MAX_IP_STRING - 1] = '\0';
-                return 0;
-            }
-        }
-        start++;
+    ip_addr_t addr;
+    if (ip_extract_first(line, strlen(line), &addr) != 0) {
+        return -1;
     }
     
-    return -1;
+    ip_addr_format(&addr, ip_out, MAX_IP_STRING);
+    return 0;
 }
 
-bool is_ip_in_tracking(const char* ip) {
-    for (int i = 0; i < ip_count; i++) {
-        if (strcmp(ip_tracking[i].ip, ip) == 0) {
-            return true;
-        }
+// Lazily sized so --max-ips can be applied before the first insert
+static void ensure_ip_table(void) {
+    if (ip_table.slots) return;
+    if (ip_table_init(&ip_table, max_tracked_ips) != 0) {
+        log_event_level(LOG_ERROR, "Failed to allocate IP tracking table");
+        exit(1);
     }
-    return false;
 }
 
-int add_ip_to_tracking(const char* ip, const char* service) {
-    if (!ip || !service) return -1;
-    
-    // Find existing IP or create new entry
-    ip_tracking_t* entry = NULL;
-    for (int i = 0; i < ip_count; i++) {
-        if (strcmp(ip_tracking[i].ip, ip) == 0) {
-            entry = &ip_tracking[i];
-            break;
+static int find_service_index(const char* service) {
+    for (int i = 0; i < service_count; i++) {
+        if (strcmp(service_configs[i].name, service) == 0) {
+            return i;
         }
     }
-    
+    return -1;
+}
+
+const char* get_service_name(int index) {
+    if (index < 0 || index >= service_count) {
+        return NULL;
+    }
+    return service_configs[index].name;
+}
+
+/**
+ * Where parsed lines are recorded
+ *
+ * Single-threaded scans write straight into the global table. Scan workers
+ * each get a private table and buffer their attacker events; the results are
+ * merged afterwards in log order, so alerts come out exactly as if one
+ * thread had read everything.
+ */
+typedef struct {
+    cowrie_event_type_t type;
+    char src_ip[MAX_IP_STRING];
+    const char* pattern_name;  // Static string, NULL if none
+    uint64_t signatures;       // Signature groups matched in the line
+    uint64_t detail;           // Credential or command hash, 0 if none
+    time_t when;
+} attacker_event_t;
+
+typedef struct {
+    ip_table_t* table;
+    int service_index;
+    time_t now;            // Timestamp for lines that don't carry their own
+    uint64_t added;        // Distinct IPs this sink inserted
+    bool buffer_events;    // Worker sinks must not touch the attacker registry
+    attacker_event_t* events;
+    int event_count;
+    int event_capacity;
+} scan_sink_t;
+
+static void init_sink(scan_sink_t* sink, ip_table_t* table, int service_index, time_t now) {
+    memset(sink, 0, sizeof(scan_sink_t));
+    sink->table = table;
+    sink->service_index = service_index;
+    sink->now = now;
+}
+
+static int window_bucket_width(int w) {
+    int width = window_seconds[w] / WINDOW_BUCKETS;
+    return width > 0 ? width : 1;
+}
+
+static int track_ip(scan_sink_t* sink, const ip_addr_t* addr, time_t when) {
+    bool created;
+    ip_tracking_t* entry = ip_table_touch(sink->table, addr, when, &created);
     if (!entry) {
-        if (ip_count >= MAX_IPS) {
-            log_event_level(LOG_WARN, "IP tracking table full");
-            return -1;
-        }
-        entry = &ip_tracking[ip_count++];
-        strncpy(entry->ip, ip, MAX_IP_STRING - 1);
-        entry->ip[MAX_IP_STRING - 1] = '\0';
-        entry->service_count = 0;
-        entry->hit_count = 0;
-        entry->first_seen = time(NULL);
-    }
-    
-    // Check if service already recorded
-    bool service_exists = false;
-    for (int i = 0; i < entry->service_count; i++) {
-        if (strcmp(entry->services[i], service) == 0) {
-            service_exists = true;
-            break;
-        }
+        return -1;
+    }
+    if (created) {
+        sink->added++;
     }
     
-    if (!service_exists && entry->service_count < MAX_SERVICES) {
-        strncpy(entry->services[entry->service_count], service, MAX_SERVICE_NAME - 1);
-        entry->services[entry->service_count][MAX_SERVICE_NAME - 1] = '\0';
+    uint32_t bit = 1u << sink->service_index;
+    if (!(entry->service_mask & bit)) {
+        entry->service_mask |= bit;
         entry->service_count++;
     }
     
-    entry->last_seen = time(NULL);
+    // Events can arrive out of order across logs - keep the widest span
+    if (when < entry->first_seen) entry->first_seen = when;
+    if (when > entry->last_seen) entry->last_seen = when;
     entry->hit_count++;
     
+    if (when > entry->service_seen[sink->service_index]) {
+        entry->service_seen[sink->service_index] = when;
+    }
+    for (int w = 0; w < window_count; w++) {
+        hit_ring_add(&entry->windows[w], when / window_bucket_width(w), 1);
+    }
+    
     return 0;
 }
 
-int parse_log_file(const char* filepath, const char* service_name) {
-    if (!file_exists(filepath)) {
-        return 0; // File doesn't exist, not an error
+bool is_ip_in_tracking(const char* ip) {
+    ip_addr_t addr;
+    if (!ip_addr_parse(ip, &addr)) return false;
+    return ip_table_find(&ip_table, &addr) != NULL;
+}
+
+int add_ip_to_tracking(const char* ip, const char* service) {
+    if (!ip || !service) return -1;
+    
+    ip_addr_t addr;
+    if (!ip_addr_parse(ip, &addr)) return -1;
+    
+    int service_index = find_service_index(service);
+    if (service_index < 0) return -1;
+    
+    ensure_ip_table();
+    scan_sink_t sink;
+    init_sink(&sink, &ip_table, service_index, time(NULL));
+    return track_ip(&sink, &addr, sink.now);
+}
+
+static void submit_attacker_event(scan_sink_t* sink, const attacker_event_t* record);
+
+// Per-line callback shared by full and incremental parsing
+static void track_log_line(const char* line, size_t len, void* ctx) {
+    scan_sink_t* sink = (scan_sink_t*)ctx;
+    
+    // The first address on a line is the remote peer; later ones are usually
+    // our own listener ("New connection: peer:port (local:port)")
+    ip_addr_t addr;
+    if (ip_extract_first(line, len, &addr) != 0) {
+        return;
     }
+    time_t when = log_time_parse(line, len);
+    if (!when) when = sink->now;
+    track_ip(sink, &addr, when);
     
-    FILE* f = fopen(filepath, "r");
-    if (!f) {
-        log_event_level(LOG_WARN, "Failed to open log file");
-        return -1;
+    // Classify the line against every attack signature in one pass
+    uint64_t signatures = match_attack_signatures(line, len);
+    if (signatures) {
+        attacker_event_t record = { .type = COWRIE_EVENT_OTHER, .signatures = signatures, .when = when };
+        ip_addr_format(&addr, record.src_ip, sizeof(record.src_ip));
+        submit_attacker_event(sink, &record);
     }
+}
+
+// Typed cowrie events feed the attacker profiles used for threat assessment
+static void apply_attacker_event(const attacker_event_t* event) {
+    attacker_profile_t* attacker = get_attacker_profile(event->src_ip);
+    if (!attacker) return;
     
-    char line[MAX_LOG_LINE];
-    int ip_count_before = ip_count;
+    switch (event->type) {
+    case COWRIE_EVENT_LOGIN_FAILED:
+        attacker->total_attempts++;
+        attacker->failed_attempts++;
+        add_credential_to_attacker(attacker, event->detail);
+        break;
+    case COWRIE_EVENT_LOGIN_SUCCESS:
+        attacker->total_attempts++;
+        add_credential_to_attacker(attacker, event->detail);
+        break;
+    case COWRIE_EVENT_COMMAND:
+        add_command_to_attacker(attacker, event->detail);
+        break;
+    case COWRIE_EVENT_FILE_DOWNLOAD:
+        attacker->successful_exploits++;
+        break;
+    default:
+        break;
+    }
     
-    // Read last N lines (simple approach - in production, use tail or seek)
-    // For now, read all lines but only process recent ones
-    while (fgets(line, sizeof(line), f)) {
-        char ip[MAX_IP_STRING];
-        if (extract_ip_from_line(line, ip) == 0) {
-            add_ip_to_tracking(ip, service_name);
-        }
+    if (event->pattern_name) {
+        add_pattern_to_attacker(attacker, get_attack_pattern(event->pattern_name));
+    }
+    for (uint64_t hits = event->signatures; hits; hits &= hits - 1) {
+        add_pattern_to_attacker(attacker, get_signature_pattern(__builtin_ctzll(hits)));
+    }
+    if (attacker->first_contact == 0 || event->when < attacker->first_contact) {
+        attacker->first_contact = event->when;
     }
+    if (event->when > attacker->last_contact) {
+        attacker->last_contact = event->when;
+    }
+    attackers_changed = true;
+}
+
+static void record_attacker_event(scan_sink_t* sink, const cowrie_event_t* event, time_t when) {
+    attacker_event_t record = { .type = event->type, .when = when };
+    memcpy(record.src_ip, event->src_ip, sizeof(record.src_ip));
     
-    fclose(f);
+    switch (event->type) {
+    case COWRIE_EVENT_LOGIN_FAILED:
+        record.pattern_name = "brute_force";
+        record.detail = hash_credential(event->username, event->password);
+        break;
+    case COWRIE_EVENT_LOGIN_SUCCESS:
+        record.detail = hash_credential(event->username, event->password);
+        break;
+    case COWRIE_EVENT_COMMAND: {
+        // The tail of a long payload is often the interesting part: match
+        // and hash the whole command, not the copy cut to COWRIE_MAX_INPUT
+        char* full = cowrie_event_full_input(event);
+        const char* command = full ? full : event->input;
+        record.signatures = match_attack_signatures(command, strlen(command));
+        record.detail = hash_command(command);
+        free(full);
+        break;
+    }
+    case COWRIE_EVENT_FILE_DOWNLOAD:
+        record.pattern_name = "malware_download";
+        break;
+    default:
+        break;
+    }
+    submit_attacker_event(sink, &record);
+}
+
+// Apply now, or keep for the merge when scanning on a worker thread
+static void submit_attacker_event(scan_sink_t* sink, const attacker_event_t* record) {
+    if (!sink->buffer_events) {
+        apply_attacker_event(record);
+        return;
+    }
     
-    int new_ips = ip_count - ip_count_before;
+    if (sink->event_count == sink->event_capacity) {
+        int capacity = sink->event_capacity ? sink->event_capacity * 2 : 256;
+        attacker_event_t* grown = realloc(sink->events, (size_t)capacity * sizeof(attacker_event_t));
+        if (!grown) return;
+        sink->events = grown;
+        sink->event_capacity = capacity;
+    }
+    sink->events[sink->event_count++] = *record;
+}
+
+// Per-line callback for cowrie.json: the source address is a field, not a guess
+static void track_json_line(const char* line, size_t len, void* ctx) {
+    scan_sink_t* sink = (scan_sink_t*)ctx;
+    
+    cowrie_event_t event;
+    if (cowrie_json_parse_line(line, len, &event) != 0 || !event.has_addr) {
+        return;
+    }
+    
+    time_t when = event.timestamp ? event.timestamp : sink->now;
+    track_ip(sink, &event.addr, when);
+    record_attacker_event(sink, &event, when);
+}
+
+static bool is_json_log(const char* path) {
+    size_t len = strlen(path);
+    return len >= 5 && strcmp(path + len - 5, ".json") == 0;
+}
+
+static log_line_handler_t line_handler_for(const char* path) {
+    return is_json_log(path) ? track_json_line : track_log_line;
+}
+
+static void log_new_ips(uint64_t new_ips, const char* service_name) {
     if (new_ips > 0) {
         char msg[256];
-        snprintf(msg, sizeof(msg), "Found %d IP(s) in %s logs", new_ips, service_name);
+        snprintf(msg, sizeof(msg), "Found %llu IP(s) in %.63s logs",
+                 (unsigned long long)new_ips, service_name);
         log_event_level(LOG_DEBUG, msg);
     }
+}
+
+// Parse a whole log file from the beginning, ignoring any saved cursor
+int parse_log_file(const char* filepath, const char* service_name) {
+    if (!file_exists(filepath)) {
+        return 0; // File doesn't exist, not an error
+    }
+    
+    int service_index = find_service_index(service_name);
+    if (service_index < 0) {
+        return -1;
+    }
     
+    ensure_ip_table();
+    scan_sink_t sink;
+    init_sink(&sink, &ip_table, service_index, time(NULL));
+    
+    log_cursor_t cursor;
+    log_cursor_reset(&cursor);
+    if (log_cursor_read(&cursor, filepath, line_handler_for(filepath), &sink) < 0) {
+        return -1;
+    }
+    
+    log_new_ips(sink.added, service_name);
     return 0;
 }
 
-int scan_logs_for_ips(void) {
-    log_event_level(LOG_INFO, "Scanning logs for IP addresses");
-    
+static void ensure_default_services(void) {
     // Default log locations if no config loaded
     if (service_count == 0) {
-        // Add default services
-        add_service_config("cowrie", "services/cowrie/logs/cowrie.log");
+        // Prefer cowrie's structured event log when it is enabled
+        add_service_config("cowrie", file_exists(COWRIE_JSON_LOG) ? COWRIE_JSON_LOG
+                                                                  : COWRIE_TEXT_LOG);
         add_service_config("router-web", "services/fake-router-web/logs/access.log");
         add_service_config("camera-web", "services/fake-camera-web/logs/access.log");
     }
+}
+
+/* ============================================================================
+ * Parallel scanning
+ * ============================================================================ */
+
+// One line-aligned byte range of one service log
+typedef struct {
+    service_config_t* config;
+    log_line_handler_t handler;
+    off_t start;
+    off_t end;
+    off_t consumed;  // -1 if the log could not be read
+    ip_table_t table;
+    scan_sink_t sink;
+} scan_chunk_t;
+
+static void scan_chunk_job(void* arg, int index) {
+    scan_chunk_t* chunk = &((scan_chunk_t*)arg)[index];
+    
+    if (ip_table_init(&chunk->table, max_tracked_ips) != 0) {
+        chunk->consumed = -1;
+        return;
+    }
+    chunk->sink.table = &chunk->table;
+    chunk->sink.buffer_events = true;
+    
+    chunk->consumed = log_cursor_read_range(chunk->config->log_path, chunk->start, chunk->end,
+                                            chunk->handler, &chunk->sink);
+}
+
+/**
+ * Fold a worker's table into the global one as if its lines had been read here
+ *
+ * New IPs are inserted in the order the worker first saw them (that is the
+ * order alerts are reported in), then every IP is touched in the order the
+ * worker last saw it, so the global recency list ends up identical too.
+ */
+static uint64_t merge_chunk(scan_chunk_t* chunk) {
+    ip_table_t* local = &chunk->table;
+    uint64_t added = 0;
+    
+    for (int i = 0; i < local->count; i++) {
+        ip_tracking_t* entry = &local->entries[i];
+        if (!ip_table_find(&ip_table, &entry->addr)) {
+            bool created;
+            ip_tracking_t* merged = ip_table_touch(&ip_table, &entry->addr, entry->first_seen, &created);
+            if (merged && created) added++;
+        }
+    }
+    
+    for (int32_t i = local->lru_tail; i >= 0; i = local->entries[i].lru_prev) {
+        ip_tracking_t* entry = &local->entries[i];
+        ip_tracking_t* merged = ip_table_touch(&ip_table, &entry->addr, entry->last_seen, NULL);
+        if (!merged) continue;
+        
+        merged->service_mask |= entry->service_mask;
+        merged->service_count = __builtin_popcount(merged->service_mask);
+        if (entry->first_seen < merged->first_seen) merged->first_seen = entry->first_seen;
+        if (entry->last_seen > merged->last_seen) merged->last_seen = entry->last_seen;
+        merged->hit_count += entry->hit_count;
+        
+        for (int s = 0; s < MAX_SERVICES; s++) {
+            if (entry->service_seen[s] > merged->service_seen[s]) {
+                merged->service_seen[s] = entry->service_seen[s];
+            }
+        }
+        for (int w = 0; w < window_count; w++) {
+            hit_ring_merge(&merged->windows[w], &entry->windows[w]);
+        }
+    }
+    ip_table.evictions += local->evictions;
+    
+    for (int i = 0; i < chunk->sink.event_count; i++) {
+        apply_attacker_event(&chunk->sink.events[i]);
+    }
+    return added;
+}
+
+static void free_chunk(scan_chunk_t* chunk) {
+    ip_table_free(&chunk->table);
+    free(chunk->sink.events);
+    chunk->sink.events = NULL;
+}
+
+/**
+ * Cut each service's new bytes into line-aligned chunks for the workers
+ * Returns the number of chunks written to chunks.
+ */
+static int plan_chunks(scan_chunk_t* chunks, int max_chunks, const off_t* ends,
+                       const scan_sink_t* sinks) {
+    int count = 0;
+    
+    for (int i = 0; i < service_count && count < max_chunks; i++) {
+        service_config_t* config = &service_configs[i];
+        off_t start = config->cursor.offset;
+        off_t span = ends[i] - start;
+        if (!config->enabled || span <= 0) continue;
+        
+        int pieces = (int)(span / SCAN_CHUNK_MIN_BYTES);
+        if (pieces > scan_threads) pieces = scan_threads;
+        if (pieces < 1) pieces = 1;
+        if (pieces > max_chunks - count) pieces = max_chunks - count;
+        
+        off_t piece_start = start;
+        for (int p = 1; p <= pieces; p++) {
+            off_t piece_end = (p == pieces) ? ends[i]
+                : log_cursor_align(config->log_path, start + span * p / pieces, ends[i]);
+            if (piece_end <= piece_start) continue;
+            
+            scan_chunk_t* chunk = &chunks[count++];
+            memset(chunk, 0, sizeof(scan_chunk_t));
+            chunk->config = config;
+            chunk->handler = line_handler_for(config->log_path);
+            chunk->start = piece_start;
+            chunk->end = piece_end;
+            chunk->sink = sinks[i];
+            piece_start = piece_end;
+        }
+    }
+    return count;
+}
+
+/**
+ * Read every service log from its cursor to its current end
+ *
+ * Small passes are read on this thread. When there is enough new data and
+ * --threads allows it, logs are split into chunks and parsed in parallel.
+ */
+static void scan_all_services(void) {
+    time_t now = time(NULL);
+    scan_sink_t sinks[MAX_SERVICES];
+    off_t ends[MAX_SERVICES];
+    off_t pending = 0;
+    
+    // Validate cursors on this thread - rotation may need to finish the old file
+    for (int i = 0; i < service_count; i++) {
+        service_config_t* config = &service_configs[i];
+        init_sink(&sinks[i], &ip_table, i, now);
+        ends[i] = 0;
+        if (!config->enabled) continue;
+        
+        if (log_cursor_begin(&config->cursor, config->log_path,
+                             line_handler_for(config->log_path), &sinks[i], &ends[i]) != 0) {
+            ends[i] = 0;
+        }
+        if (ends[i] > config->cursor.offset) {
+            pending += ends[i] - config->cursor.offset;
+        }
+    }
+    
+    int max_chunks = scan_threads * MAX_SERVICES;
+    scan_chunk_t* chunks = NULL;
+    int chunk_count = 0;
+    if (scan_threads > 1 && pending >= SCAN_PARALLEL_MIN_BYTES) {
+        chunks = calloc((size_t)max_chunks, sizeof(scan_chunk_t));
+        if (chunks) {
+            chunk_count = plan_chunks(chunks, max_chunks, ends, sinks);
+        }
+    }
+    
+    if (chunk_count > 0) {
+        worker_pool_run(scan_threads, chunk_count, scan_chunk_job, chunks);
+        
+        // Merge in log order. A short chunk means the log changed under us:
+        // drop the rest of that log, it is read again next pass.
+        service_config_t* truncated = NULL;
+        for (int c = 0; c < chunk_count; c++) {
+            scan_chunk_t* chunk = &chunks[c];
+            service_config_t* config = chunk->config;
+            int index = (int)(config - service_configs);
+            
+            if (config != truncated && chunk->consumed >= 0) {
+                sinks[index].added += merge_chunk(chunk);
+                log_cursor_commit(&config->cursor, config->log_path, chunk->consumed);
+                if (chunk->start + chunk->consumed < chunk->end) {
+                    truncated = config;
+                }
+            } else {
+                truncated = config;
+            }
+            free_chunk(chunk);
+        }
+    } else {
+        for (int i = 0; i < service_count; i++) {
+            service_config_t* config = &service_configs[i];
+            if (ends[i] <= config->cursor.offset) continue;
+            
+            off_t consumed = log_cursor_read_range(config->log_path, config->cursor.offset,
+                                                   ends[i], line_handler_for(config->log_path),
+                                                   &sinks[i]);
+            if (consumed > 0) {
+                log_cursor_commit(&config->cursor, config->log_path, consumed);
+            }
+        }
+    }
+    free(chunks);
     
-    // Scan each service's logs
     for (int i = 0; i < service_count; i++) {
-        if (service_configs[i].enabled) {
-            parse_log_file(service_configs[i].log_path, service_configs[i].name);
+        log_new_ips(sinks[i].added, service_configs[i].name);
+    }
+}
+
+int scan_logs_for_ips(void) {
+    // Follow mode scans on every inotify wakeup - keep that out of the INFO log
+    log_level_t pass_level = follow_mode ? LOG_DEBUG : LOG_INFO;
+    log_event_level(pass_level, "Scanning logs for IP addresses");
+    
+    ensure_default_services();
+    ensure_ip_table();
+    
+    // Forget IPs that have been quiet for longer than the TTL
+    if (ip_ttl_seconds > 0) {
+        int expired = ip_table_expire(&ip_table, time(NULL) - ip_ttl_seconds);
+        if (expired > 0) {
+            char msg[128];
+            snprintf(msg, sizeof(msg), "Expired %d idle IP(s)", expired);
+            log_event_level(pass_level, msg);
+            state_dirty = true;
+        }
+    }
+    
+    uint64_t evictions_before = ip_table.evictions;
+    log_cursor_t cursors_before[MAX_SERVICES];
+    for (int i = 0; i < service_count; i++) {
+        cursors_before[i] = service_configs[i].cursor;
+    }
+    
+    // Scan each service's logs from where the previous pass stopped
+    scan_all_services();
+    
+    for (int i = 0; i < service_count; i++) {
+        if (memcmp(&cursors_before[i], &service_configs[i].cursor, sizeof(log_cursor_t)) != 0) {
+            state_dirty = true;
         }
     }
     
     char msg[256];
-    snprintf(msg, sizeof(msg), "Total unique IPs tracked: %d", ip_count);
-    log_event_level(LOG_INFO, msg);
+    uint64_t evicted = ip_table.evictions - evictions_before;
+    if (evicted > 0) {
+        snprintf(msg, sizeof(msg),
+                 "IP table full: evicted %llu least recently seen IP(s) (limit %d)",
+                 (unsigned long long)evicted, ip_table.capacity);
+        log_event_level(LOG_WARN, msg);
+    }
+    
+    snprintf(msg, sizeof(msg), "Total unique IPs tracked: %d", ip_table.count);
+    log_event_level(pass_level, msg);
     
-    return ip_count;
+    return ip_table.count;
+}
+
+// Services whose latest hit falls within the window ending at the IP's last event
+static uint32_t services_in_window(const ip_tracking_t* entry, int w) {
+    uint32_t mask = 0;
+    time_t since = entry->last_seen - window_seconds[w];
+    for (int i = 0; i < service_count; i++) {
+        if ((entry->service_mask & (1u << i)) && entry->service_seen[i] > since) {
+            mask |= 1u << i;
+        }
+    }
+    return mask;
 }
 
+/**
+ * Windowed rule: two or more services within one window
+ *
+ * Only the shortest window that fires is reported; longer windows holding
+ * the same services are implied and marked as reported too. A window is
+ * re-armed once the IP's activity no longer satisfies it, so a fresh burst
+ * after a quiet period alerts again.
+ */
+static int check_windows(ip_tracking_t* entry) {
+    int fired = -1;
+    uint8_t active = 0;
+    
+    for (int w = 0; w < window_count; w++) {
+        if (__builtin_popcount(services_in_window(entry, w)) < 2) continue;
+        active |= (uint8_t)(1u << w);
+        if (fired < 0 && !(entry->window_alerted & (1u << w))) {
+            fired = w;
+        }
+    }
+    
+    entry->window_alerted = active;
+    return fired;
+}
+
+static int emit_alert(const ip_tracking_t* ip_track, int window);
+
 int detect_coordinated_attacks(void) {
     int alert_count = 0;
     
-    log_event_level(LOG_INFO, "Detecting coordinated attacks");
+    log_event_level(follow_mode ? LOG_DEBUG : LOG_INFO, "Detecting coordinated attacks");
     
-    for (int i = 0; i < ip_count; i++) {
-        ip_tracking_t* entry = &ip_tracking[i];
+    for (int i = 0; i < ip_table.count; i++) {
+        ip_tracking_t* entry = &ip_table.entries[i];
+        
+        if (window_count > 0) {
+            int window = check_windows(entry);
+            if (window >= 0) {
+                emit_alert(entry, window);
+                entry->alerted = true;
+                alert_count++;
+            }
+            continue;
+        }
         
         // Coordinated attack: IP hitting multiple services
-        if (entry->service_count >= 2) {
+        if (entry->service_count >= 2 && !entry->alerted) {
             generate_alert(entry);
+            entry->alerted = true;
             alert_count++;
         }
     }
@@ -194,7 +702,7 @@ int detect_coordinated_attacks(void) {
         char msg[256];
         snprintf(msg, sizeof(msg), "Detected %d potential coordinated attack(s)", alert_count);
         log_event_level(LOG_WARN, msg);
-    } else {
+    } else if (!follow_mode) {
         log_event_level(LOG_INFO, "No coordinated attacks detected");
     }
     
@@ -202,34 +710,110 @@ int detect_coordinated_attacks(void) {
 }
 
 int generate_alert(const ip_tracking_t* ip_track) {
+    return emit_alert(ip_track, -1);
+}
+
+// Alert text grows as needed: service and signature names come from
+// config files and have no fixed bound
+typedef struct {
+    char* data;
+    size_t length;
+    size_t capacity;
+    bool failed;        // An allocation or format failed; the text is incomplete
+} alert_text_t;
+
+static void alert_appendf(alert_text_t* text, const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+
+static void alert_appendf(alert_text_t* text, const char* fmt, ...) {
+    if (text->failed) return;
+    
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(text->data ? text->data + text->length : NULL,
+                      text->data ? text->capacity - text->length : 0, fmt, ap);
+    va_end(ap);
+    if (n < 0) {
+        text->failed = true;
+        return;
+    }
+    
+    if (text->length + (size_t)n + 1 > text->capacity) {
+        size_t capacity = text->capacity ? text->capacity : 1024;
+        while (text->length + (size_t)n + 1 > capacity) capacity *= 2;
+        char* grown = realloc(text->data, capacity);
+        if (!grown) {
+            text->failed = true;
+            return;
+        }
+        text->data = grown;
+        text->capacity = capacity;
+        
+        va_start(ap, fmt);
+        int again = vsnprintf(text->data + text->length, text->capacity - text->length, fmt, ap);
+        va_end(ap);
+        if (again != n) {
+            text->failed = true;
+            return;
+        }
+    }
+    text->length += (size_t)n;
+}
+
+// Alert text; window < 0 reports everything the IP has ever touched
+static int emit_alert(const ip_tracking_t* ip_track, int window) {
     if (!ip_track) return -1;
     
-    char alert[1024];
     char time_str[64];
     struct tm* tm_info = localtime(&ip_track->last_seen);
     strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", tm_info);
     
-    // Build services list
-    char services_list[512] = {0};
-    for (int i = 0; i < ip_track->service_count; i++) {
-        if (i > 0) strcat(services_list, ", ");
-        strcat(services_list, ip_track->services[i]);
-    }
-    
-    snprintf(alert, sizeof(alert),
-        "ALERT: Coordinated attack detected\n"
-        "  IP: %s\n"
-        "  Services hit: %s (%d services)\n"
-        "  Total hits: %d\n"
-        "  First seen: %s\n"
-        "  Last seen: %s\n"
-        "---\n",
-        ip_track->ip,
-        services_list,
-        ip_track->service_count,
-        ip_track->hit_count,
-        ctime(&ip_track->first_seen),
-        time_str);
+    uint32_t services = ip_track->service_mask;
+    if (window >= 0) {
+        services = services_in_window(ip_track, window);
+    }
+    
+    alert_text_t text = {0};
+    alert_appendf(&text, "ALERT: Coordinated attack detected\n  IP: %s\n  Services hit: ", ip_track->ip);
+    bool first = true;
+    for (int i = 0; i < service_count; i++) {
+        if (!(services & (1u << i))) continue;
+        alert_appendf(&text, "%s%s", first ? "" : ", ", service_configs[i].name);
+        first = false;
+    }
+    alert_appendf(&text, " (%d services)\n", __builtin_popcount(services));
+    
+    if (window >= 0) {
+        char label[16];
+        format_duration(window_seconds[window], label, sizeof(label));
+        uint32_t hits = hit_ring_sum(&ip_track->windows[window],
+                                     ip_track->last_seen / window_bucket_width(window));
+        alert_appendf(&text, "  Window: %s\n  Hits in window: %u\n", label, hits);
+    }
+    alert_appendf(&text, "  Total hits: %d\n", ip_track->hit_count);
+    
+    // Login counts are only known for IPs seen in cowrie.json
+    const attacker_profile_t* attacker = find_attacker_profile(ip_track->ip);
+    if (attacker && attacker->total_attempts > 0) {
+        alert_appendf(&text, "  Login attempts: %u (%u failed)\n",
+                      attacker->total_attempts, attacker->failed_attempts);
+    }
+    
+    // Attack patterns recognised in this IP's traffic
+    if (attacker && attacker->pattern_count > 0) {
+        alert_appendf(&text, "  Patterns:");
+        for (int i = 0; i < attacker->pattern_count; i++) {
+            alert_appendf(&text, "%s %s", i ? "," : "", attacker->patterns[i]->pattern_name);
+        }
+        alert_appendf(&text, "\n");
+    }
+    
+    alert_appendf(&text, "  First seen: %s\n  Last seen: %s\n---\n", ctime(&ip_track->first_seen), time_str);
+    if (text.failed) {
+        free(text.data);
+        log_event_level(LOG_ERROR, "Out of memory formatting an alert");
+        return -1;
+    }
+    const char* alert = text.data;
     
     // Log to file
     log_event_file(LOG_WARN, alert_log_path, alert);
@@ -237,6 +821,7 @@ int generate_alert(const ip_tracking_t* ip_track) {
     // Also print to stdout
     printf("\n%s", alert);
     
+    free(text.data);
     return 0;
 }
 
@@ -285,24 +870,131 @@ int add_service_config(const char* name, const char* log_path) {
     strncpy(config->log_path, log_path, MAX_LOG_LINE - 1);
     config->log_path[MAX_LOG_LINE - 1] = '\0';
     config->enabled = true;
+    log_cursor_reset(&config->cursor);
     
     return 0;
 }
 
+// Cursor file format, one service per line: name|inode|offset|fingerprint|fingerprint_len
+// An export only - cursors are resumed from the state snapshot, with the
+// tracking they fed (see restore_state())
+int save_service_cursors(const char* cursor_file) {
+    // Write to a temp file and rename, so a crash never leaves half a cursor file
+    char tmp_path[600];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", cursor_file);
+    
+    FILE* f = fopen(tmp_path, "w");
+    if (!f) {
+        log_event_level(LOG_WARN, "Failed to write quorum cursor file");
+        return -1;
+    }
+    
+    fprintf(f, "# CERBERUS quorum read cursors - name|inode|offset|fingerprint|fingerprint_len\n");
+    for (int i = 0; i < service_count; i++) {
+        const log_cursor_t* cursor = &service_configs[i].cursor;
+        fprintf(f, "%s|%llu|%llu|%u|%u\n",
+                service_configs[i].name,
+                (unsigned long long)cursor->inode,
+                (unsigned long long)cursor->offset,
+                cursor->fingerprint,
+                cursor->fingerprint_len);
+    }
+    
+    if (fclose(f) != 0 || rename(tmp_path, cursor_file) != 0) {
+        remove(tmp_path);
+        return -1;
+    }
+    return 0;
+}
+
+static quorum_state_t current_state(void) {
+    quorum_state_t state = {
+        .ips = &ip_table,
+        .services = service_configs,
+        .service_count = service_count,
+        .window_seconds = window_seconds,
+        .window_count = window_count,
+    };
+    return state;
+}
+
+/**
+ * Restore tracking, profiles and cursors from the binary snapshot
+ * 
+ * Cursors are only worth resuming together with the tracking they fed:
+ * skipping the lines already read but starting from an empty IP table
+ * would forget every hit from earlier runs, and an IP seen by one service
+ * last run and another this run would never correlate. So without a usable
+ * snapshot every log is rescanned from the start, and the text cursor file
+ * is never loaded.
+ */
+static void restore_state(void) {
+    ensure_ip_table();
+    
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    quorum_state_t state = current_state();
+    int restored = quorum_state_load(state_file_path, &state);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    
+    if (restored < 0) {
+        log_event_level(LOG_INFO, "No usable state snapshot - rescanning logs from the start");
+        return;
+    }
+    
+    double ms = (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6;
+    char msg[640];
+    snprintf(msg, sizeof(msg), "Restored %d tracked IP(s) from %s in %.1f ms",
+             restored, state_file_path, ms);
+    log_event_level(LOG_INFO, msg);
+    last_snapshot = time(NULL);
+}
+
+// Persist everything; the text cursor file is an export for tools that read it
+static void save_state(void) {
+    save_service_cursors(cursor_file_path);
+    quorum_state_t state = current_state();
+    if (quorum_state_save(state_file_path, &state) == 0) {
+        state_dirty = false;
+        last_snapshot = time(NULL);
+    }
+}
+
 int get_tracked_ip_count(void) {
-    return ip_count;
+    return ip_table.count;
 }
 
 ip_tracking_t* get_tracked_ip(int index) {
-    if (index < 0 || index >= ip_count) {
-        return NULL;
-    }
-    return &ip_tracking[index];
+    return ip_table_get(&ip_table, index);
+}
+
+/**
+ * Re-assess the threat from attacker profiles whenever new events arrived
+ * Assessment only - adaptive responses are left to the operator for now.
+ */
+static void assess_attackers(void) {
+    attacker_profile_t** profiles;
+    int count = get_attacker_profiles(&profiles);
+    if (count == 0 || !attackers_changed) return;
+    attackers_changed = false;
+    
+    detect_coordination(profiles, count);
+    
+    threat_assessment_t* threat = assess_threat_level(profiles, count);
+    if (!threat) return;
+    
+    char msg[256];
+    snprintf(msg, sizeof(msg), "Threat level %.2f: %u profiled attacker(s), %u coordinated pair(s)%s",
+             threat->overall_threat_level, threat->total_unique_attackers,
+             threat->coordinated_attack_count,
+             threat->should_trigger_rapid_morph ? " - rapid morph recommended" : "");
+    log_event_level(threat->should_trigger_rapid_morph ? LOG_WARN : LOG_INFO, msg);
+    free(threat);
 }
 
 int run_quorum_logic(void) {
-    // Clear previous tracking (or implement time-based expiration)
-    // For now, we'll accumulate across runs
+    // Tracking lives for the lifetime of the process: one pass in timer mode,
+    // the whole session in follow mode. Each pass only reads new log bytes.
     
     // Scan logs
     scan_logs_for_ips();
@@ -310,23 +1002,229 @@ int run_quorum_logic(void) {
     // Detect coordinated attacks
     int alert_count = detect_coordinated_attacks();
     
+    assess_attackers();
+    
     return alert_count;
 }
 
+static void handle_stop_signal(int sig) {
+    (void)sig;
+    keep_following = 0;
+}
+
+// Apply a --window list; returns -1 if it is malformed
+static int set_windows(const char* spec) {
+    int count = parse_window_list(spec, window_seconds, MAX_WINDOWS);
+    if (count < 0) return -1;
+    window_count = count;
+    return 0;
+}
+
+/**
+ * Follow mode - stay resident and rescan whenever a log directory changes
+ *
+ * Watching the directory instead of the file means we also see logrotate
+ * creating a fresh log, and logs that don't exist yet when we start.
+ *
+ * A resident daemon can't use the one-shot rule ("two services, ever"):
+ * after a week every scanner on the internet qualifies. Detection switches
+ * to sliding windows over event time, and IPs idle for longer than the
+ * widest window are dropped, so memory stays bounded by the table size.
+ */
+static void apply_follow_defaults(void) {
+    if (window_count == 0) {
+        set_windows(DEFAULT_WINDOWS);
+    }
+    if (ip_ttl_seconds <= 0) {
+        ip_ttl_seconds = window_seconds[window_count - 1];
+    }
+}
+
+int run_follow_mode(void) {
+    follow_mode = true;
+    ensure_default_services();
+    apply_follow_defaults();
+    
+    char windows[64] = {0};
+    for (int w = 0; w < window_count; w++) {
+        char label[16];
+        format_duration(window_seconds[w], label, sizeof(label));
+        if (windows[0]) strcat(windows, ", ");
+        strcat(windows, label);
+    }
+    char window_msg[128];
+    snprintf(window_msg, sizeof(window_msg), "Sliding detection windows: %s", windows);
+    log_event_level(LOG_INFO, window_msg);
+    
+    int inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd < 0) {
+        log_event_level(LOG_WARN, "inotify unavailable, falling back to polling");
+    } else {
+        for (int i = 0; i < service_count; i++) {
+            char dir[MAX_LOG_LINE];
+            strncpy(dir, service_configs[i].log_path, sizeof(dir) - 1);
+            dir[sizeof(dir) - 1] = '\0';
+            
+            const char* watch_dir = dirname(dir);
+            if (inotify_add_watch(inotify_fd, watch_dir,
+                                  IN_MODIFY | IN_CREATE | IN_MOVED_TO | IN_CLOSE_WRITE) < 0) {
+                char msg[MAX_LOG_LINE + 64];
+                snprintf(msg, sizeof(msg), "Cannot watch %s, polling it instead", watch_dir);
+                log_event_level(LOG_WARN, msg);
+            }
+        }
+    }
+    
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = handle_stop_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    
+    log_event_level(LOG_INFO, "Follow mode: watching service logs for new entries");
+    
+    int total_alerts = 0;
+    while (keep_following) {
+        total_alerts += run_quorum_logic();
+        save_service_cursors(cursor_file_path);
+        if (state_dirty && time(NULL) - last_snapshot >= SNAPSHOT_INTERVAL_SECONDS) {
+            save_state();
+        }
+        
+        if (inotify_fd < 0) {
+            poll(NULL, 0, FOLLOW_POLL_INTERVAL_MS);
+            continue;
+        }
+        
+        struct pollfd pfd = { .fd = inotify_fd, .events = POLLIN };
+        int ready = poll(&pfd, 1, FOLLOW_POLL_INTERVAL_MS);
+        if (ready < 0 && errno != EINTR) {
+            log_event_level(LOG_ERROR, "poll() failed in follow mode");
+            break;
+        }
+        
+        // Drain the event queue - we rescan everything anyway, so the
+        // individual events only matter as a wakeup
+        char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+        while (read(inotify_fd, events, sizeof(events)) > 0) {
+        }
+    }
+    
+    if (inotify_fd >= 0) close(inotify_fd);
+    save_state();
+    
+    char msg[256];
+    snprintf(msg, sizeof(msg), "Follow mode stopped. Alerts raised: %d", total_alerts);
+    log_event_level(LOG_INFO, msg);
+    return total_alerts;
+}
+
+static void print_usage(const char* prog) {
+    printf("Usage: %s [--follow|--daemon] [--full-rescan] [--cursor-file PATH] [--state PATH] [--max-ips N] "
+           "[--ip-ttl SECONDS] [--threads N] [--window LIST] [--signatures PATH] [service_config]\n", prog);
+    printf("  --follow          Stay resident and process new log lines as they arrive\n");
+    printf("  --daemon          Same as --follow\n");
+    printf("  --full-rescan     Ignore saved state and parse every log from the start\n");
+    printf("  --cursor-file     Text export of the read positions; never read back, resuming\n"
+           "                    uses --state (default: %s)\n", cursor_file_path);
+    printf("  --signatures      Attack signature file, name|severity|signature per line "
+           "(default: %s)\n", signature_file_path);
+    printf("  --state           Snapshot of tracked IPs, profiles and cursors (default: %s)\n",
+           state_file_path);
+    printf("  --max-ips         Distinct IPs tracked before the least recently seen is "
+           "evicted (default: %d)\n", DEFAULT_IP_CAPACITY);
+    printf("  --ip-ttl          Forget IPs not seen for this many seconds (default: never, "
+           "or the widest window when following)\n");
+    printf("  --threads         Parse logs on up to N threads when a pass has a lot of new data "
+           "(default: 1)\n");
+    printf("  --window          Alert when an IP hits 2+ services within any of these windows, "
+           "e.g. 5m,1h,24h\n"
+           "                    (default when following: %s; otherwise services ever seen)\n",
+           DEFAULT_WINDOWS);
+}
+
 int main(int argc, char* argv[]) {
     printf("Bio-Adaptive IoT Honeynet Quorum Engine\n");
     
+    const char* config_file = NULL;
+    bool follow = false;
+    bool full_rescan = false;
+    
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--follow") == 0 || strcmp(argv[i], "--daemon") == 0) {
+            follow = true;
+        } else if (strcmp(argv[i], "--full-rescan") == 0) {
+            full_rescan = true;
+        } else if (strcmp(argv[i], "--cursor-file") == 0 && i + 1 < argc) {
+            strncpy(cursor_file_path, argv[++i], sizeof(cursor_file_path) - 1);
+        } else if (strcmp(argv[i], "--signatures") == 0 && i + 1 < argc) {
+            strncpy(signature_file_path, argv[++i], sizeof(signature_file_path) - 1);
+        } else if (strcmp(argv[i], "--state") == 0 && i + 1 < argc) {
+            strncpy(state_file_path, argv[++i], sizeof(state_file_path) - 1);
+        } else if (strcmp(argv[i], "--max-ips") == 0 && i + 1 < argc) {
+            max_tracked_ips = atoi(argv[++i]);
+            if (max_tracked_ips <= 0) {
+                fprintf(stderr, "--max-ips must be a positive number\n");
+                return 2;
+            }
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            scan_threads = atoi(argv[++i]);
+            if (scan_threads < 1 || scan_threads > 64) {
+                fprintf(stderr, "--threads must be between 1 and 64\n");
+                return 2;
+            }
+        } else if (strcmp(argv[i], "--ip-ttl") == 0 && i + 1 < argc) {
+            ip_ttl_seconds = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--window") == 0 && i + 1 < argc) {
+            if (set_windows(argv[++i]) != 0) {
+                fprintf(stderr, "--window takes up to %d durations like 5m,1h,24h\n", MAX_WINDOWS);
+                return 2;
+            }
+        } else if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0) {
+            print_usage(argv[0]);
+            return 0;
+        } else {
+            config_file = argv[i];
+        }
+    }
+    
     // Load service configs if provided
-    if (argc > 1) {
-        load_service_configs(argv[1]);
+    if (config_file) {
+        load_service_configs(config_file);
+    }
+    ensure_default_services();
+    
+    // Compiled once, before any scan thread can match against it
+    load_attack_signatures(signature_file_path);
+    
+    // Windows must be known before the snapshot is restored
+    if (follow) {
+        apply_follow_defaults();
+    }
+    
+    // Resume from where the previous run stopped
+    if (!full_rescan) {
+        restore_state();
+    }
+    
+    if (follow) {
+        run_follow_mode();
+        ip_table_free(&ip_table);
+        reset_attacker_registry();
+        free_attack_signatures();
+        return 0;
     }
     
     time_t now = time(NULL);
     printf("Quorum check: Checking logs at %s", ctime(&now));
     
     int alert_count = run_quorum_logic();
+    save_state();
+    ip_table_free(&ip_table);
+    reset_attacker_registry();
+    free_attack_signatures();
     
     printf("\nQuorum check complete. Alerts: %d\n", alert_count);
     
     return (alert_count > 0) ? 1 : 0;
-}
\ No newline at end of file
+}
@@ -14,12 +14,15 @@
  * This module IS that security guard for our honeypot.
  */
 
+#define _GNU_SOURCE  // strcasestr
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <pthread.h>
 #include <sys/stat.h>
 #include "quorum_adapt.h"
+#include "aho_corasick.h"
 #include "utils.h"
 
 // Signal file paths - these are how quorum tells morph "hey, do something!"
@@ -28,8 +31,7 @@
 #define MORPH_FREQUENCY_FILE "build/signals/morph_frequency.conf"
 #define ATTACKER_BLOCKLIST "build/signals/attacker_blocklist.txt"
 
-// Known attack signatures (reserved for future pattern matching)
-__attribute__((unused))
+// Built-in attack signatures, used when no signature file is available
 static const char* brute_force_signatures[] = {
     "Failed password for",
     "Invalid user",
@@ -37,7 +39,6 @@ static const char* brute_force_signatures[] = {
     "Connection refused"
 };
 
-__attribute__((unused))
 static const char* exploitation_signatures[] = {
     "buffer overflow",
     "injection",
@@ -46,7 +47,6 @@ static const char* exploitation_signatures[] = {
     "privilege escalation"
 };
 
-__attribute__((unused))
 static const char* reconnaissance_signatures[] = {
     "nmap",
     "masscan",
@@ -56,6 +56,47 @@ static const char* reconnaissance_signatures[] = {
     "service discovery"
 };
 
+#define SIGNATURE_COUNT(list) (sizeof(list) / sizeof((list)[0]))
+
+static const struct {
+    const char* name;
+    uint32_t severity;
+    const char** signatures;
+    size_t count;
+} builtin_signature_sets[] = {
+    { "brute_force",    4, brute_force_signatures,    SIGNATURE_COUNT(brute_force_signatures) },
+    { "exploitation",   9, exploitation_signatures,   SIGNATURE_COUNT(exploitation_signatures) },
+    { "reconnaissance", 3, reconnaissance_signatures, SIGNATURE_COUNT(reconnaissance_signatures) },
+};
+
+// Signature matcher: every signature belongs to a named group, and each
+// group becomes an attack pattern in the registry when it first matches
+typedef struct {
+    char name[MAX_SIGNATURE_NAME];
+    uint32_t severity;
+} signature_group_t;
+
+static ac_automaton_t signature_matcher;
+static signature_group_t signature_groups[AC_MAX_GROUPS];
+static int signature_group_count = 0;
+static bool signatures_loaded = false;
+static pthread_once_t builtin_signatures_once = PTHREAD_ONCE_INIT;
+
+// Attacker registry: profiles indexed by IP through a chained hash that
+// doubles with the profile count, so a botnet wave doesn't degrade lookups
+#define ATTACKER_INITIAL_CAPACITY 256
+
+static attacker_profile_t** attackers = NULL;
+static int* attacker_next = NULL;      // Next profile in the same bucket, -1 = end
+static int* attacker_buckets = NULL;
+static int attacker_bucket_count = 0;  // Power of two, >= attacker_capacity
+static int attacker_capacity = 0;
+static int attacker_count = 0;
+static bool attacker_full_logged = false;
+
+static attack_pattern_t* patterns[MAX_ATTACK_PATTERNS];
+static int pattern_count = 0;
+
 // Current threat metrics
 static uint32_t current_morph_frequency_minutes = 360;  // Default: 6 hours
 static uint32_t current_command_delay_ms = 0;           // Default: none
@@ -85,7 +126,7 @@ attacker_profile_t* create_attacker_profile(const char* ip) {
     if (!profile) return NULL;
 
     memset(profile, 0, sizeof(attacker_profile_t));
-    if (ip) strncpy(profile->ip_address, ip, 31);
+    if (ip) strncpy(profile->ip_address, ip, sizeof(profile->ip_address) - 1);
     profile->first_contact = time(NULL);
     profile->last_contact = time(NULL);
 
@@ -118,31 +159,110 @@ float calculate_threat_score(attacker_profile_t* attacker) {
     return score > 1.0f ? 1.0f : score;
 }
 
+/* ============================================================================
+ * Coordination detection
+ * ============================================================================ */
+
+// What two sources have in common
+typedef enum {
+    SHARED_PATTERNS = 0,
+    SHARED_CREDENTIALS,
+    SHARED_COMMANDS
+} shared_trait_t;
+
+static const char* const shared_trait_names[] = {
+    "attack pattern set",
+    "credential list",
+    "command sequence"
+};
+
+typedef struct {
+    uint64_t key;   // Pattern mask or fingerprint hash
+    time_t when;
+    int index;      // Into the attackers array
+    shared_trait_t trait;
+} trait_record_t;
+
+static int compare_trait_records(const void* a, const void* b) {
+    const trait_record_t* x = (const trait_record_t*)a;
+    const trait_record_t* y = (const trait_record_t*)b;
+    if (x->trait != y->trait) return x->trait < y->trait ? -1 : 1;
+    if (x->key != y->key) return x->key < y->key ? -1 : 1;
+    if (x->when != y->when) return x->when < y->when ? -1 : 1;
+    return (x->index > y->index) - (x->index < y->index);
+}
+
+// Mark one wave of look-alike sources; only waves with new members are logged
+static void mark_wave(attacker_profile_t** attackers, const trait_record_t* wave, int size) {
+    int newly_marked = 0;
+    for (int i = 0; i < size; i++) {
+        attacker_profile_t* attacker = attackers[wave[i].index];
+        if (!attacker->is_coordinated) {
+            attacker->is_coordinated = true;
+            newly_marked++;
+        }
+    }
+    if (newly_marked == 0) return;
+
+    char msg[256];
+    snprintf(msg, sizeof(msg),
+             "Coordinated attack detected: %d sources sharing the same %s within %d s (%s ... %s)",
+             size, shared_trait_names[wave[0].trait], COORDINATION_WINDOW,
+             attackers[wave[0].index]->ip_address, attackers[wave[size - 1].index]->ip_address);
+    log_event_level(LOG_WARN, msg);
+}
+
 /**
  * Detect if attackers are working together
+ *
+ * Two sources are coordinated when they share a trait - the same set of
+ * attack patterns, the same credential list or the same command sequence -
+ * and were last active less than COORDINATION_WINDOW seconds apart.
+ *
+ * Comparing every pair was quadratic, which a botnet wave of a few thousand
+ * sources turns into millions of comparisons per pass. Instead each source
+ * contributes one record per trait; sorting by (trait, key, time) puts
+ * look-alikes next to each other in time order, and one sweep finds runs
+ * whose neighbours are within the window. O(n log n) overall.
  */
 void detect_coordination(attacker_profile_t** attackers, int attacker_count) {
     if (!attackers || attacker_count < 2) return;
 
-    // Look for similar patterns happening at similar times
+    trait_record_t* records = malloc((size_t)attacker_count * 3 * sizeof(trait_record_t));
+    if (!records) {
+        log_event_level(LOG_ERROR, "Out of memory while checking for coordinated attackers");
+        return;
+    }
+
+    int n = 0;
     for (int i = 0; i < attacker_count; i++) {
-        for (int j = i + 1; j < attacker_count; j++) {
-            // Check if patterns overlap in time (within 5 minutes)
-            time_t time_diff = abs((int)(attackers[i]->last_contact - attackers[j]->last_contact));
-            
-            // Similar pattern types and close timing = coordinated
-            if (time_diff < 300 && attackers[i]->pattern_count > 0 && 
-                attackers[j]->pattern_count > 0) {
-                attackers[i]->is_coordinated = true;
-                attackers[j]->is_coordinated = true;
-
-                char msg[256];
-                snprintf(msg, sizeof(msg), "Coordinated attack detected: %s and %s",
-                         attackers[i]->ip_address, attackers[j]->ip_address);
-                log_event_level(LOG_WARN, msg);
-            }
+        const attacker_profile_t* a = attackers[i];
+        if (a->pattern_mask) {
+            records[n++] = (trait_record_t){ a->pattern_mask, a->last_contact, i, SHARED_PATTERNS };
+        }
+        if (a->credential_hash) {
+            records[n++] = (trait_record_t){ a->credential_hash, a->last_contact, i, SHARED_CREDENTIALS };
+        }
+        if (a->command_hash) {
+            records[n++] = (trait_record_t){ a->command_hash, a->last_contact, i, SHARED_COMMANDS };
+        }
+    }
+    qsort(records, (size_t)n, sizeof(trait_record_t), compare_trait_records);
+
+    int start = 0;
+    for (int i = 1; i <= n; i++) {
+        bool same_wave = i < n &&
+                         records[i].trait == records[i - 1].trait &&
+                         records[i].key == records[i - 1].key &&
+                         records[i].when - records[i - 1].when < COORDINATION_WINDOW;
+        if (same_wave) continue;
+        if (i - start >= 2) {
+            mark_wave(attackers, &records[start], i - start);
         }
+        start = i;
     }
+
+    free(records);
 }
 
 /**
@@ -229,11 +349,13 @@ void update_attack_pattern(attack_pattern_t* pattern, const char* log_entry) {
     pattern->occurrence_count++;
     pattern->last_seen = time(NULL);
 
-    // Increase severity based on frequency
-    if (pattern->occurrence_count > 100) pattern->severity = 9;
-    else if (pattern->occurrence_count > 50) pattern->severity = 8;
-    else if (pattern->occurrence_count > 20) pattern->severity = 7;
-    else if (pattern->occurrence_count > 10) pattern->severity = 6;
+    // Increase severity based on frequency, never below the signature's own rating
+    uint32_t severity = 0;
+    if (pattern->occurrence_count > 100) severity = 9;
+    else if (pattern->occurrence_count > 50) severity = 8;
+    else if (pattern->occurrence_count > 20) severity = 7;
+    else if (pattern->occurrence_count > 10) severity = 6;
+    if (severity > pattern->severity) pattern->severity = severity;
 }
 
 /**
@@ -438,6 +560,423 @@ void free_attacker_profile(attacker_profile_t* profile) {
     }
 }
 
+/* ============================================================================
+ * Attacker registry
+ * ============================================================================ */
+
+static unsigned int attacker_bucket(const char* ip) {
+    uint32_t hash = 2166136261u;
+    for (const char* p = ip; *p; p++) {
+        hash ^= (unsigned char)*p;
+        hash *= 16777619u;
+    }
+    return hash & (unsigned int)(attacker_bucket_count - 1);
+}
+
+// Rebuild the bucket chains for a new bucket count
+static int rehash_attackers(int bucket_count) {
+    int* buckets = malloc((size_t)bucket_count * sizeof(int));
+    if (!buckets) return -1;
+
+    free(attacker_buckets);
+    attacker_buckets = buckets;
+    attacker_bucket_count = bucket_count;
+    for (int i = 0; i < bucket_count; i++) {
+        attacker_buckets[i] = -1;
+    }
+    for (int i = 0; i < attacker_count; i++) {
+        unsigned int bucket = attacker_bucket(attackers[i]->ip_address);
+        attacker_next[i] = attacker_buckets[bucket];
+        attacker_buckets[bucket] = i;
+    }
+    return 0;
+}
+
+// Make room for one more profile
+static int reserve_attacker_slot(void) {
+    if (attacker_count < attacker_capacity) return 0;
+
+    int capacity = attacker_capacity ? attacker_capacity * 2 : ATTACKER_INITIAL_CAPACITY;
+    attacker_profile_t** grown = realloc(attackers, (size_t)capacity * sizeof(attacker_profile_t*));
+    if (!grown) return -1;
+    attackers = grown;
+
+    int* next = realloc(attacker_next, (size_t)capacity * sizeof(int));
+    if (!next) return -1;
+    attacker_next = next;
+
+    attacker_capacity = capacity;
+    return rehash_attackers(capacity);
+}
+
+/**
+ * Look up the profile for an IP without creating one
+ */
+attacker_profile_t* find_attacker_profile(const char* ip) {
+    if (!ip || attacker_count == 0) return NULL;
+
+    for (int i = attacker_buckets[attacker_bucket(ip)]; i >= 0; i = attacker_next[i]) {
+        if (strcmp(attackers[i]->ip_address, ip) == 0) {
+            return attackers[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Find or create the profile for an IP
+ * Returns NULL once MAX_ATTACKERS profiles exist.
+ */
+attacker_profile_t* get_attacker_profile(const char* ip) {
+    attacker_profile_t* profile = find_attacker_profile(ip);
+    if (profile || !ip) return profile;
+
+    if (attacker_count >= MAX_ATTACKERS) {
+        if (!attacker_full_logged) {
+            log_event_level(LOG_WARN, "Attacker registry full, new attackers are not profiled");
+            attacker_full_logged = true;
+        }
+        return NULL;
+    }
+
+    if (reserve_attacker_slot() != 0) return NULL;
+    profile = create_attacker_profile(ip);
+    if (!profile) return NULL;
+
+    // Contact times come from the events recorded against the profile
+    profile->first_contact = 0;
+    profile->last_contact = 0;
+
+    unsigned int bucket = attacker_bucket(ip);
+    attackers[attacker_count] = profile;
+    attacker_next[attacker_count] = attacker_buckets[bucket];
+    attacker_buckets[bucket] = attacker_count;
+    attacker_count++;
+
+    return profile;
+}
+
+int get_attacker_profiles(attacker_profile_t*** profiles) {
+    if (profiles) *profiles = attackers;
+    return attacker_count;
+}
+
+/**
+ * Find or register a named attack pattern
+ * The registry keeps its own copy of the name.
+ */
+attack_pattern_t* get_attack_pattern(const char* name) {
+    if (!name) return NULL;
+
+    for (int i = 0; i < pattern_count; i++) {
+        if (strcmp(patterns[i]->pattern_name, name) == 0) {
+            return patterns[i];
+        }
+    }
+
+    if (pattern_count >= MAX_ATTACK_PATTERNS) return NULL;
+
+    char* owned_name = strdup(name);
+    if (!owned_name) return NULL;
+    attack_pattern_t* pattern = create_attack_pattern(owned_name);
+    if (!pattern) {
+        free(owned_name);
+        return NULL;
+    }
+    patterns[pattern_count++] = pattern;
+    pattern->id = (uint32_t)pattern_count;
+    return pattern;
+}
+
+int get_attack_patterns(attack_pattern_t*** registered) {
+    if (registered) *registered = patterns;
+    return pattern_count;
+}
+
+/**
+ * Attach a pattern to an attacker (once) and count the occurrence
+ */
+void add_pattern_to_attacker(attacker_profile_t* attacker, attack_pattern_t* pattern) {
+    if (!attacker || !pattern) return;
+
+    update_attack_pattern(pattern, pattern->pattern_name);
+    if (pattern->id > 0) {
+        attacker->pattern_mask |= 1ull << (pattern->id - 1);
+    }
+
+    for (int i = 0; i < attacker->pattern_count; i++) {
+        if (attacker->patterns[i] == pattern) return;
+    }
+    if (attacker->pattern_count < 10) {
+        attacker->patterns[attacker->pattern_count++] = pattern;
+    }
+}
+
+// FNV-1a folded through a 64-bit finalizer; 0 is reserved for "none"
+static uint64_t hash_bytes(uint64_t hash, const char* text) {
+    for (const char* p = text; *p; p++) {
+        hash ^= (unsigned char)*p;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static uint64_t finalize_hash(uint64_t hash) {
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ull;
+    hash ^= hash >> 33;
+    return hash ? hash : 1;
+}
+
+uint64_t hash_credential(const char* username, const char* password) {
+    uint64_t hash = hash_bytes(14695981039346656037ull, username ? username : "");
+    hash = (hash ^ 0xff) * 1099511628211ull;  // Separator: "ab"/"c" != "a"/"bc"
+    return finalize_hash(hash_bytes(hash, password ? password : ""));
+}
+
+uint64_t hash_command(const char* command) {
+    return finalize_hash(hash_bytes(14695981039346656037ull, command ? command : ""));
+}
+
+/**
+ * Fingerprint of a set of credential hashes, the same in any order
+ * Each member is mixed on its own and the results are summed, so only the
+ * sum (not the order it was built in) reaches the final mix.
+ */
+uint64_t hash_credential_set(const uint64_t* credentials, int count) {
+    if (!credentials || count <= 0) return 0;
+    uint64_t sum = 0;
+    for (int i = 0; i < count; i++) {
+        sum += finalize_hash(credentials[i]);
+    }
+    return finalize_hash(sum);
+}
+
+/**
+ * Add one tried credential to the attacker's credential-list fingerprint
+ *
+ * The fingerprint is the set of the first MAX_PROFILE_CREDENTIALS distinct
+ * credentials, combined order-independently: bots working through the same
+ * dictionary agree even if their attempts interleave differently.
+ */
+void add_credential_to_attacker(attacker_profile_t* attacker, uint64_t credential) {
+    if (!attacker || !credential) return;
+    if (attacker->credential_count >= MAX_PROFILE_CREDENTIALS) return;
+
+    for (int i = 0; i < attacker->credential_count; i++) {
+        if (attacker->credentials[i] == credential) return;
+    }
+    attacker->credentials[attacker->credential_count++] = credential;
+    attacker->credential_hash = hash_credential_set(attacker->credentials, attacker->credential_count);
+}
+
+/**
+ * Add one command to the attacker's command-sequence fingerprint
+ * Order matters here: a dropper script runs its steps in a fixed order.
+ */
+void add_command_to_attacker(attacker_profile_t* attacker, uint64_t command) {
+    if (!attacker || !command) return;
+    if (attacker->command_count >= MAX_PROFILE_COMMANDS) return;
+
+    attacker->command_hash = finalize_hash(attacker->command_hash * 1099511628211ull ^ command);
+    attacker->command_count++;
+}
+
+/* ============================================================================
+ * Signature matching
+ * ============================================================================ */
+
+static int find_signature_group(const char* name) {
+    for (int i = 0; i < signature_group_count; i++) {
+        if (strcmp(signature_groups[i].name, name) == 0) return i;
+    }
+    return -1;
+}
+
+static int add_signature(const char* name, uint32_t severity, const char* signature) {
+    int group = find_signature_group(name);
+    if (group < 0) {
+        if (signature_group_count >= AC_MAX_GROUPS) return -1;
+        group = signature_group_count++;
+        snprintf(signature_groups[group].name, sizeof(signature_groups[group].name), "%s", name);
+    }
+    if (severity > signature_groups[group].severity) {
+        signature_groups[group].severity = severity;
+    }
+    return ac_add(&signature_matcher, signature, group);
+}
+
+static void clear_signatures(void) {
+    ac_free(&signature_matcher);
+    ac_init(&signature_matcher);
+    memset(signature_groups, 0, sizeof(signature_groups));
+    signature_group_count = 0;
+}
+
+static int load_builtin_signatures(void) {
+    clear_signatures();
+    int added = 0;
+    for (size_t s = 0; s < SIGNATURE_COUNT(builtin_signature_sets); s++) {
+        for (size_t i = 0; i < builtin_signature_sets[s].count; i++) {
+            if (add_signature(builtin_signature_sets[s].name, builtin_signature_sets[s].severity,
+                              builtin_signature_sets[s].signatures[i]) == 0) {
+                added++;
+            }
+        }
+    }
+    ac_compile(&signature_matcher);
+    signatures_loaded = true;
+    return added;
+}
+
+static void load_builtin_signatures_once(void) {
+    if (!signatures_loaded) load_builtin_signatures();
+}
+
+/**
+ * Compile the signature matcher from a file, or the built-in lists
+ *
+ * File format, one signature per line: name|severity|signature
+ * Lines starting with '#' are comments. Signatures sharing a name form one
+ * attack pattern; matching is case-insensitive.
+ *
+ * Call before scanning starts - matching is lock-free and assumes the
+ * automaton no longer changes.
+ *
+ * @return Number of signatures compiled
+ */
+int load_attack_signatures(const char* path) {
+    FILE* f = path ? fopen(path, "r") : NULL;
+    if (!f) {
+        if (path) {
+            char msg[600];
+            snprintf(msg, sizeof(msg), "Signature file %s not found, using built-in signatures", path);
+            log_event_level(LOG_DEBUG, msg);
+        }
+        return load_builtin_signatures();
+    }
+
+    clear_signatures();
+    int added = 0;
+    int line_number = 0;
+    char line[512];
+    while (fgets(line, sizeof(line), f)) {
+        line_number++;
+        trim_string(line);
+        if (line[0] == '#' || line[0] == '\0') continue;
+
+        char* name = line;
+        char* severity_text = strchr(name, '|');
+        char* signature = severity_text ? strchr(severity_text + 1, '|') : NULL;
+        if (!signature) {
+            char msg[600];
+            snprintf(msg, sizeof(msg), "%s:%d: expected name|severity|signature", path, line_number);
+            log_event_level(LOG_WARN, msg);
+            continue;
+        }
+        *severity_text++ = '\0';
+        *signature++ = '\0';
+
+        int severity = atoi(severity_text);
+        if (severity < 1) severity = 1;
+        if (severity > 10) severity = 10;
+        if (add_signature(name, (uint32_t)severity, signature) == 0) {
+            added++;
+        }
+    }
+    fclose(f);
+
+    if (added == 0) {
+        log_event_level(LOG_WARN, "Signature file has no usable signatures, using built-in signatures");
+        return load_builtin_signatures();
+    }
+
+    ac_compile(&signature_matcher);
+    signatures_loaded = true;
+
+    char msg[600];
+    snprintf(msg, sizeof(msg), "Loaded %d attack signature(s) in %d pattern(s) from %s",
+             added, signature_group_count, path);
+    log_event_level(LOG_DEBUG, msg);
+    return added;
+}
+
+/**
+ * Signature groups occurring anywhere in text, as a bitmask
+ * Thread-safe once signatures are loaded.
+ */
+uint64_t match_attack_signatures(const char* text, size_t len) {
+    pthread_once(&builtin_signatures_once, load_builtin_signatures_once);
+    return ac_match(&signature_matcher, text, len);
+}
+
+const char* get_signature_name(int group) {
+    if (group < 0 || group >= signature_group_count) return NULL;
+    return signature_groups[group].name;
+}
+
+/**
+ * Registry pattern for a signature group, created on first use
+ */
+attack_pattern_t* get_signature_pattern(int group) {
+    const char* name = get_signature_name(group);
+    if (!name) return NULL;
+
+    attack_pattern_t* pattern = get_attack_pattern(name);
+    if (pattern && pattern->severity < signature_groups[group].severity) {
+        pattern->severity = signature_groups[group].severity;
+    }
+    return pattern;
+}
+
+void free_attack_signatures(void) {
+    clear_signatures();
+    signatures_loaded = false;
+}
+
+/**
+ * Map a shell command typed into the honeypot to a pattern name
+ * The most severe matching signature group wins. Returns NULL if the
+ * command matches no known signature.
+ */
+const char* classify_command(const char* command) {
+    if (!command) return NULL;
+
+    uint64_t hits = match_attack_signatures(command, strlen(command));
+    int best = -1;
+    while (hits) {
+        int group = __builtin_ctzll(hits);
+        hits &= hits - 1;
+        if (best < 0 || signature_groups[group].severity > signature_groups[best].severity) {
+            best = group;
+        }
+    }
+    return best >= 0 ? signature_groups[best].name : NULL;
+}
+
+void reset_attacker_registry(void) {
+    for (int i = 0; i < attacker_count; i++) {
+        free_attacker_profile(attackers[i]);
+    }
+    for (int i = 0; i < pattern_count; i++) {
+        free((char*)patterns[i]->pattern_name);
+        free_attack_pattern(patterns[i]);
+    }
+    free(attackers);
+    free(attacker_next);
+    free(attacker_buckets);
+    attackers = NULL;
+    attacker_next = NULL;
+    attacker_buckets = NULL;
+    attacker_bucket_count = 0;
+    attacker_capacity = 0;
+    attacker_count = 0;
+    pattern_count = 0;
+    attacker_full_logged = false;
+}
+
 /**
  * Export current threat metrics
  */
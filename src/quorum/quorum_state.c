@@ -0,0 +1,456 @@
+/**
+ * quorum_state.c - Binary snapshot of the quorum engine's memory
+ *
+ * Without a snapshot, every restart of the quorum service forgot which IPs
+ * it had seen where, so an attacker who hit cowrie before the restart and
+ * the router after it was never correlated. Rebuilding that history meant
+ * rescanning every log from the start.
+ *
+ * The snapshot holds the IP tracking table (in LRU order, so eviction
+ * order survives), the attacker profiles and patterns, and the per-service
+ * read cursors. Records are fixed-size, so loading is one mmap() and a
+ * linear walk - restoring 65536 IPs takes a few milliseconds.
+ *
+ * FILE LAYOUT (native byte order, checked on load):
+ *   header | services[] | patterns[] | ips[] | profiles[] | checksum
+ *
+ * The header records the format version and each record size; a snapshot
+ * from a different build layout is ignored rather than misread. The
+ * trailing checksum catches truncated or damaged files. Writes go to a
+ * temp file that is fsync'd and renamed over the old snapshot, so a crash
+ * leaves either the old or the new snapshot, never half of one.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "quorum_state.h"
+#include "quorum_adapt.h"
+#include "utils.h"
+
+#define SNAPSHOT_MAGIC "CERBQST"   // 8 bytes with the terminator
+#define SNAPSHOT_ENDIAN 0x01020304u
+#define MAX_PATTERN_NAME 64
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t endian;
+    int64_t saved_at;
+    uint32_t service_count;
+    uint32_t pattern_count;
+    uint32_t ip_count;
+    uint32_t profile_count;
+    uint32_t window_count;
+    int32_t window_seconds[MAX_WINDOWS];
+    uint32_t service_size;   // Record sizes guard against layout changes
+    uint32_t pattern_size;
+    uint32_t ip_size;
+    uint32_t profile_size;
+} snapshot_header_t;
+
+typedef struct {
+    char name[MAX_SERVICE_NAME];
+    uint64_t inode;
+    int64_t offset;
+    uint32_t fingerprint;
+    uint32_t fingerprint_len;
+} snapshot_service_t;
+
+typedef struct {
+    char name[MAX_PATTERN_NAME];
+    uint32_t severity;
+    uint32_t occurrence_count;
+    int64_t first_seen;
+    int64_t last_seen;
+} snapshot_pattern_t;
+
+typedef struct {
+    uint8_t addr[16];
+    uint32_t service_mask;   // Bits index the snapshot's service records
+    int32_t hit_count;
+    int64_t first_seen;
+    int64_t last_seen;
+    int64_t service_seen[MAX_SERVICES];
+    hit_ring_t windows[MAX_WINDOWS];
+    uint8_t alerted;
+    uint8_t window_alerted;
+    uint8_t reserved[6];
+} snapshot_ip_t;
+
+typedef struct {
+    char ip[MAX_IP_STRING];
+    uint8_t is_coordinated;
+    uint8_t pattern_count;
+    uint32_t total_attempts;
+    uint32_t failed_attempts;
+    uint32_t successful_exploits;
+    int64_t first_contact;
+    int64_t last_contact;
+    uint8_t patterns[10];    // Indexes the snapshot's pattern records
+    uint8_t credential_count;
+    uint8_t command_count;
+    uint64_t credentials[MAX_PROFILE_CREDENTIALS];
+    uint64_t credential_hash;
+    uint64_t command_hash;
+} snapshot_profile_t;
+
+/* ============================================================================
+ * Checksum
+ * ============================================================================ */
+
+// Word-at-a-time FNV variant; the snapshot can be tens of megabytes
+static uint64_t checksum_update(uint64_t hash, const void* data, size_t len) {
+    const unsigned char* p = (const unsigned char*)data;
+    while (len >= 8) {
+        uint64_t word;
+        memcpy(&word, p, 8);
+        hash = (hash ^ word) * 1099511628211ull;
+        p += 8;
+        len -= 8;
+    }
+    while (len-- > 0) {
+        hash = (hash ^ *p++) * 1099511628211ull;
+    }
+    return hash;
+}
+
+#define CHECKSUM_SEED 14695981039346656037ull
+
+typedef struct {
+    FILE* f;
+    uint64_t checksum;
+    bool failed;
+} snapshot_writer_t;
+
+static void write_record(snapshot_writer_t* w, const void* data, size_t size) {
+    if (w->failed) return;
+    if (fwrite(data, size, 1, w->f) != 1) {
+        w->failed = true;
+        return;
+    }
+    w->checksum = checksum_update(w->checksum, data, size);
+}
+
+/* ============================================================================
+ * Save
+ * ============================================================================ */
+
+static void fill_header(snapshot_header_t* header, const quorum_state_t* state,
+                        int pattern_count, int profile_count) {
+    memset(header, 0, sizeof(snapshot_header_t));
+    memcpy(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic));
+    header->version = QUORUM_STATE_VERSION;
+    header->endian = SNAPSHOT_ENDIAN;
+    header->saved_at = (int64_t)time(NULL);
+    header->service_count = (uint32_t)state->service_count;
+    header->pattern_count = (uint32_t)pattern_count;
+    header->ip_count = (uint32_t)state->ips->count;
+    header->profile_count = (uint32_t)profile_count;
+    header->window_count = (uint32_t)state->window_count;
+    for (int w = 0; w < state->window_count; w++) {
+        header->window_seconds[w] = state->window_seconds[w];
+    }
+    header->service_size = sizeof(snapshot_service_t);
+    header->pattern_size = sizeof(snapshot_pattern_t);
+    header->ip_size = sizeof(snapshot_ip_t);
+    header->profile_size = sizeof(snapshot_profile_t);
+}
+
+static void write_ip(snapshot_writer_t* w, const ip_tracking_t* entry) {
+    snapshot_ip_t record;
+    memset(&record, 0, sizeof(record));
+    memcpy(record.addr, entry->addr.bytes, sizeof(record.addr));
+    record.service_mask = entry->service_mask;
+    record.hit_count = entry->hit_count;
+    record.first_seen = entry->first_seen;
+    record.last_seen = entry->last_seen;
+    for (int s = 0; s < MAX_SERVICES; s++) {
+        record.service_seen[s] = entry->service_seen[s];
+    }
+    memcpy(record.windows, entry->windows, sizeof(record.windows));
+    record.alerted = entry->alerted;
+    record.window_alerted = entry->window_alerted;
+    write_record(w, &record, sizeof(record));
+}
+
+static void write_profile(snapshot_writer_t* w, const attacker_profile_t* profile) {
+    snapshot_profile_t record;
+    memset(&record, 0, sizeof(record));
+    memcpy(record.ip, profile->ip_address, sizeof(record.ip));
+    record.is_coordinated = profile->is_coordinated;
+    record.total_attempts = profile->total_attempts;
+    record.failed_attempts = profile->failed_attempts;
+    record.successful_exploits = profile->successful_exploits;
+    record.first_contact = profile->first_contact;
+    record.last_contact = profile->last_contact;
+
+    // Only registry patterns can be named again on load
+    for (int i = 0; i < profile->pattern_count; i++) {
+        const attack_pattern_t* pattern = profile->patterns[i];
+        if (pattern && pattern->id > 0) {
+            record.patterns[record.pattern_count++] = (uint8_t)(pattern->id - 1);
+        }
+    }
+
+    record.credential_count = (uint8_t)profile->credential_count;
+    memcpy(record.credentials, profile->credentials, sizeof(record.credentials));
+    record.credential_hash = profile->credential_hash;
+    record.command_count = (uint8_t)profile->command_count;
+    record.command_hash = profile->command_hash;
+    write_record(w, &record, sizeof(record));
+}
+
+int quorum_state_save(const char* path, const quorum_state_t* state) {
+    if (!path || !state || !state->ips) return -1;
+
+    attacker_profile_t** profiles;
+    attack_pattern_t** patterns;
+    int profile_count = get_attacker_profiles(&profiles);
+    int pattern_count = get_attack_patterns(&patterns);
+
+    char tmp_path[600];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    FILE* f = fopen(tmp_path, "wb");
+    if (!f) {
+        log_event_level(LOG_WARN, "Failed to write quorum state snapshot");
+        return -1;
+    }
+
+    snapshot_writer_t w = { f, CHECKSUM_SEED, false };
+    snapshot_header_t header;
+    fill_header(&header, state, pattern_count, profile_count);
+    write_record(&w, &header, sizeof(header));
+
+    for (int i = 0; i < state->service_count; i++) {
+        const service_config_t* config = &state->services[i];
+        snapshot_service_t record;
+        memset(&record, 0, sizeof(record));
+        snprintf(record.name, sizeof(record.name), "%s", config->name);
+        record.inode = (uint64_t)config->cursor.inode;
+        record.offset = (int64_t)config->cursor.offset;
+        record.fingerprint = config->cursor.fingerprint;
+        record.fingerprint_len = config->cursor.fingerprint_len;
+        write_record(&w, &record, sizeof(record));
+    }
+
+    for (int i = 0; i < pattern_count; i++) {
+        snapshot_pattern_t record;
+        memset(&record, 0, sizeof(record));
+        snprintf(record.name, sizeof(record.name), "%s", patterns[i]->pattern_name);
+        record.severity = patterns[i]->severity;
+        record.occurrence_count = patterns[i]->occurrence_count;
+        record.first_seen = patterns[i]->first_seen;
+        record.last_seen = patterns[i]->last_seen;
+        write_record(&w, &record, sizeof(record));
+    }
+
+    // Least recently seen first, so re-inserting in file order rebuilds the LRU list
+    const ip_table_t* ips = state->ips;
+    for (int32_t i = ips->lru_tail; i >= 0; i = ips->entries[i].lru_prev) {
+        write_ip(&w, &ips->entries[i]);
+    }
+
+    for (int i = 0; i < profile_count; i++) {
+        write_profile(&w, profiles[i]);
+    }
+
+    uint64_t checksum = w.checksum;
+    if (!w.failed && fwrite(&checksum, sizeof(checksum), 1, f) != 1) {
+        w.failed = true;
+    }
+    if (!w.failed && (fflush(f) != 0 || fsync(fileno(f)) != 0)) {
+        w.failed = true;
+    }
+    if (fclose(f) != 0 || w.failed || rename(tmp_path, path) != 0) {
+        remove(tmp_path);
+        log_event_level(LOG_WARN, "Failed to write quorum state snapshot");
+        return -1;
+    }
+    return 0;
+}
+
+/* ============================================================================
+ * Load
+ * ============================================================================ */
+
+static const char* validate(const unsigned char* data, size_t size, const snapshot_header_t** out) {
+    if (size < sizeof(snapshot_header_t) + sizeof(uint64_t)) return "file too short";
+
+    const snapshot_header_t* header = (const snapshot_header_t*)data;
+    if (memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) != 0) return "not a snapshot";
+    if (header->version != QUORUM_STATE_VERSION) return "unsupported version";
+    if (header->endian != SNAPSHOT_ENDIAN) return "written on another architecture";
+    if (header->service_size != sizeof(snapshot_service_t) ||
+        header->pattern_size != sizeof(snapshot_pattern_t) ||
+        header->ip_size != sizeof(snapshot_ip_t) ||
+        header->profile_size != sizeof(snapshot_profile_t)) {
+        return "record layout differs from this build";
+    }
+    if (header->service_count > MAX_SERVICES || header->pattern_count > MAX_ATTACK_PATTERNS ||
+        header->window_count > MAX_WINDOWS) {
+        return "counts out of range";
+    }
+
+    uint64_t expected = sizeof(snapshot_header_t) +
+                        (uint64_t)header->service_count * sizeof(snapshot_service_t) +
+                        (uint64_t)header->pattern_count * sizeof(snapshot_pattern_t) +
+                        (uint64_t)header->ip_count * sizeof(snapshot_ip_t) +
+                        (uint64_t)header->profile_count * sizeof(snapshot_profile_t);
+    if (expected + sizeof(uint64_t) != size) return "size does not match header";
+
+    uint64_t stored;
+    memcpy(&stored, data + expected, sizeof(stored));
+    if (checksum_update(CHECKSUM_SEED, data, expected) != stored) return "checksum mismatch";
+
+    *out = header;
+    return NULL;
+}
+
+static bool same_windows(const snapshot_header_t* header, const quorum_state_t* state) {
+    if ((int)header->window_count != state->window_count) return false;
+    for (int w = 0; w < state->window_count; w++) {
+        if (header->window_seconds[w] != state->window_seconds[w]) return false;
+    }
+    return true;
+}
+
+static void restore_ip(quorum_state_t* state, const snapshot_ip_t* record,
+                       const int* service_map, int service_count, bool keep_windows) {
+    ip_addr_t addr;
+    memcpy(addr.bytes, record->addr, sizeof(addr.bytes));
+    ip_tracking_t* entry = ip_table_touch(state->ips, &addr, (time_t)record->first_seen, NULL);
+    if (!entry) return;
+
+    // Service positions may have changed since the snapshot was taken
+    for (int s = 0; s < service_count; s++) {
+        int current = service_map[s];
+        if (current < 0 || !(record->service_mask & (1u << s))) continue;
+        entry->service_mask |= 1u << current;
+        entry->service_seen[current] = (time_t)record->service_seen[s];
+    }
+    entry->service_count = __builtin_popcount(entry->service_mask);
+    entry->hit_count = record->hit_count;
+    entry->first_seen = (time_t)record->first_seen;
+    entry->last_seen = (time_t)record->last_seen;
+    entry->alerted = record->alerted != 0;
+    if (keep_windows) {
+        memcpy(entry->windows, record->windows, sizeof(entry->windows));
+        entry->window_alerted = record->window_alerted;
+    }
+}
+
+static void restore_profile(const snapshot_profile_t* record, attack_pattern_t** patterns,
+                            int pattern_count) {
+    char ip[MAX_IP_STRING];
+    memcpy(ip, record->ip, sizeof(ip));
+    ip[sizeof(ip) - 1] = '\0';
+
+    attacker_profile_t* profile = get_attacker_profile(ip);
+    if (!profile) return;
+
+    profile->is_coordinated = record->is_coordinated != 0;
+    profile->total_attempts = record->total_attempts;
+    profile->failed_attempts = record->failed_attempts;
+    profile->successful_exploits = record->successful_exploits;
+    profile->first_contact = (time_t)record->first_contact;
+    profile->last_contact = (time_t)record->last_contact;
+
+    for (int i = 0; i < record->pattern_count && i < 10; i++) {
+        int index = record->patterns[i];
+        if (index < pattern_count && patterns[index]) {
+            profile->patterns[profile->pattern_count++] = patterns[index];
+            profile->pattern_mask |= 1ull << (patterns[index]->id - 1);
+        }
+    }
+
+    int credentials = record->credential_count;
+    if (credentials > MAX_PROFILE_CREDENTIALS) credentials = MAX_PROFILE_CREDENTIALS;
+    memcpy(profile->credentials, record->credentials, (size_t)credentials * sizeof(uint64_t));
+    profile->credential_count = credentials;
+    // Recomputed rather than trusted: older snapshots hashed in arrival order
+    profile->credential_hash = hash_credential_set(profile->credentials, credentials);
+    profile->command_count = record->command_count;
+    profile->command_hash = record->command_hash;
+}
+
+int quorum_state_load(const char* path, quorum_state_t* state) {
+    if (!path || !state || !state->ips) return -1;
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return -1;
+    }
+    size_t size = (size_t)st.st_size;
+    void* map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return -1;
+    madvise(map, size, MADV_SEQUENTIAL);
+
+    const unsigned char* data = (const unsigned char*)map;
+    const snapshot_header_t* header = NULL;
+    const char* problem = validate(data, size, &header);
+    if (problem) {
+        char msg[640];
+        snprintf(msg, sizeof(msg), "Ignoring quorum state snapshot %s: %s", path, problem);
+        log_event_level(LOG_WARN, msg);
+        munmap(map, size);
+        return -1;
+    }
+
+    const snapshot_service_t* services = (const snapshot_service_t*)(header + 1);
+    const snapshot_pattern_t* pattern_records = (const snapshot_pattern_t*)(services + header->service_count);
+    const snapshot_ip_t* ips = (const snapshot_ip_t*)(pattern_records + header->pattern_count);
+    const snapshot_profile_t* profiles = (const snapshot_profile_t*)(ips + header->ip_count);
+
+    // Cursors, and where each snapshot service sits in the current config
+    int service_map[MAX_SERVICES];
+    for (uint32_t s = 0; s < header->service_count; s++) {
+        service_map[s] = -1;
+        for (int i = 0; i < state->service_count; i++) {
+            if (strncmp(state->services[i].name, services[s].name, MAX_SERVICE_NAME) != 0) continue;
+            log_cursor_t* cursor = &state->services[i].cursor;
+            cursor->inode = (ino_t)services[s].inode;
+            cursor->offset = (off_t)services[s].offset;
+            cursor->fingerprint = services[s].fingerprint;
+            cursor->fingerprint_len = services[s].fingerprint_len;
+            service_map[s] = i;
+            break;
+        }
+    }
+
+    attack_pattern_t* patterns[MAX_ATTACK_PATTERNS];
+    for (uint32_t p = 0; p < header->pattern_count; p++) {
+        char name[MAX_PATTERN_NAME];
+        memcpy(name, pattern_records[p].name, sizeof(name));
+        name[sizeof(name) - 1] = '\0';
+        patterns[p] = get_attack_pattern(name);
+        if (!patterns[p]) continue;
+        patterns[p]->severity = pattern_records[p].severity;
+        patterns[p]->occurrence_count = pattern_records[p].occurrence_count;
+        patterns[p]->first_seen = (time_t)pattern_records[p].first_seen;
+        patterns[p]->last_seen = (time_t)pattern_records[p].last_seen;
+    }
+
+    bool keep_windows = same_windows(header, state);
+    for (uint32_t i = 0; i < header->ip_count; i++) {
+        restore_ip(state, &ips[i], service_map, (int)header->service_count, keep_windows);
+    }
+    state->ips->evictions = 0;
+
+    for (uint32_t i = 0; i < header->profile_count; i++) {
+        restore_profile(&profiles[i], patterns, (int)header->pattern_count);
+    }
+
+    munmap(map, size);
+    return state->ips->count;
+}
@@ -0,0 +1,151 @@
+/**
+ * time_window.c - Per-IP sliding-window hit counters
+ *
+ * Each tracked IP keeps one small ring of time buckets per configured
+ * window (5 minutes, 1 hour, 24 hours by default). A hit increments one
+ * bucket; moving forward in time clears the buckets that fell out of the
+ * window. Both are O(1), and the memory per IP is fixed no matter how
+ * long the daemon runs or how noisy the attacker is.
+ *
+ * Buckets are addressed by absolute slot number (event time divided by
+ * the bucket width) rather than "now", so hits may arrive out of order and
+ * the rings built by parallel scan workers merge into exactly the ring a
+ * sequential scan would have produced.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "time_window.h"
+
+static int bucket_index(int64_t slot) {
+    int64_t idx = slot % WINDOW_BUCKETS;
+    return (int)(idx < 0 ? idx + WINDOW_BUCKETS : idx);
+}
+
+/* ============================================================================
+ * Rings
+ * ============================================================================ */
+
+void hit_ring_add(hit_ring_t* ring, int64_t slot, uint32_t count) {
+    if (!ring || count == 0) return;
+
+    if (slot > ring->head_slot) {
+        int64_t advance = slot - ring->head_slot;
+        if (advance >= WINDOW_BUCKETS) {
+            memset(ring->counts, 0, sizeof(ring->counts));
+        } else {
+            for (int64_t s = ring->head_slot + 1; s <= slot; s++) {
+                ring->counts[bucket_index(s)] = 0;
+            }
+        }
+        ring->head_slot = slot;
+    } else if (slot <= ring->head_slot - WINDOW_BUCKETS) {
+        return;  // Older than anything the window still covers
+    }
+
+    uint32_t total = ring->counts[bucket_index(slot)] + count;
+    ring->counts[bucket_index(slot)] = total > UINT16_MAX ? UINT16_MAX : (uint16_t)total;
+}
+
+void hit_ring_merge(hit_ring_t* dst, const hit_ring_t* src) {
+    if (!dst || !src) return;
+    for (int i = 0; i < WINDOW_BUCKETS; i++) {
+        int64_t slot = src->head_slot - i;
+        hit_ring_add(dst, slot, src->counts[bucket_index(slot)]);
+    }
+}
+
+/**
+ * Hits in the window ending at now_slot
+ * Buckets the ring has not advanced over yet count as empty.
+ */
+uint32_t hit_ring_sum(const hit_ring_t* ring, int64_t now_slot) {
+    if (!ring) return 0;
+    uint32_t sum = 0;
+    for (int i = 0; i < WINDOW_BUCKETS; i++) {
+        int64_t slot = ring->head_slot - i;
+        if (slot <= now_slot && slot > now_slot - WINDOW_BUCKETS) {
+            sum += ring->counts[bucket_index(slot)];
+        }
+    }
+    return sum;
+}
+
+/* ============================================================================
+ * Window specifications
+ * ============================================================================ */
+
+/**
+ * Parse a duration: plain seconds, or a number with an s/m/h/d suffix
+ * Returns the duration in seconds, or -1 if it is malformed or not positive.
+ */
+int parse_duration(const char* text) {
+    if (!text || !*text) return -1;
+
+    char* end = NULL;
+    long value = strtol(text, &end, 10);
+    if (end == text || value <= 0) return -1;
+
+    long unit = 1;
+    switch (*end) {
+    case '\0': break;
+    case 's': unit = 1; end++; break;
+    case 'm': unit = 60; end++; break;
+    case 'h': unit = 3600; end++; break;
+    case 'd': unit = 86400; end++; break;
+    default: return -1;
+    }
+    if (*end != '\0' || value > 365L * 86400L / unit) return -1;
+    return (int)(value * unit);
+}
+
+/**
+ * Parse a comma-separated window list ("5m,1h,24h")
+ * Windows are returned sorted from shortest to longest, duplicates dropped.
+ *
+ * @return Number of windows, or -1 if the list is malformed or too long (seconds
+ *         is then left as it was)
+ */
+int parse_window_list(const char* spec, int* seconds, int max_windows) {
+    if (!spec || !seconds || max_windows <= 0) return -1;
+    if (max_windows > MAX_WINDOWS) max_windows = MAX_WINDOWS;
+
+    char buffer[128];
+    if (snprintf(buffer, sizeof(buffer), "%s", spec) >= (int)sizeof(buffer)) return -1;
+
+    // Built up here and copied out whole, so a bad list leaves seconds alone
+    int parsed[MAX_WINDOWS];
+    int count = 0;
+    char* saveptr = NULL;
+    for (char* item = strtok_r(buffer, ",", &saveptr); item;
+         item = strtok_r(NULL, ",", &saveptr)) {
+        int value = parse_duration(item);
+        if (value < 0) return -1;
+
+        // Insertion sort; the list is tiny
+        int pos = count;
+        while (pos > 0 && parsed[pos - 1] > value) pos--;
+        if (pos > 0 && parsed[pos - 1] == value) continue;
+        if (count == max_windows) return -1;
+        memmove(&parsed[pos + 1], &parsed[pos], (size_t)(count - pos) * sizeof(int));
+        parsed[pos] = value;
+        count++;
+    }
+    if (count == 0) return -1;
+    memcpy(seconds, parsed, (size_t)count * sizeof(int));
+    return count;
+}
+
+// Shortest exact form: 300 -> "5m", 86400 -> "1d", 90 -> "90s"
+void format_duration(int seconds, char* out, size_t out_size) {
+    if (seconds % 86400 == 0) {
+        snprintf(out, out_size, "%dd", seconds / 86400);
+    } else if (seconds % 3600 == 0) {
+        snprintf(out, out_size, "%dh", seconds / 3600);
+    } else if (seconds % 60 == 0) {
+        snprintf(out, out_size, "%dm", seconds / 60);
+    } else {
+        snprintf(out, out_size, "%ds", seconds);
+    }
+}
@@ -0,0 +1,63 @@
+/**
+ * worker_pool.c - Run independent jobs on a handful of threads
+ *
+ * Used by the quorum engine to parse several logs (or several chunks of one
+ * big log) at the same time. Threads only live for one batch: a quorum pass
+ * is long compared to thread start-up, and nothing is left running between
+ * timer invocations.
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include "worker_pool.h"
+#include "utils.h"
+
+#define MAX_WORKER_THREADS 64
+
+typedef struct {
+    worker_job_fn job;
+    void* arg;
+    int job_count;
+    atomic_int next;  // Next job index to hand out
+} worker_batch_t;
+
+static void* worker_main(void* data) {
+    worker_batch_t* batch = (worker_batch_t*)data;
+    int index;
+    while ((index = atomic_fetch_add(&batch->next, 1)) < batch->job_count) {
+        batch->job(batch->arg, index);
+    }
+    return NULL;
+}
+
+/**
+ * Run every job and wait for all of them
+ * Returns the number of threads that took part (including the caller).
+ */
+int worker_pool_run(int threads, int job_count, worker_job_fn job, void* arg) {
+    if (!job || job_count <= 0) return 0;
+
+    if (threads > MAX_WORKER_THREADS) threads = MAX_WORKER_THREADS;
+    if (threads > job_count) threads = job_count;
+    if (threads < 1) threads = 1;
+
+    worker_batch_t batch = { .job = job, .arg = arg, .job_count = job_count };
+    atomic_init(&batch.next, 0);
+
+    pthread_t workers[MAX_WORKER_THREADS];
+    int started = 0;
+    for (int i = 1; i < threads; i++) {
+        if (pthread_create(&workers[started], NULL, worker_main, &batch) != 0) {
+            log_event_level(LOG_WARN, "Failed to start scan worker, continuing with fewer threads");
+            break;
+        }
+        started++;
+    }
+
+    worker_main(&batch);
+
+    for (int i = 0; i < started; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    return started + 1;
+}
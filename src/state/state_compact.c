@@ -0,0 +1,535 @@
+/**
+ * state_compact.c - Compact, string-interned form of a system state
+ * ============================================================================
+ *
+ * All columns of a compact state share one allocation, laid out by
+ * lay_out(): it is run once to size the block and once to point the
+ * columns into it. Building a compact state is therefore one malloc for
+ * the columns plus the string pool, and freeing it is two frees.
+ *
+ * ============================================================================
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "state_compact.h"
+
+/* ============================================================================
+ * STRING POOL
+ * ============================================================================ */
+
+static uint32_t hash_string(const char* s, size_t len) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h = (h ^ (unsigned char)s[i]) * 16777619u;
+    }
+    return h;
+}
+
+int string_pool_init(string_pool_t* pool, uint32_t expected_bytes) {
+    if (!pool) return -1;
+    memset(pool, 0, sizeof(string_pool_t));
+
+    pool->capacity = expected_bytes > 64 ? expected_bytes : 64;
+    pool->data = malloc(pool->capacity);
+    pool->slot_mask = 63;
+    pool->slots = calloc(pool->slot_mask + 1, sizeof(uint32_t));
+    if (!pool->data || !pool->slots) {
+        string_pool_free(pool);
+        return -1;
+    }
+
+    pool->data[0] = '\0';   /* Handle 0 */
+    pool->size = 1;
+    return 0;
+}
+
+void string_pool_free(string_pool_t* pool) {
+    if (!pool) return;
+    free(pool->data);
+    free(pool->slots);
+    memset(pool, 0, sizeof(string_pool_t));
+}
+
+static int grow_slots(string_pool_t* pool) {
+    uint32_t mask = pool->slot_mask * 2 + 1;
+    uint32_t* slots = calloc(mask + 1, sizeof(uint32_t));
+    if (!slots) return -1;
+
+    for (uint32_t i = 0; i <= pool->slot_mask; i++) {
+        uint32_t entry = pool->slots[i];
+        if (!entry) continue;
+        const char* s = pool->data + entry - 1;
+        uint32_t at = hash_string(s, strlen(s)) & mask;
+        while (slots[at]) at = (at + 1) & mask;
+        slots[at] = entry;
+    }
+
+    free(pool->slots);
+    pool->slots = slots;
+    pool->slot_mask = mask;
+    return 0;
+}
+
+str_handle_t string_pool_intern(string_pool_t* pool, const char* s) {
+    if (!pool || !s || !*s) return 0;
+
+    size_t len = strlen(s);
+    uint32_t h = hash_string(s, len);
+    uint32_t at = h & pool->slot_mask;
+    while (pool->slots[at]) {
+        uint32_t handle = pool->slots[at] - 1;
+        if (strcmp(pool->data + handle, s) == 0) return handle;
+        at = (at + 1) & pool->slot_mask;
+    }
+
+    if (pool->size + len + 1 > pool->capacity) {
+        uint32_t capacity = pool->capacity;
+        while (pool->size + len + 1 > capacity) capacity *= 2;
+        char* data = realloc(pool->data, capacity);
+        if (!data) return (str_handle_t)-1;
+        pool->data = data;
+        pool->capacity = capacity;
+    }
+
+    str_handle_t handle = pool->size;
+    memcpy(pool->data + handle, s, len + 1);
+    pool->size += (uint32_t)len + 1;
+    pool->slots[at] = handle + 1;
+    pool->count++;
+
+    /* Keep probes short: at most half full */
+    if (pool->count * 2 > pool->slot_mask + 1 && grow_slots(pool) != 0) {
+        return (str_handle_t)-1;
+    }
+    return handle;
+}
+
+/* ============================================================================
+ * LAYOUT
+ * ============================================================================ */
+
+/* Size the column block, and point the columns into it if base is given */
+static size_t lay_out(state_compact_t* c, char* base) {
+    size_t off = 0;
+#define COLUMN(field, n) do {                                   \
+        off = (off + 15) & ~(size_t)15;                         \
+        if (base) c->field = (void*)(base + off);               \
+        off += (size_t)(n) * sizeof(*c->field);                 \
+    } while (0)
+
+    /* Hot process columns first and adjacent */
+    COLUMN(pid, c->process_count);
+    COLUMN(ppid, c->process_count);
+    COLUMN(proc_uid, c->process_count);
+    COLUMN(proc_state, c->process_count);
+    COLUMN(memory_kb, c->process_count);
+    COLUMN(proc_gid, c->process_count);
+    COLUMN(proc_name, c->process_count);
+    COLUMN(cmdline, c->process_count);
+    COLUMN(tty, c->process_count);
+    COLUMN(virtual_kb, c->process_count);
+    COLUMN(cpu_percent, c->process_count);
+    COLUMN(mem_percent, c->process_count);
+    COLUMN(start_time_offset, c->process_count);
+    COLUMN(cpu_time_ms, c->process_count);
+    COLUMN(proc_flags, c->process_count);
+
+    COLUMN(user_uid, c->user_count);
+    COLUMN(user_gid, c->user_count);
+    COLUMN(username, c->user_count);
+    COLUMN(password_hash, c->user_count);
+    COLUMN(home_dir, c->user_count);
+    COLUMN(shell, c->user_count);
+    COLUMN(gecos, c->user_count);
+    COLUMN(user_flags, c->user_count);
+
+    COLUMN(path, c->file_count);
+    COLUMN(file_name, c->file_count);
+    COLUMN(link_target, c->file_count);
+    COLUMN(content_generator, c->file_count);
+    COLUMN(file_type, c->file_count);
+    COLUMN(file_flags, c->file_count);
+    COLUMN(permissions, c->file_count);
+    COLUMN(file_owner, c->file_count);
+    COLUMN(file_group, c->file_count);
+    COLUMN(file_size, c->file_count);
+    COLUMN(atime_offset, c->file_count);
+    COLUMN(mtime_offset, c->file_count);
+    COLUMN(ctime_offset, c->file_count);
+    COLUMN(device_major, c->file_count);
+    COLUMN(device_minor, c->file_count);
+
+    COLUMN(interfaces, c->interface_count);
+    COLUMN(connections, c->connection_count);
+    COLUMN(mounts, c->mount_count);
+    COLUMN(logs, c->log_count);
+#undef COLUMN
+    return off;
+}
+
+/* ============================================================================
+ * CONVERSION
+ * ============================================================================ */
+
+/* A file's name is usually the tail of its path - point into it */
+static str_handle_t intern_name(string_pool_t* pool, str_handle_t path, const char* name) {
+    const char* p = string_pool_get(pool, path);
+    size_t plen = strlen(p), nlen = strlen(name);
+    if (nlen > 0 && nlen <= plen && strcmp(p + plen - nlen, name) == 0) {
+        return path + (str_handle_t)(plen - nlen);
+    }
+    return string_pool_intern(pool, name);
+}
+
+static str_handle_t intern_checked(string_pool_t* pool, const char* s, bool* failed) {
+    str_handle_t h = string_pool_intern(pool, s);
+    if (h == (str_handle_t)-1) {
+        *failed = true;
+        return 0;
+    }
+    return h;
+}
+
+int state_compact_build(state_compact_t* out, const system_state_t* state) {
+    if (!out || !state || !state->is_initialized) return -1;
+
+    memset(out, 0, sizeof(state_compact_t));
+    out->process_count = state->process_count;
+    out->user_count = state->user_count;
+    out->file_count = state->file_count;
+    out->interface_count = state->interface_count;
+    out->connection_count = state->connection_count;
+    out->mount_count = state->mount_count;
+    out->log_count = state->log_count;
+
+    size_t block_size = lay_out(out, NULL);
+    out->block = malloc(block_size ? block_size : 1);
+    if (!out->block || string_pool_init(&out->strings, 2048) != 0) {
+        state_compact_free(out);
+        return -1;
+    }
+    lay_out(out, out->block);
+
+    string_pool_t* pool = &out->strings;
+    bool failed = false;
+#define INTERN(s) intern_checked(pool, (s), &failed)
+
+    out->profile = state->profile;
+    out->hostname = INTERN(state->hostname);
+    out->state_seed = state->state_seed;
+    out->rng = state->rng;
+    out->boot_time = state->boot_time;
+    out->uptime_seconds = state->uptime_seconds;
+    out->next_pid = state->next_pid;
+    out->total_memory_kb = state->total_memory_kb;
+    out->used_memory_kb = state->used_memory_kb;
+    out->cached_memory_kb = state->cached_memory_kb;
+    out->buffer_memory_kb = state->buffer_memory_kb;
+    out->cpu_usage_percent = state->cpu_usage_percent;
+    out->load_avg_1 = state->load_avg_1;
+    out->load_avg_5 = state->load_avg_5;
+    out->load_avg_15 = state->load_avg_15;
+
+    for (int i = 0; i < state->process_count; i++) {
+        const state_process_t* p = &state->processes[i];
+        out->pid[i] = p->pid;
+        out->ppid[i] = p->ppid;
+        out->proc_uid[i] = p->uid;
+        out->proc_state[i] = (uint8_t)p->state;
+        out->memory_kb[i] = p->memory_kb;
+        out->proc_gid[i] = p->gid;
+        out->proc_name[i] = INTERN(p->name);
+        out->cmdline[i] = INTERN(p->cmdline);
+        out->tty[i] = INTERN(p->tty);
+        out->virtual_kb[i] = p->virtual_kb;
+        out->cpu_percent[i] = p->cpu_percent;
+        out->mem_percent[i] = p->mem_percent;
+        out->start_time_offset[i] = p->start_time_offset;
+        out->cpu_time_ms[i] = p->cpu_time_ms;
+        out->proc_flags[i] = (p->is_kernel_thread ? COMPACT_PROC_KERNEL : 0) |
+                             (p->is_service ? COMPACT_PROC_SERVICE : 0) |
+                             (p->visible_in_ps ? COMPACT_PROC_VISIBLE : 0);
+    }
+
+    for (int i = 0; i < state->user_count; i++) {
+        const state_user_t* u = &state->users[i];
+        out->user_uid[i] = u->uid;
+        out->user_gid[i] = u->gid;
+        out->username[i] = INTERN(u->username);
+        out->password_hash[i] = INTERN(u->password_hash);
+        out->home_dir[i] = INTERN(u->home_dir);
+        out->shell[i] = INTERN(u->shell);
+        out->gecos[i] = INTERN(u->gecos);
+        out->user_flags[i] = (u->is_system_user ? 1 : 0) | (u->can_login ? 2 : 0);
+    }
+
+    for (int i = 0; i < state->file_count; i++) {
+        const state_file_t* f = &state->files[i];
+        out->path[i] = INTERN(f->path);
+        out->file_name[i] = intern_name(pool, out->path[i], f->name);
+        if (out->file_name[i] == (str_handle_t)-1) {
+            out->file_name[i] = 0;
+            failed = true;
+        }
+        out->link_target[i] = INTERN(f->link_target);
+        out->content_generator[i] = f->content_generator;
+        out->file_type[i] = (uint8_t)f->type;
+        out->file_flags[i] = (f->has_dynamic_content ? COMPACT_FILE_DYNAMIC : 0) |
+                             (f->created_by_attacker ? COMPACT_FILE_ATTACKER : 0) |
+                             (f->deleted ? COMPACT_FILE_DELETED : 0);
+        out->permissions[i] = (uint16_t)f->permissions;
+        out->file_owner[i] = f->owner;
+        out->file_group[i] = f->group;
+        out->file_size[i] = f->size;
+        out->atime_offset[i] = f->atime_offset;
+        out->mtime_offset[i] = f->mtime_offset;
+        out->ctime_offset[i] = f->ctime_offset;
+        out->device_major[i] = f->device_major;
+        out->device_minor[i] = f->device_minor;
+    }
+#undef INTERN
+
+    memcpy(out->interfaces, state->interfaces, (size_t)out->interface_count * sizeof(state_interface_t));
+    memcpy(out->connections, state->connections, (size_t)out->connection_count * sizeof(state_connection_t));
+    memcpy(out->mounts, state->mounts, (size_t)out->mount_count * sizeof(state_mount_t));
+
+    /* Unroll the log ring, oldest first */
+    int first = (state->log_count == MAX_STATE_LOG_ENTRIES) ? state->log_write_index : 0;
+    for (int i = 0; i < state->log_count; i++) {
+        out->logs[i] = state->logs[(first + i) % MAX_STATE_LOG_ENTRIES];
+    }
+
+    if (failed) {
+        state_compact_free(out);
+        return -1;
+    }
+    return 0;
+}
+
+static void copy_str(char* dst, size_t size, const state_compact_t* c, str_handle_t h) {
+    snprintf(dst, size, "%s", state_compact_str(c, h));
+}
+
+int state_compact_expand(const state_compact_t* c, system_state_t* out) {
+    if (!c || !out || !c->block) return -1;
+
+    memset(out, 0, sizeof(system_state_t));
+    out->profile = c->profile;
+    copy_str(out->hostname, sizeof(out->hostname), c, c->hostname);
+    out->state_seed = c->state_seed;
+    out->rng = c->rng;
+    out->boot_time = c->boot_time;
+    out->uptime_seconds = c->uptime_seconds;
+    out->last_morph_time = time(NULL);
+    out->next_pid = c->next_pid;
+    out->total_memory_kb = c->total_memory_kb;
+    out->used_memory_kb = c->used_memory_kb;
+    out->cached_memory_kb = c->cached_memory_kb;
+    out->buffer_memory_kb = c->buffer_memory_kb;
+    out->cpu_usage_percent = c->cpu_usage_percent;
+    out->load_avg_1 = c->load_avg_1;
+    out->load_avg_5 = c->load_avg_5;
+    out->load_avg_15 = c->load_avg_15;
+
+    out->process_count = c->process_count;
+    for (int i = 0; i < c->process_count; i++) {
+        state_process_t* p = &out->processes[i];
+        p->pid = c->pid[i];
+        p->ppid = c->ppid[i];
+        p->uid = c->proc_uid[i];
+        p->gid = c->proc_gid[i];
+        copy_str(p->name, sizeof(p->name), c, c->proc_name[i]);
+        copy_str(p->cmdline, sizeof(p->cmdline), c, c->cmdline[i]);
+        copy_str(p->tty, sizeof(p->tty), c, c->tty[i]);
+        p->state = (proc_state_t)c->proc_state[i];
+        p->memory_kb = c->memory_kb[i];
+        p->virtual_kb = c->virtual_kb[i];
+        p->cpu_percent = c->cpu_percent[i];
+        p->mem_percent = c->mem_percent[i];
+        p->start_time_offset = c->start_time_offset[i];
+        p->cpu_time_ms = c->cpu_time_ms[i];
+        p->is_kernel_thread = c->proc_flags[i] & COMPACT_PROC_KERNEL;
+        p->is_service = c->proc_flags[i] & COMPACT_PROC_SERVICE;
+        p->visible_in_ps = c->proc_flags[i] & COMPACT_PROC_VISIBLE;
+    }
+    state_recount_processes(out);
+    out->dirty = 0;                 /* The derived values came along above */
+    out->load_target_1 = out->load_avg_1;
+    out->load_target_5 = out->load_avg_5;
+    out->load_target_15 = out->load_avg_15;
+    out->sim_uptime = out->uptime_seconds;
+
+    out->user_count = c->user_count;
+    for (int i = 0; i < c->user_count; i++) {
+        state_user_t* u = &out->users[i];
+        u->uid = c->user_uid[i];
+        u->gid = c->user_gid[i];
+        copy_str(u->username, sizeof(u->username), c, c->username[i]);
+        copy_str(u->password_hash, sizeof(u->password_hash), c, c->password_hash[i]);
+        copy_str(u->home_dir, sizeof(u->home_dir), c, c->home_dir[i]);
+        copy_str(u->shell, sizeof(u->shell), c, c->shell[i]);
+        copy_str(u->gecos, sizeof(u->gecos), c, c->gecos[i]);
+        u->is_system_user = c->user_flags[i] & 1;
+        u->can_login = c->user_flags[i] & 2;
+    }
+
+    if (path_index_init(&out->file_index) != 0) {
+        memset(out, 0, sizeof(system_state_t));
+        return -1;
+    }
+    for (int i = 0; i < c->file_count; i++) {
+        state_file_t record;
+        state_file_t* f = &record;
+        memset(f, 0, sizeof(state_file_t));
+        copy_str(f->path, sizeof(f->path), c, c->path[i]);
+        copy_str(f->name, sizeof(f->name), c, c->file_name[i]);
+        copy_str(f->link_target, sizeof(f->link_target), c, c->link_target[i]);
+        f->content_generator = c->content_generator[i];
+        f->type = (file_type_t)c->file_type[i];
+        f->permissions = c->permissions[i];
+        f->owner = c->file_owner[i];
+        f->group = c->file_group[i];
+        f->size = c->file_size[i];
+        f->atime_offset = c->atime_offset[i];
+        f->mtime_offset = c->mtime_offset[i];
+        f->ctime_offset = c->ctime_offset[i];
+        f->device_major = c->device_major[i];
+        f->device_minor = c->device_minor[i];
+        f->has_dynamic_content = c->file_flags[i] & COMPACT_FILE_DYNAMIC;
+        f->created_by_attacker = c->file_flags[i] & COMPACT_FILE_ATTACKER;
+        f->deleted = c->file_flags[i] & COMPACT_FILE_DELETED;
+        if (state_append_file_record(out, f) != 0) {
+            state_engine_destroy(out);
+            return -1;
+        }
+    }
+
+    out->interface_count = c->interface_count;
+    memcpy(out->interfaces, c->interfaces, (size_t)c->interface_count * sizeof(state_interface_t));
+    out->connection_count = c->connection_count;
+    memcpy(out->connections, c->connections, (size_t)c->connection_count * sizeof(state_connection_t));
+    out->mount_count = c->mount_count;
+    memcpy(out->mounts, c->mounts, (size_t)c->mount_count * sizeof(state_mount_t));
+    out->log_count = c->log_count;
+    memcpy(out->logs, c->logs, (size_t)c->log_count * sizeof(state_log_entry_t));
+    out->log_write_index = c->log_count % MAX_STATE_LOG_ENTRIES;
+
+    out->is_initialized = true;
+    state_mark_changed(out, STATE_INPUT_ALL);
+    return 0;
+}
+
+void state_compact_free(state_compact_t* c) {
+    if (!c) return;
+    free(c->block);
+    string_pool_free(&c->strings);
+    memset(c, 0, sizeof(state_compact_t));
+}
+
+size_t state_compact_memory_usage(const state_compact_t* c) {
+    if (!c) return 0;
+
+    state_compact_t sizing = *c;
+    return sizeof(state_compact_t) + lay_out(&sizing, NULL) +
+           c->strings.capacity + ((size_t)c->strings.slot_mask + 1) * sizeof(uint32_t);
+}
+
+/* ============================================================================
+ * GENERATORS
+ * ============================================================================ */
+
+static const char* compact_username(const state_compact_t* c, uid_t uid) {
+    for (int j = 0; j < c->user_count; j++) {
+        if (c->user_uid[j] == uid) return state_compact_str(c, c->username[j]);
+    }
+    return "root";
+}
+
+/**
+ * ps output, matching state_write_ps_output() byte for byte
+ */
+int state_compact_write_ps_output(const state_compact_t* c, state_sink_t* out, bool aux_format) {
+    if (!c || !out) return -1;
+
+    static const char stat_chars[] = { 'R', 'S', 'D', 'Z', 'T' };
+
+    if (aux_format) {
+        state_sink_printf(out,
+            "USER       PID %%CPU %%MEM    VSZ   RSS TTY      STAT START   TIME COMMAND\n");
+    } else {
+        state_sink_printf(out, "  PID TTY          TIME CMD\n");
+    }
+
+    for (int i = 0; i < c->process_count; i++) {
+        if (!(c->proc_flags[i] & COMPACT_PROC_VISIBLE)) continue;
+
+        char stat_char = c->proc_state[i] < sizeof(stat_chars) ? stat_chars[c->proc_state[i]] : 'S';
+        const char* tty = state_compact_str(c, c->tty[i]);
+        if (aux_format) {
+            const char* cmd = c->cmdline[i] ? state_compact_str(c, c->cmdline[i])
+                                            : state_compact_str(c, c->proc_name[i]);
+            state_sink_printf(out,
+                "%-8s %5d  %3d  %3d %6u %5u %-8s %c    %02d:%02d %4u:%02u %s\n",
+                compact_username(c, c->proc_uid[i]),
+                c->pid[i],
+                c->cpu_percent[i] / 10,
+                c->mem_percent[i],
+                c->virtual_kb[i],
+                c->memory_kb[i],
+                tty,
+                stat_char,
+                (c->start_time_offset[i] / 3600) % 24,
+                (c->start_time_offset[i] / 60) % 60,
+                c->cpu_time_ms[i] / 60000,
+                (c->cpu_time_ms[i] / 1000) % 60,
+                cmd
+            );
+        } else {
+            state_sink_printf(out,
+                "%5d %-8s %02u:%02u:%02u %s\n",
+                c->pid[i],
+                tty,
+                c->cpu_time_ms[i] / 3600000,
+                (c->cpu_time_ms[i] / 60000) % 60,
+                (c->cpu_time_ms[i] / 1000) % 60,
+                state_compact_str(c, c->proc_name[i])
+            );
+        }
+    }
+
+    return 0;
+}
+
+int state_compact_write_passwd(const state_compact_t* c, state_sink_t* out) {
+    if (!c || !out) return -1;
+
+    for (int i = 0; i < c->user_count; i++) {
+        state_sink_printf(out,
+            "%s:x:%d:%d:%s:%s:%s\n",
+            state_compact_str(c, c->username[i]),
+            c->user_uid[i],
+            c->user_gid[i],
+            state_compact_str(c, c->gecos[i]),
+            state_compact_str(c, c->home_dir[i]),
+            state_compact_str(c, c->shell[i])
+        );
+    }
+
+    return 0;
+}
+
+int state_compact_generate_ps_output(const state_compact_t* c, char* buf, size_t size,
+                                     bool aux_format) {
+    state_sink_t out;
+    if (state_sink_init_fixed(&out, buf, size) != 0) return -1;
+    return state_compact_write_ps_output(c, &out, aux_format) < 0 ? -1 : (int)out.length;
+}
+
+int state_compact_generate_passwd(const state_compact_t* c, char* buf, size_t size) {
+    state_sink_t out;
+    if (state_sink_init_fixed(&out, buf, size) != 0) return -1;
+    return state_compact_write_passwd(c, &out) < 0 ? -1 : (int)out.length;
+}
@@ -0,0 +1,250 @@
+/**
+ * state_content.c - Registered content generators and their cache
+ * ============================================================================
+ *
+ * The registry is process-wide and only grows; ids are indexes into it.
+ * The cache is per state, so it needs no locking beyond the state's own.
+ *
+ * Paths are found through a hash table whose seed was picked so that no
+ * two built-in paths share a slot: a built-in lookup is one hash and one
+ * strcmp(). Generators registered later probe linearly like any table.
+ *
+ * ============================================================================
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "state_content.h"
+
+/* ============================================================================
+ * REGISTRY
+ * ============================================================================ */
+
+/* Built-in generators, registered as ids 1..N on first use */
+static const state_content_generator_t builtins[] = {
+    {"/proc/uptime",  state_write_proc_uptime,  STATE_INPUT_TIME},
+    {"/proc/meminfo", state_write_proc_meminfo, STATE_INPUT_RESOURCES},
+    {"/proc/loadavg", state_write_proc_loadavg, STATE_INPUT_TIME | STATE_INPUT_RESOURCES | STATE_INPUT_PROCESSES},
+    {"/proc/cpuinfo", state_write_proc_cpuinfo, STATE_INPUT_IDENTITY},
+    {"/proc/version", state_write_proc_version, STATE_INPUT_IDENTITY},
+    {"/proc/mounts",  state_write_proc_mounts,  STATE_INPUT_MOUNTS},
+    {"/proc/stat",    state_write_proc_stat,    STATE_INPUT_TIME | STATE_INPUT_PROCESSES},
+    {"/proc/net/dev", state_write_proc_net_dev, STATE_INPUT_TIME | STATE_INPUT_NETWORK},
+    {"/etc/passwd",   state_write_passwd,       STATE_INPUT_USERS},
+    {"/etc/shadow",   state_write_shadow,       STATE_INPUT_USERS},
+    {"/etc/group",    state_write_group,        STATE_INPUT_USERS}
+};
+
+/*
+ * ROUTE_SEED makes the built-in paths above collision-free in ROUTE_SLOTS.
+ * After changing the list, search upwards from the FNV offset basis for
+ * the first seed that does so again; test_content_routes checks it.
+ */
+#define ROUTE_SLOTS     64
+#define ROUTE_SEED      0x811c9dcbu
+
+/* Slot 0 stays empty so that 0 means "no generator" */
+static state_content_generator_t registry[STATE_CONTENT_MAX_GENERATORS];
+static int registry_count = 1;
+static uint8_t route_slots[ROUTE_SLOTS];        /* id, 0 = empty */
+static pthread_mutex_t registry_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t builtins_once = PTHREAD_ONCE_INIT;
+
+static uint32_t route_hash(const char* path) {
+    uint32_t h = ROUTE_SEED;
+    for (const unsigned char* p = (const unsigned char*)path; *p; p++) {
+        h = (h ^ *p) * 16777619u;
+    }
+    return h ^ (h >> 15);
+}
+
+static int find_route(const char* path) {
+    for (uint32_t at = route_hash(path) & (ROUTE_SLOTS - 1); ;
+         at = (at + 1) & (ROUTE_SLOTS - 1)) {
+        uint8_t id = __atomic_load_n(&route_slots[at], __ATOMIC_ACQUIRE);
+        if (id == 0) return 0;
+        if (strcmp(registry[id].path, path) == 0) return id;
+    }
+}
+
+static int add_generator(const char* path, state_content_fn generate, uint32_t inputs) {
+    int id = registry_count;
+    if (id >= STATE_CONTENT_MAX_GENERATORS || find_route(path) != 0) return -1;
+
+    registry[id].path = path;
+    registry[id].generate = generate;
+    registry[id].inputs = inputs;
+    __atomic_store_n(&registry_count, id + 1, __ATOMIC_RELEASE);
+
+    /* Publish the slot last, so readers never see a half-written entry */
+    uint32_t at = route_hash(path) & (ROUTE_SLOTS - 1);
+    while (route_slots[at]) at = (at + 1) & (ROUTE_SLOTS - 1);
+    __atomic_store_n(&route_slots[at], (uint8_t)id, __ATOMIC_RELEASE);
+    return id;
+}
+
+static void register_builtins(void) {
+    pthread_mutex_lock(&registry_lock);
+    for (size_t i = 0; i < sizeof(builtins) / sizeof(builtins[0]); i++) {
+        add_generator(builtins[i].path, builtins[i].generate, builtins[i].inputs);
+    }
+    pthread_mutex_unlock(&registry_lock);
+}
+
+int state_content_register(const char* path, state_content_fn generate, uint32_t inputs) {
+    if (!path || path[0] != '/' || !generate) return -1;
+    pthread_once(&builtins_once, register_builtins);
+
+    pthread_mutex_lock(&registry_lock);
+    int id = add_generator(path, generate, inputs);
+    pthread_mutex_unlock(&registry_lock);
+    return id;
+}
+
+int state_content_find(const char* path) {
+    if (!path) return 0;
+    pthread_once(&builtins_once, register_builtins);
+    return find_route(path);
+}
+
+int state_content_probe_length(const char* path) {
+    if (!path) return 0;
+    pthread_once(&builtins_once, register_builtins);
+
+    int probes = 1;
+    for (uint32_t at = route_hash(path) & (ROUTE_SLOTS - 1); route_slots[at];
+         at = (at + 1) & (ROUTE_SLOTS - 1), probes++) {
+        if (strcmp(registry[route_slots[at]].path, path) == 0) return probes;
+    }
+    return 0;
+}
+
+const state_content_generator_t* state_content_generator(int id) {
+    pthread_once(&builtins_once, register_builtins);
+    if (id <= 0 || id >= __atomic_load_n(&registry_count, __ATOMIC_ACQUIRE)) return NULL;
+    return &registry[id];
+}
+
+/* ============================================================================
+ * PER-PROCESS ROUTES
+ * ============================================================================ */
+
+static const struct {
+    const char* name;
+    state_pid_content_fn generate;
+} pid_routes[] = {
+    {"stat",    state_write_proc_pid_stat},
+    {"status",  state_write_proc_pid_status},
+    {"cmdline", state_write_proc_pid_cmdline},
+    {"maps",    state_write_proc_pid_maps}
+};
+
+state_pid_content_fn state_content_pid_route(const char* path, pid_t* pid) {
+    if (!path || strncmp(path, "/proc/", 6) != 0) return NULL;
+
+    const char* p = path + 6;
+    long value = 0;
+    int digits = 0;
+    while (*p >= '0' && *p <= '9' && digits < 7) {
+        value = value * 10 + (*p++ - '0');
+        digits++;
+    }
+    if (digits == 0 || *p != '/' || value <= 0) return NULL;
+    p++;
+
+    for (size_t i = 0; i < sizeof(pid_routes) / sizeof(pid_routes[0]); i++) {
+        if (strcmp(p, pid_routes[i].name) == 0) {
+            if (pid) *pid = (pid_t)value;
+            return pid_routes[i].generate;
+        }
+    }
+    return NULL;
+}
+
+/* ============================================================================
+ * CACHE
+ * ============================================================================ */
+
+static bool entry_is_fresh(const system_state_t* state, const state_content_entry_t* entry,
+                           uint32_t inputs) {
+    if (entry->version == 0) return false;
+    if ((inputs & STATE_INPUT_TIME) && entry->uptime != state->uptime_seconds) return false;
+
+    for (int i = 0; i < STATE_INPUT_COUNT; i++) {
+        if ((inputs & (1u << i)) && state->input_version[i] > entry->version) return false;
+    }
+    return true;
+}
+
+/* Run the generator into a fresh sink and keep its output whole */
+static int regenerate(system_state_t* state, state_content_entry_t* entry,
+                      const state_content_generator_t* gen) {
+    state_sink_t out;
+    state_sink_init_buffer(&out);
+    if (gen->generate(state, &out) != 0 || !state_sink_ok(&out)) {
+        state_sink_free(&out);
+        return -1;
+    }
+
+    size_t length;
+    char* data = state_sink_detach(&out, &length);
+    if (!data) return -1;
+
+    free(entry->data);
+    entry->data = data;
+    entry->length = (uint32_t)length;
+    entry->capacity = (uint32_t)length + 1;
+    return 0;
+}
+
+int state_content_get(system_state_t* state, int id, const char** data, size_t* length) {
+    const state_content_generator_t* gen = state_content_generator(id);
+    if (!state || !gen || !data) return -1;
+
+    if (gen->inputs & STATE_INPUT_TIME) {
+        state_engine_update_time(state);
+    }
+    if ((gen->inputs & STATE_INPUT_RESOURCES) && state->dirty) {
+        state_engine_recalculate(state);
+    }
+
+    state_content_entry_t* entry = &state->content_cache[id];
+    if (!entry_is_fresh(state, entry, gen->inputs)) {
+        entry->version = 0;
+        if (regenerate(state, entry, gen) != 0) return -1;
+
+        /* Stamp after generating: some generators update the clock */
+        entry->version = state->state_version;
+        entry->uptime = state->uptime_seconds;
+    }
+
+    *data = entry->data;
+    if (length) *length = entry->length;
+    return 0;
+}
+
+void state_content_invalidate(system_state_t* state) {
+    if (!state) return;
+    for (int i = 0; i < STATE_CONTENT_MAX_GENERATORS; i++) {
+        state->content_cache[i].version = 0;
+    }
+}
+
+void state_content_free(system_state_t* state) {
+    if (!state) return;
+    for (int i = 0; i < STATE_CONTENT_MAX_GENERATORS; i++) {
+        free(state->content_cache[i].data);
+    }
+    memset(state->content_cache, 0, sizeof(state->content_cache));
+}
+
+size_t state_content_memory_usage(const system_state_t* state) {
+    if (!state) return 0;
+    size_t total = 0;
+    for (int i = 0; i < STATE_CONTENT_MAX_GENERATORS; i++) {
+        total += state->content_cache[i].capacity;
+    }
+    return total;
+}
@@ -20,12 +20,16 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdarg.h>
 #include <time.h>
+#include <math.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <ctype.h>
+#include <pthread.h>
 
 #include "state_engine.h"
+#include "state_content.h"
 #include "utils.h"
 
 /* ============================================================================
@@ -34,6 +38,7 @@
 
 static system_state_t g_state;
 static bool g_state_initialized = false;
+static pthread_mutex_t g_state_lock = PTHREAD_MUTEX_INITIALIZER;
 
 /* ============================================================================
  * PRNG - Seeded Random Number Generator
@@ -43,32 +48,116 @@ static bool g_state_initialized = false;
  * Using a seeded PRNG means we can reproduce EXACT states.
  * Same seed = same "random" numbers = same fake system.
  * This is crucial for debugging and for the Rubik's Cube effect.
+ * 
+ * WHY PER STATE:
+ * One process may host many fake devices and many attacker sessions at
+ * once, on different threads. A single global generator would make each
+ * device's values depend on what the others drew (and race besides), so
+ * every system_state_t carries its own xoshiro128** stream. The jump
+ * function skips 2^64 draws, which lets one device seed hand out
+ * non-overlapping streams to its sessions.
  */
 
-static uint32_t prng_state = 0;
+/* splitmix64 - expands one seed into well-mixed generator state */
+static uint64_t splitmix64(uint64_t* x) {
+    uint64_t z = (*x += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static inline uint32_t rotl32(uint32_t x, int k) {
+    return (x << k) | (x >> (32 - k));
+}
+
+void state_rng_seed(state_rng_t* rng, uint64_t seed) {
+    if (!rng) return;
+    uint64_t x = seed;
+    uint64_t a = splitmix64(&x);
+    uint64_t b = splitmix64(&x);
+    rng->s[0] = (uint32_t)a;
+    rng->s[1] = (uint32_t)(a >> 32);
+    rng->s[2] = (uint32_t)b;
+    rng->s[3] = (uint32_t)(b >> 32);
+    if ((rng->s[0] | rng->s[1] | rng->s[2] | rng->s[3]) == 0) {
+        rng->s[0] = 1;  /* The all-zero state is a fixed point */
+    }
+}
+
+/* xoshiro128** 1.1 */
+uint32_t state_rng_next(state_rng_t* rng) {
+    uint32_t* s = rng->s;
+    uint32_t result = rotl32(s[1] * 5, 7) * 9;
+    uint32_t t = s[1] << 9;
+    
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl32(s[3], 11);
+    return result;
+}
+
+/* Equivalent to 2^64 calls to state_rng_next() */
+void state_rng_jump(state_rng_t* rng) {
+    static const uint32_t jump[] = { 0x8764000b, 0xf542d2d3, 0x6fa035c3, 0x77f2db5b };
+    uint32_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    
+    for (size_t i = 0; i < sizeof(jump) / sizeof(jump[0]); i++) {
+        for (int b = 0; b < 32; b++) {
+            if (jump[i] & (1u << b)) {
+                s0 ^= rng->s[0];
+                s1 ^= rng->s[1];
+                s2 ^= rng->s[2];
+                s3 ^= rng->s[3];
+            }
+            state_rng_next(rng);
+        }
+    }
+    rng->s[0] = s0;
+    rng->s[1] = s1;
+    rng->s[2] = s2;
+    rng->s[3] = s3;
+}
+
+void state_rng_split(state_rng_t* parent, state_rng_t* child) {
+    if (!parent || !child) return;
+    *child = *parent;
+    state_rng_jump(parent);
+}
 
-static void prng_seed(uint32_t seed) {
-    prng_state = seed ? seed : (uint32_t)time(NULL);
+uint32_t state_new_seed(void) {
+    static uint64_t counter = 0;
+    uint64_t n = __atomic_add_fetch(&counter, 1, __ATOMIC_RELAXED);
+    uint64_t x = ((uint64_t)time(NULL) << 32) ^ ((uint64_t)getpid() << 16) ^ (n * 0xD1B54A32D192ED03ULL);
+    uint32_t seed = (uint32_t)splitmix64(&x);
+    return seed ? seed : 1;
 }
 
-/* xorshift32 - Fast, decent quality PRNG */
-static uint32_t prng_next(void) {
-    uint32_t x = prng_state;
-    x ^= x << 13;
-    x ^= x >> 17;
-    x ^= x << 5;
-    prng_state = x;
-    return x;
+static void seed_state(system_state_t* state, uint32_t seed) {
+    state->state_seed = seed;
+    state_rng_seed(&state->rng, seed);
 }
 
 uint32_t state_rand(system_state_t* state) {
-    (void)state; /* Could use per-state PRNG in future */
-    return prng_next();
+    if (state) return state_rng_next(&state->rng);
+    
+    /* No state to draw from - use a private stream for this thread */
+    static __thread state_rng_t thread_rng;
+    static __thread bool thread_rng_ready = false;
+    if (!thread_rng_ready) {
+        state_rng_seed(&thread_rng, state_new_seed());
+        thread_rng_ready = true;
+    }
+    return state_rng_next(&thread_rng);
 }
 
 uint32_t state_rand_between(system_state_t* state, uint32_t min, uint32_t max) {
     if (min >= max) return min;
-    return min + (state_rand(state) % (max - min + 1));
+    /* Multiply-shift maps the draw onto the range without modulo bias */
+    uint64_t range = (uint64_t)max - min + 1;
+    return min + (uint32_t)(((uint64_t)state_rand(state) * range) >> 32);
 }
 
 /* Generate random IP address */
@@ -98,6 +187,19 @@ void state_rand_ip(system_state_t* state, char* buf, size_t size, const char* ty
     }
 }
 
+/* Fill buf with random characters from charset (alphanumerics if NULL) */
+void state_rand_string(system_state_t* state, char* buf, size_t size, const char* charset) {
+    if (!buf || size == 0) return;
+    if (!charset || !*charset) {
+        charset = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+    }
+    uint32_t count = (uint32_t)strlen(charset);
+    for (size_t i = 0; i + 1 < size; i++) {
+        buf[i] = charset[state_rand_between(state, 0, count - 1)];
+    }
+    buf[size - 1] = '\0';
+}
+
 /* Generate random MAC address */
 void state_rand_mac(system_state_t* state, char* buf, size_t size, const char* prefix) {
     if (!buf || size < 18) return;
@@ -275,15 +377,19 @@ int state_get_builtin_profile(device_profile_t* profile, const char* name) {
     return name ? -1 : 0;
 }
 
-const char** state_list_builtin_profiles(int* count) {
-    static const char* names[16];
-    
+static const char* builtin_profile_names[16];
+static pthread_once_t builtin_profile_names_once = PTHREAD_ONCE_INIT;
+
+static void fill_builtin_profile_names(void) {
     for (int i = 0; i < builtin_profile_count && i < 16; i++) {
-        names[i] = builtin_profiles[i].name;
+        builtin_profile_names[i] = builtin_profiles[i].name;
     }
-    
+}
+
+const char** state_list_builtin_profiles(int* count) {
+    pthread_once(&builtin_profile_names_once, fill_builtin_profile_names);
     if (count) *count = builtin_profile_count;
-    return names;
+    return builtin_profile_names;
 }
 
 /* ============================================================================
@@ -382,18 +488,21 @@ static void init_users(system_state_t* state) {
 
 static void init_processes(system_state_t* state) {
     state->process_count = 0;
-    state->next_pid = state_rand_between(state, 1, 500);
     
-    /* Kernel threads - always first, low PIDs */
+    /* Kernel threads - always first, low PIDs. init is 1 and kthreadd 2
+     * (the ppid of every other kernel thread); the rest follow in boot
+     * order with the gaps short-lived early tasks leave. */
     const char* kernel_threads[] = {
         "init", "kthreadd", "ksoftirqd/0", "kworker/0:0", "kswapd0",
         "watchdog/0", "kdevtmpfs"
     };
     
+    pid_t pid = 0;
     int num_kernel = state_rand_between(state, 5, 7);
     for (int i = 0; i < num_kernel && state->process_count < MAX_STATE_PROCESSES; i++) {
         state_process_t* proc = &state->processes[state->process_count++];
-        proc->pid = (i == 0) ? 1 : state_rand_between(state, 2, 50);
+        pid = (i <= 1) ? i + 1 : pid + (pid_t)state_rand_between(state, 1, 8);
+        proc->pid = pid;
         proc->ppid = (i <= 1) ? 0 : 2;
         proc->uid = 0;
         proc->gid = 0;
@@ -447,13 +556,14 @@ static void init_processes(system_state_t* state) {
         num_services = sizeof(router_services) / sizeof(router_services[0]);
     }
     
-    /* Add random subset of services */
+    /* Add random subset of services, above the kernel threads and in
+     * ascending order, so no two processes share a PID */
+    state->next_pid = pid + (pid_t)state_rand_between(state, 50, 450);
     int services_to_add = state_rand_between(state, 3, num_services);
     for (int i = 0; i < services_to_add && state->process_count < MAX_STATE_PROCESSES; i++) {
         state_process_t* proc = &state->processes[state->process_count++];
         proc->pid = state->next_pid;
         state->next_pid += state_rand_between(state, 1, 100);
-        if (state->next_pid > 32000) state->next_pid = state_rand_between(state, 1000, 2000);
         
         proc->ppid = 1; /* Child of init */
         proc->uid = (strcmp(services[i].name, "dropbear") == 0) ? 0 : 
@@ -589,8 +699,207 @@ static void init_network(system_state_t* state) {
  * FILESYSTEM INITIALIZATION  
  * ============================================================================ */
 
+/* ----------------------------------------------------------------------------
+ * Base file tree
+ * 
+ * What `ls /` and `find /` show before the attacker touches anything: a
+ * BusyBox-style firmware image. Almost everything was written when the
+ * firmware was built, long before boot; config and runtime files change
+ * after boot. Timestamps are offsets from boot_time like everything else.
+ * ---------------------------------------------------------------------------- */
+
+static state_file_t* add_file_record(system_state_t* state, const char* path, file_type_t type,
+                                     uid_t owner, mode_t perms);
+
+static state_file_t* add_entry(system_state_t* state, const char* path, file_type_t type,
+                               mode_t perms, off_t size, int32_t mtime_offset) {
+    state_file_t* f = add_file_record(state, path, type, 0, perms);
+    if (!f) return NULL;
+    if (type != FILE_TYPE_DIRECTORY) f->size = size;
+    f->mtime_offset = mtime_offset;
+    f->ctime_offset = mtime_offset;
+    f->atime_offset = mtime_offset;
+    return f;
+}
+
+/* Serve a record's content from its registered generator, if it has one */
+static void attach_generator(state_file_t* f) {
+    if (!f) return;
+    f->content_generator = (uint16_t)state_content_find(f->path);
+    f->has_dynamic_content = f->content_generator != 0;
+}
+
+static void add_symlink(system_state_t* state, const char* path, const char* target,
+                        int32_t mtime_offset) {
+    state_file_t* f = add_entry(state, path, FILE_TYPE_SYMLINK, 0777,
+                                (off_t)strlen(target), mtime_offset);
+    if (f) strncpy(f->link_target, target, MAX_PATH_LENGTH - 1);
+}
+
+static void add_device(system_state_t* state, const char* path, file_type_t type,
+                       mode_t perms, uint32_t major, uint32_t minor) {
+    /* devtmpfs is populated at boot */
+    state_file_t* f = add_entry(state, path, type, perms, 0, 0);
+    if (f) {
+        f->device_major = major;
+        f->device_minor = minor;
+    }
+}
+
+static void init_base_tree(system_state_t* state) {
+    /* Firmware build: 1 month to 3 years before boot */
+    int32_t built = -(int32_t)state_rand_between(state, 30, 1100) * 86400 -
+                    (int32_t)state_rand_between(state, 0, 86399);
+    bool router = state->profile.type == DEVICE_TYPE_ROUTER;
+    
+    static const char* const dirs[] = {
+        "/", "/bin", "/dev", "/dev/pts", "/etc", "/etc/init.d", "/home", "/lib", "/mnt",
+        "/proc", "/root", "/sbin", "/sys", "/usr", "/usr/bin", "/usr/lib", "/usr/sbin",
+        "/usr/share", "/var", "/var/log", "/var/run", "/var/lock"
+    };
+    for (size_t i = 0; i < sizeof(dirs) / sizeof(dirs[0]); i++) {
+        add_entry(state, dirs[i], FILE_TYPE_DIRECTORY, 0755, 0, built);
+    }
+    add_entry(state, "/tmp", FILE_TYPE_DIRECTORY, 01777, 0, 0);
+    state_file_t* root_home = state_get_file(state, "/root");
+    if (root_home) root_home->permissions = 0700;
+    
+    /* Home directories of login users */
+    for (int i = 0; i < state->user_count; i++) {
+        const state_user_t* u = &state->users[i];
+        if (!u->can_login || u->uid == 0) continue;
+        state_file_t* home = add_entry(state, u->home_dir, FILE_TYPE_DIRECTORY, 0755, 0, built);
+        if (home) {
+            home->owner = u->uid;
+            home->group = u->gid;
+        }
+    }
+    
+    /* BusyBox and its applets */
+    add_entry(state, "/bin/busybox", FILE_TYPE_REGULAR, 0755,
+              state_rand_between(state, 380000, 920000), built);
+    static const char* const applets[] = {
+        "/bin/ash", "/bin/cat", "/bin/chmod", "/bin/cp", "/bin/date", "/bin/dd", "/bin/df",
+        "/bin/dmesg", "/bin/echo", "/bin/grep", "/bin/kill", "/bin/ln", "/bin/ls", "/bin/mkdir",
+        "/bin/mount", "/bin/mv", "/bin/netstat", "/bin/ping", "/bin/ps", "/bin/pwd", "/bin/rm",
+        "/bin/sed", "/bin/sh", "/bin/sleep", "/bin/sync", "/bin/tar", "/bin/touch", "/bin/umount",
+        "/bin/uname", "/bin/vi",
+        "/sbin/halt", "/sbin/ifconfig", "/sbin/init", "/sbin/klogd", "/sbin/poweroff",
+        "/sbin/reboot", "/sbin/route", "/sbin/syslogd",
+        "/usr/bin/awk", "/usr/bin/basename", "/usr/bin/cut", "/usr/bin/env", "/usr/bin/free",
+        "/usr/bin/head", "/usr/bin/id", "/usr/bin/killall", "/usr/bin/md5sum", "/usr/bin/nslookup",
+        "/usr/bin/tail", "/usr/bin/tftp", "/usr/bin/top", "/usr/bin/uptime", "/usr/bin/wc",
+        "/usr/bin/wget", "/usr/bin/which",
+        "/usr/sbin/brctl", "/usr/sbin/crond", "/usr/sbin/ntpd", "/usr/sbin/telnetd"
+    };
+    for (size_t i = 0; i < sizeof(applets) / sizeof(applets[0]); i++) {
+        const char* target = strncmp(applets[i], "/usr/", 5) == 0 ? "../../bin/busybox" :
+                             strncmp(applets[i], "/sbin/", 6) == 0 ? "../bin/busybox" : "busybox";
+        add_symlink(state, applets[i], target, built);
+    }
+    
+    /* C library */
+    add_entry(state, "/lib/ld-uClibc-0.9.33.2.so", FILE_TYPE_REGULAR, 0755, 28716, built);
+    add_symlink(state, "/lib/ld-uClibc.so.0", "ld-uClibc-0.9.33.2.so", built);
+    add_entry(state, "/lib/libuClibc-0.9.33.2.so", FILE_TYPE_REGULAR, 0755, 381020, built);
+    add_symlink(state, "/lib/libc.so.0", "libuClibc-0.9.33.2.so", built);
+    add_entry(state, "/lib/libgcc_s.so.1", FILE_TYPE_REGULAR, 0644, 84604, built);
+    add_entry(state, "/lib/libm-0.9.33.2.so", FILE_TYPE_REGULAR, 0755, 77192, built);
+    add_symlink(state, "/lib/libm.so.0", "libm-0.9.33.2.so", built);
+    add_entry(state, "/lib/libpthread-0.9.33.2.so", FILE_TYPE_REGULAR, 0755, 66984, built);
+    add_symlink(state, "/lib/libpthread.so.0", "libpthread-0.9.33.2.so", built);
+    
+    /* Service binaries, init scripts and pid files follow the process list */
+    for (int i = 0; i < state->process_count; i++) {
+        const state_process_t* p = &state->processes[i];
+        if (p->is_kernel_thread || p->cmdline[0] != '/') continue;
+        
+        char path[MAX_PATH_LENGTH];
+        snprintf(path, sizeof(path), "%s", p->cmdline);
+        char* space = strchr(path, ' ');
+        if (space) *space = '\0';
+        if (!state_lookup_file(state, path)) {
+            add_entry(state, path, FILE_TYPE_REGULAR, 0755,
+                      state_rand_between(state, 20000, 600000), built);
+        }
+        
+        snprintf(path, sizeof(path), "/etc/init.d/%s", p->name);
+        add_entry(state, path, FILE_TYPE_REGULAR, 0755, state_rand_between(state, 300, 2400), built);
+        snprintf(path, sizeof(path), "/var/run/%s.pid", p->name);
+        add_entry(state, path, FILE_TYPE_REGULAR, 0644, 5, (int32_t)p->start_time_offset);
+    }
+    
+    /* Configuration */
+    static const struct { const char* path; mode_t perms; off_t size; bool after_boot; } etc[] = {
+        {"/etc/passwd", 0644, 0, false},     {"/etc/shadow", 0600, 0, false},
+        {"/etc/group", 0644, 0, false},      {"/etc/hostname", 0644, 0, true},
+        {"/etc/hosts", 0644, 0, true},       {"/etc/resolv.conf", 0644, 0, true},
+        {"/etc/inittab", 0644, 412, false},  {"/etc/profile", 0644, 1164, false},
+        {"/etc/shells", 0644, 25, false},    {"/etc/fstab", 0644, 187, false},
+        {"/etc/banner", 0644, 0, false},     {"/etc/TZ", 0644, 7, false}
+    };
+    for (size_t i = 0; i < sizeof(etc) / sizeof(etc[0]); i++) {
+        off_t size = etc[i].size ? etc[i].size : state_rand_between(state, 60, 900);
+        attach_generator(add_entry(state, etc[i].path, FILE_TYPE_REGULAR, etc[i].perms, size,
+                                   etc[i].after_boot ? (int32_t)state_rand_between(state, 10, 60)
+                                                     : built));
+    }
+    if (router) {
+        static const char* const uci[] = {
+            "network", "wireless", "dhcp", "firewall", "system", "dropbear"
+        };
+        for (size_t i = 0; i < sizeof(uci) / sizeof(uci[0]); i++) {
+            char path[MAX_PATH_LENGTH];
+            snprintf(path, sizeof(path), "/etc/config/%s", uci[i]);
+            add_entry(state, path, FILE_TYPE_REGULAR, 0644, state_rand_between(state, 200, 3000),
+                      built + (int32_t)state_rand_between(state, 0, (uint32_t)-built));
+        }
+        add_entry(state, "/www", FILE_TYPE_DIRECTORY, 0755, 0, built);
+        add_entry(state, "/www/index.html", FILE_TYPE_REGULAR, 0644, 495, built);
+        add_entry(state, "/www/cgi-bin", FILE_TYPE_DIRECTORY, 0755, 0, built);
+        add_entry(state, "/www/cgi-bin/luci", FILE_TYPE_REGULAR, 0755, 88, built);
+    } else {
+        add_entry(state, "/mnt/mtd", FILE_TYPE_DIRECTORY, 0755, 0, built);
+        add_entry(state, "/mnt/mtd/Config", FILE_TYPE_DIRECTORY, 0755, 0, 20);
+        add_entry(state, "/mnt/mtd/Config/network", FILE_TYPE_REGULAR, 0644,
+                  state_rand_between(state, 400, 2000), 20);
+    }
+    
+    /* Device nodes */
+    static const struct { const char* path; uint32_t major, minor; mode_t perms; } chars[] = {
+        {"/dev/null", 1, 3, 0666},   {"/dev/zero", 1, 5, 0666},    {"/dev/random", 1, 8, 0666},
+        {"/dev/urandom", 1, 9, 0666}, {"/dev/tty", 5, 0, 0666},    {"/dev/console", 5, 1, 0600},
+        {"/dev/ptmx", 5, 2, 0666},   {"/dev/ttyS0", 4, 64, 0660}, {"/dev/watchdog", 10, 130, 0600}
+    };
+    for (size_t i = 0; i < sizeof(chars) / sizeof(chars[0]); i++) {
+        add_device(state, chars[i].path, FILE_TYPE_DEVICE_CHAR, chars[i].perms,
+                   chars[i].major, chars[i].minor);
+    }
+    for (uint32_t i = 0; i < 6; i++) {
+        char path[MAX_PATH_LENGTH];
+        snprintf(path, sizeof(path), "/dev/mtd%u", i);
+        add_device(state, path, FILE_TYPE_DEVICE_CHAR, 0600, 90, i * 2);
+        snprintf(path, sizeof(path), "/dev/mtdblock%u", i);
+        add_device(state, path, FILE_TYPE_DEVICE_BLOCK, 0600, 31, i);
+    }
+    
+    /* /proc files are generated on read */
+    static const char* const proc_files[] = {
+        "/proc/cpuinfo", "/proc/loadavg", "/proc/meminfo", "/proc/mounts", "/proc/net/dev",
+        "/proc/stat", "/proc/uptime", "/proc/version"
+    };
+    for (size_t i = 0; i < sizeof(proc_files) / sizeof(proc_files[0]); i++) {
+        attach_generator(add_entry(state, proc_files[i], FILE_TYPE_REGULAR, 0444, 0,
+                                   (int32_t)state->uptime_seconds));
+    }
+    
+    add_entry(state, "/var/log/messages", FILE_TYPE_REGULAR, 0644,
+              state_rand_between(state, 2000, 60000), (int32_t)state->uptime_seconds);
+}
+
 static void init_filesystem(system_state_t* state) {
     state->file_count = 0;
+    path_index_clear(&state->file_index);
     state->mount_count = 0;
     
     /* Root mount - always present */
@@ -633,6 +942,8 @@ static void init_filesystem(system_state_t* state) {
     sys_mount->total_kb = 0;
     sys_mount->used_kb = 0;
     sys_mount->available_kb = 0;
+    
+    init_base_tree(state);
 }
 
 /* ============================================================================
@@ -643,19 +954,65 @@ static void init_filesystem(system_state_t* state) {
  * All these values are CALCULATED from the state, not random!
  */
 
-static void calculate_memory_usage(system_state_t* state) {
-    /* Memory usage = sum of all process memory + kernel overhead */
-    uint32_t process_memory = 0;
+/*
+ * Derived values carry a little noise so that two devices with the same
+ * processes do not report identical numbers. Drawing it from the state's
+ * stream made every recalculation jitter; instead it is a hash of the
+ * seed, a five-minute epoch of uptime and a per-value salt. Values that
+ * real systems hold steady (kernel overhead) leave the epoch out. Crossing
+ * into a new epoch marks the derived groups dirty, so they are redrawn.
+ */
+#define NOISE_EPOCH_SECONDS     300
+
+enum {
+    NOISE_KERNEL = 1, NOISE_CACHED, NOISE_BUFFERS, NOISE_LOAD_1, NOISE_LOAD_5, NOISE_LOAD_15,
+    NOISE_CPU, NOISE_IDLE, NOISE_DIRTY_PAGES, NOISE_MAPPED, NOISE_SHMEM, NOISE_SLAB, NOISE_BOOT_STEP
+};
+
+static uint32_t noise_epoch(const system_state_t* state) {
+    return (uint32_t)(state->uptime_seconds / NOISE_EPOCH_SECONDS);
+}
+
+static uint32_t state_noise(const system_state_t* state, uint32_t epoch, uint32_t salt,
+                            uint32_t min, uint32_t max) {
+    if (min >= max) return min;
+    uint64_t x = ((uint64_t)state->state_seed << 32 | epoch) ^ ((uint64_t)salt << 56);
+    uint64_t range = (uint64_t)max - min + 1;
+    return min + (uint32_t)(((splitmix64(&x) >> 32) * range) >> 32);
+}
+
+void state_recount_processes(system_state_t* state) {
+    if (!state) return;
+    
+    state->process_memory_kb = 0;
+    state->process_cpu_percent = 0;
+    state->running_count = 0;
     for (int i = 0; i < state->process_count; i++) {
-        process_memory += state->processes[i].memory_kb;
+        state->process_memory_kb += state->processes[i].memory_kb;
+        state->process_cpu_percent += state->processes[i].cpu_percent;
+        if (state->processes[i].state == PROC_STATE_RUNNING) state->running_count++;
     }
+    state->dirty = STATE_DIRTY_ALL;
+}
+
+/* Keep the running sums in step with one process joining (sign 1) or leaving (-1) */
+static void count_process(system_state_t* state, const state_process_t* p, int sign) {
+    state->process_memory_kb += (uint32_t)sign * p->memory_kb;
+    state->process_cpu_percent += (uint32_t)sign * p->cpu_percent;
+    if (p->state == PROC_STATE_RUNNING) state->running_count += (uint16_t)sign;
+    state->dirty |= STATE_DIRTY_ALL;
+}
+
+static void calculate_memory_usage(system_state_t* state) {
+    /* Memory usage = sum of all process memory + kernel overhead */
+    uint32_t epoch = noise_epoch(state);
     
     /* Add kernel overhead (typically 10-20% on embedded) */
     uint32_t kernel_overhead = state->profile.total_ram_kb * 
-                               state_rand_between(state, 10, 20) / 100;
+                               state_noise(state, 0, NOISE_KERNEL, 10, 20) / 100;
     
     state->total_memory_kb = state->profile.total_ram_kb;
-    state->used_memory_kb = process_memory + kernel_overhead;
+    state->used_memory_kb = state->process_memory_kb + kernel_overhead;
     
     /* Clamp to not exceed total */
     if (state->used_memory_kb > state->total_memory_kb * 95 / 100) {
@@ -664,42 +1021,122 @@ static void calculate_memory_usage(system_state_t* state) {
     
     /* Cache and buffers (typically 10-30% of free memory) */
     uint32_t free_mem = state->total_memory_kb - state->used_memory_kb;
-    state->cached_memory_kb = free_mem * state_rand_between(state, 15, 30) / 100;
-    state->buffer_memory_kb = free_mem * state_rand_between(state, 5, 15) / 100;
+    state->cached_memory_kb = free_mem * state_noise(state, epoch, NOISE_CACHED, 15, 30) / 100;
+    state->buffer_memory_kb = free_mem * state_noise(state, epoch, NOISE_BUFFERS, 5, 15) / 100;
 }
 
 static void calculate_load_average(system_state_t* state) {
     /* Load average = running processes / CPU cores (roughly) */
-    int running = 0;
-    for (int i = 0; i < state->process_count; i++) {
-        if (state->processes[i].state == PROC_STATE_RUNNING) {
-            running++;
-        }
-    }
+    uint32_t epoch = noise_epoch(state);
     
     /* Load is usually low on IoT devices */
-    float base_load = (float)running / (float)state->profile.cpu_cores;
+    float base_load = (float)state->running_count / (float)state->profile.cpu_cores;
     
-    /* Add some variation, stored as fixed point (x100) */
-    state->load_avg_1 = (uint16_t)((base_load + 0.01f * state_rand_between(state, 0, 50)) * 100);
-    state->load_avg_5 = (uint16_t)((base_load + 0.01f * state_rand_between(state, 0, 30)) * 100);
-    state->load_avg_15 = (uint16_t)((base_load + 0.01f * state_rand_between(state, 0, 20)) * 100);
+    /* Add some variation, stored as fixed point (x100). These are targets:
+     * the simulation clock moves the load averages toward them. */
+    state->load_target_1 = (uint16_t)((base_load + 0.01f * state_noise(state, epoch, NOISE_LOAD_1, 0, 50)) * 100);
+    state->load_target_5 = (uint16_t)((base_load + 0.01f * state_noise(state, epoch, NOISE_LOAD_5, 0, 30)) * 100);
+    state->load_target_15 = (uint16_t)((base_load + 0.01f * state_noise(state, epoch, NOISE_LOAD_15, 0, 20)) * 100);
     
     /* Clamp to reasonable values for IoT */
-    if (state->load_avg_1 > 500) state->load_avg_1 = state_rand_between(state, 10, 100);
-    if (state->load_avg_5 > 400) state->load_avg_5 = state_rand_between(state, 10, 80);
-    if (state->load_avg_15 > 300) state->load_avg_15 = state_rand_between(state, 5, 60);
+    if (state->load_target_1 > 500) state->load_target_1 = state_noise(state, epoch, NOISE_LOAD_1, 10, 100);
+    if (state->load_target_5 > 400) state->load_target_5 = state_noise(state, epoch, NOISE_LOAD_5, 10, 80);
+    if (state->load_target_15 > 300) state->load_target_15 = state_noise(state, epoch, NOISE_LOAD_15, 5, 60);
 }
 
 static void calculate_cpu_usage(system_state_t* state) {
     /* CPU usage = sum of process CPU percentages (capped) */
-    uint32_t total_cpu = 0;
+    uint32_t total_cpu = state->process_cpu_percent;
+    
+    /* Normalize to 0-100 range */
+    state->cpu_usage_percent = (total_cpu > 100) ? state_noise(state, noise_epoch(state), NOISE_CPU, 5, 30)
+                                                 : total_cpu;
+}
+
+/* Recompute the dirty groups; returns true if any were */
+static bool calculate_derived(system_state_t* state) {
+    if (!state->dirty) return false;
+    
+    if (state->dirty & STATE_DIRTY_MEMORY) calculate_memory_usage(state);
+    if (state->dirty & STATE_DIRTY_LOAD) calculate_load_average(state);
+    if (state->dirty & STATE_DIRTY_CPU) calculate_cpu_usage(state);
+    state->dirty = 0;
+    return true;
+}
+
+/* ============================================================================
+ * SIMULATION CLOCK
+ * ============================================================================
+ * 
+ * Nothing ticks in the background. Each read that updates uptime moves the
+ * time-driven values from sim_uptime to the new uptime in one step:
+ * - interface counters keep growing at their average rate since boot
+ * - each process gains cpu_percent of the elapsed time as CPU time
+ * - load averages decay toward their targets like the kernel's, by
+ *   exp(-elapsed / period) for periods of 1, 5 and 15 minutes
+ */
+
+/* x grown by the factor now / then, without overflowing 64 bits */
+static uint64_t scale_counter(uint64_t x, uint32_t then, uint32_t now) {
+    uint64_t dt = now - then;
+    return x + (x / then) * dt + (x % then) * dt / then;
+}
+
+static uint16_t decay_load(uint16_t load, uint16_t target, uint32_t dt, double period) {
+    double e = exp(-(double)dt / period);
+    return (uint16_t)lround(target + ((double)load - target) * e);
+}
+
+/* Process CPU time for a run of seconds; cpu_percent is % x10 */
+static uint32_t cpu_ms(const state_process_t* p, uint64_t seconds) {
+    uint64_t ms = seconds * p->cpu_percent;
+    return ms > UINT32_MAX ? UINT32_MAX : (uint32_t)ms;
+}
+
+static void advance_clock(system_state_t* state) {
+    uint32_t now = state->uptime_seconds;
+    uint32_t then = state->sim_uptime;
+    if (now <= then || then == 0) {
+        if (now < then || then == 0) state->sim_uptime = now;   /* Clock stepped back */
+        return;
+    }
+    uint32_t dt = now - then;
+    
+    for (int i = 0; i < state->interface_count; i++) {
+        state_interface_t* iface = &state->interfaces[i];
+        if (!iface->is_up) continue;
+        iface->rx_bytes = scale_counter(iface->rx_bytes, then, now);
+        iface->tx_bytes = scale_counter(iface->tx_bytes, then, now);
+        iface->rx_packets = scale_counter(iface->rx_packets, then, now);
+        iface->tx_packets = scale_counter(iface->tx_packets, then, now);
+    }
+    
     for (int i = 0; i < state->process_count; i++) {
-        total_cpu += state->processes[i].cpu_percent;
+        state_process_t* p = &state->processes[i];
+        if (p->state == PROC_STATE_ZOMBIE || p->state == PROC_STATE_STOPPED) continue;
+        uint32_t gain = cpu_ms(p, dt);
+        p->cpu_time_ms = (p->cpu_time_ms > UINT32_MAX - gain) ? UINT32_MAX : p->cpu_time_ms + gain;
     }
     
-    /* Normalize to 0-100 range */
-    state->cpu_usage_percent = (total_cpu > 100) ? state_rand_between(state, 5, 30) : total_cpu;
+    state->load_avg_1 = decay_load(state->load_avg_1, state->load_target_1, dt, 60.0);
+    state->load_avg_5 = decay_load(state->load_avg_5, state->load_target_5, dt, 300.0);
+    state->load_avg_15 = decay_load(state->load_avg_15, state->load_target_15, dt, 900.0);
+    
+    state->sim_uptime = now;
+    state_mark_changed(state, STATE_INPUT_NETWORK | STATE_INPUT_PROCESSES | STATE_INPUT_RESOURCES);
+}
+
+/* Start the clock on a freshly built state: settled load, CPU time so far */
+static void start_clock(system_state_t* state) {
+    for (int i = 0; i < state->process_count; i++) {
+        state_process_t* p = &state->processes[i];
+        uint32_t start = p->start_time_offset;
+        p->cpu_time_ms = cpu_ms(p, state->uptime_seconds > start ? state->uptime_seconds - start : 0);
+    }
+    state->load_avg_1 = state->load_target_1;
+    state->load_avg_5 = state->load_target_5;
+    state->load_avg_15 = state->load_target_15;
+    state->sim_uptime = state->uptime_seconds;
 }
 
 /* ============================================================================
@@ -714,6 +1151,7 @@ int state_engine_init(system_state_t* state, const device_profile_t* profile) {
     
     /* Clear everything */
     memset(state, 0, sizeof(system_state_t));
+    if (path_index_init(&state->file_index) != 0) return -1;
     
     /* Copy profile */
     if (profile) {
@@ -723,9 +1161,8 @@ int state_engine_init(system_state_t* state, const device_profile_t* profile) {
         state_get_builtin_profile(&state->profile, NULL);
     }
     
-    /* Generate initial seed */
-    state->state_seed = (uint32_t)time(NULL) ^ (uint32_t)getpid();
-    prng_seed(state->state_seed);
+    /* Generate initial seed - unique per state, even for states created together */
+    seed_state(state, state_new_seed());
     
     /* Set boot time (1-90 days ago for IoT device) */
     int days_ago = state_rand_between(state, 1, 90);
@@ -754,12 +1191,12 @@ int state_engine_init(system_state_t* state, const device_profile_t* profile) {
     init_filesystem(state);
     
     /* Calculate derived values - THE CORRELATION */
-    calculate_memory_usage(state);
-    calculate_load_average(state);
-    calculate_cpu_usage(state);
+    state_recount_processes(state);
+    calculate_derived(state);
+    start_clock(state);
     
     state->is_initialized = true;
-    state->needs_recalculation = false;
+    state_mark_changed(state, STATE_INPUT_ALL);
     
     return 0;
 }
@@ -770,18 +1207,46 @@ int state_engine_init(system_state_t* state, const device_profile_t* profile) {
 void state_engine_destroy(system_state_t* state) {
     if (!state) return;
     
+    free(state->files);
+    path_index_free(&state->file_index);
+    state_content_free(state);
+    
     /* Clear sensitive data */
     memset(state, 0, sizeof(system_state_t));
     state->is_initialized = false;
 }
 
+size_t state_engine_memory_usage(const system_state_t* state) {
+    if (!state) return 0;
+    return sizeof(system_state_t) + (size_t)state->file_capacity * sizeof(state_file_t) +
+           path_index_memory_usage(&state->file_index) + state_content_memory_usage(state);
+}
+
+void state_mark_changed(system_state_t* state, uint32_t inputs) {
+    if (!state) return;
+    
+    if (++state->state_version == 0) {
+        /* Wrapped: no stamp can be compared any more */
+        state_content_invalidate(state);
+        state->state_version = 1;
+        inputs = STATE_INPUT_ALL;
+    }
+    for (int i = 0; i < STATE_INPUT_COUNT; i++) {
+        if (inputs & (1u << i)) state->input_version[i] = state->state_version;
+    }
+}
+
 /**
  * Update uptime based on current time
  */
 void state_engine_update_time(system_state_t* state) {
     if (!state || !state->is_initialized) return;
     
+    uint32_t epoch = noise_epoch(state);
     state->uptime_seconds = time(NULL) - state->boot_time;
+    /* The noise moved on: derived values keyed on the old epoch are stale */
+    if (noise_epoch(state) != epoch) state->dirty |= STATE_DIRTY_ALL;
+    advance_clock(state);
 }
 
 /**
@@ -792,11 +1257,9 @@ void state_engine_recalculate(system_state_t* state) {
     if (!state || !state->is_initialized) return;
     
     state_engine_update_time(state);
-    calculate_memory_usage(state);
-    calculate_load_average(state);
-    calculate_cpu_usage(state);
-    
-    state->needs_recalculation = false;
+    if (calculate_derived(state)) {
+        state_mark_changed(state, STATE_INPUT_RESOURCES);
+    }
 }
 
 /**
@@ -811,8 +1274,7 @@ int state_engine_morph(system_state_t* state, uint32_t seed) {
     memcpy(&saved_profile, &state->profile, sizeof(device_profile_t));
     
     /* Re-initialize with new seed */
-    state->state_seed = seed ? seed : ((uint32_t)time(NULL) ^ state_rand(state));
-    prng_seed(state->state_seed);
+    seed_state(state, seed ? seed : state_new_seed());
     
     /* Clear counts but keep profile */
     state->user_count = 0;
@@ -844,10 +1306,11 @@ int state_engine_morph(system_state_t* state, uint32_t seed) {
     init_filesystem(state);
     
     /* Recalculate correlations */
-    calculate_memory_usage(state);
-    calculate_load_average(state);
-    calculate_cpu_usage(state);
+    state_recount_processes(state);
+    calculate_derived(state);
+    start_clock(state);
     
+    state_mark_changed(state, STATE_INPUT_ALL);
     return 0;
 }
 
@@ -865,173 +1328,655 @@ int state_engine_morph_to_profile(system_state_t* state, const device_profile_t*
 }
 
 /* ============================================================================
- * OUTPUT GENERATORS - Generate File Contents From State
+ * STATE MUTATION API - Attacker actions change the state
  * ============================================================================
  * 
- * These functions generate realistic file contents based on the current state.
- * They DON'T use random values - they DERIVE everything from state!
+ * Every change lands in the same arrays the generators read, so `touch`
+ * followed by `ls`, or `kill` followed by `ps`, stay consistent.
+ * Timestamps are stored relative to boot_time like everything else.
  */
 
+static int32_t seconds_since_boot(const system_state_t* state) {
+    return (int32_t)(time(NULL) - state->boot_time);
+}
+
+static const char* path_basename(const char* path) {
+    const char* slash = strrchr(path, '/');
+    return (slash && slash[1]) ? slash + 1 : path;
+}
+
+/* ----------------------------------------------------------------------------
+ * File table
+ * 
+ * Records live in a growable array; the path index maps each path to its
+ * slot. A deleted record keeps its slot (for forensics) and is reused if
+ * the same path is created again.
+ * ---------------------------------------------------------------------------- */
+
+static state_file_t* live_slot(const system_state_t* state, int32_t node) {
+    if (node == PATH_INDEX_NONE) return NULL;
+    int32_t slot = state->file_index.nodes[node].file;
+    if (slot == PATH_INDEX_NONE || state->files[slot].deleted) return NULL;
+    return &state->files[slot];
+}
+
+static int reserve_file_slot(system_state_t* state) {
+    if (state->file_count < state->file_capacity) return 0;
+    if (state->file_count >= MAX_STATE_FILES) return -1;
+    
+    int capacity = state->file_capacity ? state->file_capacity * 2 : 256;
+    state_file_t* files = realloc(state->files, (size_t)capacity * sizeof(state_file_t));
+    if (!files) return -1;
+    state->files = files;
+    state->file_capacity = capacity;
+    return 0;
+}
+
 /**
- * Generate /proc/uptime content
+ * Find a live (not deleted) file record
+ * The pointer is valid until the next file is added.
  */
-int state_generate_proc_uptime(system_state_t* state, char* buf, size_t size) {
-    if (!state || !buf || size < 32) return -1;
-    
-    state_engine_update_time(state);
-    
-    /* Format: uptime_seconds idle_seconds */
-    /* idle_seconds is typically 90-99% of uptime for IoT */
-    double uptime = (double)state->uptime_seconds;
-    double idle = uptime * (90 + (state_rand(state) % 10)) / 100.0;
-    
-    return snprintf(buf, size, "%.2f %.2f\n", uptime, idle);
+const state_file_t* state_lookup_file(const system_state_t* state, const char* path) {
+    if (!state || !path || !state->files) return NULL;
+    return live_slot(state, path_index_lookup(&state->file_index, path));
+}
+
+state_file_t* state_get_file(system_state_t* state, const char* path) {
+    return (state_file_t*)state_lookup_file(state, path);
+}
+
+bool state_file_exists(system_state_t* state, const char* path) {
+    return state_lookup_file(state, path) != NULL;
 }
 
 /**
- * Generate /proc/meminfo content
- * THIS IS WHERE CORRELATION SHINES - values derived from process memory!
+ * Fill a file record the way a fresh create would
+ * Shared with the overlay layer, which builds records outside any state.
  */
-int state_generate_proc_meminfo(system_state_t* state, char* buf, size_t size) {
-    if (!state || !buf || size < 512) return -1;
+void state_init_file_record(const system_state_t* state, state_file_t* f, const char* path,
+                            file_type_t type, uid_t owner, mode_t perms) {
+    memset(f, 0, sizeof(state_file_t));
+    strncpy(f->path, path, MAX_PATH_LENGTH - 1);
+    strncpy(f->name, path_basename(path), MAX_NAME_LENGTH - 1);
+    f->type = type;
+    f->permissions = perms;
+    f->owner = owner;
+    f->group = owner;
+    f->size = (type == FILE_TYPE_DIRECTORY) ? 4096 : 0;
+    
+    int32_t now = seconds_since_boot(state);
+    f->atime_offset = now;
+    f->mtime_offset = now;
+    f->ctime_offset = now;
+}
+
+int state_append_file_record(system_state_t* state, const state_file_t* record) {
+    if (!state || !record || reserve_file_slot(state) != 0) return -1;
     
-    uint32_t total = state->total_memory_kb;
-    uint32_t free = total - state->used_memory_kb;
-    uint32_t buffers = state->buffer_memory_kb;
-    uint32_t cached = state->cached_memory_kb;
-    uint32_t available = free + buffers + cached;
+    int32_t node = path_index_insert(&state->file_index, record->path);
+    if (node == PATH_INDEX_NONE) return -1;
     
-    /* Swap is usually 0 on IoT */
-    uint32_t swap_total = 0;
-    uint32_t swap_free = 0;
+    int32_t slot = state->file_count++;
+    state->files[slot] = *record;
     
-    return snprintf(buf, size,
-        "MemTotal:       %8u kB\n"
-        "MemFree:        %8u kB\n"
-        "MemAvailable:   %8u kB\n"
-        "Buffers:        %8u kB\n"
-        "Cached:         %8u kB\n"
-        "SwapCached:     %8u kB\n"
-        "Active:         %8u kB\n"
-        "Inactive:       %8u kB\n"
-        "SwapTotal:      %8u kB\n"
-        "SwapFree:       %8u kB\n"
-        "Dirty:          %8u kB\n"
-        "Writeback:      %8u kB\n"
-        "AnonPages:      %8u kB\n"
-        "Mapped:         %8u kB\n"
-        "Shmem:          %8u kB\n"
-        "Slab:           %8u kB\n",
-        total,
-        free,
-        available,
-        buffers,
-        cached,
-        0,  /* SwapCached */
-        state->used_memory_kb * 60 / 100,  /* Active ~60% of used */
-        state->used_memory_kb * 40 / 100,  /* Inactive ~40% of used */
-        swap_total,
-        swap_free,
-        state_rand_between(state, 0, 100),  /* Dirty */
-        0,  /* Writeback */
-        state->used_memory_kb * 50 / 100,  /* AnonPages */
-        state_rand_between(state, 1000, 5000),  /* Mapped */
-        state_rand_between(state, 100, 500),    /* Shmem */
-        state_rand_between(state, 1000, 3000)   /* Slab */
-    );
+    /* A deleted record only claims the path if nothing else has */
+    path_node_t* n = &state->file_index.nodes[node];
+    if (!record->deleted || n->file == PATH_INDEX_NONE || state->files[n->file].deleted) {
+        n->file = slot;
+    }
+    return 0;
 }
 
-/**
- * Generate /proc/loadavg content
- * Derived from running process count!
- */
-int state_generate_proc_loadavg(system_state_t* state, char* buf, size_t size) {
-    if (!state || !buf || size < 64) return -1;
+/* Create (or revive) the record for node, whose path is known to be free */
+static state_file_t* create_at_node(system_state_t* state, int32_t node, file_type_t type,
+                                    uid_t owner, mode_t perms) {
+    char path[MAX_PATH_LENGTH];
+    if (path_index_path(&state->file_index, node, path, sizeof(path)) < 0) return NULL;
+    
+    int32_t slot = state->file_index.nodes[node].file;
+    if (slot == PATH_INDEX_NONE) {
+        if (reserve_file_slot(state) != 0) return NULL;
+        slot = state->file_count++;
+        state->file_index.nodes[node].file = slot;
+    }
     
-    /* Count running processes for the fraction */
-    int running = 0;
-    for (int i = 0; i < state->process_count; i++) {
-        if (state->processes[i].state == PROC_STATE_RUNNING) {
-            running++;
+    state_file_t* f = &state->files[slot];
+    state_init_file_record(state, f, path, type, owner, perms);
+    return f;
+}
+
+/* Add a record at path, creating missing parent directories like mkdir -p */
+static state_file_t* add_file_record(system_state_t* state, const char* path, file_type_t type,
+                                     uid_t owner, mode_t perms) {
+    if (!state->files && reserve_file_slot(state) != 0) return NULL;
+    
+    int32_t node = path_index_insert(&state->file_index, path);
+    if (node == PATH_INDEX_NONE || live_slot(state, node)) return NULL;
+    
+    /* Topmost missing ancestor first. Every component takes at least two
+     * characters ("/x"), so a path that fits MAX_PATH_LENGTH fits here. */
+    int32_t missing[MAX_PATH_LENGTH / 2];
+    int depth = 0;
+    int32_t p = state->file_index.nodes[node].parent;
+    for (; p != PATH_INDEX_NONE && !live_slot(state, p); p = state->file_index.nodes[p].parent) {
+        if (depth == (int)(sizeof(missing) / sizeof(missing[0]))) return NULL;
+        missing[depth++] = p;
+    }
+    while (depth > 0) {
+        if (!create_at_node(state, missing[--depth], FILE_TYPE_DIRECTORY, owner, 0755)) {
+            return NULL;
         }
     }
-    if (running == 0) running = 1;
     
-    /* Format: load1 load5 load15 running/total last_pid */
-    return snprintf(buf, size, "%.2f %.2f %.2f %d/%d %d\n",
-        state->load_avg_1 / 100.0,
-        state->load_avg_5 / 100.0,
-        state->load_avg_15 / 100.0,
-        running,
-        state->process_count,
-        state->next_pid - 1
-    );
+    return create_at_node(state, node, type, owner, perms);
 }
 
-/**
- * Generate /etc/passwd content
- * Derived from user list!
- */
-int state_generate_passwd(system_state_t* state, char* buf, size_t size) {
-    if (!state || !buf || size < 256) return -1;
+int state_add_file(system_state_t* state, const char* path, file_type_t type, 
+                   uid_t owner, mode_t perms) {
+    if (!state || !path || path[0] != '/') return -1;
     
-    int written = 0;
-    for (int i = 0; i < state->user_count && written < (int)size - 100; i++) {
-        state_user_t* u = &state->users[i];
-        int len = snprintf(buf + written, size - written,
-            "%s:x:%d:%d:%s:%s:%s\n",
-            u->username,
-            u->uid,
-            u->gid,
-            u->gecos,
-            u->home_dir,
-            u->shell
-        );
-        if (len > 0) written += len;
-    }
+    state_file_t* f = add_file_record(state, path, type, owner, perms);
+    if (!f) return -1;
     
-    return written;
+    if (state->has_active_session) {
+        f->created_by_attacker = true;
+        state->current_session.files_created++;
+    }
+    state_mark_changed(state, STATE_INPUT_FILES);
+    return 0;
+}
+
+typedef struct {
+    system_state_t* state;
+    int32_t ctime;
+} remove_walk_t;
+
+static int mark_deleted(const path_index_t* index, int32_t node, int depth, void* ctx) {
+    (void)index;
+    (void)depth;
+    remove_walk_t* walk = ctx;
+    state_file_t* f = live_slot(walk->state, node);
+    if (f) {
+        f->deleted = true;
+        f->ctime_offset = walk->ctime;
+    }
+    return 0;
 }
 
 /**
- * Generate /etc/shadow content (fake hashes)
+ * Remove a file; a directory goes with everything under it (rm -r)
  */
-int state_generate_shadow(system_state_t* state, char* buf, size_t size) {
-    if (!state || !buf || size < 256) return -1;
+int state_remove_file(system_state_t* state, const char* path) {
+    if (!state || !path || !state->files) return -1;
     
-    int written = 0;
-    for (int i = 0; i < state->user_count && written < (int)size - 150; i++) {
-        state_user_t* u = &state->users[i];
+    int32_t node = path_index_lookup(&state->file_index, path);
+    if (node == PATH_INDEX_ROOT || !live_slot(state, node)) return -1;
+    
+    /* Soft delete: the records stay for forensics, but nothing shows them */
+    remove_walk_t walk = { state, seconds_since_boot(state) };
+    path_index_walk(&state->file_index, node, mark_deleted, &walk);
+    
+    if (state->has_active_session) {
+        state->current_session.files_deleted++;
+    }
+    state_mark_changed(state, STATE_INPUT_FILES);
+    return 0;
+}
+
+int state_modify_file(system_state_t* state, const char* path, off_t new_size) {
+    state_file_t* f = state_get_file(state, path);
+    if (!f || new_size < 0) return -1;
+    
+    f->size = new_size;
+    f->mtime_offset = seconds_since_boot(state);
+    f->ctime_offset = f->mtime_offset;
+    state_mark_changed(state, STATE_INPUT_FILES);
+    return 0;
+}
+
+/**
+ * Fill a process record for something the attacker started
+ */
+void state_init_process_record(const system_state_t* state, state_process_t* p, pid_t pid,
+                               const char* name, const char* cmdline, uid_t owner, pid_t ppid) {
+    memset(p, 0, sizeof(state_process_t));
+    p->pid = pid;
+    p->ppid = ppid;
+    p->uid = owner;
+    p->gid = owner;
+    strncpy(p->name, name, MAX_NAME_LENGTH - 1);
+    strncpy(p->cmdline, cmdline ? cmdline : name, MAX_CMDLINE_LENGTH - 1);
+    p->state = PROC_STATE_SLEEPING;
+    p->memory_kb = 256;
+    p->virtual_kb = 1024;
+    p->start_time_offset = (uint32_t)seconds_since_boot(state);
+    p->visible_in_ps = true;
+    strncpy(p->tty, "pts/0", sizeof(p->tty) - 1);
+}
+
+/**
+ * Start a process
+ * Returns the new PID, or -1 if the table is full.
+ */
+int state_add_process(system_state_t* state, const char* name, const char* cmdline,
+                      uid_t owner, pid_t ppid) {
+    if (!state || !name || !*name) return -1;
+    if (state->process_count >= MAX_STATE_PROCESSES) return -1;
+    
+    /* PIDs only move forward until they wrap, like the real allocator */
+    pid_t pid = state->next_pid;
+    do {
+        pid = (pid >= 32767) ? 300 : pid + 1;
+    } while (state_get_process(state, pid));
+    state->next_pid = pid;
+    
+    state_process_t* p = &state->processes[state->process_count++];
+    state_init_process_record(state, p, pid, name, cmdline, owner, ppid);
+    count_process(state, p, 1);
+    
+    if (state->has_active_session) {
+        state->current_session.processes_started++;
+    }
+    state_mark_changed(state, STATE_INPUT_PROCESSES);
+    return pid;
+}
+
+int state_kill_process(system_state_t* state, pid_t pid) {
+    if (!state || pid <= 1) return -1;  /* init can't be killed */
+    
+    for (int i = 0; i < state->process_count; i++) {
+        if (state->processes[i].pid != pid) continue;
+        count_process(state, &state->processes[i], -1);
+        
+        /* Keep the table in start order - ps output depends on it */
+        memmove(&state->processes[i], &state->processes[i + 1],
+                (size_t)(state->process_count - i - 1) * sizeof(state_process_t));
+        state->process_count--;
+        
+        /* Its sockets close with it */
+        for (int c = state->connection_count - 1; c >= 0; c--) {
+            if (state->connections[c].owner_pid == pid) {
+                state->connections[c] = state->connections[--state->connection_count];
+            }
+        }
+        state_mark_changed(state, STATE_INPUT_PROCESSES | STATE_INPUT_NETWORK);
+        return 0;
+    }
+    return -1;
+}
+
+state_process_t* state_get_process(system_state_t* state, pid_t pid) {
+    if (!state) return NULL;
+    
+    for (int i = 0; i < state->process_count; i++) {
+        if (state->processes[i].pid == pid) return &state->processes[i];
+    }
+    return NULL;
+}
+
+state_process_t* state_get_process_by_name(system_state_t* state, const char* name) {
+    if (!state || !name) return NULL;
+    
+    for (int i = 0; i < state->process_count; i++) {
+        if (strcmp(state->processes[i].name, name) == 0) return &state->processes[i];
+    }
+    return NULL;
+}
+
+int state_add_user(system_state_t* state, const char* username, uid_t uid, 
+                   const char* home, const char* shell) {
+    if (!state || !username || !*username) return -1;
+    if (state->user_count >= MAX_STATE_USERS) return -1;
+    if (state_get_user(state, username)) return -1;
+    
+    state_user_t* user = &state->users[state->user_count++];
+    memset(user, 0, sizeof(state_user_t));
+    strncpy(user->username, username, MAX_NAME_LENGTH - 1);
+    strncpy(user->password_hash, "!", sizeof(user->password_hash) - 1);  /* Locked until passwd */
+    user->uid = uid;
+    user->gid = uid;
+    strncpy(user->home_dir, home ? home : "/", MAX_PATH_LENGTH - 1);
+    strncpy(user->shell, shell ? shell : "/bin/sh", MAX_PATH_LENGTH - 1);
+    strncpy(user->gecos, username, MAX_NAME_LENGTH - 1);
+    user->is_system_user = uid < 1000;
+    user->can_login = strstr(user->shell, "false") == NULL && strstr(user->shell, "nologin") == NULL;
+    state_mark_changed(state, STATE_INPUT_USERS);
+    return 0;
+}
+
+state_user_t* state_get_user(system_state_t* state, const char* username) {
+    if (!state || !username) return NULL;
+    
+    for (int i = 0; i < state->user_count; i++) {
+        if (strcmp(state->users[i].username, username) == 0) return &state->users[i];
+    }
+    return NULL;
+}
+
+state_user_t* state_get_user_by_uid(system_state_t* state, uid_t uid) {
+    if (!state) return NULL;
+    
+    for (int i = 0; i < state->user_count; i++) {
+        if (state->users[i].uid == uid) return &state->users[i];
+    }
+    return NULL;
+}
+
+/**
+ * Fill a log entry; the facility follows from the service like syslog's
+ */
+void state_init_log_entry(const system_state_t* state, state_log_entry_t* entry,
+                          state_log_level_t level, const char* service, const char* message) {
+    memset(entry, 0, sizeof(state_log_entry_t));
+    entry->time_offset = seconds_since_boot(state);
+    entry->level = level;
+    strncpy(entry->service, service, MAX_NAME_LENGTH - 1);
+    strncpy(entry->message, message, MAX_LOG_MESSAGE - 1);
+    
+    const char* facility = "daemon";
+    if (strcmp(service, "kernel") == 0) {
+        facility = "kern";
+    } else if (strcmp(service, "dropbear") == 0 || strcmp(service, "sshd") == 0 ||
+               strcmp(service, "login") == 0 || strcmp(service, "telnetd") == 0) {
+        facility = "auth";
+    }
+    strncpy(entry->facility, facility, sizeof(entry->facility) - 1);
+}
+
+int state_add_log(system_state_t* state, state_log_level_t level, const char* service,
+                  const char* message) {
+    if (!state || !service || !message) return -1;
+    
+    state_log_entry_t entry;
+    state_init_log_entry(state, &entry, level, service, message);
+    return state_append_log_record(state, &entry);
+}
+
+int state_append_log_record(system_state_t* state, const state_log_entry_t* record) {
+    if (!state || !record) return -1;
+    
+    /* Circular: the oldest entry makes room */
+    state->logs[state->log_write_index] = *record;
+    state->log_write_index = (state->log_write_index + 1) % MAX_STATE_LOG_ENTRIES;
+    if (state->log_count < MAX_STATE_LOG_ENTRIES) state->log_count++;
+    state_mark_changed(state, STATE_INPUT_LOGS);
+    return 0;
+}
+
+int state_add_connection(system_state_t* state, const char* proto, 
+                         const char* local_ip, uint16_t local_port,
+                         const char* remote_ip, uint16_t remote_port,
+                         connection_state_t conn_state, pid_t owner) {
+    if (!state || !proto || !local_ip) return -1;
+    if (state->connection_count >= MAX_STATE_CONNECTIONS) return -1;
+    
+    state_connection_t* c = &state->connections[state->connection_count++];
+    memset(c, 0, sizeof(state_connection_t));
+    strncpy(c->protocol, proto, sizeof(c->protocol) - 1);
+    strncpy(c->local_ip, local_ip, MAX_IP_LENGTH - 1);
+    c->local_port = local_port;
+    strncpy(c->remote_ip, remote_ip ? remote_ip : "0.0.0.0", MAX_IP_LENGTH - 1);
+    c->remote_port = remote_port;
+    c->state = conn_state;
+    c->owner_pid = owner;
+    state_mark_changed(state, STATE_INPUT_NETWORK);
+    return 0;
+}
+
+int state_remove_connection(system_state_t* state, const char* local_ip, 
+                            uint16_t local_port) {
+    if (!state || !local_ip) return -1;
+    
+    for (int i = 0; i < state->connection_count; i++) {
+        state_connection_t* c = &state->connections[i];
+        if (c->local_port == local_port && strcmp(c->local_ip, local_ip) == 0) {
+            *c = state->connections[--state->connection_count];
+            state_mark_changed(state, STATE_INPUT_NETWORK);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/* ============================================================================
+ * SESSION TRACKING
+ * ============================================================================ */
+
+void state_init_session(const system_state_t* state, attacker_session_t* session,
+                        const char* source_ip, uint16_t source_port, const char* username) {
+    memset(session, 0, sizeof(attacker_session_t));
+    session->connect_time = time(NULL);
+    snprintf(session->session_id, sizeof(session->session_id), "%08lx%08x",
+             (unsigned long)session->connect_time, state_new_seed());
+    strncpy(session->source_ip, source_ip, MAX_IP_LENGTH - 1);
+    session->source_port = source_port;
+    strncpy(session->username, username, MAX_NAME_LENGTH - 1);
+    
+    /* Land in the user's home, as a login shell would */
+    const char* home = "/";
+    for (int i = 0; i < state->user_count; i++) {
+        if (strcmp(state->users[i].username, username) == 0) {
+            home = state->users[i].home_dir;
+            break;
+        }
+    }
+    strncpy(session->current_dir, home, MAX_PATH_LENGTH - 1);
+}
+
+int state_start_session(system_state_t* state, const char* source_ip, 
+                        uint16_t source_port, const char* username) {
+    if (!state || !source_ip || !username) return -1;
+    
+    state_init_session(state, &state->current_session, source_ip, source_port, username);
+    state->has_active_session = true;
+    return 0;
+}
+
+void state_end_session(system_state_t* state) {
+    if (!state) return;
+    state->has_active_session = false;
+}
+
+void state_session_record_command(attacker_session_t* session, const char* command) {
+    session->commands_executed++;
+    session->last_command_time = time(NULL);
+    strncpy(session->last_command, command, MAX_CMDLINE_LENGTH - 1);
+    session->last_command[MAX_CMDLINE_LENGTH - 1] = '\0';
+}
+
+void state_record_command(system_state_t* state, const char* command) {
+    if (!state || !command || !state->has_active_session) return;
+    state_session_record_command(&state->current_session, command);
+}
+
+void state_set_current_dir(system_state_t* state, const char* path) {
+    if (!state || !path || !state->has_active_session) return;
+    strncpy(state->current_session.current_dir, path, MAX_PATH_LENGTH - 1);
+    state->current_session.current_dir[MAX_PATH_LENGTH - 1] = '\0';
+}
+
+/* ============================================================================
+ * OUTPUT GENERATORS - Generate File Contents From State
+ * ============================================================================
+ * 
+ * These functions generate realistic file contents based on the current state.
+ * They DON'T use random values - they DERIVE everything from state!
+ */
+
+/* ps/stat state letter */
+static char proc_state_char(proc_state_t s) {
+    switch (s) {
+        case PROC_STATE_RUNNING: return 'R';
+        case PROC_STATE_SLEEPING: return 'S';
+        case PROC_STATE_DISK_WAIT: return 'D';
+        case PROC_STATE_ZOMBIE: return 'Z';
+        case PROC_STATE_STOPPED: return 'T';
+    }
+    return 'S';
+}
+
+/**
+ * Generate /proc/uptime content
+ */
+int state_write_proc_uptime(system_state_t* state, state_sink_t* out) {
+    if (!state || !out) return -1;
+    
+    state_engine_update_time(state);
+    
+    /* Format: uptime_seconds idle_seconds */
+    /* idle_seconds is typically 90-99% of uptime for IoT */
+    double uptime = (double)state->uptime_seconds;
+    double idle = uptime * state_noise(state, 0, NOISE_IDLE, 90, 99) / 100.0;
+    
+    state_sink_printf(out, "%.2f %.2f\n", uptime, idle);
+    return 0;
+}
+
+/**
+ * Generate /proc/meminfo content
+ * THIS IS WHERE CORRELATION SHINES - values derived from process memory!
+ */
+int state_write_proc_meminfo(system_state_t* state, state_sink_t* out) {
+    if (!state || !out) return -1;
+    
+    uint32_t total = state->total_memory_kb;
+    uint32_t free = total - state->used_memory_kb;
+    uint32_t buffers = state->buffer_memory_kb;
+    uint32_t cached = state->cached_memory_kb;
+    uint32_t available = free + buffers + cached;
+    uint32_t epoch = noise_epoch(state);
+    
+    /* Swap is usually 0 on IoT */
+    uint32_t swap_total = 0;
+    uint32_t swap_free = 0;
+    
+    state_sink_printf(out,
+        "MemTotal:       %8u kB\n"
+        "MemFree:        %8u kB\n"
+        "MemAvailable:   %8u kB\n"
+        "Buffers:        %8u kB\n"
+        "Cached:         %8u kB\n"
+        "SwapCached:     %8u kB\n"
+        "Active:         %8u kB\n"
+        "Inactive:       %8u kB\n"
+        "SwapTotal:      %8u kB\n"
+        "SwapFree:       %8u kB\n"
+        "Dirty:          %8u kB\n"
+        "Writeback:      %8u kB\n"
+        "AnonPages:      %8u kB\n"
+        "Mapped:         %8u kB\n"
+        "Shmem:          %8u kB\n"
+        "Slab:           %8u kB\n",
+        total,
+        free,
+        available,
+        buffers,
+        cached,
+        0,  /* SwapCached */
+        state->used_memory_kb * 60 / 100,  /* Active ~60% of used */
+        state->used_memory_kb * 40 / 100,  /* Inactive ~40% of used */
+        swap_total,
+        swap_free,
+        state_noise(state, epoch, NOISE_DIRTY_PAGES, 0, 100),  /* Dirty */
+        0,  /* Writeback */
+        state->used_memory_kb * 50 / 100,  /* AnonPages */
+        state_noise(state, epoch, NOISE_MAPPED, 1000, 5000),  /* Mapped */
+        state_noise(state, epoch, NOISE_SHMEM, 100, 500),     /* Shmem */
+        state_noise(state, epoch, NOISE_SLAB, 1000, 3000)     /* Slab */
+    );
+    return 0;
+}
+
+/**
+ * Generate /proc/loadavg content
+ * Derived from running process count!
+ */
+int state_write_proc_loadavg(system_state_t* state, state_sink_t* out) {
+    if (!state || !out) return -1;
+    
+    state_engine_update_time(state);
+    
+    /* Count running processes for the fraction */
+    int running = 0;
+    for (int i = 0; i < state->process_count; i++) {
+        if (state->processes[i].state == PROC_STATE_RUNNING) {
+            running++;
+        }
+    }
+    if (running == 0) running = 1;
+    
+    /* Format: load1 load5 load15 running/total last_pid */
+    state_sink_printf(out, "%.2f %.2f %.2f %d/%d %d\n",
+        state->load_avg_1 / 100.0,
+        state->load_avg_5 / 100.0,
+        state->load_avg_15 / 100.0,
+        running,
+        state->process_count,
+        state->next_pid - 1
+    );
+    return 0;
+}
+
+/**
+ * Generate /etc/passwd content
+ * Derived from user list!
+ */
+int state_write_passwd(system_state_t* state, state_sink_t* out) {
+    if (!state || !out) return -1;
+    
+    for (int i = 0; i < state->user_count; i++) {
+        state_user_t* u = &state->users[i];
+        state_sink_printf(out,
+            "%s:x:%d:%d:%s:%s:%s\n",
+            u->username,
+            u->uid,
+            u->gid,
+            u->gecos,
+            u->home_dir,
+            u->shell
+        );
+    }
+    
+    return 0;
+}
+
+/**
+ * Generate /etc/shadow content (fake hashes)
+ */
+int state_write_shadow(system_state_t* state, state_sink_t* out) {
+    if (!state || !out) return -1;
+    
+    for (int i = 0; i < state->user_count; i++) {
+        state_user_t* u = &state->users[i];
         const char* hash = u->can_login ? u->password_hash : "*";
-        int len = snprintf(buf + written, size - written,
+        state_sink_printf(out,
             "%s:%s:18000:0:99999:7:::\n",
             u->username,
             hash
         );
-        if (len > 0) written += len;
     }
     
-    return written;
+    return 0;
 }
 
 /**
  * Generate ps aux output
  * Directly from process list - perfect correlation!
  */
-int state_generate_ps_output(system_state_t* state, char* buf, size_t size, bool aux_format) {
-    if (!state || !buf || size < 256) return -1;
+int state_write_ps_output(system_state_t* state, state_sink_t* out, bool aux_format) {
+    if (!state || !out) return -1;
     
-    int written = 0;
+    state_engine_update_time(state);
     
     /* Header */
     if (aux_format) {
-        written = snprintf(buf, size, 
+        state_sink_printf(out,
             "USER       PID %%CPU %%MEM    VSZ   RSS TTY      STAT START   TIME COMMAND\n");
     } else {
-        written = snprintf(buf, size, "  PID TTY          TIME CMD\n");
+        state_sink_printf(out, "  PID TTY          TIME CMD\n");
     }
     
-    for (int i = 0; i < state->process_count && written < (int)size - 200; i++) {
+    for (int i = 0; i < state->process_count; i++) {
         state_process_t* p = &state->processes[i];
         if (!p->visible_in_ps) continue;
         
@@ -1044,20 +1989,11 @@ int state_generate_ps_output(system_state_t* state, char* buf, size_t size, bool
             }
         }
         
-        /* State character */
-        char stat_char = 'S';
-        switch (p->state) {
-            case PROC_STATE_RUNNING: stat_char = 'R'; break;
-            case PROC_STATE_SLEEPING: stat_char = 'S'; break;
-            case PROC_STATE_DISK_WAIT: stat_char = 'D'; break;
-            case PROC_STATE_ZOMBIE: stat_char = 'Z'; break;
-            case PROC_STATE_STOPPED: stat_char = 'T'; break;
-        }
+        char stat_char = proc_state_char(p->state);
         
-        int len;
         if (aux_format) {
-            len = snprintf(buf + written, size - written,
-                "%-8s %5d  %3d  %3d %6u %5u %-8s %c    %02d:%02d   0:%02d %s\n",
+            state_sink_printf(out,
+                "%-8s %5d  %3d  %3d %6u %5u %-8s %c    %02d:%02d %4u:%02u %s\n",
                 username,
                 p->pid,
                 p->cpu_percent / 10,
@@ -1069,31 +2005,27 @@ int state_generate_ps_output(system_state_t* state, char* buf, size_t size, bool
                 (p->start_time_offset / 3600) % 24,
                 (p->start_time_offset / 60) % 60,
                 p->cpu_time_ms / 60000,
+                (p->cpu_time_ms / 1000) % 60,
                 p->cmdline[0] ? p->cmdline : p->name
             );
         } else {
-            len = snprintf(buf + written, size - written,
-                "%5d %-8s 00:00:%02d %s\n",
+            state_sink_printf(out,
+                "%5d %-8s %02u:%02u:%02u %s\n",
                 p->pid,
                 p->tty,
-                p->cpu_time_ms / 60000,
+                p->cpu_time_ms / 3600000,
+                (p->cpu_time_ms / 60000) % 60,
+                (p->cpu_time_ms / 1000) % 60,
                 p->name
             );
         }
-        if (len > 0) written += len;
     }
     
-    return written;
+    return 0;
 }
 
-/**
- * Generate uptime command output
- */
-int state_generate_uptime_output(system_state_t* state, char* buf, size_t size) {
-    if (!state || !buf || size < 128) return -1;
-    
-    state_engine_update_time(state);
-    
+/* "HH:MM:SS up ..., N user,  load average: ..." - shared by uptime and top */
+static void write_uptime_summary(const system_state_t* state, state_sink_t* out) {
     uint32_t uptime = state->uptime_seconds;
     int days = uptime / 86400;
     int hours = (uptime % 86400) / 3600;
@@ -1104,21 +2036,22 @@ int state_generate_uptime_output(system_state_t* state, char* buf, size_t size)
     
     /* Current time */
     time_t now = time(NULL);
-    struct tm* tm_info = localtime(&now);
+    struct tm tm_info;
+    localtime_r(&now, &tm_info);
     char time_str[16];
-    strftime(time_str, sizeof(time_str), "%H:%M:%S", tm_info);
+    strftime(time_str, sizeof(time_str), "%H:%M:%S", &tm_info);
     
     if (days > 0) {
-        return snprintf(buf, size, 
-            " %s up %d days, %2d:%02d,  %d user,  load average: %.2f, %.2f, %.2f\n",
+        state_sink_printf(out,
+            "%s up %d days, %2d:%02d,  %d user,  load average: %.2f, %.2f, %.2f\n",
             time_str, days, hours, mins, users,
             state->load_avg_1 / 100.0,
             state->load_avg_5 / 100.0,
             state->load_avg_15 / 100.0
         );
     } else {
-        return snprintf(buf, size,
-            " %s up %2d:%02d,  %d user,  load average: %.2f, %.2f, %.2f\n",
+        state_sink_printf(out,
+            "%s up %2d:%02d,  %d user,  load average: %.2f, %.2f, %.2f\n",
             time_str, hours, mins, users,
             state->load_avg_1 / 100.0,
             state->load_avg_5 / 100.0,
@@ -1127,41 +2060,55 @@ int state_generate_uptime_output(system_state_t* state, char* buf, size_t size)
     }
 }
 
+/**
+ * Generate uptime command output
+ */
+int state_write_uptime_output(system_state_t* state, state_sink_t* out) {
+    if (!state || !out) return -1;
+    
+    state_engine_update_time(state);
+    
+    state_sink_puts(out, " ");
+    write_uptime_summary(state, out);
+    return 0;
+}
+
 /**
  * Generate free command output
  */
-int state_generate_free_output(system_state_t* state, char* buf, size_t size) {
-    if (!state || !buf || size < 256) return -1;
+int state_write_free_output(system_state_t* state, state_sink_t* out) {
+    if (!state || !out) return -1;
     
     uint32_t total = state->total_memory_kb;
     uint32_t used = state->used_memory_kb;
     uint32_t free = total - used;
-    uint32_t shared = state_rand_between(state, 100, 500);
+    uint32_t shared = state_noise(state, noise_epoch(state), NOISE_SHMEM, 100, 500);   /* Shmem in meminfo */
     uint32_t buffers = state->buffer_memory_kb;
     uint32_t cached = state->cached_memory_kb;
     uint32_t available = free + buffers + cached;
     
-    return snprintf(buf, size,
+    state_sink_printf(out,
         "              total        used        free      shared  buff/cache   available\n"
         "Mem:       %8u    %8u    %8u    %8u    %8u    %8u\n"
         "Swap:      %8u    %8u    %8u\n",
         total, used, free, shared, buffers + cached, available,
         0, 0, 0  /* No swap on IoT */
     );
+    return 0;
 }
 
 /**
  * Generate ifconfig output
  */
-int state_generate_ifconfig_output(system_state_t* state, char* buf, size_t size) {
-    if (!state || !buf || size < 512) return -1;
+int state_write_ifconfig_output(system_state_t* state, state_sink_t* out) {
+    if (!state || !out) return -1;
     
-    int written = 0;
+    state_engine_update_time(state);
     
-    for (int i = 0; i < state->interface_count && written < (int)size - 400; i++) {
+    for (int i = 0; i < state->interface_count; i++) {
         state_interface_t* iface = &state->interfaces[i];
         
-        int len = snprintf(buf + written, size - written,
+        state_sink_printf(out,
             "%s      Link encap:%s  HWaddr %s\n"
             "          inet addr:%s  Bcast:%s  Mask:%s\n"
             "          %s  MTU:%u  Metric:1\n"
@@ -1184,27 +2131,22 @@ int state_generate_ifconfig_output(system_state_t* state, char* buf, size_t size
             (unsigned long)iface->rx_bytes,
             (unsigned long)iface->tx_bytes
         );
-        if (len > 0) written += len;
     }
     
-    return written;
+    return 0;
 }
 
 /**
  * Generate /proc/cpuinfo content
  */
-int state_generate_proc_cpuinfo(system_state_t* state, char* buf, size_t size) {
-    if (!state || !buf || size < 512) return -1;
-    
-    int written = 0;
+int state_write_proc_cpuinfo(system_state_t* state, state_sink_t* out) {
+    if (!state || !out) return -1;
     
-    for (uint32_t i = 0; i < state->profile.cpu_cores && written < (int)size - 300; i++) {
-        int len;
-        
+    for (uint32_t i = 0; i < state->profile.cpu_cores; i++) {
         if (state->profile.architecture == ARCH_MIPS || 
             state->profile.architecture == ARCH_MIPSEL) {
             /* MIPS format */
-            len = snprintf(buf + written, size - written,
+            state_sink_printf(out,
                 "system type\t\t: %s\n"
                 "machine\t\t\t: %s %s\n"
                 "processor\t\t: %d\n"
@@ -1227,7 +2169,7 @@ int state_generate_proc_cpuinfo(system_state_t* state, char* buf, size_t size) {
             );
         } else {
             /* ARM format */
-            len = snprintf(buf + written, size - written,
+            state_sink_printf(out,
                 "processor\t: %d\n"
                 "model name\t: %s\n"
                 "BogoMIPS\t: %u.%02u\n"
@@ -1247,90 +2189,367 @@ int state_generate_proc_cpuinfo(system_state_t* state, char* buf, size_t size) {
                 (state->profile.architecture == ARCH_AARCH64) ? 8 : 7
             );
         }
-        if (len > 0) written += len;
     }
     
-    return written;
+    return 0;
 }
 
 /**
  * Generate /proc/version content
  */
-int state_generate_proc_version(system_state_t* state, char* buf, size_t size) {
-    if (!state || !buf || size < 256) return -1;
+int state_write_proc_version(system_state_t* state, state_sink_t* out) {
+    if (!state || !out) return -1;
     
-    return snprintf(buf, size,
-        "Linux version %s (%s@%s) (gcc version 5.4.0) #1 SMP %s\n",
+    state_sink_printf(out,
+        "Linux version %s (%s@%s) (" STATE_KERNEL_COMPILER ") " STATE_KERNEL_BUILD "\n",
         state->profile.kernel_version,
         "root",
-        state->hostname,
-        "Mon Jan 1 00:00:00 UTC 2024"
+        state->hostname
     );
+    return 0;
 }
 
 /**
  * Generate /proc/mounts content
  */
-int state_generate_proc_mounts(system_state_t* state, char* buf, size_t size) {
-    if (!state || !buf || size < 512) return -1;
-    
-    int written = 0;
+int state_write_proc_mounts(system_state_t* state, state_sink_t* out) {
+    if (!state || !out) return -1;
     
-    for (int i = 0; i < state->mount_count && written < (int)size - 150; i++) {
+    for (int i = 0; i < state->mount_count; i++) {
         state_mount_t* m = &state->mounts[i];
-        int len = snprintf(buf + written, size - written,
+        state_sink_printf(out,
             "%s %s %s %s 0 0\n",
             m->device,
             m->mount_point,
             m->fs_type,
             m->options
         );
-        if (len > 0) written += len;
     }
     
-    return written;
+    return 0;
 }
 
 /**
- * Generate df command output
+ * Generate /etc/group content
+ * One group per distinct gid, named after the first user holding it
  */
-int state_generate_df_output(system_state_t* state, char* buf, size_t size) {
-    if (!state || !buf || size < 512) return -1;
-    
-    int written = snprintf(buf, size,
-        "Filesystem           1K-blocks      Used Available Use%% Mounted on\n");
+int state_write_group(system_state_t* state, state_sink_t* out) {
+    if (!state || !out) return -1;
     
-    for (int i = 0; i < state->mount_count && written < (int)size - 100; i++) {
-        state_mount_t* m = &state->mounts[i];
-        if (m->total_kb == 0) continue; /* Skip virtual filesystems */
+    for (int i = 0; i < state->user_count; i++) {
+        const state_user_t* u = &state->users[i];
         
-        int use_percent = (m->total_kb > 0) ? (m->used_kb * 100 / m->total_kb) : 0;
-        int len = snprintf(buf + written, size - written,
-            "%-20s %10lu %10lu %10lu %3d%% %s\n",
-            m->device,
+        bool seen = false;
+        for (int j = 0; j < i && !seen; j++) {
+            seen = state->users[j].gid == u->gid;
+        }
+        if (seen) continue;
+        
+        state_sink_printf(out, "%s:x:%u:\n",
+                           u->username, (unsigned)u->gid);
+    }
+    
+    return 0;
+}
+
+/**
+ * Generate /proc/stat content
+ * CPU time splits follow the process table and uptime; nothing is random,
+ * so two reads a second apart only move forward.
+ */
+int state_write_proc_stat(system_state_t* state, state_sink_t* out) {
+    if (!state || !out) return -1;
+    
+    state_engine_update_time(state);
+    
+    uint32_t cores = state->profile.cpu_cores ? state->profile.cpu_cores : 1;
+    uint64_t per_cpu = (uint64_t)state->uptime_seconds * 100;   /* USER_HZ */
+    uint64_t busy = 0;
+    int running = 0, blocked = 0;
+    for (int i = 0; i < state->process_count; i++) {
+        busy += state->processes[i].cpu_time_ms / 10;
+        if (state->processes[i].state == PROC_STATE_RUNNING) running++;
+        if (state->processes[i].state == PROC_STATE_DISK_WAIT) blocked++;
+    }
+    busy /= cores;
+    if (busy < per_cpu * state->cpu_usage_percent / 100) {
+        busy = per_cpu * state->cpu_usage_percent / 100;
+    }
+    if (busy > per_cpu / 2) busy = per_cpu / 2;
+    
+    uint64_t user = busy * 6 / 10, system = busy * 3 / 10, softirq = busy - user - system;
+    uint64_t iowait = per_cpu / 400, irq = per_cpu / 5000;
+    uint64_t idle = per_cpu - busy - iowait - irq;
+    
+    state_sink_printf(out, "cpu  %llu 0 %llu %llu %llu %llu %llu 0 0 0\n",
+                      (unsigned long long)(user * cores), (unsigned long long)(system * cores),
+                      (unsigned long long)(idle * cores), (unsigned long long)(iowait * cores),
+                      (unsigned long long)(irq * cores), (unsigned long long)(softirq * cores));
+    for (uint32_t c = 0; c < cores; c++) {
+        state_sink_printf(out, "cpu%u %llu 0 %llu %llu %llu %llu %llu 0 0 0\n", c,
+                          (unsigned long long)user, (unsigned long long)system,
+                          (unsigned long long)idle, (unsigned long long)iowait,
+                          (unsigned long long)irq, (unsigned long long)softirq);
+    }
+    
+    /* Interrupt and context switch rates are fixed per seed */
+    uint64_t intr = (uint64_t)state->uptime_seconds * (120 + state->state_seed % 200);
+    uint64_t ctxt = (uint64_t)state->uptime_seconds * (300 + state->state_seed % 500);
+    state_sink_printf(out,
+                      "intr %llu\nctxt %llu\nbtime %ld\nprocesses %d\n"
+                      "procs_running %d\nprocs_blocked %d\nsoftirq %llu\n",
+                      (unsigned long long)intr, (unsigned long long)ctxt,
+                      (long)state->boot_time, (int)state->next_pid - 1,
+                      running ? running : 1, blocked,
+                      (unsigned long long)(intr * 2 / 3));
+    
+    return 0;
+}
+
+/**
+ * Generate /proc/net/dev content
+ */
+int state_write_proc_net_dev(system_state_t* state, state_sink_t* out) {
+    if (!state || !out) return -1;
+    
+    state_engine_update_time(state);
+    
+    state_sink_printf(out,
+        "Inter-|   Receive                                                |  Transmit\n"
+        " face |bytes    packets errs drop fifo frame compressed multicast|"
+        "bytes    packets errs drop fifo colls carrier compressed\n");
+    
+    for (int i = 0; i < state->interface_count; i++) {
+        const state_interface_t* iface = &state->interfaces[i];
+        state_sink_printf(out,
+            "%6s:%8llu %7llu %4u    0    0     0          0         0 "
+            "%8llu %7llu %4u    0    0     0       0          0\n",
+            iface->name,
+            (unsigned long long)iface->rx_bytes, (unsigned long long)iface->rx_packets,
+            iface->rx_errors,
+            (unsigned long long)iface->tx_bytes, (unsigned long long)iface->tx_packets,
+            iface->tx_errors);
+    }
+    
+    return 0;
+}
+
+/* ============================================================================
+ * PER-PROCESS /proc FILES
+ * ============================================================================
+ * 
+ * Everything comes from the process record, so /proc/<pid>/status agrees
+ * with ps and a killed process's directory is gone.
+ */
+
+/* Path of the executable, from the first word of the command line */
+static void proc_exe_path(const state_process_t* p, char* out, size_t size) {
+    size_t len = strcspn(p->cmdline, " ");
+    if (p->cmdline[0] != '/' || len == 0) {
+        snprintf(out, size, "/usr/sbin/%s", p->name);
+        return;
+    }
+    if (len >= size) len = size - 1;
+    memcpy(out, p->cmdline, len);
+    out[len] = '\0';
+}
+
+/**
+ * Generate /proc/<pid>/stat content (the 44 fields of a 3.x kernel)
+ */
+int state_write_proc_pid_stat(system_state_t* state, pid_t pid, state_sink_t* out) {
+    state_engine_update_time(state);
+    const state_process_t* p = state_get_process(state, pid);
+    if (!p || !out) return -1;
+    
+    bool kernel = p->is_kernel_thread;
+    uint32_t ticks = p->cpu_time_ms / 10;
+    unsigned long code = kernel ? 0 : 0x400000;
+    
+    state_sink_printf(out,
+        "%d (%.15s) %c %d %d %d 0 -1 %u %u 0 0 0 %u %u 0 0 20 0 1 0 %llu %llu %u %s "
+        "%lu %lu %lu 0 0 0 0 %d %d 0 0 0 17 0 0 0 0 0 0\n",
+        (int)p->pid, p->name, proc_state_char(p->state), (int)p->ppid,
+        (int)p->pid, (int)p->pid,
+        kernel ? 0x00208040u : 0x00400100u,
+        kernel ? 0 : 150 + p->memory_kb / 2,
+        ticks * 2 / 3, ticks - ticks * 2 / 3,
+        (unsigned long long)p->start_time_offset * 100,
+        (unsigned long long)p->virtual_kb * 1024,
+        p->memory_kb / 4,
+        kernel ? "0" : "4294967295",
+        code, code ? code + 0x8000 : 0, code ? 0x7fd3be40UL : 0,
+        kernel ? -1 : 0,
+        kernel ? 0 : 0x4002
+    );
+    return 0;
+}
+
+/**
+ * Generate /proc/<pid>/status content
+ */
+int state_write_proc_pid_status(system_state_t* state, pid_t pid, state_sink_t* out) {
+    const state_process_t* p = state_get_process(state, pid);
+    if (!p || !out) return -1;
+    
+    static const char* const state_names[] = {
+        "R (running)", "S (sleeping)", "D (disk sleep)", "Z (zombie)", "T (stopped)"
+    };
+    
+    state_sink_printf(out,
+        "Name:\t%.15s\n"
+        "State:\t%s\n"
+        "Tgid:\t%d\n"
+        "Pid:\t%d\n"
+        "PPid:\t%d\n"
+        "TracerPid:\t0\n"
+        "Uid:\t%u\t%u\t%u\t%u\n"
+        "Gid:\t%u\t%u\t%u\t%u\n"
+        "FDSize:\t32\n"
+        "Groups:\t\n",
+        p->name, state_names[p->state], (int)p->pid, (int)p->pid, (int)p->ppid,
+        (unsigned)p->uid, (unsigned)p->uid, (unsigned)p->uid, (unsigned)p->uid,
+        (unsigned)p->gid, (unsigned)p->gid, (unsigned)p->gid, (unsigned)p->gid);
+    
+    /* Kernel threads have no address space */
+    if (!p->is_kernel_thread) {
+        uint32_t stack = 136, exe = p->virtual_kb / 8, lib = p->virtual_kb / 3;
+        state_sink_printf(out,
+            "VmPeak:\t%8u kB\n"
+            "VmSize:\t%8u kB\n"
+            "VmLck:\t%8u kB\n"
+            "VmHWM:\t%8u kB\n"
+            "VmRSS:\t%8u kB\n"
+            "VmData:\t%8u kB\n"
+            "VmStk:\t%8u kB\n"
+            "VmExe:\t%8u kB\n"
+            "VmLib:\t%8u kB\n"
+            "VmPTE:\t%8u kB\n",
+            p->virtual_kb, p->virtual_kb, 0u, p->memory_kb, p->memory_kb,
+            p->virtual_kb > exe + lib + stack ? p->virtual_kb - exe - lib - stack : 0,
+            stack, exe, lib, 8u);
+    }
+    uint32_t switches = p->cpu_time_ms / 4 + 1;
+    state_sink_printf(out,
+        "Threads:\t1\n"
+        "SigQ:\t0/466\n"
+        "SigPnd:\t0000000000000000\n"
+        "ShdPnd:\t0000000000000000\n"
+        "SigBlk:\t0000000000000000\n"
+        "SigIgn:\t%016x\n"
+        "SigCgt:\t%016x\n"
+        "CapInh:\t0000000000000000\n"
+        "CapPrm:\t%s\n"
+        "CapEff:\t%s\n"
+        "CapBnd:\tffffffffffffffff\n"
+        "voluntary_ctxt_switches:\t%u\n"
+        "nonvoluntary_ctxt_switches:\t%u\n",
+        p->is_kernel_thread ? 0xffffffffu : 0x1000u,
+        p->is_kernel_thread ? 0u : 0x4002u,
+        p->uid == 0 ? "ffffffffffffffff" : "0000000000000000",
+        p->uid == 0 ? "ffffffffffffffff" : "0000000000000000",
+        switches, switches / 20);
+    
+    return 0;
+}
+
+/**
+ * Generate /proc/<pid>/cmdline content
+ * Arguments are NUL-separated with no trailing newline; kernel threads
+ * have an empty command line.
+ */
+int state_write_proc_pid_cmdline(system_state_t* state, pid_t pid, state_sink_t* out) {
+    const state_process_t* p = state_get_process(state, pid);
+    if (!p || !out) return -1;
+    if (p->is_kernel_thread) return 0;
+    
+    char args[MAX_CMDLINE_LENGTH];
+    const char* src = p->cmdline[0] ? p->cmdline : p->name;
+    size_t len = strlen(src);
+    for (size_t i = 0; i < len; i++) {
+        args[i] = (src[i] == ' ') ? '\0' : src[i];
+    }
+    args[len] = '\0';
+    state_sink_write(out, args, len + 1);
+    return 0;
+}
+
+/**
+ * Generate /proc/<pid>/maps content
+ * A uClibc binary's layout: text and data, heap, the C library, stack.
+ */
+int state_write_proc_pid_maps(system_state_t* state, pid_t pid, state_sink_t* out) {
+    const state_process_t* p = state_get_process(state, pid);
+    if (!p || !out) return -1;
+    if (p->is_kernel_thread) return 0;
+    
+    char exe[MAX_PATH_LENGTH];
+    proc_exe_path(p, exe, sizeof(exe));
+    
+    /* Sizes scale with the process but stay page aligned */
+    unsigned long text = 0x400000, text_len = ((p->virtual_kb / 8) * 1024 + 0xfff) & ~0xfffUL;
+    unsigned long data = 0x410000 + text_len, heap = data + 0x1000;
+    unsigned long heap_len = ((p->memory_kb / 2) * 1024 + 0xfff) & ~0xfffUL;
+    unsigned long inode = 100 + ((unsigned long)p->pid * 2654435761UL) % 900;
+    
+    state_sink_printf(out,
+        "%08lx-%08lx r-xp 00000000 1f:02 %-10lu %s\n"
+        "%08lx-%08lx rw-p %08lx 1f:02 %-10lu %s\n"
+        "%08lx-%08lx rwxp 00000000 00:00 0          [heap]\n"
+        "77e00000-77e5d000 r-xp 00000000 1f:02 311        /lib/libuClibc-0.9.33.2.so\n"
+        "77e5d000-77e6c000 ---p 00000000 00:00 0 \n"
+        "77e6c000-77e6d000 r--p 0005c000 1f:02 311        /lib/libuClibc-0.9.33.2.so\n"
+        "77e6d000-77e6e000 rw-p 0005d000 1f:02 311        /lib/libuClibc-0.9.33.2.so\n"
+        "77e80000-77e87000 r-xp 00000000 1f:02 305        /lib/ld-uClibc-0.9.33.2.so\n"
+        "77e96000-77e97000 r--p 00006000 1f:02 305        /lib/ld-uClibc-0.9.33.2.so\n"
+        "77e97000-77e98000 rw-p 00007000 1f:02 305        /lib/ld-uClibc-0.9.33.2.so\n"
+        "7fd1f000-7fd40000 rwxp 00000000 00:00 0          [stack]\n"
+        "7fff7000-7fff8000 r-xp 00000000 00:00 0          [vdso]\n",
+        text, text + text_len, inode, exe,
+        data, data + 0x1000, text_len, inode, exe,
+        heap, heap + heap_len);
+    return 0;
+}
+
+/**
+ * Generate df command output
+ */
+int state_write_df_output(system_state_t* state, state_sink_t* out) {
+    if (!state || !out) return -1;
+    
+    state_sink_printf(out,
+        "Filesystem           1K-blocks      Used Available Use%% Mounted on\n");
+    
+    for (int i = 0; i < state->mount_count; i++) {
+        state_mount_t* m = &state->mounts[i];
+        if (m->total_kb == 0) continue; /* Skip virtual filesystems */
+        
+        int use_percent = (m->total_kb > 0) ? (m->used_kb * 100 / m->total_kb) : 0;
+        state_sink_printf(out,
+            "%-20s %10lu %10lu %10lu %3d%% %s\n",
+            m->device,
             (unsigned long)m->total_kb,
             (unsigned long)m->used_kb,
             (unsigned long)m->available_kb,
             use_percent,
             m->mount_point
         );
-        if (len > 0) written += len;
     }
     
-    return written;
+    return 0;
 }
 
 /**
  * Generate netstat output
  */
-int state_generate_netstat_output(system_state_t* state, char* buf, size_t size) {
-    if (!state || !buf || size < 512) return -1;
+int state_write_netstat_output(system_state_t* state, state_sink_t* out) {
+    if (!state || !out) return -1;
     
-    int written = snprintf(buf, size,
+    state_sink_printf(out,
         "Active Internet connections (servers and established)\n"
         "Proto Recv-Q Send-Q Local Address           Foreign Address         State\n");
     
-    for (int i = 0; i < state->connection_count && written < (int)size - 100; i++) {
+    for (int i = 0; i < state->connection_count; i++) {
         state_connection_t* c = &state->connections[i];
         
         const char* state_str = "UNKNOWN";
@@ -1349,7 +2568,7 @@ int state_generate_netstat_output(system_state_t* state, char* buf, size_t size)
                  c->state == CONN_STATE_LISTEN ? "0.0.0.0" : c->remote_ip, 
                  c->remote_port);
         
-        int len = snprintf(buf + written, size - written,
+        state_sink_printf(out,
             "%-5s %6d %6d %-23s %-23s %s\n",
             c->protocol,
             0, 0,  /* Recv-Q, Send-Q */
@@ -1357,76 +2576,711 @@ int state_generate_netstat_output(system_state_t* state, char* buf, size_t size)
             remote,
             state_str
         );
-        if (len > 0) written += len;
     }
     
-    return written;
+    return 0;
+}
+
+/**
+ * Machine name for the profile's architecture, as uname -m prints it
+ */
+const char* state_arch_name(const device_profile_t* profile) {
+    if (!profile) return "unknown";
+    
+    switch (profile->architecture) {
+        case ARCH_MIPS: return "mips";
+        case ARCH_MIPSEL: return "mipsel";
+        case ARCH_ARM: return "armv6l";
+        case ARCH_ARMV7: return "armv7l";
+        case ARCH_AARCH64: return "aarch64";
+        case ARCH_X86: return "i686";
+        case ARCH_X86_64: return "x86_64";
+    }
+    return "unknown";
 }
 
 /**
  * Generate uname output
  */
-int state_generate_uname_output(system_state_t* state, char* buf, size_t size, const char* flags) {
-    if (!state || !buf || size < 256) return -1;
+int state_write_uname_output(system_state_t* state, state_sink_t* out, const char* flags) {
+    if (!state || !out) return -1;
     
-    const char* arch_str = "unknown";
-    switch (state->profile.architecture) {
-        case ARCH_MIPS: arch_str = "mips"; break;
-        case ARCH_MIPSEL: arch_str = "mipsel"; break;
-        case ARCH_ARM: arch_str = "armv6l"; break;
-        case ARCH_ARMV7: arch_str = "armv7l"; break;
-        case ARCH_AARCH64: arch_str = "aarch64"; break;
-        case ARCH_X86: arch_str = "i686"; break;
-        case ARCH_X86_64: arch_str = "x86_64"; break;
-    }
+    const char* arch_str = state_arch_name(&state->profile);
     
     if (!flags || strcmp(flags, "-a") == 0) {
-        return snprintf(buf, size, "Linux %s %s #1 SMP %s %s GNU/Linux\n",
+        state_sink_printf(out, "Linux %s %s " STATE_KERNEL_BUILD " %s GNU/Linux\n",
             state->hostname,
             state->profile.kernel_version,
-            "Mon Jan 1 00:00:00 UTC 2024",
             arch_str
         );
+        return 0;
     } else if (strcmp(flags, "-r") == 0) {
-        return snprintf(buf, size, "%s\n", state->profile.kernel_version);
+        state_sink_printf(out, "%s\n", state->profile.kernel_version);
+        return 0;
     } else if (strcmp(flags, "-m") == 0) {
-        return snprintf(buf, size, "%s\n", arch_str);
+        state_sink_printf(out, "%s\n", arch_str);
+        return 0;
     } else if (strcmp(flags, "-n") == 0) {
-        return snprintf(buf, size, "%s\n", state->hostname);
+        state_sink_printf(out, "%s\n", state->hostname);
+        return 0;
     } else if (strcmp(flags, "-s") == 0) {
-        return snprintf(buf, size, "Linux\n");
+        state_sink_printf(out, "Linux\n");
+        return 0;
+    }
+    
+    state_sink_printf(out, "Linux\n");
+    return 0;
+}
+
+/* ----------------------------------------------------------------------------
+ * Directory listings - ls and find walk the path index, not the file table
+ * ---------------------------------------------------------------------------- */
+
+static const char* owner_name(const system_state_t* state, uid_t uid, char* scratch, size_t size) {
+    for (int i = 0; i < state->user_count; i++) {
+        if (state->users[i].uid == uid) return state->users[i].username;
+    }
+    snprintf(scratch, size, "%u", (unsigned)uid);
+    return scratch;
+}
+
+static void format_mode(const state_file_t* f, char out[11]) {
+    static const char type_chars[] = { '-', 'd', 'l', 'c', 'b', 'p', 's' };
+    mode_t m = f->permissions;
+    
+    out[0] = (size_t)f->type < sizeof(type_chars) ? type_chars[f->type] : '?';
+    for (int i = 0; i < 3; i++) {
+        int shift = 6 - 3 * i;
+        out[1 + 3 * i] = (m >> shift) & 4 ? 'r' : '-';
+        out[2 + 3 * i] = (m >> shift) & 2 ? 'w' : '-';
+        out[3 + 3 * i] = (m >> shift) & 1 ? 'x' : '-';
+    }
+    if (m & 04000) out[3] = (m & 0100) ? 's' : 'S';
+    if (m & 02000) out[6] = (m & 0010) ? 's' : 'S';
+    if (m & 01000) out[9] = (m & 0001) ? 't' : 'T';
+    out[10] = '\0';
+}
+
+static int ls_long_line(const system_state_t* state, const state_file_t* f, const char* name,
+                        time_t now, state_sink_t* out) {
+    char mode[11], user_buf[16], group_buf[16], size_col[32], date[16];
+    format_mode(f, mode);
+    
+    if (f->type == FILE_TYPE_DEVICE_CHAR || f->type == FILE_TYPE_DEVICE_BLOCK) {
+        snprintf(size_col, sizeof(size_col), "%3u, %3u", f->device_major, f->device_minor);
+    } else {
+        snprintf(size_col, sizeof(size_col), "%lld", (long long)f->size);
+    }
+    
+    /* Like ls: time of day for the last six months, else the year */
+    time_t mtime = state->boot_time + f->mtime_offset;
+    struct tm tm_info;
+    localtime_r(&mtime, &tm_info);
+    bool recent = mtime <= now && now - mtime < 180L * 86400;
+    strftime(date, sizeof(date), recent ? "%b %e %H:%M" : "%b %e  %Y", &tm_info);
+    
+    return state_sink_printf(out, "%s %4d %-8s %-8s %8s %s %s%s%s\n",
+                             mode, f->type == FILE_TYPE_DIRECTORY ? 2 : 1,
+                             owner_name(state, f->owner, user_buf, sizeof(user_buf)),
+                             owner_name(state, f->group, group_buf, sizeof(group_buf)),
+                             size_col, date, name,
+                             f->type == FILE_TYPE_SYMLINK ? " -> " : "",
+                             f->type == FILE_TYPE_SYMLINK ? f->link_target : "") < 0 ? -1 : 0;
+}
+
+static const system_state_t* sort_state;   /* qsort has no context argument */
+
+static int compare_slots(const void* a, const void* b) {
+    return strcmp(sort_state->files[*(const int32_t*)a].name,
+                  sort_state->files[*(const int32_t*)b].name);
+}
+
+/**
+ * Write ls output for a path
+ * Directories list their children sorted by name; anything else lists
+ * itself. show_hidden adds dotfiles and "." / "..".
+ */
+int state_write_ls_output(system_state_t* state, const char* path, state_sink_t* out,
+                          bool long_format, bool show_hidden) {
+    if (!state || !out || !state->files) return -1;
+    if (!path || !*path) {
+        path = state->has_active_session ? state->current_session.current_dir : "/";
+    }
+    
+    int32_t node = path_index_lookup(&state->file_index, path);
+    const state_file_t* target = live_slot(state, node);
+    if (!target) {
+        state_sink_printf(out, "ls: %s: No such file or directory\n", path);
+        return 0;
+    }
+    
+    time_t now = time(NULL);
+    if (target->type != FILE_TYPE_DIRECTORY) {
+        if (long_format) {
+            ls_long_line(state, target, path, now, out);
+        } else {
+            state_sink_printf(out, "%s\n", path);
+        }
+        return 0;
+    }
+    
+    /* Gather the live children, then sort them like ls does */
+    const path_index_t* index = &state->file_index;
+    int count = 0;
+    for (int32_t c = index->nodes[node].first_child; c != PATH_INDEX_NONE; c = index->nodes[c].next_sibling) {
+        count++;
+    }
+    int32_t* slots = malloc((size_t)(count ? count : 1) * sizeof(int32_t));
+    if (!slots) return -1;
+    
+    int shown = 0;
+    long long blocks = 0;
+    for (int32_t c = index->nodes[node].first_child; c != PATH_INDEX_NONE; c = index->nodes[c].next_sibling) {
+        const state_file_t* f = live_slot(state, c);
+        if (!f || (!show_hidden && f->name[0] == '.')) continue;
+        slots[shown++] = (int32_t)(f - state->files);
+        blocks += (f->size + 1023) / 1024;
+    }
+    sort_state = state;
+    qsort(slots, (size_t)shown, sizeof(int32_t), compare_slots);
+    
+    const state_file_t* parent = live_slot(state, node == PATH_INDEX_ROOT ? node : index->nodes[node].parent);
+    if (long_format) {
+        state_sink_printf(out, "total %lld\n", blocks);
+        if (show_hidden) {
+            ls_long_line(state, target, ".", now, out);
+            ls_long_line(state, parent ? parent : target, "..", now, out);
+        }
+        for (int i = 0; i < shown; i++) {
+            if (ls_long_line(state, &state->files[slots[i]], state->files[slots[i]].name,
+                             now, out) != 0) {
+                break;
+            }
+        }
+    } else {
+        if (show_hidden) state_sink_printf(out, ".  ..%s", shown ? "  " : "");
+        for (int i = 0; i < shown; i++) {
+            if (state_sink_printf(out, "%s%s", state->files[slots[i]].name,
+                                  i + 1 < shown ? "  " : "") < 0) {
+                break;
+            }
+        }
+        if (shown || show_hidden) state_sink_printf(out, "\n");
+    }
+    
+    free(slots);
+    return 0;
+}
+
+typedef struct {
+    const system_state_t* state;
+    state_sink_t* out;
+} find_walk_t;
+
+static int find_visit(const path_index_t* index, int32_t node, int depth, void* ctx) {
+    (void)depth;
+    find_walk_t* walk = ctx;
+    if (!live_slot(walk->state, node)) return 0;
+    
+    char path[MAX_PATH_LENGTH * 2];
+    if (path_index_path(index, node, path, sizeof(path)) < 0) return 0;
+    return state_sink_printf(walk->out, "%s\n", path) < 0;
+}
+
+/**
+ * Write find output: path and everything under it, pre-order
+ */
+int state_write_find_output(system_state_t* state, const char* path, state_sink_t* out) {
+    if (!state || !out || !state->files) return -1;
+    if (!path || !*path) path = ".";
+    
+    int32_t node = path_index_lookup(&state->file_index, path);
+    if (!live_slot(state, node)) {
+        state_sink_printf(out, "find: %s: No such file or directory\n", path);
+        return 0;
+    }
+    
+    find_walk_t walk = { state, out };
+    path_index_walk(&state->file_index, node, find_visit, &walk);
+    return 0;
+}
+
+/* du keeps a running total for each directory on the path being walked */
+#define DU_MAX_DEPTH    (MAX_PATH_LENGTH / 2)
+
+typedef struct {
+    const system_state_t* state;
+    state_sink_t* out;
+    int top;                            /* Directories still open */
+    int32_t nodes[DU_MAX_DEPTH];
+    int depths[DU_MAX_DEPTH];
+    uint64_t kb[DU_MAX_DEPTH];
+} du_walk_t;
+
+/* Space a file takes on disk in KiB: whole 4 KiB blocks */
+static uint64_t du_kb(const state_file_t* f) {
+    if (f->type == FILE_TYPE_DIRECTORY) return 4;
+    if (f->type != FILE_TYPE_REGULAR || f->size <= 0) return 0;
+    return ((uint64_t)f->size + 4095) / 4096 * 4;
+}
+
+/* Print the innermost open directory and add its total to its parent's */
+static int du_close(du_walk_t* walk) {
+    walk->top--;
+    if (walk->top > 0) walk->kb[walk->top - 1] += walk->kb[walk->top];
+    
+    char path[MAX_PATH_LENGTH * 2];
+    if (path_index_path(&walk->state->file_index, walk->nodes[walk->top], path, sizeof(path)) < 0) return 0;
+    return state_sink_printf(walk->out, "%llu\t%s\n", (unsigned long long)walk->kb[walk->top], path) < 0;
+}
+
+static int du_visit(const path_index_t* index, int32_t node, int depth, void* ctx) {
+    (void)index;
+    du_walk_t* walk = ctx;
+    while (walk->top > 0 && walk->depths[walk->top - 1] >= depth) {
+        if (du_close(walk)) return 1;
     }
     
-    return snprintf(buf, size, "Linux\n");
+    const state_file_t* f = live_slot(walk->state, node);
+    if (!f) return 0;
+    if (f->type == FILE_TYPE_DIRECTORY && walk->top < DU_MAX_DEPTH) {
+        walk->nodes[walk->top] = node;
+        walk->depths[walk->top] = depth;
+        walk->kb[walk->top] = du_kb(f);
+        walk->top++;
+    } else if (walk->top > 0) {
+        walk->kb[walk->top - 1] += du_kb(f);
+    }
+    return 0;
+}
+
+/**
+ * Write du output: every directory under path with its total, children
+ * before parents, path itself last
+ */
+int state_write_du_output(system_state_t* state, const char* path, state_sink_t* out) {
+    if (!state || !out || !state->files) return -1;
+    if (!path || !*path) path = ".";
+    
+    int32_t node = path_index_lookup(&state->file_index, path);
+    const state_file_t* f = live_slot(state, node);
+    if (!f) {
+        state_sink_printf(out, "du: cannot access '%s': No such file or directory\n", path);
+        return 0;
+    }
+    if (f->type != FILE_TYPE_DIRECTORY) {
+        state_sink_printf(out, "%llu\t%s\n", (unsigned long long)du_kb(f), path);
+        return 0;
+    }
+    
+    du_walk_t* walk = calloc(1, sizeof(du_walk_t));
+    if (!walk) return -1;
+    walk->state = state;
+    walk->out = out;
+    int stopped = path_index_walk(&state->file_index, node, du_visit, walk);
+    while (!stopped && walk->top > 0) stopped = du_close(walk);
+    free(walk);
+    return 0;
+}
+
+/* ----------------------------------------------------------------------------
+ * Console tools - top and dmesg
+ * ---------------------------------------------------------------------------- */
+
+/* top lists the busiest processes first; equal ones keep table order */
+static int compare_top_rows(const void* a, const void* b) {
+    const state_process_t* x = *(const state_process_t* const*)a;
+    const state_process_t* y = *(const state_process_t* const*)b;
+    if (x->cpu_percent != y->cpu_percent) return (x->cpu_percent < y->cpu_percent) ? 1 : -1;
+    return (x > y) - (x < y);
 }
 
 /**
- * Route content from path to appropriate generator
+ * Generate top output (one batch-mode frame)
+ * The summary lines are the same numbers free, uptime and ps report.
  */
+int state_write_top_output(system_state_t* state, state_sink_t* out) {
+    if (!state || !out) return -1;
+    
+    state_engine_update_time(state);
+    if (state->dirty) state_engine_recalculate(state);
+    
+    state_sink_puts(out, "top - ");
+    write_uptime_summary(state, out);
+    
+    int sleeping = 0, stopped = 0, zombie = 0;
+    for (int i = 0; i < state->process_count; i++) {
+        switch (state->processes[i].state) {
+            case PROC_STATE_SLEEPING:
+            case PROC_STATE_DISK_WAIT: sleeping++; break;
+            case PROC_STATE_STOPPED: stopped++; break;
+            case PROC_STATE_ZOMBIE: zombie++; break;
+            default: break;
+        }
+    }
+    state_sink_printf(out,
+        "Tasks: %3d total, %3u running, %3d sleeping, %3d stopped, %3d zombie\n",
+        state->process_count, state->running_count, sleeping, stopped, zombie);
+    
+    /* Same split of busy time as /proc/stat */
+    double busy = state->cpu_usage_percent > 100 ? 100.0 : state->cpu_usage_percent;
+    double user = busy * 0.6, system = busy * 0.3;
+    state_sink_printf(out,
+        "%%Cpu(s): %4.1f us, %4.1f sy,  0.0 ni, %4.1f id,  0.0 wa,  0.0 hi, %4.1f si,  0.0 st\n",
+        user, system, 100.0 - busy, busy - user - system);
+    
+    uint32_t total = state->total_memory_kb;
+    uint32_t used = state->used_memory_kb;
+    uint32_t cache = state->buffer_memory_kb + state->cached_memory_kb;
+    state_sink_printf(out,
+        "KiB Mem : %8u total, %8u free, %8u used, %8u buff/cache\n"
+        "KiB Swap: %8u total, %8u free, %8u used. %8u avail Mem\n\n",
+        total, total - used, used, cache, 0, 0, 0, total - used + cache);
+    
+    state_sink_printf(out,
+        "  PID USER      PR  NI    VIRT    RES    SHR S  %%CPU %%MEM     TIME+ COMMAND\n");
+    
+    const state_process_t* rows[MAX_STATE_PROCESSES];
+    int row_count = 0;
+    for (int i = 0; i < state->process_count; i++) {
+        if (state->processes[i].visible_in_ps) rows[row_count++] = &state->processes[i];
+    }
+    qsort(rows, (size_t)row_count, sizeof(rows[0]), compare_top_rows);
+    
+    for (int i = 0; i < row_count; i++) {
+        const state_process_t* p = rows[i];
+        char scratch[16];
+        state_sink_printf(out,
+            "%5d %-8.8s  20   0 %7u %6u %6u %c %5.1f %4.1f %3u:%02u.%02u %s\n",
+            p->pid,
+            owner_name(state, p->uid, scratch, sizeof(scratch)),
+            p->virtual_kb,
+            p->memory_kb,
+            p->memory_kb * 2 / 5,       /* Shared pages: libc, busybox */
+            proc_state_char(p->state),
+            p->cpu_percent / 10.0,
+            state->total_memory_kb ? p->memory_kb * 100.0 / state->total_memory_kb : 0.0,
+            p->cpu_time_ms / 60000,
+            (p->cpu_time_ms / 1000) % 60,
+            (p->cpu_time_ms / 10) % 100,
+            p->name
+        );
+    }
+    
+    return 0;
+}
+
+/* One kernel ring buffer line; boot steps are microseconds after boot */
+static void dmesg_line(state_sink_t* out, uint64_t usec, const char* fmt, ...)
+    __attribute__((format(printf, 3, 4)));
+
+static void dmesg_line(state_sink_t* out, uint64_t usec, const char* fmt, ...) {
+    char message[MAX_LOG_MESSAGE];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(message, sizeof(message), fmt, ap);
+    va_end(ap);
+    state_sink_printf(out, "[%5llu.%06llu] %s\n",
+                      (unsigned long long)(usec / 1000000), (unsigned long long)(usec % 1000000), message);
+}
+
+/* Advance the boot clock by a seed-fixed delay; step numbers the delays */
+static uint64_t boot_step(const system_state_t* state, uint64_t* t, uint32_t* step,
+                          uint32_t min_us, uint32_t max_us) {
+    *t += state_noise(state, ++*step, NOISE_BOOT_STEP, min_us, max_us);
+    return *t;
+}
+
+/**
+ * Generate dmesg output
+ * The boot messages describe this device - kernel, CPU, RAM, root
+ * filesystem, interfaces - with timings fixed by the seed, followed by
+ * the kernel-facility entries from the state's log.
+ */
+int state_write_dmesg(system_state_t* state, state_sink_t* out) {
+    if (!state || !out) return -1;
+    
+    const device_profile_t* prof = &state->profile;
+    uint64_t t = 0;
+    uint32_t step = 0;
+    
+    dmesg_line(out, t, "Linux version %s (root@%s) (" STATE_KERNEL_COMPILER ") " STATE_KERNEL_BUILD,
+               prof->kernel_version, state->hostname);
+    dmesg_line(out, t, "CPU: %s", prof->cpu_model);
+    dmesg_line(out, t, "Machine model: %s %s", prof->vendor, prof->model);
+    dmesg_line(out, t, "Memory: %uK/%uK available", state->total_memory_kb - state->used_memory_kb,
+               prof->total_ram_kb);
+    dmesg_line(out, boot_step(state, &t, &step, 2000, 9000),
+               "Calibrating delay loop... %u.%02u BogoMIPS (lpj=%u)",
+               prof->bogomips / 100, prof->bogomips % 100, prof->bogomips * 50);
+    if (prof->cpu_cores > 1) {
+        dmesg_line(out, boot_step(state, &t, &step, 20000, 60000), "Brought up %u CPUs", prof->cpu_cores);
+    }
+    dmesg_line(out, boot_step(state, &t, &step, 50000, 150000), "NET: Registered protocol family 16");
+    dmesg_line(out, boot_step(state, &t, &step, 100000, 300000), "NET: Registered protocol family 2");
+    
+    for (int i = 0; i < state->mount_count; i++) {
+        const state_mount_t* m = &state->mounts[i];
+        if (strcmp(m->mount_point, "/") != 0) continue;
+        dmesg_line(out, boot_step(state, &t, &step, 300000, 900000),
+                   "VFS: Mounted root (%s filesystem) readonly on device 31:2.", m->fs_type);
+    }
+    dmesg_line(out, boot_step(state, &t, &step, 10000, 40000), "Freeing unused kernel memory: %uK",
+               200 + state_noise(state, 0, NOISE_BOOT_STEP, 0, 200));
+    
+    for (int i = 0; i < state->interface_count; i++) {
+        const state_interface_t* iface = &state->interfaces[i];
+        if (iface->is_loopback) continue;
+        dmesg_line(out, boot_step(state, &t, &step, 500000, 2000000), "%s: link %s", iface->name,
+                   iface->is_up ? "up, 100Mbps, full-duplex" : "down");
+    }
+    
+    /* Oldest first from the circular log */
+    int start = (state->log_count < MAX_STATE_LOG_ENTRIES) ? 0 : state->log_write_index;
+    for (int i = 0; i < state->log_count; i++) {
+        const state_log_entry_t* e = &state->logs[(start + i) % MAX_STATE_LOG_ENTRIES];
+        if (strcmp(e->facility, "kern") != 0) continue;
+        uint64_t usec = e->time_offset > 0 ? (uint64_t)e->time_offset * 1000000 : 0;
+        if (usec < t) usec = t;
+        dmesg_line(out, usec, "%s", e->message);
+    }
+    
+    return 0;
+}
+
+/**
+ * /var/log/syslog: every log entry, stamped from boot_time so the dates
+ * agree with uptime and dmesg
+ */
+int state_write_syslog(system_state_t* state, state_sink_t* out) {
+    if (!state || !out) return -1;
+    
+    int start = (state->log_count < MAX_STATE_LOG_ENTRIES) ? 0 : state->log_write_index;
+    for (int i = 0; i < state->log_count; i++) {
+        const state_log_entry_t* e = &state->logs[(start + i) % MAX_STATE_LOG_ENTRIES];
+        time_t when = state->boot_time + e->time_offset;
+        struct tm tm;
+        char stamp[32];
+        localtime_r(&when, &tm);
+        strftime(stamp, sizeof(stamp), "%b %e %H:%M:%S", &tm);
+        if (e->pid > 0) {
+            state_sink_printf(out, "%s %s %s[%d]: %s\n", stamp, state->hostname, e->service,
+                              e->pid, e->message);
+        } else {
+            state_sink_printf(out, "%s %s %s: %s\n", stamp, state->hostname, e->service, e->message);
+        }
+    }
+    
+    return 0;
+}
+
+/**
+ * Write a path's content from its generator, through the content cache
+ */
+int state_write_file_content(system_state_t* state, const char* path, state_sink_t* out) {
+    if (!state || !path || !out) return -1;
+    
+    /* The file record names its generator; paths not in the tree fall back
+     * to the registry, then to the per-process routes */
+    const state_file_t* f = state_lookup_file(state, path);
+    int id = (f && f->has_dynamic_content) ? f->content_generator : 0;
+    if (id == 0 && !f) id = state_content_find(path);
+    if (id == 0) {
+        pid_t pid;
+        state_pid_content_fn generate = f ? NULL : state_content_pid_route(path, &pid);
+        if (!generate) return -1;
+        return generate(state, pid, out);
+    }
+    
+    const char* data;
+    size_t length;
+    if (state_content_get(state, id, &data, &length) != 0) return -1;
+    state_sink_write(out, data, length);
+    return 0;
+}
+
+/* ============================================================================
+ * LEGACY BUFFER API
+ * ============================================================================ */
+
+/*
+ * The state_generate_* functions below run a writer into the caller's
+ * buffer. Output that does not fit is cut at the last whole line; size is
+ * the buffer size, NUL included, and the return value the bytes written.
+ */
+
+static int sink_result(const state_sink_t* sink, int rc) {
+    return rc < 0 ? -1 : (int)sink->length;
+}
+
+int state_generate_proc_uptime(system_state_t* state, char* buf, size_t size) {
+    state_sink_t out;
+    if (state_sink_init_fixed(&out, buf, size) != 0) return -1;
+    return sink_result(&out, state_write_proc_uptime(state, &out));
+}
+
+int state_generate_proc_meminfo(system_state_t* state, char* buf, size_t size) {
+    state_sink_t out;
+    if (state_sink_init_fixed(&out, buf, size) != 0) return -1;
+    return sink_result(&out, state_write_proc_meminfo(state, &out));
+}
+
+int state_generate_proc_loadavg(system_state_t* state, char* buf, size_t size) {
+    state_sink_t out;
+    if (state_sink_init_fixed(&out, buf, size) != 0) return -1;
+    return sink_result(&out, state_write_proc_loadavg(state, &out));
+}
+
+int state_generate_proc_cpuinfo(system_state_t* state, char* buf, size_t size) {
+    state_sink_t out;
+    if (state_sink_init_fixed(&out, buf, size) != 0) return -1;
+    return sink_result(&out, state_write_proc_cpuinfo(state, &out));
+}
+
+int state_generate_proc_version(system_state_t* state, char* buf, size_t size) {
+    state_sink_t out;
+    if (state_sink_init_fixed(&out, buf, size) != 0) return -1;
+    return sink_result(&out, state_write_proc_version(state, &out));
+}
+
+int state_generate_proc_mounts(system_state_t* state, char* buf, size_t size) {
+    state_sink_t out;
+    if (state_sink_init_fixed(&out, buf, size) != 0) return -1;
+    return sink_result(&out, state_write_proc_mounts(state, &out));
+}
+
+int state_generate_proc_stat(system_state_t* state, char* buf, size_t size) {
+    state_sink_t out;
+    if (state_sink_init_fixed(&out, buf, size) != 0) return -1;
+    return sink_result(&out, state_write_proc_stat(state, &out));
+}
+
+int state_generate_proc_net_dev(system_state_t* state, char* buf, size_t size) {
+    state_sink_t out;
+    if (state_sink_init_fixed(&out, buf, size) != 0) return -1;
+    return sink_result(&out, state_write_proc_net_dev(state, &out));
+}
+
+int state_generate_passwd(system_state_t* state, char* buf, size_t size) {
+    state_sink_t out;
+    if (state_sink_init_fixed(&out, buf, size) != 0) return -1;
+    return sink_result(&out, state_write_passwd(state, &out));
+}
+
+int state_generate_shadow(system_state_t* state, char* buf, size_t size) {
+    state_sink_t out;
+    if (state_sink_init_fixed(&out, buf, size) != 0) return -1;
+    return sink_result(&out, state_write_shadow(state, &out));
+}
+
+int state_generate_group(system_state_t* state, char* buf, size_t size) {
+    state_sink_t out;
+    if (state_sink_init_fixed(&out, buf, size) != 0) return -1;
+    return sink_result(&out, state_write_group(state, &out));
+}
+
+int state_generate_proc_pid_stat(system_state_t* state, pid_t pid, char* buf, size_t size) {
+    state_sink_t out;
+    if (state_sink_init_fixed(&out, buf, size) != 0) return -1;
+    return sink_result(&out, state_write_proc_pid_stat(state, pid, &out));
+}
+
+int state_generate_proc_pid_status(system_state_t* state, pid_t pid, char* buf, size_t size) {
+    state_sink_t out;
+    if (state_sink_init_fixed(&out, buf, size) != 0) return -1;
+    return sink_result(&out, state_write_proc_pid_status(state, pid, &out));
+}
+
+int state_generate_proc_pid_cmdline(system_state_t* state, pid_t pid, char* buf, size_t size) {
+    state_sink_t out;
+    if (state_sink_init_fixed(&out, buf, size) != 0) return -1;
+    return sink_result(&out, state_write_proc_pid_cmdline(state, pid, &out));
+}
+
+int state_generate_proc_pid_maps(system_state_t* state, pid_t pid, char* buf, size_t size) {
+    state_sink_t out;
+    if (state_sink_init_fixed(&out, buf, size) != 0) return -1;
+    return sink_result(&out, state_write_proc_pid_maps(state, pid, &out));
+}
+
+int state_generate_ps_output(system_state_t* state, char* buf, size_t size, bool aux_format) {
+    state_sink_t out;
+    if (state_sink_init_fixed(&out, buf, size) != 0) return -1;
+    return sink_result(&out, state_write_ps_output(state, &out, aux_format));
+}
+
+int state_generate_uptime_output(system_state_t* state, char* buf, size_t size) {
+    state_sink_t out;
+    if (state_sink_init_fixed(&out, buf, size) != 0) return -1;
+    return sink_result(&out, state_write_uptime_output(state, &out));
+}
+
+int state_generate_top_output(system_state_t* state, char* buf, size_t size) {
+    state_sink_t out;
+    if (state_sink_init_fixed(&out, buf, size) != 0) return -1;
+    return sink_result(&out, state_write_top_output(state, &out));
+}
+
+int state_generate_dmesg(system_state_t* state, char* buf, size_t size) {
+    state_sink_t out;
+    if (state_sink_init_fixed(&out, buf, size) != 0) return -1;
+    return sink_result(&out, state_write_dmesg(state, &out));
+}
+
+int state_generate_free_output(system_state_t* state, char* buf, size_t size) {
+    state_sink_t out;
+    if (state_sink_init_fixed(&out, buf, size) != 0) return -1;
+    return sink_result(&out, state_write_free_output(state, &out));
+}
+
+int state_generate_ifconfig_output(system_state_t* state, char* buf, size_t size) {
+    state_sink_t out;
+    if (state_sink_init_fixed(&out, buf, size) != 0) return -1;
+    return sink_result(&out, state_write_ifconfig_output(state, &out));
+}
+
+int state_generate_df_output(system_state_t* state, char* buf, size_t size) {
+    state_sink_t out;
+    if (state_sink_init_fixed(&out, buf, size) != 0) return -1;
+    return sink_result(&out, state_write_df_output(state, &out));
+}
+
+int state_generate_netstat_output(system_state_t* state, char* buf, size_t size) {
+    state_sink_t out;
+    if (state_sink_init_fixed(&out, buf, size) != 0) return -1;
+    return sink_result(&out, state_write_netstat_output(state, &out));
+}
+
+int state_generate_uname_output(system_state_t* state, char* buf, size_t size, const char* flags) {
+    state_sink_t out;
+    if (state_sink_init_fixed(&out, buf, size) != 0) return -1;
+    return sink_result(&out, state_write_uname_output(state, &out, flags));
+}
+
+int state_generate_ls_output(system_state_t* state, const char* path, char* buf,
+                             size_t size, bool long_format, bool show_hidden) {
+    state_sink_t out;
+    if (state_sink_init_fixed(&out, buf, size) != 0) return -1;
+    return sink_result(&out, state_write_ls_output(state, path, &out, long_format, show_hidden));
+}
+
+int state_generate_find_output(system_state_t* state, const char* path, char* buf, size_t size) {
+    state_sink_t out;
+    if (state_sink_init_fixed(&out, buf, size) != 0) return -1;
+    return sink_result(&out, state_write_find_output(state, path, &out));
+}
+
+int state_generate_du_output(system_state_t* state, const char* path, char* buf, size_t size) {
+    state_sink_t out;
+    if (state_sink_init_fixed(&out, buf, size) != 0) return -1;
+    return sink_result(&out, state_write_du_output(state, path, &out));
+}
+
 int state_generate_file_content(system_state_t* state, const char* path,
                                 char* buffer, size_t buffer_size) {
-    if (!state || !path || !buffer) return -1;
-    
-    /* Route to appropriate generator based on path */
-    if (strcmp(path, "/proc/uptime") == 0) {
-        return state_generate_proc_uptime(state, buffer, buffer_size);
-    } else if (strcmp(path, "/proc/meminfo") == 0) {
-        return state_generate_proc_meminfo(state, buffer, buffer_size);
-    } else if (strcmp(path, "/proc/loadavg") == 0) {
-        return state_generate_proc_loadavg(state, buffer, buffer_size);
-    } else if (strcmp(path, "/proc/cpuinfo") == 0) {
-        return state_generate_proc_cpuinfo(state, buffer, buffer_size);
-    } else if (strcmp(path, "/proc/version") == 0) {
-        return state_generate_proc_version(state, buffer, buffer_size);
-    } else if (strcmp(path, "/proc/mounts") == 0) {
-        return state_generate_proc_mounts(state, buffer, buffer_size);
-    } else if (strcmp(path, "/etc/passwd") == 0) {
-        return state_generate_passwd(state, buffer, buffer_size);
-    } else if (strcmp(path, "/etc/shadow") == 0) {
-        return state_generate_shadow(state, buffer, buffer_size);
-    }
-    
-    return -1; /* Unknown path */
+    state_sink_t out;
+    if (state_sink_init_fixed(&out, buffer, buffer_size) != 0) return -1;
+    return sink_result(&out, state_write_file_content(state, path, &out));
 }
 
 /* ============================================================================
@@ -1439,20 +3293,25 @@ system_state_t* state_get_global(void) {
 }
 
 int state_init_global(const device_profile_t* profile) {
+    pthread_mutex_lock(&g_state_lock);
     if (g_state_initialized) {
         state_engine_destroy(&g_state);
+        g_state_initialized = false;
     }
     
     int result = state_engine_init(&g_state, profile);
     if (result == 0) {
         g_state_initialized = true;
     }
+    pthread_mutex_unlock(&g_state_lock);
     return result;
 }
 
 void state_destroy_global(void) {
+    pthread_mutex_lock(&g_state_lock);
     if (g_state_initialized) {
         state_engine_destroy(&g_state);
         g_state_initialized = false;
     }
+    pthread_mutex_unlock(&g_state_lock);
 }
\ No newline at end of file
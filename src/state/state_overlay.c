@@ -0,0 +1,514 @@
+/**
+ * state_overlay.c - Copy-on-write session views of a shared system state
+ * ============================================================================
+ *
+ * The base state is the device; an overlay is one attacker's session on it.
+ * Overlays hold small growable arrays of deltas instead of the base's fixed
+ * tables, so an idle session costs the struct and nothing else.
+ *
+ * Lookups are linear over the deltas: a session changes a handful of
+ * things, so scanning them is cheaper than keeping an index up to date.
+ *
+ * ============================================================================
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "state_overlay.h"
+
+/* ============================================================================
+ * HELPERS
+ * ============================================================================ */
+
+/* Make room for one more element; arrays start small and double */
+static int reserve(void** items, int count, int* capacity, size_t item_size) {
+    if (count < *capacity) return 0;
+
+    int new_capacity = *capacity ? *capacity * 2 : 4;
+    void* grown = realloc(*items, (size_t)new_capacity * item_size);
+    if (!grown) return -1;
+    *items = grown;
+    *capacity = new_capacity;
+    return 0;
+}
+
+static const state_file_t* base_file(const system_state_t* base, const char* path) {
+    return state_lookup_file(base, path);
+}
+
+/* The overlay's own record for path, whiteouts included */
+static state_file_t* overlay_file(const state_overlay_t* ov, const char* path) {
+    for (int i = 0; i < ov->file_count; i++) {
+        if (strcmp(ov->files[i].path, path) == 0) return &ov->files[i];
+    }
+    return NULL;
+}
+
+/* path is dir itself or somewhere under it */
+static bool path_within(const char* path, const char* dir, size_t dir_len) {
+    return strncmp(path, dir, dir_len) == 0 && (path[dir_len] == '\0' || path[dir_len] == '/');
+}
+
+/* Fresh record at path, reusing a whiteout the session left there */
+static state_file_t* create_record(state_overlay_t* ov, const char* path, file_type_t type,
+                                   uid_t owner, mode_t perms) {
+    state_file_t* f = overlay_file(ov, path);
+    if (!f) {
+        if (reserve((void**)&ov->files, ov->file_count, &ov->file_capacity,
+                    sizeof(state_file_t)) != 0) {
+            return NULL;
+        }
+        f = &ov->files[ov->file_count++];
+    }
+    state_init_file_record(ov->base, f, path, type, owner, perms);
+    return f;
+}
+
+/* path_index_walk() callback: hide each live base file the session hasn't touched */
+static int whiteout_base_file(const path_index_t* index, int32_t node, int depth, void* ctx) {
+    (void)depth;
+    state_overlay_t* ov = ctx;
+    int32_t slot = index->nodes[node].file;
+    if (slot == PATH_INDEX_NONE) return 0;
+
+    const state_file_t* under = &ov->base->files[slot];
+    if (under->deleted || overlay_file(ov, under->path)) return 0;
+
+    if (reserve((void**)&ov->files, ov->file_count, &ov->file_capacity,
+                sizeof(state_file_t)) != 0) {
+        return -1;
+    }
+    state_file_t* whiteout = &ov->files[ov->file_count++];
+    *whiteout = *under;
+    whiteout->deleted = true;
+    return 0;
+}
+
+static bool base_pid_killed(const state_overlay_t* ov, pid_t pid) {
+    for (int i = 0; i < ov->killed_count; i++) {
+        if (ov->killed[i] == pid) return true;
+    }
+    return false;
+}
+
+static const state_process_t* base_process(const state_overlay_t* ov, pid_t pid) {
+    const system_state_t* base = ov->base;
+    for (int i = 0; i < base->process_count; i++) {
+        if (base->processes[i].pid == pid) {
+            return base_pid_killed(ov, pid) ? NULL : &base->processes[i];
+        }
+    }
+    return NULL;
+}
+
+static int overlay_process_index(const state_overlay_t* ov, pid_t pid) {
+    for (int i = 0; i < ov->process_count; i++) {
+        if (ov->processes[i].pid == pid) return i;
+    }
+    return -1;
+}
+
+/* A base socket is gone if the session closed it or killed its owner */
+static bool base_socket_visible(const state_overlay_t* ov, const state_connection_t* c) {
+    if (c->owner_pid > 0 && base_pid_killed(ov, c->owner_pid)) return false;
+    for (int i = 0; i < ov->closed_count; i++) {
+        if (ov->closed[i].local_port == c->local_port &&
+            strcmp(ov->closed[i].local_ip, c->local_ip) == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* ============================================================================
+ * LIFECYCLE
+ * ============================================================================ */
+
+int state_overlay_init(state_overlay_t* ov, const system_state_t* base,
+                       const char* source_ip, uint16_t source_port, const char* username) {
+    if (!ov || !base || !base->is_initialized || !source_ip || !username) return -1;
+
+    memset(ov, 0, sizeof(state_overlay_t));
+    ov->base = base;
+    ov->next_pid = base->next_pid;
+    state_init_session(base, &ov->session, source_ip, source_port, username);
+    return 0;
+}
+
+void state_overlay_destroy(state_overlay_t* ov) {
+    if (!ov) return;
+
+    free(ov->files);
+    free(ov->processes);
+    free(ov->killed);
+    free(ov->connections);
+    free(ov->closed);
+    free(ov->logs);
+    memset(ov, 0, sizeof(state_overlay_t));
+}
+
+size_t state_overlay_memory_usage(const state_overlay_t* ov) {
+    if (!ov) return 0;
+
+    return sizeof(state_overlay_t) +
+           (size_t)ov->file_capacity * sizeof(state_file_t) +
+           (size_t)ov->process_capacity * sizeof(state_process_t) +
+           (size_t)ov->killed_capacity * sizeof(pid_t) +
+           (size_t)ov->connection_capacity * sizeof(state_connection_t) +
+           (size_t)ov->closed_capacity * sizeof(state_socket_key_t) +
+           (size_t)ov->log_capacity * sizeof(state_log_entry_t);
+}
+
+/* ============================================================================
+ * READS
+ * ============================================================================ */
+
+const state_file_t* state_overlay_get_file(const state_overlay_t* ov, const char* path) {
+    if (!ov || !path) return NULL;
+
+    const state_file_t* own = overlay_file(ov, path);
+    if (own) return own->deleted ? NULL : own;
+    return base_file(ov->base, path);
+}
+
+bool state_overlay_file_exists(const state_overlay_t* ov, const char* path) {
+    return state_overlay_get_file(ov, path) != NULL;
+}
+
+const state_process_t* state_overlay_get_process(const state_overlay_t* ov, pid_t pid) {
+    if (!ov) return NULL;
+
+    int i = overlay_process_index(ov, pid);
+    if (i >= 0) return &ov->processes[i];
+    return base_process(ov, pid);
+}
+
+const state_process_t* state_overlay_get_process_by_name(const state_overlay_t* ov, const char* name) {
+    if (!ov || !name) return NULL;
+
+    int cursor = 0;
+    const state_process_t* p;
+    while ((p = state_overlay_next_process(ov, &cursor)) != NULL) {
+        if (strcmp(p->name, name) == 0) return p;
+    }
+    return NULL;
+}
+
+/* Cursors run over the base table, then continue into the overlay's */
+
+const state_file_t* state_overlay_next_file(const state_overlay_t* ov, int* cursor) {
+    if (!ov || !cursor) return NULL;
+
+    const system_state_t* base = ov->base;
+    while (*cursor < base->file_count) {
+        const state_file_t* f = &base->files[(*cursor)++];
+        if (!f->deleted && !overlay_file(ov, f->path)) return f;
+    }
+    while (*cursor - base->file_count < ov->file_count) {
+        const state_file_t* f = &ov->files[(*cursor)++ - base->file_count];
+        if (!f->deleted) return f;
+    }
+    return NULL;
+}
+
+const state_process_t* state_overlay_next_process(const state_overlay_t* ov, int* cursor) {
+    if (!ov || !cursor) return NULL;
+
+    const system_state_t* base = ov->base;
+    while (*cursor < base->process_count) {
+        const state_process_t* p = &base->processes[(*cursor)++];
+        if (!base_pid_killed(ov, p->pid)) return p;
+    }
+    if (*cursor - base->process_count < ov->process_count) {
+        return &ov->processes[(*cursor)++ - base->process_count];
+    }
+    return NULL;
+}
+
+const state_connection_t* state_overlay_next_connection(const state_overlay_t* ov, int* cursor) {
+    if (!ov || !cursor) return NULL;
+
+    const system_state_t* base = ov->base;
+    while (*cursor < base->connection_count) {
+        const state_connection_t* c = &base->connections[(*cursor)++];
+        if (base_socket_visible(ov, c)) return c;
+    }
+    if (*cursor - base->connection_count < ov->connection_count) {
+        return &ov->connections[(*cursor)++ - base->connection_count];
+    }
+    return NULL;
+}
+
+int state_overlay_materialize(const state_overlay_t* ov, system_state_t* out) {
+    if (!ov || !out) return -1;
+
+    const system_state_t* base = ov->base;
+
+    /* Scalars, users, interfaces and mounts are never overlaid */
+    memcpy(out, base, sizeof(system_state_t));
+
+    /* The file table, its index and the content cache are the base's -
+     * build out's own */
+    out->files = NULL;
+    out->file_count = 0;
+    out->file_capacity = 0;
+    memset(out->content_cache, 0, sizeof(out->content_cache));
+    if (path_index_init(&out->file_index) != 0) {
+        memset(out, 0, sizeof(system_state_t));
+        return -1;
+    }
+
+    int cursor = 0, n = 0;
+    const state_file_t* f;
+    while ((f = state_overlay_next_file(ov, &cursor)) != NULL) {
+        if (state_append_file_record(out, f) != 0) break;
+    }
+
+    cursor = 0;
+    const state_process_t* p;
+    while ((p = state_overlay_next_process(ov, &cursor)) != NULL && n < MAX_STATE_PROCESSES) {
+        out->processes[n++] = *p;
+    }
+    out->process_count = n;
+    out->next_pid = ov->next_pid;
+
+    cursor = 0;
+    n = 0;
+    const state_connection_t* c;
+    while ((c = state_overlay_next_connection(ov, &cursor)) != NULL && n < MAX_STATE_CONNECTIONS) {
+        out->connections[n++] = *c;
+    }
+    out->connection_count = n;
+
+    /* Session log lines go after the device's, oldest first */
+    int first = (ov->log_count == ov->log_capacity) ? ov->log_write_index : 0;
+    for (int i = 0; i < ov->log_count; i++) {
+        out->logs[out->log_write_index] = ov->logs[(first + i) % ov->log_capacity];
+        out->log_write_index = (out->log_write_index + 1) % MAX_STATE_LOG_ENTRIES;
+        if (out->log_count < MAX_STATE_LOG_ENTRIES) out->log_count++;
+    }
+
+    out->current_session = ov->session;
+    out->has_active_session = true;
+    if (ov->process_count > 0 || ov->killed_count > 0) state_recount_processes(out);
+    return 0;
+}
+
+/* ============================================================================
+ * MUTATIONS
+ * ============================================================================ */
+
+int state_overlay_add_file(state_overlay_t* ov, const char* path, file_type_t type,
+                           uid_t owner, mode_t perms) {
+    if (!ov || !path || path[0] != '/' || strlen(path) >= MAX_PATH_LENGTH) return -1;
+    if (state_overlay_file_exists(ov, path)) return -1;
+
+    /* Missing parent directories first, topmost down (mkdir -p) */
+    char parent[MAX_PATH_LENGTH];
+    for (const char* slash = strchr(path + 1, '/'); slash && slash[1]; slash = strchr(slash + 1, '/')) {
+        if (slash[-1] == '/') continue;
+        size_t len = (size_t)(slash - path);
+        memcpy(parent, path, len);
+        parent[len] = '\0';
+        if (state_overlay_file_exists(ov, parent)) continue;
+        if (!create_record(ov, parent, FILE_TYPE_DIRECTORY, owner, 0755)) return -1;
+    }
+
+    /* Re-creating a file the session deleted reuses its whiteout */
+    state_file_t* f = create_record(ov, path, type, owner, perms);
+    if (!f) return -1;
+    f->created_by_attacker = true;
+    ov->session.files_created++;
+    return 0;
+}
+
+/**
+ * Remove a file; a directory goes with everything under it (rm -r)
+ * Base files get whiteouts, files only this session made are forgotten.
+ */
+int state_overlay_remove_file(state_overlay_t* ov, const char* path) {
+    if (!ov || !path || !state_overlay_file_exists(ov, path)) return -1;
+
+    const path_index_t* index = &ov->base->file_index;
+    int32_t node = path_index_lookup(index, path);
+    if (node == PATH_INDEX_ROOT) return -1;
+
+    /* The session's own records under path */
+    size_t len = strlen(path);
+    int kept = 0;
+    for (int i = 0; i < ov->file_count; i++) {
+        state_file_t* f = &ov->files[i];
+        if (!f->deleted && path_within(f->path, path, len)) {
+            if (!base_file(ov->base, f->path)) continue;
+            f->deleted = true;
+        }
+        if (kept != i) ov->files[kept] = *f;
+        kept++;
+    }
+    ov->file_count = kept;
+
+    /* Base files under path the session never touched */
+    if (node != PATH_INDEX_NONE && path_index_walk(index, node, whiteout_base_file, ov) != 0) {
+        return -1;
+    }
+
+    ov->session.files_deleted++;
+    return 0;
+}
+
+int state_overlay_modify_file(state_overlay_t* ov, const char* path, off_t new_size) {
+    if (!ov || !path || new_size < 0) return -1;
+
+    state_file_t* own = overlay_file(ov, path);
+    if (own && own->deleted) return -1;
+
+    if (!own) {
+        /* Copy up before the first write */
+        const state_file_t* under = base_file(ov->base, path);
+        if (!under) return -1;
+        if (reserve((void**)&ov->files, ov->file_count, &ov->file_capacity,
+                    sizeof(state_file_t)) != 0) {
+            return -1;
+        }
+        own = &ov->files[ov->file_count++];
+        *own = *under;
+    }
+
+    own->size = new_size;
+    own->mtime_offset = (int32_t)(time(NULL) - ov->base->boot_time);
+    own->ctime_offset = own->mtime_offset;
+    return 0;
+}
+
+int state_overlay_add_process(state_overlay_t* ov, const char* name, const char* cmdline,
+                              uid_t owner, pid_t ppid) {
+    if (!ov || !name || !*name) return -1;
+    if (ov->base->process_count - ov->killed_count + ov->process_count >= MAX_STATE_PROCESSES) {
+        return -1;
+    }
+    if (reserve((void**)&ov->processes, ov->process_count, &ov->process_capacity,
+                sizeof(state_process_t)) != 0) {
+        return -1;
+    }
+
+    /* Killed base PIDs stay taken, as they would until the kernel wraps */
+    pid_t pid = ov->next_pid;
+    do {
+        pid = (pid >= 32767) ? 300 : pid + 1;
+    } while (overlay_process_index(ov, pid) >= 0 || base_process(ov, pid) || base_pid_killed(ov, pid));
+    ov->next_pid = pid;
+
+    state_process_t* p = &ov->processes[ov->process_count++];
+    state_init_process_record(ov->base, p, pid, name, cmdline, owner, ppid);
+    ov->session.processes_started++;
+    return pid;
+}
+
+int state_overlay_kill_process(state_overlay_t* ov, pid_t pid) {
+    if (!ov || pid <= 1) return -1;  /* init can't be killed */
+
+    int i = overlay_process_index(ov, pid);
+    if (i >= 0) {
+        memmove(&ov->processes[i], &ov->processes[i + 1],
+                (size_t)(ov->process_count - i - 1) * sizeof(state_process_t));
+        ov->process_count--;
+
+        for (int c = ov->connection_count - 1; c >= 0; c--) {
+            if (ov->connections[c].owner_pid == pid) {
+                ov->connections[c] = ov->connections[--ov->connection_count];
+            }
+        }
+        return 0;
+    }
+
+    if (!base_process(ov, pid)) return -1;
+    if (reserve((void**)&ov->killed, ov->killed_count, &ov->killed_capacity,
+                sizeof(pid_t)) != 0) {
+        return -1;
+    }
+    ov->killed[ov->killed_count++] = pid;
+    return 0;
+}
+
+int state_overlay_add_connection(state_overlay_t* ov, const char* proto,
+                                 const char* local_ip, uint16_t local_port,
+                                 const char* remote_ip, uint16_t remote_port,
+                                 connection_state_t conn_state, pid_t owner) {
+    if (!ov || !proto || !local_ip) return -1;
+    if (reserve((void**)&ov->connections, ov->connection_count, &ov->connection_capacity,
+                sizeof(state_connection_t)) != 0) {
+        return -1;
+    }
+
+    state_connection_t* c = &ov->connections[ov->connection_count++];
+    memset(c, 0, sizeof(state_connection_t));
+    strncpy(c->protocol, proto, sizeof(c->protocol) - 1);
+    strncpy(c->local_ip, local_ip, MAX_IP_LENGTH - 1);
+    c->local_port = local_port;
+    strncpy(c->remote_ip, remote_ip ? remote_ip : "0.0.0.0", MAX_IP_LENGTH - 1);
+    c->remote_port = remote_port;
+    c->state = conn_state;
+    c->owner_pid = owner;
+    return 0;
+}
+
+int state_overlay_remove_connection(state_overlay_t* ov, const char* local_ip,
+                                    uint16_t local_port) {
+    if (!ov || !local_ip) return -1;
+
+    for (int i = 0; i < ov->connection_count; i++) {
+        state_connection_t* c = &ov->connections[i];
+        if (c->local_port == local_port && strcmp(c->local_ip, local_ip) == 0) {
+            *c = ov->connections[--ov->connection_count];
+            return 0;
+        }
+    }
+
+    const system_state_t* base = ov->base;
+    for (int i = 0; i < base->connection_count; i++) {
+        const state_connection_t* c = &base->connections[i];
+        if (c->local_port != local_port || strcmp(c->local_ip, local_ip) != 0) continue;
+        if (!base_socket_visible(ov, c)) continue;
+
+        if (reserve((void**)&ov->closed, ov->closed_count, &ov->closed_capacity,
+                    sizeof(state_socket_key_t)) != 0) {
+            return -1;
+        }
+        state_socket_key_t* key = &ov->closed[ov->closed_count++];
+        memcpy(key->local_ip, c->local_ip, MAX_IP_LENGTH);
+        key->local_port = local_port;
+        return 0;
+    }
+    return -1;
+}
+
+int state_overlay_add_log(state_overlay_t* ov, state_log_level_t level, const char* service,
+                          const char* message) {
+    if (!ov || !service || !message) return -1;
+
+    if (ov->log_count == ov->log_capacity && ov->log_capacity < MAX_STATE_LOG_ENTRIES) {
+        if (reserve((void**)&ov->logs, ov->log_count, &ov->log_capacity,
+                    sizeof(state_log_entry_t)) != 0) {
+            return -1;
+        }
+        if (ov->log_capacity > MAX_STATE_LOG_ENTRIES) ov->log_capacity = MAX_STATE_LOG_ENTRIES;
+        ov->log_write_index = ov->log_count;
+    }
+
+    state_init_log_entry(ov->base, &ov->logs[ov->log_write_index], level, service, message);
+    ov->log_write_index = (ov->log_write_index + 1) % ov->log_capacity;
+    if (ov->log_count < ov->log_capacity) ov->log_count++;
+    return 0;
+}
+
+void state_overlay_record_command(state_overlay_t* ov, const char* command) {
+    if (!ov || !command) return;
+    state_session_record_command(&ov->session, command);
+}
+
+void state_overlay_set_current_dir(state_overlay_t* ov, const char* path) {
+    if (!ov || !path) return;
+    strncpy(ov->session.current_dir, path, MAX_PATH_LENGTH - 1);
+    ov->session.current_dir[MAX_PATH_LENGTH - 1] = '\0';
+}
@@ -0,0 +1,261 @@
+/**
+ * state_path_index.c - Directory tree index over a state's files
+ * ============================================================================
+ *
+ * Nodes live in one growable array and are referred to by id, so growing
+ * it never invalidates links. The (parent, component) hash is open
+ * addressed and kept at most half full.
+ *
+ * ============================================================================
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "state_path_index.h"
+
+#define INITIAL_NODES       64
+#define INITIAL_NAMES       1024
+
+/* ============================================================================
+ * HASHING
+ * ============================================================================ */
+
+static uint32_t hash_component(int32_t parent, const char* name, size_t len) {
+    uint32_t h = 2166136261u ^ ((uint32_t)parent * 0x9E3779B1u);
+    for (size_t i = 0; i < len; i++) {
+        h = (h ^ (unsigned char)name[i]) * 16777619u;
+    }
+    return h;
+}
+
+static uint32_t node_hash(const path_index_t* index, int32_t id) {
+    const path_node_t* n = &index->nodes[id];
+    return hash_component(n->parent, index->names + n->name, n->name_len);
+}
+
+static int grow_buckets(path_index_t* index) {
+    uint32_t mask = index->bucket_mask ? index->bucket_mask * 2 + 1 : 127;
+    int32_t* buckets = calloc((size_t)mask + 1, sizeof(int32_t));
+    if (!buckets) return -1;
+
+    /* The root has no parent and is never looked up by name */
+    for (int32_t id = 1; id < index->node_count; id++) {
+        uint32_t at = node_hash(index, id) & mask;
+        while (buckets[at]) at = (at + 1) & mask;
+        buckets[at] = id + 1;
+    }
+
+    free(index->buckets);
+    index->buckets = buckets;
+    index->bucket_mask = mask;
+    return 0;
+}
+
+/* ============================================================================
+ * LIFECYCLE
+ * ============================================================================ */
+
+int path_index_init(path_index_t* index) {
+    if (!index) return -1;
+    memset(index, 0, sizeof(path_index_t));
+
+    index->nodes = malloc(INITIAL_NODES * sizeof(path_node_t));
+    index->names = malloc(INITIAL_NAMES);
+    if (!index->nodes || !index->names || grow_buckets(index) != 0) {
+        path_index_free(index);
+        return -1;
+    }
+    index->node_capacity = INITIAL_NODES;
+    index->names_capacity = INITIAL_NAMES;
+
+    path_index_clear(index);
+    return 0;
+}
+
+void path_index_free(path_index_t* index) {
+    if (!index) return;
+    free(index->nodes);
+    free(index->names);
+    free(index->buckets);
+    memset(index, 0, sizeof(path_index_t));
+}
+
+void path_index_clear(path_index_t* index) {
+    if (!index || !index->nodes) return;
+
+    path_node_t* root = &index->nodes[PATH_INDEX_ROOT];
+    memset(root, 0, sizeof(path_node_t));
+    root->parent = PATH_INDEX_NONE;
+    root->first_child = PATH_INDEX_NONE;
+    root->last_child = PATH_INDEX_NONE;
+    root->next_sibling = PATH_INDEX_NONE;
+    root->file = PATH_INDEX_NONE;
+    index->node_count = 1;
+    index->names_size = 0;
+    memset(index->buckets, 0, ((size_t)index->bucket_mask + 1) * sizeof(int32_t));
+}
+
+size_t path_index_memory_usage(const path_index_t* index) {
+    if (!index) return 0;
+    return (size_t)index->node_capacity * sizeof(path_node_t) + index->names_capacity +
+           ((size_t)index->bucket_mask + 1) * sizeof(int32_t);
+}
+
+/* ============================================================================
+ * LOOKUP
+ * ============================================================================ */
+
+int32_t path_index_child(const path_index_t* index, int32_t parent, const char* name, size_t len) {
+    if (!index || !index->buckets) return PATH_INDEX_NONE;
+
+    uint32_t at = hash_component(parent, name, len) & index->bucket_mask;
+    while (index->buckets[at]) {
+        int32_t id = index->buckets[at] - 1;
+        const path_node_t* n = &index->nodes[id];
+        if (n->parent == parent && n->name_len == len &&
+            memcmp(index->names + n->name, name, len) == 0) {
+            return id;
+        }
+        at = (at + 1) & index->bucket_mask;
+    }
+    return PATH_INDEX_NONE;
+}
+
+static int32_t add_child(path_index_t* index, int32_t parent, const char* name, size_t len) {
+    if (index->node_count == index->node_capacity) {
+        int32_t capacity = index->node_capacity * 2;
+        path_node_t* nodes = realloc(index->nodes, (size_t)capacity * sizeof(path_node_t));
+        if (!nodes) return PATH_INDEX_NONE;
+        index->nodes = nodes;
+        index->node_capacity = capacity;
+    }
+    if (index->names_size + len > index->names_capacity) {
+        size_t capacity = index->names_capacity * 2;
+        while (index->names_size + len > capacity) capacity *= 2;
+        char* names = realloc(index->names, capacity);
+        if (!names) return PATH_INDEX_NONE;
+        index->names = names;
+        index->names_capacity = capacity;
+    }
+    if ((uint32_t)(index->node_count + 1) * 2 > index->bucket_mask + 1 && grow_buckets(index) != 0) {
+        return PATH_INDEX_NONE;
+    }
+
+    int32_t id = index->node_count++;
+    path_node_t* n = &index->nodes[id];
+    memcpy(index->names + index->names_size, name, len);
+    n->name = (uint32_t)index->names_size;
+    n->name_len = (uint32_t)len;
+    index->names_size += len;
+    n->parent = parent;
+    n->first_child = PATH_INDEX_NONE;
+    n->last_child = PATH_INDEX_NONE;
+    n->next_sibling = PATH_INDEX_NONE;
+    n->file = PATH_INDEX_NONE;
+
+    path_node_t* p = &index->nodes[parent];
+    if (p->last_child == PATH_INDEX_NONE) {
+        p->first_child = id;
+    } else {
+        index->nodes[p->last_child].next_sibling = id;
+    }
+    p->last_child = id;
+
+    uint32_t at = hash_component(parent, name, len) & index->bucket_mask;
+    while (index->buckets[at]) at = (at + 1) & index->bucket_mask;
+    index->buckets[at] = id + 1;
+    return id;
+}
+
+/* Shared walk over the components of path; create says whether to add missing ones */
+static int32_t resolve(path_index_t* index, const char* path, int create) {
+    if (!index || !path || !index->nodes) return PATH_INDEX_NONE;
+
+    int32_t node = PATH_INDEX_ROOT;
+    const char* p = path;
+    while (*p) {
+        while (*p == '/') p++;
+        const char* start = p;
+        while (*p && *p != '/') p++;
+        size_t len = (size_t)(p - start);
+
+        if (len == 0 || (len == 1 && start[0] == '.')) continue;
+        if (len == 2 && start[0] == '.' && start[1] == '.') {
+            if (node != PATH_INDEX_ROOT) node = index->nodes[node].parent;
+            continue;
+        }
+
+        int32_t child = path_index_child(index, node, start, len);
+        if (child == PATH_INDEX_NONE) {
+            if (!create) return PATH_INDEX_NONE;
+            child = add_child(index, node, start, len);
+            if (child == PATH_INDEX_NONE) return PATH_INDEX_NONE;
+        }
+        node = child;
+    }
+    return node;
+}
+
+int32_t path_index_lookup(const path_index_t* index, const char* path) {
+    return resolve((path_index_t*)index, path, 0);
+}
+
+int32_t path_index_insert(path_index_t* index, const char* path) {
+    return resolve(index, path, 1);
+}
+
+int path_index_path(const path_index_t* index, int32_t node, char* buf, size_t size) {
+    if (!index || !buf || size < 2 || node < 0 || node >= index->node_count) return -1;
+
+    if (node == PATH_INDEX_ROOT) {
+        buf[0] = '/';
+        buf[1] = '\0';
+        return 1;
+    }
+
+    /* Measure, then fill from the end */
+    size_t total = 0;
+    for (int32_t n = node; n != PATH_INDEX_ROOT; n = index->nodes[n].parent) {
+        total += 1 + index->nodes[n].name_len;
+    }
+    if (total + 1 > size) return -1;
+
+    size_t end = total;
+    buf[end] = '\0';
+    for (int32_t n = node; n != PATH_INDEX_ROOT; n = index->nodes[n].parent) {
+        const path_node_t* pn = &index->nodes[n];
+        end -= pn->name_len;
+        memcpy(buf + end, index->names + pn->name, pn->name_len);
+        buf[--end] = '/';
+    }
+    return (int)total;
+}
+
+/* ============================================================================
+ * WALK
+ * ============================================================================ */
+
+int path_index_walk(const path_index_t* index, int32_t node, path_walk_fn fn, void* ctx) {
+    if (!index || !fn || node < 0 || node >= index->node_count) return 0;
+
+    /* Iterative pre-order: descend to first child, else next sibling, else climb */
+    int depth = 0;
+    int32_t n = node;
+    while (n != PATH_INDEX_NONE) {
+        int stop = fn(index, n, depth, ctx);
+        if (stop) return stop;
+
+        if (index->nodes[n].first_child != PATH_INDEX_NONE) {
+            n = index->nodes[n].first_child;
+            depth++;
+            continue;
+        }
+        while (n != node && index->nodes[n].next_sibling == PATH_INDEX_NONE) {
+            n = index->nodes[n].parent;
+            depth--;
+        }
+        n = (n == node) ? PATH_INDEX_NONE : index->nodes[n].next_sibling;
+    }
+    return 0;
+}
@@ -0,0 +1,442 @@
+/**
+ * state_persist.c - Saving, loading and exporting a system state
+ * ============================================================================
+ *
+ * WHY A BINARY FORMAT:
+ * Without one, every restart built a brand new fake device: new uptime,
+ * new hostname, new processes. An attacker who came back after a restart
+ * found a different machine at the same address.
+ *
+ * A saved state is the system_state_t itself followed by its file table,
+ * so loading is one mmap(), a memcpy() of the fixed part and a walk over
+ * the file records to rebuild the path index - a few milliseconds even
+ * for a large tree. Pointers are cleared on save; the content cache is
+ * not saved and fills again on first read.
+ *
+ * FILE LAYOUT (native byte order, checked on load):
+ *   header | system_state_t | files[] | checksum
+ *
+ * The header records the format version and the record sizes, so a file
+ * from a build with a different layout is refused rather than misread,
+ * and the trailing checksum catches truncated or damaged files. Writes go
+ * to a temp file that is fsync'd and renamed over the old one, so a crash
+ * leaves either the old or the new state, never half of one.
+ *
+ * The boot time is stored as a wall clock time: a loaded device has been
+ * "up" while the honeypot was down, and the simulation clock advances its
+ * counters over the gap on the first read.
+ *
+ * ============================================================================
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "state_engine.h"
+
+#define STATE_FILE_MAGIC    "CERBSTA"       /* 8 bytes with the terminator */
+#define STATE_FILE_ENDIAN   0x01020304u
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t endian;
+    int64_t saved_at;
+    uint32_t state_size;            /* Record sizes guard against layout changes */
+    uint32_t file_size;
+    uint32_t file_count;
+    uint32_t reserved;
+} state_file_header_t;
+
+/* ============================================================================
+ * CHECKSUM
+ * ============================================================================ */
+
+/* Word-at-a-time FNV variant, as used for the quorum snapshots */
+static uint64_t checksum_update(uint64_t hash, const void* data, size_t len) {
+    const unsigned char* p = (const unsigned char*)data;
+    while (len >= 8) {
+        uint64_t word;
+        memcpy(&word, p, 8);
+        hash = (hash ^ word) * 1099511628211ull;
+        p += 8;
+        len -= 8;
+    }
+    while (len-- > 0) {
+        hash = (hash ^ *p++) * 1099511628211ull;
+    }
+    return hash;
+}
+
+#define CHECKSUM_SEED 14695981039346656037ull
+
+/* ============================================================================
+ * SAVE
+ * ============================================================================ */
+
+typedef struct {
+    FILE* f;
+    uint64_t checksum;
+    bool failed;
+} state_writer_t;
+
+static void write_record(state_writer_t* w, const void* data, size_t size) {
+    if (w->failed || size == 0) return;
+    if (fwrite(data, size, 1, w->f) != 1) {
+        w->failed = true;
+        return;
+    }
+    w->checksum = checksum_update(w->checksum, data, size);
+}
+
+int state_save_to_file(system_state_t* state, const char* filepath) {
+    if (!state || !filepath || !state->is_initialized || state->file_count < 0) return -1;
+
+    /* The fixed part, minus everything that points into this process */
+    system_state_t* copy = malloc(sizeof(system_state_t));
+    if (!copy) return -1;
+    memcpy(copy, state, sizeof(system_state_t));
+    copy->files = NULL;
+    copy->file_capacity = 0;
+    memset(&copy->file_index, 0, sizeof(copy->file_index));
+    memset(copy->content_cache, 0, sizeof(copy->content_cache));
+
+    state_file_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, STATE_FILE_MAGIC, sizeof(header.magic));
+    header.version = STATE_FILE_VERSION;
+    header.endian = STATE_FILE_ENDIAN;
+    header.saved_at = (int64_t)time(NULL);
+    header.state_size = sizeof(system_state_t);
+    header.file_size = sizeof(state_file_t);
+    header.file_count = (uint32_t)state->file_count;
+
+    char tmp_path[600];
+    if ((size_t)snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", filepath) >= sizeof(tmp_path)) {
+        free(copy);
+        return -1;
+    }
+    FILE* f = fopen(tmp_path, "wb");
+    if (!f) {
+        free(copy);
+        return -1;
+    }
+
+    state_writer_t w = { f, CHECKSUM_SEED, false };
+    write_record(&w, &header, sizeof(header));
+    write_record(&w, copy, sizeof(system_state_t));
+    write_record(&w, state->files, (size_t)state->file_count * sizeof(state_file_t));
+    free(copy);
+
+    uint64_t checksum = w.checksum;
+    if (!w.failed && fwrite(&checksum, sizeof(checksum), 1, f) != 1) {
+        w.failed = true;
+    }
+    if (!w.failed && (fflush(f) != 0 || fsync(fileno(f)) != 0)) {
+        w.failed = true;
+    }
+    if (fclose(f) != 0 || w.failed || rename(tmp_path, filepath) != 0) {
+        unlink(tmp_path);
+        return -1;
+    }
+    return 0;
+}
+
+/* ============================================================================
+ * LOAD
+ * ============================================================================ */
+
+static const char* validate(const unsigned char* data, size_t size,
+                            const state_file_header_t** out) {
+    if (size < sizeof(state_file_header_t) + sizeof(uint64_t)) return "file too short";
+
+    const state_file_header_t* header = (const state_file_header_t*)data;
+    if (memcmp(header->magic, STATE_FILE_MAGIC, sizeof(header->magic)) != 0) return "not a saved state";
+    if (header->version != STATE_FILE_VERSION) return "unsupported version";
+    if (header->endian != STATE_FILE_ENDIAN) return "written on another architecture";
+    if (header->state_size != sizeof(system_state_t) || header->file_size != sizeof(state_file_t)) {
+        return "record layout differs from this build";
+    }
+    if (header->file_count > MAX_STATE_FILES) return "counts out of range";
+
+    uint64_t expected = sizeof(state_file_header_t) + sizeof(system_state_t) +
+                        (uint64_t)header->file_count * sizeof(state_file_t);
+    if (expected + sizeof(uint64_t) != size) return "size does not match header";
+
+    uint64_t stored;
+    memcpy(&stored, data + expected, sizeof(stored));
+    if (checksum_update(CHECKSUM_SEED, data, expected) != stored) return "checksum mismatch";
+
+    const system_state_t* saved = (const system_state_t*)(header + 1);
+    if (saved->user_count < 0 || saved->user_count > MAX_STATE_USERS ||
+        saved->process_count < 0 || saved->process_count > MAX_STATE_PROCESSES ||
+        saved->interface_count < 0 || saved->interface_count > MAX_STATE_INTERFACES ||
+        saved->connection_count < 0 || saved->connection_count > MAX_STATE_CONNECTIONS ||
+        saved->mount_count < 0 || saved->mount_count > MAX_STATE_MOUNTS ||
+        saved->log_count < 0 || saved->log_count > MAX_STATE_LOG_ENTRIES ||
+        saved->log_write_index < 0 || saved->log_write_index >= MAX_STATE_LOG_ENTRIES ||
+        (uint32_t)saved->file_count != header->file_count) {
+        return "counts out of range";
+    }
+
+    *out = header;
+    return NULL;
+}
+
+int state_load_from_file(system_state_t* state, const char* filepath) {
+    if (!state || !filepath) return -1;
+
+    int fd = open(filepath, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return -1;
+    }
+    size_t size = (size_t)st.st_size;
+    void* map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return -1;
+    madvise(map, size, MADV_SEQUENTIAL);
+
+    const unsigned char* data = (const unsigned char*)map;
+    const state_file_header_t* header = NULL;
+    if (validate(data, size, &header) != NULL) {
+        munmap(map, size);
+        return -1;
+    }
+
+    const system_state_t* saved = (const system_state_t*)(header + 1);
+    const state_file_t* files = (const state_file_t*)(saved + 1);
+
+    memcpy(state, saved, sizeof(system_state_t));
+    state->files = NULL;
+    state->file_count = 0;
+    state->file_capacity = 0;
+    memset(state->content_cache, 0, sizeof(state->content_cache));
+
+    int result = path_index_init(&state->file_index);
+    for (uint32_t i = 0; result == 0 && i < header->file_count; i++) {
+        result = state_append_file_record(state, &files[i]);
+    }
+    munmap(map, size);
+
+    if (result != 0) {
+        state_engine_destroy(state);
+        return -1;
+    }
+    state_mark_changed(state, STATE_INPUT_ALL);
+    return 0;
+}
+
+/* ============================================================================
+ * JSON EXPORT
+ * ============================================================================ */
+
+static void json_string(state_sink_t* out, const char* s) {
+    state_sink_write(out, "\"", 1);
+    const char* run = s;
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c >= 0x20 && c != '"' && c != '\\') continue;
+
+        state_sink_write(out, run, (size_t)(s - run));
+        switch (c) {
+            case '"':  state_sink_puts(out, "\\\""); break;
+            case '\\': state_sink_puts(out, "\\\\"); break;
+            case '\n': state_sink_puts(out, "\\n"); break;
+            case '\r': state_sink_puts(out, "\\r"); break;
+            case '\t': state_sink_puts(out, "\\t"); break;
+            default:   state_sink_printf(out, "\\u%04x", c); break;
+        }
+        run = s + 1;
+    }
+    state_sink_write(out, run, (size_t)(s - run));
+    state_sink_write(out, "\"", 1);
+}
+
+/* "key":"value" with an optional leading comma */
+static void json_field(state_sink_t* out, const char* key, const char* value, bool first) {
+    state_sink_printf(out, "%s\"%s\":", first ? "" : ",", key);
+    json_string(out, value);
+}
+
+static const char* const proc_states[] = { "R", "S", "D", "Z", "T" };
+static const char* const log_levels[] = { "debug", "info", "notice", "warning", "error", "critical" };
+static const char* const conn_states[] = {
+    "ESTABLISHED", "LISTEN", "TIME_WAIT", "CLOSE_WAIT", "SYN_SENT", "SYN_RECV"
+};
+
+#define NAME_OF(table, i) \
+    ((size_t)(i) < sizeof(table) / sizeof(table[0]) ? table[i] : "?")
+
+static void write_identity(const system_state_t* state, state_sink_t* out) {
+    const device_profile_t* p = &state->profile;
+    json_field(out, "hostname", state->hostname, true);
+    state_sink_printf(out, ",\"profile\":{");
+    json_field(out, "name", p->name, true);
+    json_field(out, "vendor", p->vendor, false);
+    json_field(out, "model", p->model, false);
+    json_field(out, "cpu", p->cpu_model, false);
+    json_field(out, "kernel", p->kernel_version, false);
+    json_field(out, "os", p->os_name, false);
+    json_field(out, "os_version", p->os_version, false);
+    state_sink_printf(out, ",\"cores\":%u,\"ram_kb\":%u}", p->cpu_cores, p->total_ram_kb);
+    state_sink_printf(out, ",\"seed\":%u,\"boot_time\":%lld,\"uptime\":%u,\"version\":%u",
+                      state->state_seed, (long long)state->boot_time, state->uptime_seconds,
+                      state->state_version);
+    state_sink_printf(out, ",\"resources\":{\"total_kb\":%u,\"used_kb\":%u,\"cached_kb\":%u,"
+                      "\"buffers_kb\":%u,\"cpu\":%u,\"load\":[%.2f,%.2f,%.2f]}",
+                      state->total_memory_kb, state->used_memory_kb, state->cached_memory_kb,
+                      state->buffer_memory_kb, state->cpu_usage_percent,
+                      state->load_avg_1 / 100.0, state->load_avg_5 / 100.0,
+                      state->load_avg_15 / 100.0);
+}
+
+static void write_users(const system_state_t* state, state_sink_t* out) {
+    state_sink_printf(out, ",\"users\":[");
+    for (int i = 0; i < state->user_count; i++) {
+        const state_user_t* u = &state->users[i];
+        state_sink_printf(out, "%s{\"uid\":%u,\"gid\":%u", i ? "," : "", (unsigned)u->uid,
+                          (unsigned)u->gid);
+        json_field(out, "name", u->username, false);
+        json_field(out, "home", u->home_dir, false);
+        json_field(out, "shell", u->shell, false);
+        state_sink_printf(out, ",\"login\":%s}", u->can_login ? "true" : "false");
+    }
+    state_sink_printf(out, "]");
+}
+
+static void write_processes(const system_state_t* state, state_sink_t* out) {
+    state_sink_printf(out, ",\"processes\":[");
+    for (int i = 0; i < state->process_count; i++) {
+        const state_process_t* p = &state->processes[i];
+        state_sink_printf(out, "%s{\"pid\":%d,\"ppid\":%d,\"uid\":%u", i ? "," : "", (int)p->pid,
+                          (int)p->ppid, (unsigned)p->uid);
+        json_field(out, "name", p->name, false);
+        json_field(out, "cmdline", p->cmdline, false);
+        json_field(out, "state", NAME_OF(proc_states, p->state), false);
+        state_sink_printf(out, ",\"rss_kb\":%u,\"vsz_kb\":%u,\"cpu\":%u,\"cpu_time_ms\":%u,"
+                          "\"kernel\":%s,\"visible\":%s}",
+                          p->memory_kb, p->virtual_kb, p->cpu_percent, p->cpu_time_ms,
+                          p->is_kernel_thread ? "true" : "false",
+                          p->visible_in_ps ? "true" : "false");
+    }
+    state_sink_printf(out, "]");
+}
+
+static void write_network(const system_state_t* state, state_sink_t* out) {
+    state_sink_printf(out, ",\"interfaces\":[");
+    for (int i = 0; i < state->interface_count; i++) {
+        const state_interface_t* iface = &state->interfaces[i];
+        state_sink_printf(out, "%s{", i ? "," : "");
+        json_field(out, "name", iface->name, true);
+        json_field(out, "ip", iface->ip_address, false);
+        json_field(out, "mac", iface->mac_address, false);
+        state_sink_printf(out, ",\"up\":%s,\"rx_bytes\":%llu,\"tx_bytes\":%llu,"
+                          "\"rx_packets\":%llu,\"tx_packets\":%llu}",
+                          iface->is_up ? "true" : "false",
+                          (unsigned long long)iface->rx_bytes, (unsigned long long)iface->tx_bytes,
+                          (unsigned long long)iface->rx_packets, (unsigned long long)iface->tx_packets);
+    }
+    state_sink_printf(out, "]");
+
+    state_sink_printf(out, ",\"connections\":[");
+    for (int i = 0; i < state->connection_count; i++) {
+        const state_connection_t* c = &state->connections[i];
+        state_sink_printf(out, "%s{", i ? "," : "");
+        json_field(out, "proto", c->protocol, true);
+        json_field(out, "local", c->local_ip, false);
+        state_sink_printf(out, ",\"local_port\":%u", c->local_port);
+        json_field(out, "remote", c->remote_ip, false);
+        state_sink_printf(out, ",\"remote_port\":%u", c->remote_port);
+        json_field(out, "state", NAME_OF(conn_states, c->state), false);
+        state_sink_printf(out, ",\"pid\":%d}", (int)c->owner_pid);
+    }
+    state_sink_printf(out, "]");
+}
+
+static void write_storage(const system_state_t* state, state_sink_t* out) {
+    state_sink_printf(out, ",\"mounts\":[");
+    for (int i = 0; i < state->mount_count; i++) {
+        const state_mount_t* m = &state->mounts[i];
+        state_sink_printf(out, "%s{", i ? "," : "");
+        json_field(out, "device", m->device, true);
+        json_field(out, "path", m->mount_point, false);
+        json_field(out, "type", m->fs_type, false);
+        state_sink_printf(out, ",\"total_kb\":%llu,\"used_kb\":%llu}",
+                          (unsigned long long)m->total_kb, (unsigned long long)m->used_kb);
+    }
+    state_sink_printf(out, "]");
+
+    int live = 0;
+    for (int i = 0; i < state->file_count; i++) live += !state->files[i].deleted;
+    state_sink_printf(out, ",\"files\":%d", live);
+}
+
+static void write_logs(const system_state_t* state, state_sink_t* out) {
+    /* Oldest first, like the ring is read for syslog */
+    int first = (state->log_count == MAX_STATE_LOG_ENTRIES) ? state->log_write_index : 0;
+    state_sink_printf(out, ",\"logs\":[");
+    for (int i = 0; i < state->log_count; i++) {
+        const state_log_entry_t* e = &state->logs[(first + i) % MAX_STATE_LOG_ENTRIES];
+        state_sink_printf(out, "%s{\"time\":%lld", i ? "," : "",
+                          (long long)(state->boot_time + e->time_offset));
+        json_field(out, "level", NAME_OF(log_levels, e->level), false);
+        json_field(out, "service", e->service, false);
+        json_field(out, "message", e->message, false);
+        state_sink_printf(out, "}");
+    }
+    state_sink_printf(out, "]");
+}
+
+static void write_session(const system_state_t* state, state_sink_t* out) {
+    if (!state->has_active_session) {
+        state_sink_printf(out, ",\"session\":null");
+        return;
+    }
+    const attacker_session_t* s = &state->current_session;
+    state_sink_printf(out, ",\"session\":{");
+    json_field(out, "id", s->session_id, true);
+    json_field(out, "ip", s->source_ip, false);
+    state_sink_printf(out, ",\"port\":%u,\"connected\":%lld", s->source_port,
+                      (long long)s->connect_time);
+    json_field(out, "user", s->username, false);
+    json_field(out, "cwd", s->current_dir, false);
+    json_field(out, "last_command", s->last_command, false);
+    state_sink_printf(out, ",\"commands\":%u,\"files_created\":%u,\"files_deleted\":%u,"
+                      "\"processes_started\":%u,\"suspicious\":%s}",
+                      s->commands_executed, s->files_created, s->files_deleted,
+                      s->processes_started, s->is_suspicious ? "true" : "false");
+}
+
+int state_write_json(const system_state_t* state, state_sink_t* out) {
+    if (!state || !out) return -1;
+
+    state_sink_printf(out, "{");
+    write_identity(state, out);
+    write_users(state, out);
+    write_processes(state, out);
+    write_network(state, out);
+    write_storage(state, out);
+    write_logs(state, out);
+    write_session(state, out);
+    state_sink_printf(out, "}\n");
+    return 0;
+}
+
+int state_export_json(system_state_t* state, char* buffer, size_t buffer_size) {
+    state_sink_t out;
+    if (state_sink_init_fixed(&out, buffer, buffer_size) != 0) return -1;
+    if (state_write_json(state, &out) != 0 || !state_sink_ok(&out)) {
+        buffer[0] = '\0';               /* Half a JSON document is no use */
+        return -1;
+    }
+    return (int)out.length;
+}
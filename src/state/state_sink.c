@@ -0,0 +1,347 @@
+/**
+ * state_sink.c - Output sinks for the state generators
+ * ============================================================================
+ *
+ * Heap chunks start at STATE_SINK_CHUNK_SIZE and double up to 64 KB, so a
+ * one-line output costs one small allocation and a huge one a few dozen.
+ * state_sink_write() fills the current chunk and carries on in the next;
+ * state_sink_printf() keeps each formatted piece in one chunk, starting a
+ * fresh one when the tail is too small.
+ *
+ * ============================================================================
+ */
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "state_sink.h"
+
+#define MAX_CHUNK_SIZE      (64 * 1024)
+#define WRITEV_BATCH        64
+
+/* ============================================================================
+ * SETUP
+ * ============================================================================ */
+
+void state_sink_init_buffer(state_sink_t* sink) {
+    memset(sink, 0, sizeof(state_sink_t));
+    sink->mode = STATE_SINK_BUFFER;
+    sink->fd = -1;
+}
+
+void state_sink_init_fd(state_sink_t* sink, int fd) {
+    state_sink_init_buffer(sink);
+    sink->mode = STATE_SINK_FD;
+    sink->fd = fd;
+}
+
+int state_sink_init_fixed(state_sink_t* sink, char* buf, size_t size) {
+    if (!sink || !buf || size == 0) return -1;
+    memset(sink, 0, sizeof(state_sink_t));
+    sink->mode = STATE_SINK_FIXED;
+    sink->fd = -1;
+    sink->first.data = buf;
+    sink->first.capacity = size;
+    sink->chunks = &sink->first;
+    sink->chunk_count = 1;
+    sink->chunk_capacity = 1;
+    buf[0] = '\0';
+    return 0;
+}
+
+void state_sink_free(state_sink_t* sink) {
+    if (!sink) return;
+    if (sink->mode != STATE_SINK_FIXED) {
+        for (int i = 0; i < sink->chunk_count; i++) {
+            free(sink->chunks[i].data);
+        }
+        free(sink->chunks);
+    }
+    sink->chunks = NULL;
+    sink->chunk_count = 0;
+    sink->chunk_capacity = 0;
+    sink->length = 0;
+}
+
+/* Drop the held bytes, keeping the first chunk for reuse */
+static void empty(state_sink_t* sink) {
+    if (sink->mode != STATE_SINK_FIXED) {
+        for (int i = 1; i < sink->chunk_count; i++) {
+            free(sink->chunks[i].data);
+        }
+        if (sink->chunk_count > 1) sink->chunk_count = 1;
+    }
+    if (sink->chunk_count > 0) {
+        sink->chunks[0].length = 0;
+        sink->chunks[0].data[0] = '\0';
+    }
+    sink->length = 0;
+    sink->full = false;
+}
+
+/* ============================================================================
+ * WRITING
+ * ============================================================================ */
+
+static state_sink_chunk_t* add_chunk(state_sink_t* sink, size_t need) {
+    if (sink->chunk_count == sink->chunk_capacity) {
+        int capacity = sink->chunk_capacity ? sink->chunk_capacity * 2 : 4;
+        state_sink_chunk_t* chunks = realloc(sink->chunks, (size_t)capacity * sizeof(state_sink_chunk_t));
+        if (!chunks) return NULL;
+        sink->chunks = chunks;
+        sink->chunk_capacity = capacity;
+    }
+
+    size_t capacity = STATE_SINK_CHUNK_SIZE;
+    for (int i = 0; i < sink->chunk_count && capacity < MAX_CHUNK_SIZE; i++) capacity *= 2;
+    if (capacity < need + 1) capacity = need + 1;
+
+    state_sink_chunk_t* c = &sink->chunks[sink->chunk_count];
+    c->data = malloc(capacity);
+    if (!c->data) return NULL;
+    c->data[0] = '\0';
+    c->length = 0;
+    c->capacity = capacity;
+    sink->chunk_count++;
+    return c;
+}
+
+static size_t room(const state_sink_chunk_t* c) {
+    return c->capacity - c->length - 1;
+}
+
+static state_sink_chunk_t* last_chunk(state_sink_t* sink) {
+    return sink->chunk_count ? &sink->chunks[sink->chunk_count - 1] : NULL;
+}
+
+/* Bookkeeping after bytes landed in the last chunk */
+static void commit(state_sink_t* sink, state_sink_chunk_t* c, size_t length) {
+    c->length += length;
+    c->data[c->length] = '\0';
+    sink->length += length;
+    if (sink->mode == STATE_SINK_FD && sink->length >= STATE_SINK_FLUSH_BYTES) {
+        state_sink_flush(sink);
+    }
+}
+
+int state_sink_write(state_sink_t* sink, const void* data, size_t length) {
+    if (!sink || (!data && length) || sink->failed || sink->full) return -1;
+    if (length > (size_t)INT32_MAX) return -1;
+
+    if (sink->mode == STATE_SINK_FIXED) {
+        state_sink_chunk_t* c = &sink->first;
+        if (length > room(c)) {
+            sink->full = true;
+            return -1;
+        }
+        memcpy(c->data + c->length, data, length);
+        commit(sink, c, length);
+        return (int)length;
+    }
+
+    const char* p = data;
+    size_t left = length;
+    while (left > 0) {
+        state_sink_chunk_t* c = last_chunk(sink);
+        if (!c || room(c) == 0) c = add_chunk(sink, left);
+        if (!c) {
+            sink->failed = true;
+            return -1;
+        }
+        size_t n = left < room(c) ? left : room(c);
+        memcpy(c->data + c->length, p, n);
+        commit(sink, c, n);
+        p += n;
+        left -= n;
+    }
+    return (int)length;
+}
+
+int state_sink_puts(state_sink_t* sink, const char* s) {
+    return s ? state_sink_write(sink, s, strlen(s)) : -1;
+}
+
+int state_sink_printf(state_sink_t* sink, const char* fmt, ...) {
+    if (!sink || !fmt || sink->failed || sink->full) return -1;
+
+    state_sink_chunk_t* c = last_chunk(sink);
+    if (!c && sink->mode != STATE_SINK_FIXED) c = add_chunk(sink, 0);
+    if (!c) {
+        sink->failed = true;
+        return -1;
+    }
+
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(c->data + c->length, room(c) + 1, fmt, ap);
+    va_end(ap);
+    if (n < 0) {
+        c->data[c->length] = '\0';
+        sink->failed = true;
+        return -1;
+    }
+
+    if ((size_t)n > room(c)) {
+        c->data[c->length] = '\0';     /* Drop the partial line */
+        if (sink->mode == STATE_SINK_FIXED) {
+            sink->full = true;
+            return -1;
+        }
+
+        /* Format again into a chunk that fits it whole */
+        c = add_chunk(sink, (size_t)n);
+        if (!c) {
+            sink->failed = true;
+            return -1;
+        }
+        va_start(ap, fmt);
+        vsnprintf(c->data, room(c) + 1, fmt, ap);
+        va_end(ap);
+    }
+
+    commit(sink, c, (size_t)n);
+    return n;
+}
+
+/* ============================================================================
+ * READING OUT
+ * ============================================================================ */
+
+size_t state_sink_total(const state_sink_t* sink) {
+    return sink ? sink->flushed + sink->length : 0;
+}
+
+int state_sink_iov(const state_sink_t* sink, struct iovec* iov, int max) {
+    if (!sink || !iov) return 0;
+    int n = 0;
+    for (int i = 0; i < sink->chunk_count && n < max; i++) {
+        if (sink->chunks[i].length == 0) continue;
+        iov[n].iov_base = sink->chunks[i].data;
+        iov[n].iov_len = sink->chunks[i].length;
+        n++;
+    }
+    return n;
+}
+
+/* Drop the first `chunk` chunks and `offset` bytes of the next: fd has them */
+static void consume(state_sink_t* sink, int chunk, size_t offset) {
+    size_t dropped = offset;
+    for (int i = 0; i < chunk; i++) dropped += sink->chunks[i].length;
+
+    if (sink->mode != STATE_SINK_FIXED && chunk > 0) {
+        for (int i = 0; i < chunk; i++) free(sink->chunks[i].data);
+        memmove(sink->chunks, sink->chunks + chunk,
+                (size_t)(sink->chunk_count - chunk) * sizeof(state_sink_chunk_t));
+        sink->chunk_count -= chunk;
+    }
+    if (offset > 0 && sink->chunk_count > 0) {
+        state_sink_chunk_t* c = &sink->chunks[0];
+        memmove(c->data, c->data + offset, c->length - offset + 1);
+        c->length -= offset;
+    }
+    sink->length -= dropped;
+}
+
+ssize_t state_sink_writev(state_sink_t* sink, int fd) {
+    if (!sink || fd < 0) return -1;
+
+    /* Position in the chunk chain, so short writes resume where they stopped */
+    int chunk = 0;
+    size_t offset = 0;
+    ssize_t total = 0;
+
+    while (chunk < sink->chunk_count) {
+        struct iovec iov[WRITEV_BATCH];
+        int n = 0;
+        for (int i = chunk; i < sink->chunk_count && n < WRITEV_BATCH; i++) {
+            size_t skip = (i == chunk) ? offset : 0;
+            if (sink->chunks[i].length == skip) continue;
+            iov[n].iov_base = sink->chunks[i].data + skip;
+            iov[n].iov_len = sink->chunks[i].length - skip;
+            n++;
+        }
+        if (n == 0) break;
+
+        ssize_t w = writev(fd, iov, n);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            consume(sink, chunk, offset);
+            sink->failed = true;
+            return -1;
+        }
+        total += w;
+
+        size_t left = (size_t)w;
+        while (left > 0 && chunk < sink->chunk_count) {
+            size_t avail = sink->chunks[chunk].length - offset;
+            if (left < avail) {
+                offset += left;
+                left = 0;
+            } else {
+                left -= avail;
+                chunk++;
+                offset = 0;
+            }
+        }
+        while (chunk < sink->chunk_count && sink->chunks[chunk].length == offset) {
+            chunk++;
+            offset = 0;
+        }
+    }
+
+    empty(sink);
+    return total;
+}
+
+int state_sink_flush(state_sink_t* sink) {
+    if (!sink || sink->mode != STATE_SINK_FD) return -1;
+    if (sink->length == 0) return 0;
+
+    size_t held = sink->length;
+    int result = state_sink_writev(sink, sink->fd) < 0 ? -1 : 0;
+    sink->flushed += held - sink->length;
+    return result;
+}
+
+size_t state_sink_copy(const state_sink_t* sink, char* buf, size_t size) {
+    if (!sink || !buf || size == 0) return 0;
+
+    size_t written = 0;
+    for (int i = 0; i < sink->chunk_count && written < size - 1; i++) {
+        size_t n = sink->chunks[i].length;
+        if (n > size - 1 - written) n = size - 1 - written;
+        memcpy(buf + written, sink->chunks[i].data, n);
+        written += n;
+    }
+    buf[written] = '\0';
+    return written;
+}
+
+char* state_sink_detach(state_sink_t* sink, size_t* length) {
+    if (!sink || sink->failed) return NULL;
+
+    char* out;
+    if (sink->mode != STATE_SINK_FIXED && sink->chunk_count == 1) {
+        out = sink->chunks[0].data;
+        sink->chunk_count = 0;
+    } else {
+        out = malloc(sink->length + 1);
+        if (!out) return NULL;
+        state_sink_copy(sink, out, sink->length + 1);
+    }
+
+    if (length) *length = sink->length;
+    if (sink->mode != STATE_SINK_FIXED) {
+        size_t flushed = sink->flushed;
+        state_sink_free(sink);
+        sink->flushed = flushed;
+    } else {
+        empty(sink);
+    }
+    return out;
+}
@@ -15,8 +15,10 @@ void log_event(const char* msg) {
 }
 
 void log_event_level(log_level_t level, const char* msg) {
+    // ctime_r, not ctime: morph phases log from several threads at once
     time_t now = time(NULL);
-    char* time_str = ctime(&now);
+    char time_str[32];
+    ctime_r(&now, time_str);
     time_str[strlen(time_str) - 1] = '\0'; // Remove newline
     
     const char* level_str;
@@ -35,7 +37,8 @@ void log_to_file(const char* filepath, const char* msg) {
     FILE* f = fopen(filepath, "a");
     if (f) {
         time_t now = time(NULL);
-        char* time_str = ctime(&now);
+        char time_str[32];
+        ctime_r(&now, time_str);
         time_str[strlen(time_str) - 1] = '\0';
         fprintf(f, "[%s] %s\n", time_str, msg);
         fclose(f);
@@ -46,7 +49,8 @@ void log_event_file(log_level_t level, const char* filepath, const char* msg) {
     FILE* f = fopen(filepath, "a");
     if (f) {
         time_t now = time(NULL);
-        char* time_str = ctime(&now);
+        char time_str[32];
+        ctime_r(&now, time_str);
         time_str[strlen(time_str) - 1] = '\0';
         
         const char* level_str;
@@ -89,16 +93,34 @@ int read_file(const char* filepath, char* buffer, size_t buffer_size) {
     return (int)bytes_read;
 }
 
+// Writers build the new file next to the old one and rename it into place,
+// so a reader (Cowrie, nginx) sees either the old file or the new one -
+// never a truncated one halfway through a morph.
+static FILE* open_replacement(const char* filepath, char* tmp_path, size_t tmp_size) {
+    if ((size_t)snprintf(tmp_path, tmp_size, "%s.tmp", filepath) >= tmp_size) {
+        return NULL;
+    }
+    return fopen(tmp_path, "w");
+}
+
+static int commit_replacement(FILE* f, const char* tmp_path, const char* filepath, bool failed) {
+    if (ferror(f)) failed = true;
+    if (fclose(f) != 0 || failed || rename(tmp_path, filepath) != 0) {
+        remove(tmp_path);
+        return -1;
+    }
+    return 0;
+}
+
 int write_file(const char* filepath, const char* content) {
-    FILE* f = fopen(filepath, "w");
+    char tmp_path[1024];
+    FILE* f = open_replacement(filepath, tmp_path, sizeof(tmp_path));
     if (!f) {
         return -1;
     }
     
     int result = fprintf(f, "%s", content);
-    fclose(f);
-    
-    return (result >= 0) ? 0 : -1;
+    return commit_replacement(f, tmp_path, filepath, result < 0);
 }
 
 int append_file(const char* filepath, const char* content) {
@@ -119,7 +141,8 @@ int copy_file(const char* src, const char* dst) {
         return -1;
     }
     
-    FILE* dst_f = fopen(dst, "w");
+    char tmp_path[1024];
+    FILE* dst_f = open_replacement(dst, tmp_path, sizeof(tmp_path));
     if (!dst_f) {
         fclose(src_f);
         return -1;
@@ -127,14 +150,17 @@ int copy_file(const char* src, const char* dst) {
     
     char buffer[4096];
     size_t bytes;
+    bool failed = false;
     while ((bytes = fread(buffer, 1, sizeof(buffer), src_f)) > 0) {
-        fwrite(buffer, 1, bytes, dst_f);
+        if (fwrite(buffer, 1, bytes, dst_f) != bytes) {
+            failed = true;
+            break;
+        }
     }
+    if (ferror(src_f)) failed = true;
     
     fclose(src_f);
-    fclose(dst_f);
-    
-    return 0;
+    return commit_replacement(dst_f, tmp_path, dst, failed);
 }
 
 // String utilities
@@ -196,8 +222,8 @@ int create_dir(const char* dirpath) {
         return 0; // Already exists
     }
     
-    // Try to create directory
-    if (mkdir(dirpath, 0755) == 0) {
+    // Try to create directory (EEXIST: another thread just made it)
+    if (mkdir(dirpath, 0755) == 0 || errno == EEXIST) {
         return 0;
     }
     
@@ -209,7 +235,7 @@ int create_dir(const char* dirpath) {
         *last_slash = '\0';
         if (create_dir(path_copy) == 0) {
             free(path_copy);
-            return mkdir(dirpath, 0755) == 0 ? 0 : -1;
+            return (mkdir(dirpath, 0755) == 0 || errno == EEXIST) ? 0 : -1;
         }
     }
     
